@@ -25,6 +25,8 @@ extern "C"
         unsigned math_type;
         unsigned output_mode;
         char log_level;
+        /* the number of threads used for compilation, 0 for the hardware concurrency */
+        unsigned num_threads;
     } configuration;
     
     #define MATH_TYPE_FAST 1
@@ -33,6 +33,14 @@ namespace vc4c
 		SPIR_V = 2
 	};
 
+	enum class RegisterAllocator
+	{
+		//uses the linear-scan allocator for kernels with more instructions than the configured threshold, the graph coloring otherwise
+		AUTO = 0,
+		GRAPH_COLORING = 1,
+		LINEAR_SCAN = 2
+	};
+
 	/*
 	 * The maximum VPM size to be used (in bytes).
 	 *
@@ -52,6 +60,16 @@ namespace vc4c
 	    unsigned availableVPMSize = VPM_DEFAULT_SIZE;
 	    Frontend frontend = Frontend::DEFAULT;
 	    bool autoVectorization = false;
+	    //the maximum number of additional rounds of the single-step optimizations, which only re-visit the instructions affected by modifications of the previous round
+	    unsigned additionalOptimizationRounds = 4;
+	    RegisterAllocator registerAllocator = RegisterAllocator::AUTO;
+	    //the number of instructions of a kernel, above which the faster linear-scan register allocator is selected automatically
+	    unsigned linearScanThreshold = 8192;
+	    //whether to compile kernels for the threaded mode (two hardware-threads per QPU, each with half of the physical registers), switching threads while waiting for TMU loads
+	    //kernels which cannot be allocated within the halved register-file fall back to the non-threaded mode
+	    bool threadableKernels = false;
+	    //the number of threads compiling the kernels of a module (including the calling thread), 0 for the hardware concurrency
+	    unsigned numThreads = 0;
 	};
 
 	/*
@@ -67,17 +85,19 @@ namespace vc4c
 	 * Numbers of elements for a native SIMD vector
 	 */
 	constexpr std::size_t NATIVE_VECTOR_SIZE{16};
-
 	/*
-	 * Maximum number of instructions to check for reordering.
-	 * This prevents long runs for huge linear programs at the cost of less performant code
+	 * The number of QPUs available on the VideoCore IV GPU, each of which could execute the same kernel in parallel
 	 */
-	constexpr std::size_t REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK{64};
+	constexpr uint32_t NUM_QPUS{12};
 
 	/*
 	 * Maximum number of rounds the register-checker tries to resolve conflicts
 	 */
 	constexpr std::size_t REGISTER_RESOLVER_MAX_ROUNDS{6};
+	/*
+	 * Maximum number of rounds of spilling locals for register conflicts the register-checker failed to resolve
+	 */
+	constexpr std::size_t REGISTER_SPILLING_MAX_ROUNDS{8};
 
 	/*
 	 * Magic number to identify QPU assembler code (machine code)
@@ -0,0 +1,187 @@
+/*
+ * Header for the public interface of the additional tools shipped with the compiler, e.g. the QPU emulator
+ *
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_TOOLS_H
+#define VC4C_TOOLS_H
+
+#include "config.h"
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace vc4c
+{
+	namespace tools
+	{
+		/*
+		 * The reasons for a QPU to stall, as tracked by the emulator
+		 */
+		enum class StallReason
+		{
+			//the load_tmu signal waits for the TMU response to be available
+			TMU = 0,
+			//waiting for the completion of a DMA load (RAM to VPM)
+			VPM_DMA_LOAD = 1,
+			//waiting for the completion of a DMA store (VPM to RAM)
+			VPM_DMA_STORE = 2,
+			//waiting to acquire the hardware mutex
+			MUTEX = 3,
+			//waiting for a semaphore to be incremented/decremented
+			SEMAPHORE = 4
+		};
+		constexpr std::size_t NUM_STALL_REASONS{5};
+		std::string toString(StallReason reason);
+
+		/*
+		 * The accesses violating the timing requirements of the hardware, as detected by the emulator.
+		 *
+		 * The hardware does not stall for these, but reads undefined values, so the emulator reads a poison value instead.
+		 */
+		enum class Hazard
+		{
+			//reading r4 before the result of the SFU calculation is written to it
+			SFU_RESULT = 0,
+			//reading from VPM before the VPM read setup takes effect
+			VPM_READ = 1,
+			//reading a register-file register in the instruction directly following the write
+			REGISTER_FILE = 2
+		};
+		constexpr std::size_t NUM_HAZARDS{3};
+		std::string toString(Hazard hazard);
+		//the value read instead of the undefined values
+		constexpr uint32_t POISON_VALUE{0xDEADBEEF};
+
+		/*
+		 * The value for a single kernel parameter.
+		 *
+		 * Direct parameters (scalars and vectors) are passed as one UNIFORM per vector-element,
+		 * pointer parameters are backed by a buffer allocated in the emulated memory and passed as the address of this buffer.
+		 */
+		struct ParameterValue
+		{
+			//the UNIFORM values for direct parameters, one per vector-element
+			std::vector<uint32_t> scalarValues;
+			//the initial contents of the buffer (in 32-bit words) for pointer parameters
+			std::vector<uint32_t> buffer;
+			//whether this parameter is a pointer to a buffer
+			bool isBuffer;
+
+			static ParameterValue fromScalar(uint32_t value);
+			static ParameterValue fromVector(const std::vector<uint32_t>& values);
+			static ParameterValue fromBuffer(const std::vector<uint32_t>& contents);
+		};
+
+		/*
+		 * The input for an emulation run
+		 */
+		struct EmulationData
+		{
+			//the name of the kernel to execute, can be empty if the module contains a single kernel
+			std::string kernelName;
+			//the kernel parameters, in the order of the kernel signature
+			std::vector<ParameterValue> parameters;
+			//the number of work-items per work-group per dimension. Every work-item is run on its own QPU
+			std::array<uint32_t, 3> localSizes{{1, 1, 1}};
+			//the number of work-groups per dimension. The work-groups are executed one after the other
+			std::array<uint32_t, 3> numGroups{{1, 1, 1}};
+			//the global offset per dimension
+			std::array<uint32_t, 3> globalOffsets{{0, 0, 0}};
+			//the maximum number of cycles to emulate per work-group, before the execution is aborted
+			uint64_t maxCycles = 10000000;
+		};
+
+		/*
+		 * Statistics collected for a single QPU, summed up for all work-groups
+		 *
+		 * NOTE: All cycles are counted in instruction slots, so a single cycle executes one (16-way SIMD) instruction.
+		 */
+		struct QPUStatistics
+		{
+			//the number of cycles the QPU was running, including stalls
+			uint64_t cycles = 0;
+			//the number of executed instructions
+			uint64_t instructions = 0;
+			//the number of executed instructions neither executing an ALU operation, nor signaling any periphery
+			uint64_t nops = 0;
+			//the number of executed branches, taken and not taken
+			uint64_t branches = 0;
+			//the number of branches taken
+			uint64_t branchesTaken = 0;
+			//the number of UNIFORMs read
+			uint64_t uniformsRead = 0;
+			//the number of cycles stalled, by reason
+			std::array<uint64_t, NUM_STALL_REASONS> stalls{};
+			//the number of reads of undefined values, by hazard
+			std::array<uint64_t, NUM_HAZARDS> hazards{};
+
+			uint64_t getTotalStalls() const;
+			uint64_t getTotalHazards() const;
+		};
+
+		/*
+		 * Statistics collected for the accesses to the (emulated) main memory
+		 */
+		struct MemoryStatistics
+		{
+			//the number of TMU requests (each loads up to 16 words)
+			uint64_t tmuRequests = 0;
+			//the number of bytes read via the TMU
+			uint64_t tmuBytesRead = 0;
+			//the number of TMU requests not fully served by the TMU cache
+			uint64_t tmuCacheMisses = 0;
+			//the number of DMA loads (RAM to VPM)
+			uint64_t dmaLoads = 0;
+			//the number of bytes read via DMA
+			uint64_t dmaBytesRead = 0;
+			//the number of DMA stores (VPM to RAM)
+			uint64_t dmaStores = 0;
+			//the number of bytes written via DMA
+			uint64_t dmaBytesWritten = 0;
+			//the number of bytes read from the UNIFORM stream
+			uint64_t uniformBytesRead = 0;
+		};
+
+		/*
+		 * The result of an emulation run
+		 */
+		struct EmulationResult
+		{
+			//the kernel executed
+			std::string kernelName;
+			//whether all QPUs finished their execution for all work-groups within the cycle limit
+			bool completed = false;
+			//the total number of cycles for all work-groups
+			uint64_t totalCycles = 0;
+			//the statistics per QPU (indexed by the QPU number), only the QPUs running the kernel are listed
+			std::vector<QPUStatistics> qpuStatistics;
+			MemoryStatistics memoryStatistics;
+			//the final contents of the buffers passed as parameters. Entries for direct parameters are empty
+			std::vector<std::vector<uint32_t>> buffers;
+
+			/*
+			 * Writes a human-readable report of the statistics to the given stream
+			 */
+			void dumpStatistics(std::ostream& stream) const;
+		};
+
+		/*
+		 * Emulates the execution of the given kernel within the binary module (as written by the code-generator) on the host.
+		 *
+		 * The emulation is cycle-approximate: The latencies of the periphery (SFU, TMU, VPM, DMA) are modeled after the
+		 * VideoCore IV specification, memory-bandwidth and cache behavior are roughly estimated.
+		 * Values read too early (see Hazard) are counted in the statistics and replaced with a poison value.
+		 *
+		 * Throws a CompilationError on invalid input, accesses to invalid memory or a dead-lock of the emulated QPUs.
+		 */
+		EmulationResult emulate(std::istream& module, const EmulationData& data);
+	} // namespace tools
+} // namespace vc4c
+
+#endif /* VC4C_TOOLS_H */
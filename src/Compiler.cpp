@@ -6,7 +6,7 @@
 
 #include "Compiler.h"
 
-#include "BackgroundWorker.h"
+#include "ThreadPool.h"
 #include "Parser.h"
 #include "Precompiler.h"
 #include "Profiler.h"
@@ -130,17 +130,18 @@ std::size_t Compiler::convert()
     opt.optimize(module);
     PROFILE_END(Optimizer);
 
-    std::vector<threading::BackgroundWorker> workers;
-    workers.reserve(module.getKernels().size());
+    const std::shared_ptr<threading::ThreadPool> pool = threading::ThreadPool::getGlobalPool(config.numThreads);
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(module.getKernels().size());
     for(Method* kernelFunc : module.getKernels())
     {
         auto f = [&codeGen, kernelFunc]() -> void
 		{
         	toMachineCode(codeGen, *kernelFunc);
 		};
-		workers.emplace(workers.end(), f, "Code Generator")->operator ()();
+		tasks.push_back(pool->schedule(f));
     }
-    threading::BackgroundWorker::waitForAll(workers);
+    pool->waitForAll(tasks);
     
     //TODO could discard unused globals
     //since they are exported, they are still in the intermediate code, even if not used (e.g. optimized away)
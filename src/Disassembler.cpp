@@ -71,8 +71,7 @@ static void extractBinary(std::istream& binary, qpu_asm::ModuleInfo& moduleInfo,
 		tmp.resize(moduleInfo.getGlobalDataSize().getValue());
 		binary.read(reinterpret_cast<char*>(tmp.data()), moduleInfo.getGlobalDataSize().toBytes().getValue());
 
-		std::shared_ptr<ComplexType> elementType(new ArrayType(TYPE_INT64, moduleInfo.getGlobalDataSize().getValue()));
-		const DataType type("i64[]", 1, elementType);
+		const DataType type = TYPE_INT64.toArrayType(static_cast<unsigned>(moduleInfo.getGlobalDataSize().getValue()));
 		globals.emplace_back("globalData", type.toPointerType(), Value(ContainerValue(), type));
 
 		auto& elements = globals.begin()->value.container.elements;
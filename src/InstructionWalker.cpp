@@ -234,6 +234,7 @@ const intermediate::IntermediateInstruction* InstructionWalker::get() const
 intermediate::IntermediateInstruction* InstructionWalker::release()
 {
 	throwOnEnd(isEndOfMethod());
+	basicBlock->method.invalidateInstructionIndex();
 	return (*pos).release();
 }
 
@@ -242,6 +243,7 @@ InstructionWalker& InstructionWalker::reset(intermediate::IntermediateInstructio
 	throwOnEnd(isEndOfMethod());
 	if(dynamic_cast<intermediate::BranchLabel*>(instr) != dynamic_cast<intermediate::BranchLabel*>((*pos).get()))
 			throw CompilationError(CompilationStep::GENERAL, "Can't add labels into a basic block", instr->to_string());
+	basicBlock->method.invalidateInstructionIndex();
 	(*pos).reset(instr);
 	return *this;
 }
@@ -249,6 +251,7 @@ InstructionWalker& InstructionWalker::reset(intermediate::IntermediateInstructio
 InstructionWalker& InstructionWalker::erase()
 {
 	throwOnEnd(isEndOfMethod());
+	basicBlock->method.invalidateInstructionIndex();
 	pos = basicBlock->instructions.erase(pos);
 	return *this;
 }
@@ -259,6 +262,7 @@ InstructionWalker& InstructionWalker::emplace(intermediate::IntermediateInstruct
 		throw CompilationError(CompilationStep::GENERAL, "Can't emplace at the start of a basic block", instr->to_string());
 	if(dynamic_cast<intermediate::BranchLabel*>(instr) != nullptr)
 		throw CompilationError(CompilationStep::GENERAL, "Can't add labels into a basic block", instr->to_string());
+	basicBlock->method.invalidateInstructionIndex();
 	pos = basicBlock->instructions.emplace(pos, instr);
 	return *this;
 }
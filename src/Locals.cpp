@@ -6,6 +6,8 @@
 
 #include "Locals.h"
 
+#include <algorithm>
+
 using namespace vc4c;
 
 bool LocalUser::readsLocal(const Local* local) const
@@ -20,7 +22,14 @@ bool LocalUser::writesLocal(const Local* local) const
 	return allLocals.find(local) != allLocals.end() && has_flag(allLocals.at(local), Type::WRITER);
 }
 
-Local::Local(const DataType& type, const std::string& name) : type(type), name(name), reference(nullptr, ANY_ELEMENT)
+LocalUser::~LocalUser()
+{
+	//unregister from all locals still used
+	while(!localSlots.empty())
+		const_cast<Local*>(localSlots.back().first)->removeUser(*this, Type::BOTH);
+}
+
+Local::Local(const DataType& type, const std::string& name) : type(type), name(name), reference(nullptr, ANY_ELEMENT), numReaders(0), numWriters(0), userRevision(0)
 {
 
 }
@@ -44,7 +53,7 @@ const Value Local::createReference(int index) const
     return Value(this, type);
 }
 
-const OrderedMap<const LocalUser*, LocalUse>& Local::getUsers() const
+const LocalUsers& Local::getUsers() const
 {
 	return users;
 }
@@ -62,57 +71,123 @@ FastSet<const LocalUser*> Local::getUsers(const LocalUser::Type type) const
 
 void Local::forUsers(const LocalUser::Type type, const std::function<void(const LocalUser*)>& consumer) const
 {
-	for(const auto& pair : this->users)
+	//iterate backwards, so removing the current user (which moves the last user into its place) does not skip any user
+	for(std::size_t i = users.size(); i > 0; --i)
 	{
+		if(i > users.size())
+			continue;
+		const auto& pair = users[i - 1];
 		if((has_flag(type, LocalUser::Type::READER) && pair.second.readsLocal()) || (has_flag(type, LocalUser::Type::WRITER) && pair.second.writesLocal()))
 			consumer(pair.first);
 	}
 }
 
+std::size_t Local::countUsers(const LocalUser::Type type) const
+{
+	if(type == LocalUser::Type::READER)
+		return numReaders;
+	if(type == LocalUser::Type::WRITER)
+		return numWriters;
+	if(type == LocalUser::Type::BOTH)
+		return users.size();
+	return 0;
+}
+
+LocalUse Local::getUse(const LocalUser& user) const
+{
+	const std::size_t index = findUser(user);
+	if(index == users.size())
+		return LocalUse();
+	return users[index].second;
+}
+
 void Local::removeUser(const LocalUser& user, const LocalUser::Type type)
 {
+	const std::size_t index = findUser(user);
 	if(type == LocalUser::Type::BOTH)
 	{
 		//if we remove the user completely, ignore if it was a user
-		users.erase(&user);
+		if(index != users.size())
+			removeUserAt(index);
 		return;
 	}
-	if(users.find(&user) == users.end())
+	if(index == users.size())
 		throw CompilationError(CompilationStep::GENERAL, "Trying to remove a not registered user for a local", user.to_string());
-	LocalUse& use = users.at(&user);
-	if(type == LocalUser::Type::READER)
-		--use.numReads;
-	else if(type == LocalUser::Type::WRITER)
-		--use.numWrites;
+	LocalUse& use = users[index].second;
+	if(type == LocalUser::Type::READER && --use.numReads == 0)
+		--numReaders;
+	else if(type == LocalUser::Type::WRITER && --use.numWrites == 0)
+		--numWriters;
 	if(!use.readsLocal() && !use.writesLocal())
-		users.erase(&user);
+		removeUserAt(index);
 }
 
 void Local::addUser(const LocalUser& user, const LocalUser::Type type)
 {
-	if(users.find(&user) == users.end())
-		users.emplace(&user, LocalUse());
-	LocalUse& use = users.at(&user);
-	if(has_flag(type, LocalUser::Type::READER))
-		++use.numReads;
-	if(has_flag(type, LocalUser::Type::WRITER))
-		++use.numWrites;
+	std::size_t index = findUser(user);
+	if(index == users.size())
+	{
+		user.localSlots.emplace_back(this, index);
+		users.emplace_back(&user, LocalUse());
+		++userRevision;
+	}
+	LocalUse& use = users[index].second;
+	if(has_flag(type, LocalUser::Type::READER) && use.numReads++ == 0)
+		++numReaders;
+	if(has_flag(type, LocalUser::Type::WRITER) && use.numWrites++ == 0)
+		++numWriters;
 }
 
 const LocalUser* Local::getSingleWriter() const
 {
-	const LocalUser* writer = nullptr;
+	if(numWriters != 1)
+		return nullptr;
 	for(const auto& pair : this->users)
 	{
 		if(pair.second.writesLocal())
+			return pair.first;
+	}
+	return nullptr;
+}
+
+std::size_t Local::getUserRevision() const
+{
+	return userRevision;
+}
+
+std::size_t Local::findUser(const LocalUser& user) const
+{
+	for(const auto& slot : user.localSlots)
+	{
+		if(slot.first == this)
+			return slot.second;
+	}
+	return users.size();
+}
+
+void Local::removeUserAt(const std::size_t index)
+{
+	const LocalUser* user = users[index].first;
+	if(users[index].second.readsLocal())
+		--numReaders;
+	if(users[index].second.writesLocal())
+		--numWriters;
+	auto slotIt = std::find_if(user->localSlots.begin(), user->localSlots.end(), [this](const std::pair<const Local*, std::size_t>& slot) -> bool { return slot.first == this;});
+	*slotIt = user->localSlots.back();
+	user->localSlots.pop_back();
+
+	//move the last user into the freed position and update its back-reference
+	if(index != users.size() - 1)
+	{
+		users[index] = users.back();
+		for(auto& slot : users[index].first->localSlots)
 		{
-			if(writer != nullptr)
-				//multiple writers
-				return nullptr;
-			writer = pair.first;
+			if(slot.first == this)
+				slot.second = index;
 		}
 	}
-	return writer;
+	users.pop_back();
+	++userRevision;
 }
 
 std::string Local::to_string(bool withContent) const
@@ -150,6 +225,13 @@ bool Parameter::isOutputParameter() const
     return has_flag(decorations, ParameterDecorations::OUTPUT);
 }
 
+void Parameter::setType(const DataType& newType)
+{
+	if(type.isPointerType() != newType.isPointerType() || type.getScalarBitCount() != newType.getScalarBitCount())
+		throw CompilationError(CompilationStep::GENERAL, "Cannot change type of parameter to incompatible type", newType.to_string());
+	type = newType;
+}
+
 Global::Global(const std::string& name, const DataType& globalType, const Value& value) : Local(globalType, name), value(value)
 {
 
@@ -11,9 +11,12 @@
 
 #include <functional>
 #include <utility>
+#include <vector>
 
 namespace vc4c
 {
+	class Local;
+
 	struct LocalUser
 	{
 		enum class Type
@@ -24,7 +27,7 @@ namespace vc4c
 		LocalUser() = default;
 		LocalUser(const LocalUser&) = delete;
 		LocalUser(LocalUser&&) = delete;
-		virtual ~LocalUser() = default;
+		virtual ~LocalUser();
 
 		LocalUser& operator=(const LocalUser&) = delete;
 		LocalUser& operator=(LocalUser&&) = delete;
@@ -36,6 +39,16 @@ namespace vc4c
 		virtual void replaceLocal(const Local* oldLocal, const Local* newLocal, Type type = add_flag(Type::READER, Type::WRITER)) = 0;
 
 		virtual std::string to_string() const = 0;
+
+	private:
+		/*
+		 * The position of this user in the list of users of every local it uses.
+		 *
+		 * Since any user only uses a few locals, this allows to look up and remove the usage of a local in (nearly) constant time.
+		 */
+		mutable std::vector<std::pair<const Local*, std::size_t>> localSlots;
+
+		friend class Local;
 	};
 
 	class Method;
@@ -56,6 +69,11 @@ namespace vc4c
 		}
 	};
 
+	/*
+	 * The list of users of a local, containing the number of reads/writes of every user
+	 */
+	using LocalUsers = std::vector<std::pair<const LocalUser*, LocalUse>>;
+
 	class Local : private NonCopyable
 	{
 	public:
@@ -70,15 +88,38 @@ namespace vc4c
 
 		const Value createReference(int index = WHOLE_OBJECT) const;
 
-		const OrderedMap<const LocalUser*, LocalUse>& getUsers() const;
+		const LocalUsers& getUsers() const;
+		/*
+		 * Returns a copy of all users of the given type.
+		 *
+		 * NOTE: Use this only if the users are modified while iterating, otherwise #forUsers() or #countUsers() do not allocate any memory
+		 */
 		FastSet<const LocalUser*> getUsers(LocalUser::Type type) const;
+		/*
+		 * Calls the consumer for all users of the given type.
+		 * The consumer is allowed to remove the current user from the list of users (e.g. by replacing the local within the user).
+		 */
 		void forUsers(const LocalUser::Type type, const std::function<void(const LocalUser*)>& consumer) const;
+		/*
+		 * Returns the number of users reading (for READER), writing (for WRITER) or using in any way (for BOTH) this local
+		 */
+		std::size_t countUsers(LocalUser::Type type) const;
+		/*
+		 * Returns the number of reads and writes of this local by the given user, which is empty, if the user does not use this local
+		 */
+		LocalUse getUse(const LocalUser& user) const;
 		void removeUser(const LocalUser& user, LocalUser::Type type);
 		void addUser(const LocalUser& user, LocalUser::Type type);
 		/*
 		 * Returns the only instruction writing to this local, if there is exactly one
 		 */
 		const LocalUser* getSingleWriter() const;
+		/*
+		 * Returns a number which changes every time a user is added to or removed from this local.
+		 *
+		 * This allows caches of data derived from the users (e.g. the live-interval) to detect whether they are outdated.
+		 */
+		std::size_t getUserRevision() const;
 
 		template<typename T>
 		bool is() const
@@ -101,15 +142,24 @@ namespace vc4c
 		virtual std::string to_string(bool withContent = false) const;
 		virtual bool residesInMemory() const;
 
-		const DataType type;
+		/*
+		 * NOTE: The type is fixed on creation, the only exception is Parameter#setType()
+		 */
+		DataType type;
 		const std::string name;
 		//Another local (e.g. parameter, global) referenced by this local with the index, if it is a scalar index, otherwise ANY_ELEMENT
 		const std::pair<Local*, int> reference;
 	protected:
 		Local(const DataType& type, const std::string& name);
 	private:
-		//FIXME unordered_map randomly throws SEGFAULT somewhere in stdlib in #removeUser called by IntermediateInstruction#erase
-		OrderedMap<const LocalUser*, LocalUse> users;
+		LocalUsers users;
+		//the number of users reading/writing this local
+		std::size_t numReaders;
+		std::size_t numWriters;
+		std::size_t userRevision;
+
+		std::size_t findUser(const LocalUser& user) const;
+		void removeUserAt(std::size_t index);
 
 		friend class Method;
 	};
@@ -147,7 +197,7 @@ namespace vc4c
 		/*
 		 * Parameter points to volatile memory, accesses to this parameter cannot be reordered/eliminated/duplicated or combined. Only valid for pointers.
 		 */
-		VOLATILE = 0x30
+		VOLATILE = 0x40
 	};
 
 	struct Parameter : public Local
@@ -158,6 +208,13 @@ namespace vc4c
 
 		bool isInputParameter() const;
 		bool isOutputParameter() const;
+		/*
+		 * Replaces the type of this parameter.
+		 *
+		 * This is required for the LLVM front-end, where the address space of pointer parameters is only known after the meta-data has been parsed.
+		 * The new type needs to be compatible to the original type, e.g. only differ in the address space
+		 */
+		void setType(const DataType& newType);
 
 		ParameterDecorations decorations;
 		std::size_t maxByteOffset = SIZE_MAX;
@@ -12,6 +12,8 @@
 #include "log.h"
 #include "periphery/VPM.h"
 
+#include <algorithm>
+
 using namespace vc4c;
 
 const std::string BasicBlock::DEFAULT_BLOCK("%start_of_function");
@@ -57,25 +59,56 @@ std::size_t BasicBlock::size() const
 	return instructions.size();
 }
 
-bool BasicBlock::isLocallyLimited(InstructionWalker curIt, const Local* locale, const std::size_t threshold) const
+static bool isUsedBy(const Local* locale, const intermediate::IntermediateInstruction* instr)
 {
-	auto remainingUsers = locale->getUsers();
+	if(instr == nullptr)
+		return false;
+	const LocalUse use = locale->getUse(*instr);
+	return use.readsLocal() || use.writesLocal();
+}
 
-	int32_t usageRangeLeft = static_cast<int32_t>(threshold);
+/*
+ * Checks via the live-interval of the local, whether all users of the local are within the given range and the given block
+ */
+static bool checkRangeViaIndex(const Method& method, InstructionWalker curIt, const Local* locale, const std::size_t threshold, const BasicBlock& block)
+{
+	const Optional<InstructionPosition> curPos = method.findInstructionPosition(curIt.get());
+	//users which are not part of the method (e.g. parts of combined instructions) are never within range
+	const Optional<LiveInterval> interval = method.getLiveInterval(locale);
+	if(!curPos || !interval)
+		return false;
 	//check whether the local is written in the instruction before (and this)
 	//this happens e.g. for comparisons
-	if(!curIt.isStartOfBlock())
-	{
-		remainingUsers.erase(curIt.copy().previousInBlock().get());
-	}
-	while(usageRangeLeft >= 0 && !curIt.isEndOfBlock())
+	const std::size_t firstIndex = curIt.isStartOfBlock() ? curPos->index : curPos->index - 1;
+	const std::size_t lastIndex = curPos->index + threshold;
+	return interval->block == &block && interval->first >= firstIndex && interval->last <= lastIndex;
+}
+
+/*
+ * Checks by walking all instructions of the range, whether all users of the local are within the range and the block of the current instruction
+ */
+static bool checkRangeViaWalk(InstructionWalker curIt, const Local* locale, const std::size_t threshold)
+{
+	std::size_t numUsersFound = 0;
+	if(!curIt.isStartOfBlock() && isUsedBy(locale, curIt.copy().previousInBlock().get()))
+		++numUsersFound;
+	for(std::size_t i = 0; i <= threshold && !curIt.isEndOfBlock(); ++i)
 	{
-		remainingUsers.erase(curIt.get());
-		--usageRangeLeft;
+		if(isUsedBy(locale, curIt.get()))
+			++numUsersFound;
 		curIt.nextInBlock();
 	}
+	return numUsersFound == locale->getUsers().size();
+}
 
-	return remainingUsers.empty();
+bool BasicBlock::isLocallyLimited(InstructionWalker curIt, const Local* locale, const std::size_t threshold) const
+{
+	//at most one user is found for each instruction in range, so we can skip the check for locals with too many users
+	if(locale->getUsers().size() > threshold + 2)
+		return false;
+	if(!curIt.isEndOfBlock() && method.useInstructionIndex(threshold))
+		return checkRangeViaIndex(method, curIt, locale, threshold, *this);
+	return checkRangeViaWalk(curIt, locale, threshold);
 }
 
 const intermediate::BranchLabel* BasicBlock::getLabel() const
@@ -131,15 +164,38 @@ void BasicBlock::forPredecessors(const std::function<void(InstructionWalker)>& c
 	}
 }
 
-bool BasicBlock::fallsThroughToNextBlock() const
+/*
+ * Walks back from the given position to the previous instruction, skipping NOPs and the 3 delay slots of a preceding branch, which can be filled with other instructions
+ */
+static InstructionWalker skipDelaySlots(InstructionWalker it)
 {
-	//if the last instruction of a basic block is not an unconditional branch to another block, the control-flow falls through to the next block
-	InstructionWalker it = const_cast<BasicBlock*>(this)->end();
-	do
+	Optional<InstructionWalker> lastInstruction;
+	std::size_t numSlots = 0;
+	while(!it.isStartOfBlock() && numSlots <= 3)
 	{
 		it.previousInBlock();
+		//positions moved away from stay empty until the empty instructions are cleaned
+		if(!it.has())
+			continue;
+		if(it.has<intermediate::Branch>())
+			return it;
+		if(it.has<intermediate::Nop>())
+		{
+			if(it.get<intermediate::Nop>()->type == intermediate::DelayType::BRANCH_DELAY)
+				++numSlots;
+			continue;
+		}
+		if(!lastInstruction)
+			lastInstruction = it;
+		++numSlots;
 	}
-	while(it.has<intermediate::Nop>());
+	return lastInstruction ? lastInstruction.value() : it;
+}
+
+bool BasicBlock::fallsThroughToNextBlock() const
+{
+	//if the last instruction of a basic block is not an unconditional branch to another block, the control-flow falls through to the next block
+	InstructionWalker it = skipDelaySlots(const_cast<BasicBlock*>(this)->end());
 	const intermediate::Branch* lastBranch = dynamic_cast<const intermediate::Branch*>(it.get());
 	const intermediate::Branch* secondLastBranch = nullptr;
 	if(!it.isStartOfBlock())
@@ -147,11 +203,7 @@ bool BasicBlock::fallsThroughToNextBlock() const
 		if(lastBranch != nullptr && !lastBranch->isUnconditional())
 			//skip writing/setting of condition for conditional jump
 			it.previousInBlock();
-		do
-		{
-			it.previousInBlock();
-		}
-		while(it.has<intermediate::Nop>());
+		it = skipDelaySlots(it);
 		secondLastBranch = dynamic_cast<const intermediate::Branch*>(it.get());
 	}
 	if(lastBranch != nullptr && lastBranch->isUnconditional())
@@ -203,7 +255,7 @@ bool BasicBlock::isStartOfMethod() const
 	return &method.basicBlocks.front() == this;
 }
 
-Method::Method(const Module& module) : isKernel(false), name(), returnType(TYPE_UNKNOWN), vpm(new periphery::VPM(module.compilationConfig.availableVPMSize)), module(module)
+Method::Method(const Module& module) : isKernel(false), name(), returnType(TYPE_UNKNOWN), vpm(new periphery::VPM(module.compilationConfig.availableVPMSize)), module(module), instructionIndexValid(false), unindexedRangeSteps(0)
 {
 
 }
@@ -212,6 +264,7 @@ Method::~Method()
 {
 	//makes sure, instructions are removed before locals (so usages are all zero)
 	basicBlocks.clear();
+	invalidateInstructionIndex();
 }
 
 const Local* Method::findLocal(const std::string& name) const
@@ -266,53 +319,44 @@ const Local* Method::findOrCreateLocal(const DataType& type, const std::string&
 	return &(it.first->second);
 }
 
-static bool removeUsagesInBasicBlock(Method& method, BasicBlock& bb, const Local* locale, OrderedMap<const LocalUser*, LocalUse>& remainingUsers, int& usageRangeLeft)
+Optional<InstructionPosition> Method::findInstructionPosition(const intermediate::IntermediateInstruction* instr) const
 {
-	InstructionWalker it = bb.begin();
-	while(usageRangeLeft >= 0 && !it.isEndOfMethod())
-	{
-		remainingUsers.erase(it.get());
-		--usageRangeLeft;
-		if(it.has<intermediate::Branch>())
-		{
-			BasicBlock* successor = method.findBasicBlock(it.get<intermediate::Branch>()->getTarget());
-			if(successor != nullptr && removeUsagesInBasicBlock(method, *successor, locale, remainingUsers, usageRangeLeft))
-				return true;
-		}
-		it.nextInMethod();
-	}
-	return remainingUsers.empty();
+	if(!instructionIndexValid)
+		updateInstructionIndex();
+	auto it = instructionIndex.find(instr);
+	if(it == instructionIndex.end())
+		return {};
+	return it->second;
 }
 
-bool Method::isLocallyLimited(InstructionWalker curIt, const Local* locale, const std::size_t threshold) const
+Optional<LiveInterval> Method::getLiveInterval(const Local* local) const
 {
-	auto remainingUsers = locale->getUsers();
-
-	int32_t usageRangeLeft = static_cast<int32_t>(threshold);
-	//check whether the local is written in the instruction before (and this)
-	//this happens e.g. for comparisons
-	if(!curIt.isStartOfBlock())
+	if(!instructionIndexValid)
+		updateInstructionIndex();
+	auto cacheIt = liveIntervals.find(local);
+	if(cacheIt != liveIntervals.end() && cacheIt->second.first == local->getUserRevision())
+		return cacheIt->second.second;
+	Optional<LiveInterval> interval;
+	for(const auto& pair : local->getUsers())
 	{
-		remainingUsers.erase(curIt.copy().previousInBlock().get());
-	}
-	while(usageRangeLeft >= 0 && !curIt.isEndOfMethod())
-	{
-		remainingUsers.erase(curIt.get());
-		--usageRangeLeft;
-		const intermediate::Branch* branch = curIt.get<intermediate::Branch>();
-		if(branch != nullptr)
+		auto it = instructionIndex.find(dynamic_cast<const intermediate::IntermediateInstruction*>(pair.first));
+		if(it == instructionIndex.end())
+		{
+			interval = Optional<LiveInterval>{};
+			break;
+		}
+		if(!interval)
+			interval = LiveInterval{it->second.block, it->second.index, it->second.index};
+		else
 		{
-			BasicBlock* successor = const_cast<Method*>(this)->findBasicBlock(branch->getTarget());
-			if(successor != nullptr && removeUsagesInBasicBlock(*const_cast<Method*>(this), *successor, locale, remainingUsers, usageRangeLeft))
-				return true;
-			if(branch->isUnconditional())
-				//this branch jumps away unconditionally and the successor does not have all remaining usages within the remaining range, so we abort
-				return false;
+			if(interval->block != it->second.block)
+				interval->block = nullptr;
+			interval->first = std::min(interval->first, it->second.index);
+			interval->last = std::max(interval->last, it->second.index);
 		}
-		curIt.nextInMethod();
 	}
-
-	return remainingUsers.empty();
+	liveIntervals[local] = std::make_pair(local->getUserRevision(), interval);
+	return interval;
 }
 
 static std::size_t tmpIndex = 0;
@@ -402,6 +446,7 @@ std::size_t Method::cleanEmptyInstructions()
 
 void Method::appendToEnd(intermediate::IntermediateInstruction* instr)
 {
+	invalidateInstructionIndex();
 	if(dynamic_cast<intermediate::BranchLabel*>(instr) != nullptr)
 		basicBlocks.emplace_back(*this, dynamic_cast<intermediate::BranchLabel*>(instr));
 	else
@@ -448,6 +493,8 @@ void Method::cleanLocals()
 #endif
 		if((*it).second.getUsers().empty())
 		{
+			//a new local could be created at the same address, so the cached interval must not be kept
+			liveIntervals.erase(&it->second);
 			it = locals.erase(it);
 			++numCleaned;
 		}
@@ -498,6 +545,7 @@ InstructionWalker Method::emplaceLabel(InstructionWalker it, intermediate::Branc
 	}
 	if(blockIt == basicBlocks.end())
 		throw CompilationError(CompilationStep::GENERAL, "Failed to find basic block for instruction iterator");
+	invalidateInstructionIndex();
 	//1. insert new basic block after the current (or in front of it, if we emplace at the start of the basic block)
 	bool isStartOfBlock = blockIt->begin() == it;
 	if(!isStartOfBlock)
@@ -598,10 +646,51 @@ BasicBlock* Method::getPreviousBlock(const BasicBlock* block)
 	return nullptr;
 }
 
+void Method::invalidateInstructionIndex()
+{
+	instructionIndexValid = false;
+	unindexedRangeSteps = 0;
+}
+
+void Method::updateInstructionIndex() const
+{
+	PROFILE_START(updateInstructionIndex);
+	instructionIndex.clear();
+	//the positions of the users may have changed
+	liveIntervals.clear();
+	std::size_t index = 0;
+	for(const BasicBlock& bb : basicBlocks)
+	{
+		for(const auto& instr : bb.instructions)
+		{
+			if(instr)
+				instructionIndex.emplace(instr.get(), InstructionPosition{&bb, index});
+			++index;
+		}
+	}
+	instructionIndexValid = true;
+	unindexedRangeSteps = 0;
+	PROFILE_END(updateInstructionIndex);
+}
+
+bool Method::useInstructionIndex(const std::size_t threshold) const
+{
+	if(instructionIndexValid)
+		return true;
+	//rebuilding the index costs about as much as walking all instructions once,
+	//so only rebuild it, if at least as many instructions were walked since the index was invalidated
+	unindexedRangeSteps += threshold + 2;
+	if(unindexedRangeSteps < instructionIndex.size())
+		return false;
+	updateInstructionIndex();
+	return true;
+}
+
 void Method::checkAndCreateDefaultBasicBlock()
 {
 	if(basicBlocks.empty())
 	{
+		invalidateInstructionIndex();
 		// in case the input code does not always add a label to the start of a function
 		basicBlocks.emplace_back(*this, new intermediate::BranchLabel(*findOrCreateLocal(TYPE_LABEL, BasicBlock::DEFAULT_BLOCK)));
 	}
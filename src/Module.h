@@ -29,8 +29,10 @@ namespace vc4c
 	{
 		std::array<uint32_t, 3> workGroupSizes;
 		std::array<uint32_t, 3> workGroupSizeHints;
+		//whether the kernel was compiled to be executed by two hardware-threads per QPU
+		bool isThreadable;
 
-		KernelMetaData()
+		KernelMetaData() : isThreadable(false)
 		{
 			workGroupSizes.fill(0);
 			workGroupSizeHints.fill(0);
@@ -41,6 +43,29 @@ namespace vc4c
 	class Module;
 	class Method;
 	class ControlFlowGraph;
+	class BasicBlock;
+
+	/*
+	 * The position of an instruction within its method, as stored in the instruction index of the method
+	 */
+	struct InstructionPosition
+	{
+		//the basic block containing the instruction
+		const BasicBlock* block;
+		//the number of the instruction, counted from the start of the method (including labels)
+		std::size_t index;
+	};
+
+	/*
+	 * The live-interval of a local, the numbers of the first and the last instruction using the local (see InstructionPosition#index)
+	 */
+	struct LiveInterval
+	{
+		//the basic block containing all users of the local, or nullptr if the local is used in several blocks
+		const BasicBlock* block;
+		std::size_t first;
+		std::size_t last;
+	};
 
 	class BasicBlock : private NonCopyable
 	{
@@ -63,6 +88,8 @@ namespace vc4c
 
 		/*!
 		 * Checks if all usages of this local are within a certain range from the current instruction within a single basic block
+		 *
+		 * The range includes the instruction before and the next threshold instructions after (and including) the current instruction.
 		 */
 		bool isLocallyLimited(InstructionWalker curIt, const Local* locale, std::size_t threshold = ACCUMULATOR_THRESHOLD_HINT) const;
 
@@ -149,10 +176,19 @@ namespace vc4c
 		const StackAllocation* findStackAllocation(const std::string& name) const;
 		const Local* findOrCreateLocal(const DataType& type, const std::string& name) __attribute__((returns_nonnull));
 
-		/*!
-		 * Checks if all usages of this local are within a certain range from the current instruction, but following branches
+		/*
+		 * Returns the position of the given instruction within this method, if it is contained in this method.
+		 *
+		 * The positions are taken from an index, which is invalidated by any modification of the instructions lists and rebuilt lazily on the next query.
 		 */
-		bool isLocallyLimited(InstructionWalker curIt, const Local* locale, std::size_t threshold = ACCUMULATOR_THRESHOLD_HINT) const;
+		Optional<InstructionPosition> findInstructionPosition(const intermediate::IntermediateInstruction* instr) const;
+		/*
+		 * Returns the live-interval of the given local, derived from the positions of its users in the instruction index.
+		 *
+		 * The intervals are cached until the instruction index is rebuilt or the users of the local change, so repeated queries are answered in constant time.
+		 * Returns an empty value, if the local has no users or is used by instructions not contained in this method (e.g. parts of combined instructions)
+		 */
+		Optional<LiveInterval> getLiveInterval(const Local* local) const;
 
 		InstructionWalker walkAllInstructions();
 		void forAllInstructions(const std::function<void(const intermediate::IntermediateInstruction*)>& consumer) const;
@@ -196,9 +232,26 @@ namespace vc4c
 		const Module& module;
 		RandomModificationList<BasicBlock> basicBlocks;
 		OrderedMap<std::string, Local> locals;
+		//the positions of all instructions, see #findInstructionPosition()
+		mutable FastMap<const LocalUser*, InstructionPosition> instructionIndex;
+		mutable bool instructionIndexValid;
+		//the number of instructions walked by range-checks since the index was last invalidated
+		mutable std::size_t unindexedRangeSteps;
+		//the cached live-intervals of the locals together with the user-revision of the local they were calculated for, see #getLiveInterval()
+		mutable FastMap<const Local*, std::pair<std::size_t, Optional<LiveInterval>>> liveIntervals;
 
 		std::string createLocalName(const std::string& prefix = "", const std::string& postfix = "");
 
+		void invalidateInstructionIndex();
+		void updateInstructionIndex() const;
+		/*
+		 * Returns whether range-checks should use the instruction index, rebuilding it if it is worth it.
+		 *
+		 * If the instructions are modified between most checks (as by many optimization steps), rebuilding the index every time
+		 * would be more expensive than walking the few instructions of the range, so the index is only rebuilt after enough unindexed checks.
+		 */
+		bool useInstructionIndex(std::size_t threshold) const;
+
 		BasicBlock* getNextBlockAfter(const BasicBlock* block);
 		BasicBlock* getPreviousBlock(const BasicBlock* block);
 
@@ -211,6 +264,8 @@ namespace vc4c
 
 	class Module : private NonCopyable
 	{
+		//releases the types created for this module, is declared first to be destroyed after all other members
+		TypeScope typeScope;
 	public:
 		explicit Module(const Configuration& compilationConfig);
 		Module(const Module&) = delete;
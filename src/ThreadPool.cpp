@@ -0,0 +1,249 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "ThreadPool.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef MULTI_THREADED
+#include <chrono>
+#include <condition_variable>
+#include <dlfcn.h>
+#include <sys/prctl.h>
+#include <thread>
+#endif
+
+using namespace threading;
+
+using Task = std::packaged_task<void()>;
+
+struct ThreadPool::State
+{
+	std::string name;
+#ifdef MULTI_THREADED
+	struct TaskQueue
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	//one queue per worker-thread
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> workers;
+
+	//guards the following members
+	std::mutex lock;
+	std::condition_variable wakeUp;
+	std::size_t numQueuedTasks = 0;
+	std::size_t nextQueue = 0;
+	bool shutdown = false;
+#endif
+
+	explicit State(const std::string& name) : name(name)
+	{
+	}
+};
+
+#ifdef MULTI_THREADED
+//the pool and the queue of the current thread, if it is a worker-thread
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local std::size_t currentQueue = 0;
+#endif
+
+ThreadPool::ThreadPool(const std::string& name, const unsigned numWorkers) : state(new State(name))
+{
+#ifdef MULTI_THREADED
+	if(numWorkers == 0)
+		return;
+	//we need thread-support, so load the pthread library dynamically (if it is not yet loaded)
+	void* handle = dlopen("libpthread.so.0", RTLD_GLOBAL | RTLD_LAZY);
+	if(handle == nullptr)
+	{
+		throw std::runtime_error(std::string("Error loading pthread library: ") + dlerror());
+	}
+	state->queues.reserve(numWorkers);
+	for(unsigned i = 0; i < numWorkers; ++i)
+		state->queues.emplace_back(new State::TaskQueue());
+	state->workers.reserve(numWorkers);
+	for(unsigned i = 0; i < numWorkers; ++i)
+		state->workers.emplace_back(&ThreadPool::runWorker, this, i);
+#endif
+}
+
+ThreadPool::~ThreadPool()
+{
+#ifdef MULTI_THREADED
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		state->shutdown = true;
+	}
+	state->wakeUp.notify_all();
+	for(std::thread& worker : state->workers)
+		worker.join();
+#endif
+}
+
+std::future<void> ThreadPool::schedule(const std::function<void()>& task)
+{
+	Task wrapper([task]() -> void
+	{
+		try
+		{
+			task();
+		}
+		catch(const std::exception& e)
+		{
+			logging::error() << "Background worker threw error: " << e.what() << logging::endl;
+			//the exception is stored in the future
+			throw;
+		}
+	});
+	std::future<void> result = wrapper.get_future();
+#ifdef MULTI_THREADED
+	if(!state->workers.empty())
+	{
+		std::size_t index = currentQueue;
+		{
+			std::lock_guard<std::mutex> guard(state->lock);
+			if(currentPool != this)
+			{
+				index = state->nextQueue;
+				state->nextQueue = (state->nextQueue + 1) % state->queues.size();
+			}
+			//the task is counted before it is queued, so a worker executing it cannot decrement the counter below zero
+			++state->numQueuedTasks;
+		}
+		{
+			std::lock_guard<std::mutex> guard(state->queues[index]->lock);
+			state->queues[index]->tasks.push_back(std::move(wrapper));
+		}
+		state->wakeUp.notify_one();
+		return result;
+	}
+#endif
+	//without worker-threads, execute directly
+	wrapper();
+	return result;
+}
+
+void ThreadPool::waitForAll(std::vector<std::future<void>>& futures)
+{
+#ifdef MULTI_THREADED
+	for(std::future<void>& future : futures)
+	{
+		while(future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			//if there is nothing to help with, the task waited for is already being executed
+			if(state->workers.empty() || !executeQueuedTask(currentPool == this ? currentQueue : 0))
+				future.wait();
+		}
+	}
+#endif
+	//throwing the exception after all tasks are finished solves the problem of tasks accessing already destroyed objects
+	std::exception_ptr err = nullptr;
+	for(std::future<void>& future : futures)
+	{
+		try
+		{
+			future.get();
+		}
+		catch(...)
+		{
+			err = std::current_exception();
+		}
+	}
+	futures.clear();
+	if(err)
+		std::rethrow_exception(err);
+}
+
+static unsigned getGlobalPoolSize(const unsigned numThreads)
+{
+#ifdef MULTI_THREADED
+	//the thread waiting for the tasks executes them too
+	return numThreads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : numThreads;
+#else
+	return 1;
+#endif
+}
+
+static std::mutex globalPoolLock;
+static std::shared_ptr<ThreadPool> globalPool;
+static unsigned globalPoolSize = 0;
+
+std::shared_ptr<ThreadPool> ThreadPool::getGlobalPool(const unsigned numThreads)
+{
+	const unsigned poolSize = getGlobalPoolSize(numThreads);
+	std::lock_guard<std::mutex> guard(globalPoolLock);
+	if(!globalPool || globalPoolSize != poolSize)
+	{
+		//the worker-threads of the old pool are joined when the last reference to it is released
+		globalPool = std::make_shared<ThreadPool>("VC4C worker", poolSize - 1);
+		globalPoolSize = poolSize;
+	}
+	return globalPool;
+}
+
+bool ThreadPool::executeQueuedTask(const std::size_t firstQueue)
+{
+#ifdef MULTI_THREADED
+	const std::size_t numQueues = state->queues.size();
+	for(std::size_t i = 0; i < numQueues; ++i)
+	{
+		const std::size_t index = (firstQueue + i) % numQueues;
+		State::TaskQueue& queue = *state->queues[index];
+		Task task;
+		{
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if(queue.tasks.empty())
+				continue;
+			if(currentPool == this && index == currentQueue)
+			{
+				//execute the own tasks in reverse order, the last task scheduled is most likely to access the same data
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else
+			{
+				//steal the oldest task of another queue
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+		}
+		{
+			std::lock_guard<std::mutex> guard(state->lock);
+			--state->numQueuedTasks;
+		}
+		task();
+		return true;
+	}
+#endif
+	return false;
+}
+
+void ThreadPool::runWorker(const std::size_t index)
+{
+#ifdef MULTI_THREADED
+	currentPool = this;
+	currentQueue = index;
+	prctl(PR_SET_NAME, state->name.data(), 0, 0, 0);
+	while(true)
+	{
+		if(executeQueuedTask(index))
+			continue;
+		std::unique_lock<std::mutex> guard(state->lock);
+		state->wakeUp.wait(guard, [this]() -> bool { return state->shutdown || state->numQueuedTasks > 0; });
+		if(state->shutdown && state->numQueuedTasks == 0)
+			return;
+	}
+#endif
+}
@@ -0,0 +1,75 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace threading
+{
+	/*
+	 * Pool of worker-threads executing the tasks scheduled by all compilations of the process (e.g. the optimization and code-generation of single kernels).
+	 *
+	 * Every worker has its own queue of tasks. Tasks scheduled from within a worker are put into its own queue (to be executed next by this worker),
+	 * tasks scheduled from other threads are distributed over all queues. Workers without tasks left steal the oldest tasks of the other workers.
+	 *
+	 * A thread waiting for tasks to finish executes queued tasks in the meantime, so tasks can schedule and wait for other tasks (e.g. for parallel passes within a kernel)
+	 * and the thread scheduling the tasks of a compilation takes part in executing them.
+	 */
+	class ThreadPool
+	{
+	public:
+		/*
+		 * Creates a pool with the given number of worker-threads in addition to the threads waiting for tasks.
+		 *
+		 * A pool without worker-threads executes all tasks on the thread scheduling them.
+		 */
+		ThreadPool(const std::string& name, unsigned numWorkers);
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) = delete;
+		~ThreadPool();
+
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) = delete;
+
+		/*
+		 * Schedules the given task for execution, the returned future receives any exception thrown by the task
+		 */
+		std::future<void> schedule(const std::function<void()>& task);
+
+		/*
+		 * Waits for all the given tasks to finish (while executing queued tasks) and re-throws the exception of a failed task.
+		 *
+		 * The exception is thrown after all tasks are finished, so no task accesses data already destroyed by the unwinding of the stack
+		 */
+		void waitForAll(std::vector<std::future<void>>& futures);
+
+		/*
+		 * Returns the process-wide pool with the given number of threads (worker-threads and the thread waiting), 0 for the hardware concurrency.
+		 * Without multi-threading support, the pool has no worker-threads.
+		 *
+		 * If the current pool has a different number of threads, it is replaced by a new pool for all following calls.
+		 * The old pool is kept alive (and its queued tasks executed) until the last compilation still using it releases its reference.
+		 */
+		static std::shared_ptr<ThreadPool> getGlobalPool(unsigned numThreads);
+
+	private:
+		struct State;
+
+		std::unique_ptr<State> state;
+
+		bool executeQueuedTask(std::size_t firstQueue);
+		void runWorker(std::size_t index);
+	};
+
+} /* namespace threading */
+
+#endif /* THREAD_POOL_H */
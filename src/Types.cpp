@@ -9,9 +9,14 @@
 #include "CompilationError.h"
 #include "helper.h"
 
+#include <array>
 #include <cstdlib>
+#include <deque>
 #include <limits>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <tuple>
 
 using namespace vc4c;
 
@@ -20,8 +25,206 @@ ComplexType::~ComplexType()
 
 }
 
-DataType::DataType(const std::string& name, const unsigned char num, const std::shared_ptr<ComplexType>& complexType) :
-    typeName(name), num(num), complexType(complexType)
+namespace vc4c
+{
+	enum class TypeKind : unsigned char
+	{
+		SIMPLE,
+		POINTER,
+		ARRAY,
+		STRUCT,
+		IMAGE
+	};
+
+	/*
+	 * An entry of the type-table, describing a scalar or complex base-type.
+	 *
+	 * Entries are never modified after they are inserted into the table.
+	 */
+	struct TypeEntry
+	{
+		std::string name;
+		std::unique_ptr<ComplexType> complexType;
+		TypeKind kind;
+		//the position within the table, identifies this exact entry
+		uint32_t index;
+		//the ID of the class of equal types, see DataType#getTypeID()
+		uint32_t typeID;
+		//cached properties
+		bool isFloating;
+		bool isUnknown;
+		unsigned char scalarBitCount;
+	};
+} // namespace vc4c
+
+/*
+ * The key a type is interned by, consisting of the kind, the name and the types (IDs and vector-widths) of the elements as well as any additional properties
+ */
+struct TypeKey
+{
+	TypeKind kind;
+	std::string name;
+	std::vector<std::pair<uint32_t, unsigned char>> elements;
+	std::array<uint32_t, 4> properties;
+
+	bool operator<(const TypeKey& other) const
+	{
+		return std::tie(kind, name, elements, properties) < std::tie(other.kind, other.name, other.elements, other.properties);
+	}
+};
+
+/*
+ * The global table of all types.
+ *
+ * Types are interned by two keys:
+ * - the exact key, which distinguishes all information stored in the type (e.g. address space and alignment of pointers) and determines the table-entry
+ * - the class key, which contains only the information relevant for type-equality and determines the type-ID
+ */
+class TypeTable : private NonCopyable
+{
+public:
+	TypeTable();
+
+	template<typename Factory>
+	const TypeEntry* intern(const TypeKey& exactKey, const TypeKey& classKey, const Factory& createComplexType)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = entries.find(exactKey);
+		if(it != entries.end())
+			return it->second;
+		//types created within a type-scope are released together with the last type-scope
+		const bool isTransient = numScopes > 0;
+		std::deque<TypeEntry>& entryStorage = isTransient ? transientStorage : storage;
+		entryStorage.emplace_back();
+		TypeEntry& entry = entryStorage.back();
+		entry.name = exactKey.name;
+		entry.complexType = createComplexType();
+		entry.kind = exactKey.kind;
+		//the transient entries and classes are always the last ones, so the positions and IDs stay unique after they are released
+		entry.index = static_cast<uint32_t>(storage.size() + transientStorage.size() - 1);
+		const auto classIt = classes.emplace(classKey, static_cast<uint32_t>(classes.size()));
+		entry.typeID = classIt.first->second;
+		entry.isFloating = entry.kind == TypeKind::SIMPLE && (entry.name == "float" || entry.name == "double" || entry.name == "half");
+		entry.isUnknown = !entry.name.empty() && entry.name[0] == '?';
+		entry.scalarBitCount = 32;
+		if(entry.kind == TypeKind::SIMPLE && !entry.name.empty() && entry.name[0] == 'i')
+			entry.scalarBitCount = static_cast<unsigned char>(atoi(entry.name.substr(1).data()));
+		else if(entry.kind == TypeKind::SIMPLE && entry.name == "half")
+			//16-bit floating point type
+			entry.scalarBitCount = 16;
+		else if(entry.kind == TypeKind::SIMPLE && entry.name == "void")
+			//single byte
+			entry.scalarBitCount = 8;
+		entries.emplace(exactKey, &entry);
+		if(isTransient)
+		{
+			transientKeys.push_back(exactKey);
+			if(classIt.second)
+				transientClasses.push_back(classKey);
+		}
+		return &entry;
+	}
+
+	void acquireScope()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		++numScopes;
+	}
+
+	void releaseScope()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if(--numScopes > 0)
+			return;
+		for(const TypeKey& key : transientKeys)
+			entries.erase(key);
+		for(const TypeKey& key : transientClasses)
+			classes.erase(key);
+		transientKeys.clear();
+		transientClasses.clear();
+		transientStorage.clear();
+	}
+
+	/*
+	 * Looks up the entry of a built-in scalar type.
+	 *
+	 * The built-in types are interned on construction of the table and never modified afterwards,
+	 * so this does not need to acquire the lock, which keeps the construction of the most common types cheap.
+	 */
+	const TypeEntry* findBuiltin(const std::string& name) const
+	{
+		for(const TypeEntry* entry : builtins)
+		{
+			if(entry->name == name)
+				return entry;
+		}
+		return nullptr;
+	}
+
+private:
+	std::mutex lock;
+	//deque does not invalidate references to the entries on insertion
+	std::deque<TypeEntry> storage;
+	std::map<TypeKey, const TypeEntry*> entries;
+	std::map<TypeKey, uint32_t> classes;
+	//the number of type-scopes currently existing
+	std::size_t numScopes = 0;
+	//the entries created within the current type-scopes and the keys to remove on release
+	std::deque<TypeEntry> transientStorage;
+	std::vector<TypeKey> transientKeys;
+	std::vector<TypeKey> transientClasses;
+	std::array<const TypeEntry*, 13> builtins;
+};
+
+static std::unique_ptr<ComplexType> noComplexType()
+{
+	return nullptr;
+}
+
+TypeTable::TypeTable()
+{
+	//the names of the scalar types constructed most often, e.g. by the default constructor and the TYPE_XXX constants
+	static const std::array<const char*, 13> builtinNames = {"", "?", "void", "bool", "label", "i1", "i8", "i16", "i32", "i64", "half", "float", "double"};
+	for(std::size_t i = 0; i < builtinNames.size(); ++i)
+	{
+		const TypeKey key{TypeKind::SIMPLE, builtinNames[i], {}, {}};
+		builtins[i] = intern(key, key, noComplexType);
+	}
+}
+
+/*
+ * The table itself is kept for the lifetime of the process, since the (trivially copyable) DataType handles refer to its entries from anywhere, e.g. from static constants.
+ * Only the entries created within type-scopes are released, see TypeScope
+ */
+static TypeTable& getTypeTable()
+{
+	static TypeTable table;
+	return table;
+}
+
+TypeScope::TypeScope()
+{
+	getTypeTable().acquireScope();
+}
+
+TypeScope::~TypeScope()
+{
+	getTypeTable().releaseScope();
+}
+
+DataType::DataType(const std::string& name, const unsigned char num) : num(num), entry(nullptr), typeID(0)
+{
+	TypeTable& table = getTypeTable();
+	entry = table.findBuiltin(name);
+	if(entry == nullptr)
+	{
+		const TypeKey key{TypeKind::SIMPLE, name, {}, {}};
+		entry = table.intern(key, key, noComplexType);
+	}
+	typeID = entry->typeID;
+}
+
+DataType::DataType(const TypeEntry* entry, const unsigned char num) : num(num), entry(entry), typeID(entry->typeID)
 {
 
 }
@@ -31,8 +234,8 @@ std::string DataType::to_string() const
     const std::string braceLeft = isVectorType() ? "<" : "";
     const std::string braceRight = isVectorType() ? ">" : "";
     if(num > 1)
-        return braceLeft + (std::to_string(num) + " x ") + (typeName + braceRight);
-    return typeName;
+        return braceLeft + (std::to_string(num) + " x ") + (entry->name + braceRight);
+    return entry->name;
 }
 
 static std::string toSignedTypeName(const std::string& typeName)
@@ -63,79 +266,76 @@ static std::string toUnsignedTypeName(const std::string& typeName)
 
 std::string DataType::getTypeName(bool isSigned, bool isUnsigned) const
 {
-	if(complexType != nullptr || (!isFloatingType() && !isSigned && !isUnsigned))
+	if(isComplexType() || (!isFloatingType() && !isSigned && !isUnsigned))
 		return to_string();
-	const std::string tName = isSigned ? toSignedTypeName(typeName) : isUnsigned ? toUnsignedTypeName(typeName) : typeName;
+	const std::string tName = isSigned ? toSignedTypeName(entry->name) : isUnsigned ? toUnsignedTypeName(entry->name) : entry->name;
 	if(num > 1)
 		return tName + std::to_string(num);
 	return tName;
 }
 
-bool DataType::operator==(const DataType& right) const
+const std::string& DataType::getBaseName() const
 {
-	if(this == &right)
-		return true;
-    return typeName.compare(right.typeName) == 0 && num == right.num && (complexType == nullptr) == (right.complexType == nullptr) && (complexType != nullptr ? (*complexType.get()) == (*right.complexType.get()) : true);
+	return entry->name;
 }
 
 bool DataType::isScalarType() const
 {
-    return !complexType && num == 1;
+    return entry->kind == TypeKind::SIMPLE && num == 1;
 }
 
 bool DataType::isVectorType() const
 {
-    return !complexType && num > 1;
+    return entry->kind == TypeKind::SIMPLE && num > 1;
+}
+
+bool DataType::isComplexType() const
+{
+	return entry->kind != TypeKind::SIMPLE;
 }
 
 bool DataType::isPointerType() const
 {
-	return getPointerType().has_value();
+	return entry->kind == TypeKind::POINTER;
 }
 
-Optional<PointerType*> DataType::getPointerType() const
+Optional<const PointerType*> DataType::getPointerType() const
 {
-	PointerType* pointerType = dynamic_cast<PointerType*>(complexType.get());
-	if(pointerType != nullptr)
-			return pointerType;
-	return Optional<PointerType*>(false, nullptr);
+	if(entry->kind == TypeKind::POINTER)
+		return static_cast<const PointerType*>(entry->complexType.get());
+	return Optional<const PointerType*>(false, nullptr);
 }
 
-Optional<ArrayType*> DataType::getArrayType() const
+Optional<const ArrayType*> DataType::getArrayType() const
 {
-	ArrayType* arrayType = dynamic_cast<ArrayType*>(complexType.get());
-	if(arrayType != nullptr)
-		return arrayType;
-	return Optional<ArrayType*>(false, nullptr);
+	if(entry->kind == TypeKind::ARRAY)
+		return static_cast<const ArrayType*>(entry->complexType.get());
+	return Optional<const ArrayType*>(false, nullptr);
 }
 
-Optional<StructType*> DataType::getStructType() const
+Optional<const StructType*> DataType::getStructType() const
 {
-	StructType* structType = dynamic_cast<StructType*>(complexType.get());
-	if(structType != nullptr)
-		return structType;
-	return Optional<StructType*>(false, nullptr);
+	if(entry->kind == TypeKind::STRUCT)
+		return static_cast<const StructType*>(entry->complexType.get());
+	return Optional<const StructType*>(false, nullptr);
 }
 
 
-Optional<ImageType*> DataType::getImageType() const
+Optional<const ImageType*> DataType::getImageType() const
 {
-	ImageType* imageType = dynamic_cast<ImageType*>(complexType.get());
-	if(imageType != nullptr)
-		return imageType;
-	return Optional<ImageType*>(false, nullptr);
+	if(entry->kind == TypeKind::IMAGE)
+		return static_cast<const ImageType*>(entry->complexType.get());
+	return Optional<const ImageType*>(false, nullptr);
 }
 
 bool DataType::isFloatingType() const
 {
-	if(complexType)
-		return false;
-    return typeName == "float" || typeName == "double" || typeName == "half";
+	return entry->isFloating;
 }
 
 bool DataType::isUnknown() const
 {
-    return typeName[0] == '?';
+    return entry->isUnknown;
 }
 
 const DataType DataType::getElementType(const int index) const
@@ -146,37 +346,83 @@ const DataType DataType::getElementType(const int index) const
 		return getArrayType().value()->elementType;
 	if(getStructType() && index >= 0)
 		return getStructType().value()->elementTypes.at(static_cast<std::size_t>(index));
-	if(complexType)
+	if(isComplexType())
 		throw CompilationError(CompilationStep::GENERAL, "Can't get element-type of heterogeneous complex type", to_string());
     if(num == 1)
         return *this;
-    return DataType{typeName, 1};
+    return DataType{entry, 1};
 }
 
-const DataType DataType::toPointerType() const
+const DataType DataType::toPointerType(const AddressSpace addressSpace, const unsigned alignment) const
 {
-	std::shared_ptr<ComplexType> c(new PointerType(*this));
-	return DataType(to_string() + "*", 1, c);
+	const DataType elementType = *this;
+	const TypeKey key{TypeKind::POINTER, to_string() + "*", {std::make_pair(entry->index, num)}, {static_cast<uint32_t>(addressSpace), alignment}};
+	//the address space and the alignment are not relevant for equality
+	const TypeKey classKey{TypeKind::POINTER, key.name, {std::make_pair(typeID, num)}, {}};
+	return DataType(getTypeTable().intern(key, classKey, [&]() -> std::unique_ptr<ComplexType>
+	{
+		return std::unique_ptr<ComplexType>(new PointerType(elementType, addressSpace, alignment));
+	}));
 }
 
 const DataType DataType::toVectorType(unsigned char vectorWidth) const
 {
-	if(complexType)
+	if(isComplexType())
 		throw CompilationError(CompilationStep::GENERAL, "Can't form vector-type of complex type", to_string());
 	if(vectorWidth > 16 || vectorWidth == 0)
 		throw CompilationError(CompilationStep::GENERAL, "Invalid width for SIMD vector", std::to_string(static_cast<unsigned>(vectorWidth)));
-	if(num == vectorWidth)
-		return *this;
-	return DataType(typeName, vectorWidth, complexType);
+	return DataType(entry, vectorWidth);
+}
+
+const DataType DataType::toArrayType(const unsigned int size) const
+{
+	const DataType elementType = *this;
+	const TypeKey key{TypeKind::ARRAY, (to_string() + "[") + std::to_string(size) + "]", {std::make_pair(entry->index, num)}, {size}};
+	const TypeKey classKey{TypeKind::ARRAY, key.name, {std::make_pair(typeID, num)}, {size}};
+	return DataType(getTypeTable().intern(key, classKey, [&]() -> std::unique_ptr<ComplexType>
+	{
+		return std::unique_ptr<ComplexType>(new ArrayType(elementType, size));
+	}));
+}
+
+DataType DataType::createStructType(const std::string& name, const std::vector<DataType>& elementTypes, const bool isPacked)
+{
+	TypeKey key{TypeKind::STRUCT, name, {}, {isPacked}};
+	TypeKey classKey{TypeKind::STRUCT, name, {}, {isPacked}};
+	key.elements.reserve(elementTypes.size());
+	classKey.elements.reserve(elementTypes.size());
+	for(const DataType& element : elementTypes)
+	{
+		key.elements.emplace_back(element.entry->index, element.num);
+		classKey.elements.emplace_back(element.typeID, element.num);
+	}
+	return DataType(getTypeTable().intern(key, classKey, [&]() -> std::unique_ptr<ComplexType>
+	{
+		return std::unique_ptr<ComplexType>(new StructType(elementTypes, isPacked));
+	}));
+}
+
+DataType DataType::createImageType(const uint8_t dimensions, const bool isImageArray, const bool isImageBuffer, const bool isSampled)
+{
+	std::unique_ptr<ImageType> image(new ImageType());
+	image->dimensions = dimensions;
+	image->isImageArray = isImageArray;
+	image->isImageBuffer = isImageBuffer;
+	image->isSampled = isSampled;
+	const TypeKey key{TypeKind::IMAGE, image->getImageTypeName(), {}, {dimensions, isImageArray, isImageBuffer, isSampled}};
+	return DataType(getTypeTable().intern(key, key, [&]() -> std::unique_ptr<ComplexType>
+	{
+		return std::move(image);
+	}));
 }
 
 bool DataType::containsType(const DataType& other) const
 {
     if(*this == other)
         return true;
-    if(complexType)
+    if(isComplexType())
     		throw CompilationError(CompilationStep::GENERAL, "Can't check type hierarchy for complex type", to_string());
-    if(typeName[0] == 'i' && other.typeName[0] == 'i')
+    if(entry->name[0] == 'i' && other.entry->name[0] == 'i')
     {
         if(getScalarBitCount() <= other.getScalarBitCount())
         {
@@ -192,35 +438,24 @@ const DataType DataType::getUnionType(const DataType& other) const
 	if(*this == other)
 		return *this;
 	//doesn't work for heterogeneous types
-	if(complexType || other.complexType)
+	if(isComplexType() || other.isComplexType())
 		throw CompilationError(CompilationStep::GENERAL, "Can't form union type of distinct complex types!");
 	if(isFloatingType() != other.isFloatingType())
 		throw CompilationError(CompilationStep::GENERAL, "Can't form union type of floating-point and integer types!");
-	return DataType(getScalarBitCount() > other.getScalarBitCount() ? typeName : other.typeName, std::max(num, other.num));
+	return DataType(getScalarBitCount() > other.getScalarBitCount() ? entry : other.entry, std::max(num, other.num));
 }
 
 unsigned char DataType::getScalarBitCount() const
 {
-	if(isPointerType())
+	if(entry->kind == TypeKind::POINTER)
 		//32-bit pointer
 		return 32;
-	if(getImageType())
+	if(entry->kind == TypeKind::IMAGE)
 		//images are pointers to the image-data
 		return 32;
-	if(complexType)
+	if(isComplexType())
 		throw CompilationError(CompilationStep::GENERAL, "Can't get bit-width of complex type", to_string());
-    if(typeName[0] == 'i')
-    {
-        int bitCount = atoi(typeName.substr(1).data());
-        return static_cast<unsigned char>(bitCount);
-    }
-    if(typeName.compare("half") == 0)
-    	//16-bit floating point type
-    	return 16;
-    if(typeName.compare("void") == 0)
-    	//single byte
-    	return 8;
-    return 32;
+    return entry->scalarBitCount;
 }
 
 uint64_t DataType::getScalarWidthMask() const
@@ -241,7 +476,7 @@ unsigned int DataType::getPhysicalWidth() const
 		//images are just pointers to data
 		//32-bit pointer
 		return 4;
-	if(complexType)
+	if(isComplexType())
 		//any other complex type
 		throw CompilationError(CompilationStep::GENERAL, "Can't get width of complex type", to_string());
 	return getVectorWidth(true) * getScalarBitCount() / 8;
@@ -249,7 +484,7 @@ unsigned int DataType::getPhysicalWidth() const
 
 unsigned int DataType::getVectorWidth(bool physicalWidth) const
 {
-	if(complexType && num != 1)
+	if(isComplexType() && num != 1)
 		throw CompilationError(CompilationStep::GENERAL, "Can't have vectors of complex types", to_string());
 	if(physicalWidth && num == 3)
 		//OpenCL 1.2, page 203:
@@ -8,6 +8,7 @@
 #define TYPES_H
 
 #include "helper.h"
+#include "performance.h"
 
 #include <memory>
 #include <string>
@@ -18,6 +19,20 @@ namespace vc4c
 	static constexpr int WHOLE_OBJECT { -1 };
 	static constexpr int ANY_ELEMENT { -1 };
 
+	enum class AddressSpace
+	{
+		//the generic address space (SPIR-V StorageClassGeneric)
+		GENERIC = 0,
+		//private memory, only for the single execution, OpenCL defaults to this (SPIR-V StorageClassFunction)
+		PRIVATE = 1,
+		//global memory pool, shared between all kernel executions (SPIR-V StorageClassCrossWorkgroup)
+		GLOBAL = 2,
+		//constant memory, usually as part of the binary (global data segment) (SPIR-V StorageClassUniformConstant)
+		CONSTANT = 3,
+		//local memory, shared between all work-items in the work-group (SPIR-V StorageClassWorkgroup)
+		LOCAL = 4
+	};
+
 	struct ComplexType
 	{
 		virtual ~ComplexType();
@@ -29,15 +44,21 @@ namespace vc4c
 	struct ArrayType;
 	struct StructType;
 	struct ImageType;
-
+	struct TypeEntry;
+
+	/*
+	 * A data-type is a handle to an entry in the global type-table combined with the number of vector-elements.
+	 *
+	 * The base-types (the scalar or complex types without the vector-width) are interned, so equal types share the same type-ID,
+	 * which makes copying, comparing and hashing types cheap.
+	 * The table-entries are immutable, complex types are created via #toPointerType(), #toArrayType(), #createStructType() and #createImageType().
+	 */
 	struct DataType
 	{
-		std::string typeName;
 		//the number of elements for vector-types
 		unsigned char num;
-		std::shared_ptr<ComplexType> complexType;
 
-		DataType(const std::string& name = "", unsigned char num = 1, const std::shared_ptr<ComplexType>& complexType = nullptr);
+		DataType(const std::string& name = "", unsigned char num = 1);
 
 		std::string to_string() const;
 
@@ -46,8 +67,15 @@ namespace vc4c
 		 * Otherwise, returns #to_string()
 		 */
 		std::string getTypeName(bool isSigned = false, bool isUnsigned = false) const;
+		/*
+		 * Returns the name of the base-type, without the vector-width
+		 */
+		const std::string& getBaseName() const;
 
-		bool operator==(const DataType& right) const;
+		inline bool operator==(const DataType& right) const
+		{
+			return typeID == right.typeID && num == right.num;
+		}
 		inline bool operator!=(const DataType& right) const
 		{
 			return !(*this == right);
@@ -59,18 +87,20 @@ namespace vc4c
 		bool isVectorType() const;
 
 		//"complex" types
+		bool isComplexType() const;
 		bool isPointerType() const;
-		Optional<PointerType*> getPointerType() const;
-		Optional<ArrayType*> getArrayType() const;
-		Optional<StructType*> getStructType() const;
-		Optional<ImageType*> getImageType() const;
+		Optional<const PointerType*> getPointerType() const;
+		Optional<const ArrayType*> getArrayType() const;
+		Optional<const StructType*> getStructType() const;
+		Optional<const ImageType*> getImageType() const;
 
 		bool isFloatingType() const;
 		bool isUnknown() const;
 
 		const DataType getElementType(int index = ANY_ELEMENT) const;
-		const DataType toPointerType() const;
+		const DataType toPointerType(AddressSpace addressSpace = AddressSpace::PRIVATE, unsigned alignment = 0) const;
 		const DataType toVectorType(unsigned char vectorWidth) const;
+		const DataType toArrayType(unsigned int size) const;
 
 		bool containsType(const DataType& other) const;
 		const DataType getUnionType(const DataType& other) const;
@@ -89,6 +119,45 @@ namespace vc4c
 		 * The physical vector width is the number of elements used in RAM
 		 */
 		unsigned int getVectorWidth(bool physicalWidth = false) const;
+
+		/*
+		 * The ID of the base-type. Two types with the same ID and vector-width are equal
+		 */
+		inline uint32_t getTypeID() const
+		{
+			return typeID;
+		}
+
+		static DataType createStructType(const std::string& name, const std::vector<DataType>& elementTypes, bool isPacked = false);
+		static DataType createImageType(uint8_t dimensions, bool isImageArray, bool isImageBuffer, bool isSampled);
+
+	private:
+		const TypeEntry* entry;
+		uint32_t typeID;
+
+		explicit DataType(const TypeEntry* entry, unsigned char num = 1);
+	};
+
+	/*
+	 * Keeps the types created while any type-scope exists (e.g. the pointer-, array- and struct-types of a module) until the last type-scope is destroyed.
+	 *
+	 * Types created while no type-scope exists (e.g. the TYPE_XXX constants) are kept for the lifetime of the process.
+	 * So types created within a type-scope must not be used after all type-scopes are destroyed.
+	 */
+	class TypeScope : private NonCopyable
+	{
+	public:
+		TypeScope();
+		~TypeScope();
+	};
+
+	template<>
+	struct hash<DataType>
+	{
+		inline size_t operator()(const DataType& type) const noexcept
+		{
+			return (static_cast<size_t>(type.getTypeID()) << 8) | type.num;
+		}
 	};
 
 	static const DataType TYPE_INT8 = DataType { "i8", 1};
@@ -106,20 +175,6 @@ namespace vc4c
 //event is uint32
 	static const DataType TYPE_EVENT = TYPE_INT32;
 
-	enum class AddressSpace
-	{
-		//the generic address space (SPIR-V StorageClassGeneric)
-		GENERIC = 0,
-		//private memory, only for the single execution, OpenCL defaults to this (SPIR-V StorageClassFunction)
-		PRIVATE = 1,
-		//global memory pool, shared between all kernel executions (SPIR-V StorageClassCrossWorkgroup)
-		GLOBAL = 2,
-		//constant memory, usually as part of the binary (global data segment) (SPIR-V StorageClassUniformConstant)
-		CONSTANT = 3,
-		//local memory, shared between all work-items in the work-group (SPIR-V StorageClassWorkgroup)
-		LOCAL = 4
-	};
-
 	//not really that complex, but this allows e.g. pointer of pointers
 	struct PointerType : public ComplexType
 	{
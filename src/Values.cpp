@@ -505,22 +505,21 @@ bool Value::operator==(const Value& other) const
 		return true;
     if(valueType != other.valueType)
         return false;
-    if(type != other.type)
-        return false;
+    //compare the (cheap) contents first, the type-name comparison is more expensive
     switch(valueType)
     {
     case ValueType::CONTAINER:
-        return container.elements == other.container.elements;
+        return container.elements == other.container.elements && type == other.type;
     case ValueType::LITERAL:
-        return other.hasLiteral(literal);
+        return literal == other.literal && type == other.type;
     case ValueType::LOCAL:
-        return local == other.local;
+        return local == other.local && type == other.type;
     case ValueType::REGISTER:
-        return reg == other.reg;
+        return reg == other.reg && type == other.type;
     case ValueType::UNDEFINED:
-        return true;
+        return type == other.type;
     case ValueType::SMALL_IMMEDIATE:
-    	return other.hasImmediate(immediate);
+    	return immediate == other.immediate && type == other.type;
     }
     throw CompilationError(CompilationStep::GENERAL, "Unhandled value-type!");
 }
@@ -598,7 +597,7 @@ Optional<Literal> Value::getLiteralValue() const
 
 std::string Value::to_string(const bool writeAccess, bool withLiterals) const
 {
-    const std::string typeName = (type.typeName.empty() ? "unknown" : type.to_string()) + ' ';
+    const std::string typeName = (type.getBaseName().empty() ? "unknown" : type.to_string()) + ' ';
     switch(valueType)
     {
     case ValueType::LITERAL:
@@ -721,7 +720,50 @@ Value Value::createZeroInitializer(const DataType& type)
 	return val;
 }
 
+static inline std::size_t combineHash(std::size_t seed, std::size_t value) noexcept
+{
+	//see boost::hash_combine
+	return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+static std::size_t hashLiteral(const Literal& lit) noexcept
+{
+	//needs to match Literal#operator==
+	switch(lit.type)
+	{
+		case LiteralType::BOOL:
+			return std::hash<bool>{}(lit.isTrue());
+		case LiteralType::REAL:
+		{
+			const double real = lit.real();
+			//+0.0 and -0.0 compare equal
+			return real == 0.0 ? 0 : std::hash<double>{}(real);
+		}
+		case LiteralType::INTEGER:
+			break;
+	}
+	return std::hash<int64_t>{}(lit.integer);
+}
+
 std::size_t vc4c::hash<vc4c::Value>::operator()(vc4c::Value const& val) const noexcept
 {
-	return std::hash<std::string>::operator()(val.to_string());
+	std::size_t result = combineHash(static_cast<std::size_t>(val.valueType), vc4c::hash<DataType>{}(val.type));
+	switch(val.valueType)
+	{
+		case ValueType::CONTAINER:
+			for(const Value& element : val.container.elements)
+				result = combineHash(result, operator()(element));
+			return result;
+		case ValueType::LITERAL:
+			return combineHash(result, hashLiteral(val.literal));
+		case ValueType::LOCAL:
+			return combineHash(result, std::hash<const Local*>{}(val.local));
+		case ValueType::REGISTER:
+			return combineHash(result, (static_cast<std::size_t>(val.reg.file) << 8) | val.reg.num);
+		case ValueType::SMALL_IMMEDIATE:
+			return combineHash(result, val.immediate.value);
+		case ValueType::UNDEFINED:
+			return result;
+	}
+	return result;
 }
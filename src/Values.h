@@ -303,8 +303,13 @@ namespace vc4c
 	const Value ELEMENT_NUMBER_REGISTER(REG_ELEMENT_NUMBER, TYPE_INT8.toVectorType(16));
 	const Value ROTATION_REGISTER(REG_ACC5, TYPE_INT8);
 
+	/*
+	 * Structural hash over the value-type, the contents (literal, register, local, small immediate or container elements) and the data-type.
+	 *
+	 * Two values comparing equal via Value#operator== always have the same hash. Calculating the hash does not allocate any memory.
+	 */
 	template<>
-	struct hash<Value> : public std::hash<std::string>
+	struct hash<Value>
 	{
 		size_t operator()(const Value& val) const noexcept;
 	};
@@ -0,0 +1,238 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "DataFlowAnalysis.h"
+
+#include "../InstructionWalker.h"
+#include "../Profiler.h"
+
+#include <deque>
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+static constexpr std::size_t BITS_PER_WORD = 64;
+
+BitSet::BitSet(const std::size_t size) : words((size + BITS_PER_WORD - 1) / BITS_PER_WORD, 0), numBits(size)
+{
+}
+
+std::size_t BitSet::size() const
+{
+	return numBits;
+}
+
+std::size_t BitSet::count() const
+{
+	std::size_t num = 0;
+	for(uint64_t word : words)
+		num += static_cast<std::size_t>(__builtin_popcountll(word));
+	return num;
+}
+
+bool BitSet::none() const
+{
+	for(uint64_t word : words)
+	{
+		if(word != 0)
+			return false;
+	}
+	return true;
+}
+
+bool BitSet::test(const std::size_t index) const
+{
+	return (words[index / BITS_PER_WORD] & (uint64_t{1} << (index % BITS_PER_WORD))) != 0;
+}
+
+void BitSet::set(const std::size_t index)
+{
+	words[index / BITS_PER_WORD] |= uint64_t{1} << (index % BITS_PER_WORD);
+}
+
+void BitSet::reset(const std::size_t index)
+{
+	words[index / BITS_PER_WORD] &= ~(uint64_t{1} << (index % BITS_PER_WORD));
+}
+
+void BitSet::setAll()
+{
+	for(uint64_t& word : words)
+		word = ~uint64_t{0};
+	//clear the bits beyond the size, so the comparison and counting of sets is not disturbed
+	if(numBits % BITS_PER_WORD != 0)
+		words.back() = (uint64_t{1} << (numBits % BITS_PER_WORD)) - 1;
+}
+
+bool BitSet::unite(const BitSet& other)
+{
+	bool changed = false;
+	for(std::size_t i = 0; i < words.size(); ++i)
+	{
+		const uint64_t tmp = words[i] | other.words[i];
+		changed = changed || tmp != words[i];
+		words[i] = tmp;
+	}
+	return changed;
+}
+
+void BitSet::subtract(const BitSet& other)
+{
+	for(std::size_t i = 0; i < words.size(); ++i)
+		words[i] &= ~other.words[i];
+}
+
+void BitSet::intersect(const BitSet& other)
+{
+	for(std::size_t i = 0; i < words.size(); ++i)
+		words[i] &= other.words[i];
+}
+
+void BitSet::forAll(const std::function<void(std::size_t)>& consumer) const
+{
+	for(std::size_t i = 0; i < words.size(); ++i)
+	{
+		uint64_t word = words[i];
+		while(word != 0)
+		{
+			const std::size_t bit = static_cast<std::size_t>(__builtin_ctzll(word));
+			consumer(i * BITS_PER_WORD + bit);
+			//clear lowest set bit
+			word &= word - 1;
+		}
+	}
+}
+
+bool BitSet::operator==(const BitSet& other) const
+{
+	return numBits == other.numBits && words == other.words;
+}
+
+bool BitSet::operator!=(const BitSet& other) const
+{
+	return !(*this == other);
+}
+
+LocalNumbering::LocalNumbering(const Method& method)
+{
+	method.forAllInstructions([this](const intermediate::IntermediateInstruction* instr) -> void
+	{
+		instr->forUsedLocals([this](const Local* local, LocalUser::Type type) -> void
+		{
+			if(local->type != TYPE_LABEL && numbers.emplace(local, locals.size()).second)
+				locals.push_back(local);
+		});
+	});
+}
+
+std::size_t LocalNumbering::size() const
+{
+	return locals.size();
+}
+
+Optional<std::size_t> LocalNumbering::getNumber(const Local* local) const
+{
+	auto it = numbers.find(local);
+	if(it == numbers.end())
+		return {};
+	return Optional<std::size_t>(it->second);
+}
+
+const Local* LocalNumbering::getLocal(const std::size_t number) const
+{
+	return locals.at(number);
+}
+
+BitSetDataFlow::BitSetDataFlow(Method& method, const DataFlowDirection direction, const std::size_t numElements) : method(method), direction(direction)
+{
+	sets.reserve(method.getBasicBlocks().size());
+	for(const BasicBlock& block : method.getBasicBlocks())
+		sets.emplace(&block, DataFlowSets{BitSet(numElements), BitSet(numElements), BitSet(numElements), BitSet(numElements)});
+}
+
+DataFlowSets& BitSetDataFlow::getSets(const BasicBlock& block)
+{
+	return sets.at(&block);
+}
+
+const DataFlowSets& BitSetDataFlow::getSets(const BasicBlock& block) const
+{
+	return sets.at(&block);
+}
+
+void BitSetDataFlow::solve()
+{
+	PROFILE_START(solveDataFlow);
+	/*
+	 * The edges are taken from the same source as the control-flow graph (the predecessors of all blocks),
+	 * but the nodes of the control-flow graph map their neighbors by node, so they cannot store both directions for a pair of blocks jumping to each other (e.g. a loop consisting of a single block)
+	 */
+	FastMap<const BasicBlock*, std::vector<const BasicBlock*>> predecessors;
+	FastMap<const BasicBlock*, std::vector<const BasicBlock*>> successors;
+	predecessors.reserve(sets.size());
+	successors.reserve(sets.size());
+	for(const BasicBlock& block : method.getBasicBlocks())
+	{
+		block.forPredecessors([&block, &predecessors, &successors](InstructionWalker it) -> void
+		{
+			predecessors[&block].push_back(it.getBasicBlock());
+			successors[it.getBasicBlock()].push_back(&block);
+		});
+	}
+	const bool isForward = direction == DataFlowDirection::FORWARD;
+	//the blocks the information flows from and to
+	const auto& inputBlocks = isForward ? predecessors : successors;
+	const auto& outputBlocks = isForward ? successors : predecessors;
+
+	//start with the blocks in the order of the information flow, so most blocks only need to be processed once for acyclic control-flow
+	std::deque<const BasicBlock*> workList;
+	FastSet<const BasicBlock*> queuedBlocks;
+	queuedBlocks.reserve(sets.size());
+	for(const BasicBlock& block : method.getBasicBlocks())
+	{
+		if(isForward)
+			workList.push_back(&block);
+		else
+			workList.push_front(&block);
+		queuedBlocks.emplace(&block);
+	}
+
+	//the initial in- and out-sets are empty, so every block is processed at least once
+	while(!workList.empty())
+	{
+		const BasicBlock* block = workList.front();
+		workList.pop_front();
+		queuedBlocks.erase(block);
+		DataFlowSets& blockSets = sets.at(block);
+		BitSet& input = isForward ? blockSets.in : blockSets.out;
+		BitSet& output = isForward ? blockSets.out : blockSets.in;
+
+		auto inputIt = inputBlocks.find(block);
+		if(inputIt != inputBlocks.end())
+		{
+			for(const BasicBlock* neighbor : inputIt->second)
+				input.unite(isForward ? sets.at(neighbor).out : sets.at(neighbor).in);
+		}
+
+		BitSet result(input);
+		result.subtract(blockSets.kill);
+		result.unite(blockSets.gen);
+		if(result != output)
+		{
+			output = result;
+			auto outputIt = outputBlocks.find(block);
+			if(outputIt != outputBlocks.end())
+			{
+				for(const BasicBlock* neighbor : outputIt->second)
+				{
+					if(queuedBlocks.emplace(neighbor).second)
+						workList.push_back(neighbor);
+				}
+			}
+		}
+	}
+	PROFILE_END(solveDataFlow);
+}
@@ -0,0 +1,140 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_DATA_FLOW_ANALYSIS_H
+#define VC4C_DATA_FLOW_ANALYSIS_H
+
+#include "../Module.h"
+#include "../performance.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * A set of small non-negative numbers (e.g. the numbers assigned to locals), stored as one bit per possible element.
+		 *
+		 * All sets combined with each other need to have the same size
+		 */
+		class BitSet
+		{
+		public:
+			explicit BitSet(std::size_t size = 0);
+
+			/*
+			 * Returns the number of possible elements (NOT the number of elements contained)
+			 */
+			std::size_t size() const;
+			/*
+			 * Returns the number of elements contained
+			 */
+			std::size_t count() const;
+			bool none() const;
+
+			bool test(std::size_t index) const;
+			void set(std::size_t index);
+			void reset(std::size_t index);
+			void setAll();
+
+			/*
+			 * Adds all elements of the other set to this set and returns whether this set was changed
+			 */
+			bool unite(const BitSet& other);
+			/*
+			 * Removes all elements of the other set from this set
+			 */
+			void subtract(const BitSet& other);
+			/*
+			 * Removes all elements from this set, which are not contained in the other set
+			 */
+			void intersect(const BitSet& other);
+
+			/*
+			 * Runs the consumer for all elements contained, in ascending order
+			 */
+			void forAll(const std::function<void(std::size_t)>& consumer) const;
+
+			bool operator==(const BitSet& other) const;
+			bool operator!=(const BitSet& other) const;
+
+		private:
+			std::vector<uint64_t> words;
+			std::size_t numBits;
+		};
+
+		/*
+		 * Assigns every local used within a method a dense number, so sets of locals can be represented as bit-sets.
+		 *
+		 * Labels are not numbered, since they are never live in a register.
+		 * NOTE: The numbering is a snapshot, locals created afterwards are not numbered!
+		 */
+		class LocalNumbering
+		{
+		public:
+			explicit LocalNumbering(const Method& method);
+
+			std::size_t size() const;
+			Optional<std::size_t> getNumber(const Local* local) const;
+			const Local* getLocal(std::size_t number) const;
+
+		private:
+			FastMap<const Local*, std::size_t> numbers;
+			std::vector<const Local*> locals;
+		};
+
+		enum class DataFlowDirection
+		{
+			//the information flows from a block to its successors, e.g. reaching definitions
+			FORWARD,
+			//the information flows from a block to its predecessors, e.g. liveness
+			BACKWARD
+		};
+
+		/*
+		 * The sets of a single basic block.
+		 *
+		 * The transfer-function of the block is: out = gen | (in - kill) for forward problems, in = gen | (out - kill) for backward problems
+		 */
+		struct DataFlowSets
+		{
+			BitSet gen;
+			BitSet kill;
+			BitSet in;
+			BitSet out;
+		};
+
+		/*
+		 * Solver for data-flow problems over the basic blocks of a method, where the values are represented as bit-sets and the meet-operator is the union
+		 * (a "may"-problem, e.g. liveness or reaching definitions).
+		 *
+		 * The user of this class sets the gen- and kill-sets for every basic block, then the in- and out-sets are calculated by a work-list iterating the control-flow between the blocks until a fix-point is reached.
+		 */
+		class BitSetDataFlow
+		{
+		public:
+			BitSetDataFlow(Method& method, DataFlowDirection direction, std::size_t numElements);
+
+			DataFlowSets& getSets(const BasicBlock& block);
+			const DataFlowSets& getSets(const BasicBlock& block) const;
+
+			/*
+			 * Calculates the in- and out-sets of all basic blocks from their gen- and kill-sets
+			 */
+			void solve();
+
+		private:
+			Method& method;
+			DataFlowDirection direction;
+			FastMap<const BasicBlock*, DataFlowSets> sets;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_DATA_FLOW_ANALYSIS_H */
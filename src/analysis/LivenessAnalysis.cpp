@@ -0,0 +1,211 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "LivenessAnalysis.h"
+
+#include "../Profiler.h"
+#include "../intermediate/IntermediateInstruction.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+namespace
+{
+	/*
+	 * The state of a local while walking backwards through a basic block, which is required to determine whether conditional writes end its live-range
+	 */
+	struct ConditionalState
+	{
+		//the condition of all reads since the local became live, COND_ALWAYS if unknown or the conditions differ
+		ConditionCode readCondition;
+		//the condition of a conditional write already found (after the last read), COND_NEVER if there is none
+		ConditionCode writeCondition;
+	};
+
+	/*
+	 * Walks backwards through the instructions of a basic block and applies their transfer-functions to the set of live locals
+	 */
+	class BlockScan
+	{
+	public:
+		BitSet live;
+
+		BlockScan(const LocalNumbering& numbering, const BitSet& liveOut, bool trackConditionalWrites) :
+			live(liveOut), numbering(numbering), trackConditionalWrites(trackConditionalWrites)
+		{
+		}
+
+		void step(const intermediate::IntermediateInstruction* instr)
+		{
+			const intermediate::CombinedOperation* combined = dynamic_cast<const intermediate::CombinedOperation*>(instr);
+			if(combined != nullptr)
+			{
+				//the writes of an instruction happen after its reads, so we need to process them first
+				if(combined->op1)
+					processWrite(combined->op1.get());
+				if(combined->op2)
+					processWrite(combined->op2.get());
+				if(combined->op1)
+					processReads(combined->op1.get());
+				if(combined->op2)
+					processReads(combined->op2.get());
+			}
+			else
+			{
+				processWrite(instr);
+				processReads(instr);
+			}
+		}
+
+	private:
+		const LocalNumbering& numbering;
+		const bool trackConditionalWrites;
+		FastMap<std::size_t, ConditionalState> conditions;
+
+		void processWrite(const intermediate::IntermediateInstruction* instr)
+		{
+			if(!instr->hasValueType(ValueType::LOCAL))
+				return;
+			const Optional<std::size_t> number = numbering.getNumber(instr->getOutput()->local);
+			if(number && live.test(number.value()) && endsLiveRange(instr, number.value()))
+			{
+				live.reset(number.value());
+				conditions.erase(number.value());
+			}
+		}
+
+		void processReads(const intermediate::IntermediateInstruction* instr)
+		{
+			for(const Value& arg : instr->getArguments())
+			{
+				if(!arg.hasType(ValueType::LOCAL))
+					continue;
+				const Optional<std::size_t> number = numbering.getNumber(arg.local);
+				if(!number)
+					continue;
+				if(!live.test(number.value()))
+				{
+					live.set(number.value());
+					if(trackConditionalWrites && instr->conditional != COND_ALWAYS)
+						conditions.emplace(number.value(), ConditionalState{instr->conditional, COND_NEVER});
+				}
+				else if(trackConditionalWrites)
+				{
+					auto it = conditions.find(number.value());
+					if(it != conditions.end())
+					{
+						//the read splits two conditional writes, so they can no longer complement each other
+						it->second.writeCondition = COND_NEVER;
+						if(it->second.readCondition != instr->conditional)
+							conditions.erase(it);
+					}
+				}
+			}
+		}
+
+		bool endsLiveRange(const intermediate::IntermediateInstruction* instr, const std::size_t number)
+		{
+			if(has_flag(instr->decoration, intermediate::InstructionDecorations::ELEMENT_INSERTION))
+				return false;
+			if(!trackConditionalWrites)
+				return instr->conditional == COND_ALWAYS && !instr->hasPackMode();
+			if(instr->conditional == COND_ALWAYS)
+				return true;
+			auto it = conditions.find(number);
+			if(it != conditions.end() && (it->second.readCondition == instr->conditional || it->second.writeCondition.isInversionOf(instr->conditional)))
+				return true;
+			if(has_flag(instr->decoration, intermediate::InstructionDecorations::PHI_NODE))
+				return true;
+			if(it == conditions.end())
+				conditions.emplace(number, ConditionalState{COND_ALWAYS, instr->conditional});
+			else if(it->second.writeCondition == COND_NEVER)
+				it->second.writeCondition = instr->conditional;
+			return false;
+		}
+	};
+} // namespace
+
+LivenessAnalysis::LivenessAnalysis(Method& method, const bool trackConditionalWrites) :
+	numbering(method), dataFlow(method, DataFlowDirection::BACKWARD, numbering.size()), trackConditionalWrites(trackConditionalWrites)
+{
+	PROFILE_START(LivenessAnalysis);
+	for(BasicBlock& block : method.getBasicBlocks())
+		calculateGenAndKill(block);
+	dataFlow.solve();
+	PROFILE_END(LivenessAnalysis);
+}
+
+const LocalNumbering& LivenessAnalysis::getLocalNumbering() const
+{
+	return numbering;
+}
+
+const BitSet& LivenessAnalysis::getLiveIn(const BasicBlock& block) const
+{
+	return dataFlow.getSets(block).in;
+}
+
+const BitSet& LivenessAnalysis::getLiveOut(const BasicBlock& block) const
+{
+	return dataFlow.getSets(block).out;
+}
+
+void LivenessAnalysis::forInstructionsInBlock(BasicBlock& block, const std::function<void(InstructionWalker, const BitSet&)>& consumer) const
+{
+	BlockScan scan(numbering, getLiveOut(block), trackConditionalWrites);
+	InstructionWalker it = block.end();
+	do
+	{
+		it.previousInBlock();
+		if(!it.has())
+			continue;
+		consumer(it, scan.live);
+		scan.step(it.get());
+	} while(!it.isStartOfBlock());
+}
+
+bool LivenessAnalysis::isLiveAfter(InstructionWalker it, const Local* local) const
+{
+	const Optional<std::size_t> number = numbering.getNumber(local);
+	if(!number)
+		return false;
+	BlockScan scan(numbering, getLiveOut(*it.getBasicBlock()), trackConditionalWrites);
+	InstructionWalker pos = it.getBasicBlock()->end();
+	pos.previousInBlock();
+	while(!(pos == it))
+	{
+		if(pos.has())
+			scan.step(pos.get());
+		pos.previousInBlock();
+	}
+	return scan.live.test(number.value());
+}
+
+void LivenessAnalysis::calculateGenAndKill(BasicBlock& block)
+{
+	DataFlowSets& sets = dataFlow.getSets(block);
+	/*
+	 * Since the state of every local is independent of all other locals, it is enough to walk the block twice:
+	 * - starting with no live locals, the locals live at the start of the block are the ones read before being written (gen-set)
+	 * - starting with all locals live, the locals not live at the start of the block are the ones overwritten (kill-set)
+	 */
+	BlockScan genScan(numbering, sets.gen, trackConditionalWrites);
+	BitSet allLocals(numbering.size());
+	allLocals.setAll();
+	BlockScan killScan(numbering, allLocals, trackConditionalWrites);
+	InstructionWalker it = block.end();
+	do
+	{
+		it.previousInBlock();
+		if(!it.has())
+			continue;
+		genScan.step(it.get());
+		killScan.step(it.get());
+	} while(!it.isStartOfBlock());
+	sets.gen = genScan.live;
+	sets.kill = allLocals;
+	sets.kill.subtract(killScan.live);
+}
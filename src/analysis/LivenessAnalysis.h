@@ -0,0 +1,63 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_LIVENESS_ANALYSIS_H
+#define VC4C_LIVENESS_ANALYSIS_H
+
+#include "DataFlowAnalysis.h"
+
+#include "../InstructionWalker.h"
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * Determines which locals are live (e.g. may be read afterwards, before being overwritten) at the start and the end of every basic block of a method
+		 * as well as after every single instruction.
+		 *
+		 * Only writes to the whole value of a local end its live-range, so writes to single elements (e.g. vector insertions) and writes with pack-modes do not.
+		 * If conditional writes are tracked, additionally the following conditional writes end the live-range of a local (as the register-allocator assumes):
+		 * - two consecutive writes with inverted conditions (e.g. for selects),
+		 * - a write with the same condition as all following reads of the local,
+		 * - a write setting the value of a phi-node.
+		 * Otherwise, the live-range of a local only ends at unconditional writes, which is required for optimizations removing writes deemed to be unused.
+		 *
+		 * NOTE: The analysis is a snapshot and needs to be recreated after the instructions of the method are modified.
+		 */
+		class LivenessAnalysis
+		{
+		public:
+			LivenessAnalysis(Method& method, bool trackConditionalWrites);
+
+			const LocalNumbering& getLocalNumbering() const;
+
+			const BitSet& getLiveIn(const BasicBlock& block) const;
+			const BitSet& getLiveOut(const BasicBlock& block) const;
+
+			/*
+			 * Runs the consumer for all instructions in the given basic block (in reverse order, including the label) with the set of locals live directly after the instruction
+			 */
+			void forInstructionsInBlock(BasicBlock& block, const std::function<void(InstructionWalker, const BitSet&)>& consumer) const;
+
+			/*
+			 * Returns whether the local is live directly after the given instruction.
+			 *
+			 * NOTE: This walks to the end of the basic block, so to check all instructions, #forInstructionsInBlock should be used.
+			 */
+			bool isLiveAfter(InstructionWalker it, const Local* local) const;
+
+		private:
+			LocalNumbering numbering;
+			BitSetDataFlow dataFlow;
+			bool trackConditionalWrites;
+
+			void calculateGenAndKill(BasicBlock& block);
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_LIVENESS_ANALYSIS_H */
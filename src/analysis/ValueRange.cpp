@@ -0,0 +1,251 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "ValueRange.h"
+
+#include "../intermediate/IntermediateInstruction.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+using namespace vc4c::intermediate;
+
+static constexpr int64_t MIN_VALUE = std::numeric_limits<int32_t>::min();
+static constexpr int64_t MAX_VALUE = std::numeric_limits<int32_t>::max();
+//limits the recursion over the writers of the locals, locals further up the chain are unknown
+static constexpr unsigned MAX_DEPTH = 32;
+
+ValueRange::ValueRange() : minValue(MIN_VALUE), maxValue(MAX_VALUE)
+{
+}
+
+ValueRange::ValueRange(const int64_t minValue, const int64_t maxValue) : minValue(minValue), maxValue(maxValue)
+{
+	//ranges exceeding the 32-bit registers can wrap around, so anything could be the result
+	if(minValue < MIN_VALUE || maxValue > MAX_VALUE || minValue > maxValue)
+	{
+		this->minValue = MIN_VALUE;
+		this->maxValue = MAX_VALUE;
+	}
+}
+
+bool ValueRange::isUnknown() const
+{
+	return minValue == MIN_VALUE && maxValue == MAX_VALUE;
+}
+
+bool ValueRange::fitsIntoUnsignedBits(const unsigned numBits) const
+{
+	return minValue >= 0 && maxValue < (int64_t(1) << numBits);
+}
+
+bool ValueRange::absoluteFitsIntoBits(const unsigned numBits) const
+{
+	return -minValue < (int64_t(1) << numBits) && maxValue < (int64_t(1) << numBits);
+}
+
+ValueRange ValueRange::unite(const ValueRange& other) const
+{
+	return ValueRange(std::min(minValue, other.minValue), std::max(maxValue, other.maxValue));
+}
+
+std::string ValueRange::to_string() const
+{
+	if(isUnknown())
+		return "[?]";
+	return std::string("[") + std::to_string(minValue) + ", " + std::to_string(maxValue) + "]";
+}
+
+static Optional<int64_t> getShiftOffset(const Value& value)
+{
+	const Optional<Literal> lit = value.getLiteralValue();
+	if(!lit || lit->type != LiteralType::INTEGER || lit->integer < 0 || lit->integer > 31)
+		return {};
+	return lit->integer;
+}
+
+static ValueRange determineRange(const Value& value, const Method& method, FastMap<const Local*, ValueRange>& ranges, unsigned depth);
+
+static ValueRange getWorkItemRange(const InstructionDecorations decoration, const std::string& methodName, const Method& method)
+{
+	//the local IDs and sizes are stored as single bytes
+	const uint32_t maxLocalSize = method.metaData.workGroupSizes.at(0) > 0 ? *std::max_element(method.metaData.workGroupSizes.begin(), method.metaData.workGroupSizes.end()) : 0xFF;
+	if(has_flag(decoration, InstructionDecorations::BUILTIN_LOCAL_ID) || methodName == "vc4cl_local_id")
+		return ValueRange(0, std::max(maxLocalSize, 1u) - 1);
+	if(has_flag(decoration, InstructionDecorations::BUILTIN_LOCAL_SIZE) || methodName == "vc4cl_local_size")
+		return ValueRange(0, maxLocalSize);
+	if(has_flag(decoration, InstructionDecorations::BUILTIN_WORK_DIMENSIONS) || methodName == "vc4cl_work_dimensions")
+		return ValueRange(1, 3);
+	return ValueRange();
+}
+
+static ValueRange getOperationRange(const Operation* op, const Method& method, FastMap<const Local*, ValueRange>& ranges, const unsigned depth)
+{
+	const ValueRange first = determineRange(op->getFirstArg(), method, ranges, depth);
+	if(op->op == OP_CLZ)
+		return ValueRange(0, 32);
+	if(!op->getSecondArg())
+		return ValueRange();
+	const Value& arg1 = op->getSecondArg().value();
+	const ValueRange second = determineRange(arg1, method, ranges, depth);
+
+	if(op->op == OP_AND)
+	{
+		//masking with a non-negative value clears the sign and can only lower the value
+		if(first.minValue >= 0 && second.minValue >= 0)
+			return ValueRange(0, std::min(first.maxValue, second.maxValue));
+		if(first.minValue >= 0)
+			return ValueRange(0, first.maxValue);
+		if(second.minValue >= 0)
+			return ValueRange(0, second.maxValue);
+		return ValueRange();
+	}
+	if(op->op == OP_OR || op->op == OP_XOR)
+	{
+		if(first.minValue < 0 || second.minValue < 0)
+			return ValueRange();
+		//the result cannot have more bits than the larger operand
+		int64_t mask = 1;
+		while(mask <= std::max(first.maxValue, second.maxValue))
+			mask <<= 1;
+		return ValueRange(0, mask - 1);
+	}
+	if(op->op == OP_SHR || op->op == OP_ASR || op->op == OP_SHL)
+	{
+		const Optional<int64_t> offset = getShiftOffset(arg1);
+		if(!offset)
+			return ValueRange();
+		if(op->op == OP_SHL)
+			//shifting out any set bit would wrap the value
+			return first.minValue >= 0 ? ValueRange(first.minValue << offset.value(), first.maxValue << offset.value()) : ValueRange();
+		if(op->op == OP_ASR || first.minValue >= 0)
+			return ValueRange(first.minValue >> offset.value(), first.maxValue >> offset.value());
+		return offset.value() == 0 ? first : ValueRange(0, static_cast<int64_t>(std::numeric_limits<uint32_t>::max() >> offset.value()));
+	}
+	if(first.isUnknown() && second.isUnknown())
+		return ValueRange();
+	if(op->op == OP_MIN)
+		return ValueRange(std::min(first.minValue, second.minValue), std::min(first.maxValue, second.maxValue));
+	if(op->op == OP_MAX)
+		return ValueRange(std::max(first.minValue, second.minValue), std::max(first.maxValue, second.maxValue));
+	if(first.isUnknown() || second.isUnknown())
+		return ValueRange();
+	if(op->op == OP_ADD)
+		return ValueRange(first.minValue + second.minValue, first.maxValue + second.maxValue);
+	if(op->op == OP_SUB)
+		return ValueRange(first.minValue - second.maxValue, first.maxValue - second.minValue);
+	if((op->op == OP_MUL24 && first.fitsIntoUnsignedBits(24) && second.fitsIntoUnsignedBits(24)) || op->opCode == "mul")
+	{
+		const int64_t products[] = {first.minValue * second.minValue, first.minValue * second.maxValue, first.maxValue * second.minValue, first.maxValue * second.maxValue};
+		return ValueRange(*std::min_element(std::begin(products), std::end(products)), *std::max_element(std::begin(products), std::end(products)));
+	}
+	if((op->opCode == "udiv" || op->opCode == "urem") && first.minValue >= 0 && second.minValue > 0)
+	{
+		if(op->opCode == "udiv")
+			return ValueRange(first.minValue / second.maxValue, first.maxValue / second.minValue);
+		return ValueRange(0, std::min(first.maxValue, second.maxValue - 1));
+	}
+	return ValueRange();
+}
+
+static ValueRange getUnpackRange(const Unpack unpack)
+{
+	//the moves unpacking a value are integer operations, so the bytes are zero-extended and the half-words are sign-extended
+	if(unpack == UNPACK_8A_32 || unpack == UNPACK_8B_32 || unpack == UNPACK_8C_32 || unpack == UNPACK_8D_32)
+		return ValueRange(0, std::numeric_limits<uint8_t>::max());
+	if(unpack == UNPACK_16A_32 || unpack == UNPACK_16B_32)
+		return ValueRange(std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
+	return ValueRange();
+}
+
+static ValueRange getWriterRange(const IntermediateInstruction* writer, const Method& method, FastMap<const Local*, ValueRange>& ranges, const unsigned depth)
+{
+	if(writer != nullptr && !writer->hasPackMode() && dynamic_cast<const MoveOperation*>(writer) != nullptr && dynamic_cast<const VectorRotation*>(writer) == nullptr)
+	{
+		const ValueRange unpackRange = getUnpackRange(writer->unpackMode);
+		if(!unpackRange.isUnknown())
+			return unpackRange;
+	}
+	if(writer == nullptr || writer->hasPackMode() || writer->hasUnpackMode())
+		return ValueRange();
+	const MethodCall* call = dynamic_cast<const MethodCall*>(writer);
+	const ValueRange workItemRange = getWorkItemRange(writer->decoration, call != nullptr ? call->methodName : "", method);
+	if(!workItemRange.isUnknown())
+		return workItemRange;
+	//vector rotations only move the elements around
+	if(dynamic_cast<const MoveOperation*>(writer) != nullptr)
+		return determineRange(dynamic_cast<const MoveOperation*>(writer)->getSource(), method, ranges, depth);
+	if(dynamic_cast<const LoadImmediate*>(writer) != nullptr)
+		return determineRange(Value(dynamic_cast<const LoadImmediate*>(writer)->getImmediate(), writer->getOutput()->type), method, ranges, depth);
+	if(dynamic_cast<const Operation*>(writer) != nullptr)
+		return getOperationRange(dynamic_cast<const Operation*>(writer), method, ranges, depth);
+	return ValueRange();
+}
+
+static ValueRange determineRange(const Value& value, const Method& method, FastMap<const Local*, ValueRange>& ranges, const unsigned depth)
+{
+	if(value.type.isFloatingType() || value.type.getScalarBitCount() > 32)
+		return ValueRange();
+	if(value.hasType(ValueType::CONTAINER))
+	{
+		if(value.container.elements.empty())
+			return ValueRange();
+		ValueRange range = determineRange(value.container.elements.front(), method, ranges, depth);
+		for(const Value& element : value.container.elements)
+			range = range.unite(determineRange(element, method, ranges, depth));
+		return range;
+	}
+	if(value.isLiteralValue())
+	{
+		const Literal lit = value.getLiteralValue().value();
+		if(lit.type == LiteralType::REAL)
+			return ValueRange();
+		//the literal is interpreted as the 32-bit value stored in the register
+		return ValueRange(static_cast<int32_t>(lit.integer), static_cast<int32_t>(lit.integer));
+	}
+	if(!value.hasType(ValueType::LOCAL) || depth > MAX_DEPTH)
+		return ValueRange();
+	const Local* local = value.local;
+	auto it = ranges.find(local);
+	if(it != ranges.end())
+		return it->second;
+	//locals depending on themselves are unknown
+	ranges.emplace(local, ValueRange());
+
+	bool hasRange = false;
+	ValueRange range;
+	if(local->is<Parameter>() && local->type.getScalarBitCount() < 32)
+	{
+		const Parameter* param = local->as<Parameter>();
+		const int64_t numBits = param->type.getScalarBitCount();
+		if(has_flag(param->decorations, ParameterDecorations::ZERO_EXTEND))
+			range = ValueRange(0, (int64_t(1) << numBits) - 1);
+		else if(has_flag(param->decorations, ParameterDecorations::SIGN_EXTEND))
+			range = ValueRange(-(int64_t(1) << (numBits - 1)), (int64_t(1) << (numBits - 1)) - 1);
+		hasRange = true;
+	}
+	else if(local->is<Parameter>() || local->is<Global>())
+		//the value is not set by an instruction
+		hasRange = true;
+	local->forUsers(LocalUser::Type::WRITER, [&](const LocalUser* user) -> void
+	{
+		const ValueRange writerRange = getWriterRange(dynamic_cast<const IntermediateInstruction*>(user), method, ranges, depth + 1);
+		range = hasRange ? range.unite(writerRange) : writerRange;
+		hasRange = true;
+	});
+	if(!hasRange)
+		range = ValueRange();
+	ranges[local] = range;
+	return range;
+}
+
+ValueRange ValueRange::getValueRange(const Value& value, const Method& method)
+{
+	FastMap<const Local*, ValueRange> ranges;
+	return determineRange(value, method, ranges, 0);
+}
@@ -0,0 +1,69 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_VALUE_RANGE_H
+#define VC4C_VALUE_RANGE_H
+
+#include "../Module.h"
+
+#include <cstdint>
+#include <string>
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * The (inclusive) range of the integer values a literal or a local can take, as far as it can be statically determined.
+		 *
+		 * The bounds are given for the signed 32-bit interpretation of the register-contents, a range covering all signed 32-bit values is unknown.
+		 */
+		struct ValueRange
+		{
+			int64_t minValue;
+			int64_t maxValue;
+
+			/*
+			 * Creates an unknown range
+			 */
+			ValueRange();
+			ValueRange(int64_t minValue, int64_t maxValue);
+
+			bool isUnknown() const;
+			/*
+			 * Whether all values of this range are non-negative and fit into the given number of bits
+			 */
+			bool fitsIntoUnsignedBits(unsigned numBits) const;
+			/*
+			 * Whether the absolute values of all values of this range fit into the given number of bits
+			 */
+			bool absoluteFitsIntoBits(unsigned numBits) const;
+			/*
+			 * Returns the range containing the values of both ranges
+			 */
+			ValueRange unite(const ValueRange& other) const;
+
+			std::string to_string() const;
+
+			/*
+			 * Determines the range of the given value.
+			 *
+			 * For locals, the ranges are derived from all their writes, seeded by:
+			 * - literal values, masks and shifts,
+			 * - work-item information (e.g. local IDs and sizes), bounded by the work-group size of the kernel-meta-data, if known,
+			 * - zero-/sign-extended parameters of types smaller than 32 bits,
+			 * - bytes and half-words unpacked via the unpack-modes,
+			 * - minimum and maximum operations (as used by min(), max() and clamp())
+			 * Locals depending on themselves (e.g. loop counters) are unknown.
+			 *
+			 * NOTE: The range is a snapshot and is not updated when the instructions of the method are modified
+			 */
+			static ValueRange getValueRange(const Value& value, const Method& method);
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_VALUE_RANGE_H */
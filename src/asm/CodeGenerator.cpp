@@ -7,13 +7,20 @@
 #include "CodeGenerator.h"
 
 #include "../InstructionWalker.h"
+#include "../analysis/LivenessAnalysis.h"
 #include "../intermediate/Helper.h"
 #include "../intermediate/TypeConversions.h"
+#include "../optimization/Optimizer.h"
+#include "../periphery/VPM.h"
 #include "../Profiler.h"
 #include "GraphColoring.h"
 #include "KernelInfo.h"
+#include "LinearScan.h"
+#include "RegisterSpilling.h"
 #include "log.h"
 
+#include <algorithm>
+#include <chrono>
 #include <climits>
 #include <map>
 #include <sstream>
@@ -206,6 +213,354 @@ static void extendBranches(Method& method)
     logging::debug() << "Extended " << num << " branches" << logging::endl;
 }
 
+static bool setsFlags(const IntermediateInstruction* instr)
+{
+	const CombinedOperation* combined = dynamic_cast<const CombinedOperation*>(instr);
+	if(combined != nullptr)
+		return (combined->op1 && setsFlags(combined->op1.get())) || (combined->op2 && setsFlags(combined->op2.get()));
+	return instr->setFlags == SetFlag::SET_FLAGS;
+}
+
+/*
+ * Whether the instruction reads a value, which needs to be written more than one instruction before (e.g. the result of the SFU, the input of a vector-rotation or a packed value).
+ *
+ * The distance to the instruction writing the value must not shrink, so no instructions are removed from in front of such an instruction.
+ */
+static bool hasInputLatency(const IntermediateInstruction* instr)
+{
+	const CombinedOperation* combined = dynamic_cast<const CombinedOperation*>(instr);
+	if(combined != nullptr)
+		return (combined->op1 && hasInputLatency(combined->op1.get())) || (combined->op2 && hasInputLatency(combined->op2.get()));
+	if(dynamic_cast<const VectorRotation*>(instr) != nullptr || instr->hasUnpackMode())
+		return true;
+	for(const Value& arg : instr->getArguments())
+	{
+		if(arg.hasType(ValueType::REGISTER) && arg.reg != REG_ELEMENT_NUMBER && arg.reg != REG_QPU_NUMBER)
+			return true;
+		if(arg.hasType(ValueType::LOCAL))
+		{
+			bool isPacked = false;
+			arg.local->forUsers(LocalUser::Type::WRITER, [&isPacked](const LocalUser* user) -> void
+			{
+				const IntermediateInstruction* writer = dynamic_cast<const IntermediateInstruction*>(user);
+				isPacked = isPacked || writer == nullptr || writer->hasPackMode();
+			});
+			if(isPacked)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Whether the instruction only calculates a local from other locals and therefore can be executed in a branch delay slot
+ */
+static bool canBeMovedIntoDelaySlot(const IntermediateInstruction* instr)
+{
+	if(dynamic_cast<const Operation*>(instr) == nullptr && dynamic_cast<const MoveOperation*>(instr) == nullptr && dynamic_cast<const LoadImmediate*>(instr) == nullptr)
+		return false;
+	if(!instr->mapsToASMInstruction() || !instr->hasValueType(ValueType::LOCAL))
+		return false;
+	if(setsFlags(instr) || instr->signal != SIGNAL_NONE || instr->hasSideEffects() || instr->hasPackMode() || hasInputLatency(instr))
+		return false;
+	for(const Value& arg : instr->getArguments())
+	{
+		if(arg.hasType(ValueType::REGISTER))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Whether the candidate accesses a local accessed by the other instruction or depends on the flags set by it, so their order cannot be changed
+ */
+static bool dependsOn(const IntermediateInstruction* candidate, const IntermediateInstruction* other)
+{
+	const Local* output = candidate->getOutput()->local;
+	if(other->readsLocal(output) || other->writesLocal(output))
+		return true;
+	for(const Value& arg : candidate->getArguments())
+	{
+		if(arg.hasType(ValueType::LOCAL) && other->writesLocal(arg.local))
+			return true;
+	}
+	return candidate->hasConditionalExecution() && setsFlags(other);
+}
+
+static const IntermediateInstruction* findNextExecutedInstruction(InstructionWalker it)
+{
+	while(!it.isEndOfMethod())
+	{
+		if(!it.isEndOfBlock() && it.has() && it->mapsToASMInstruction())
+			return it.get();
+		it.nextInMethod();
+	}
+	return nullptr;
+}
+
+/*
+ * The instruction in the last delay slot is directly followed by the first instruction of the branch target,
+ * which is not visible to the register allocator, so the target must not read the value written in the last delay slot
+ */
+static bool isReadInNextInstruction(const IntermediateInstruction* instr, const IntermediateInstruction* takenSuccessor, const IntermediateInstruction* notTakenSuccessor)
+{
+	const Local* output = instr->getOutput()->local;
+	return (takenSuccessor != nullptr && takenSuccessor->readsLocal(output)) || (notTakenSuccessor != nullptr && notTakenSuccessor->readsLocal(output));
+}
+
+/*
+ * Selects the instructions from before the branch, which can be moved behind the branch, in reverse order.
+ *
+ * Since the instructions in the delay slots are executed anyway, only the dependencies to the instructions staying between the candidate and the branch need to be checked.
+ */
+static std::vector<InstructionWalker> findInstructionsBeforeBranch(InstructionWalker branchIt, const FastSet<const IntermediateInstruction*>& delaySlotInstructions, const std::size_t maxInstructions)
+{
+	std::vector<InstructionWalker> candidates;
+	std::vector<const IntermediateInstruction*> remainingInstructions;
+	InstructionWalker it = branchIt.copy().previousInBlock();
+	while(candidates.size() < maxInstructions && !it.has<BranchLabel>())
+	{
+		if(it.has())
+		{
+			const IntermediateInstruction* instr = it.get();
+			if(it.has<Nop>() || it.has<Branch>() || delaySlotInstructions.find(instr) != delaySlotInstructions.end())
+				break;
+			if(canBeMovedIntoDelaySlot(instr) && std::none_of(remainingInstructions.begin(), remainingInstructions.end(), [instr](const IntermediateInstruction* other) -> bool { return dependsOn(instr, other);}))
+				candidates.push_back(it);
+			else if(hasInputLatency(instr))
+				break;
+			else
+				remainingInstructions.push_back(instr);
+		}
+		if(it.isStartOfBlock())
+			break;
+		it.previousInBlock();
+	}
+	return candidates;
+}
+
+/*
+ * Selects the first instructions of the branch target, which can be moved into the delay slots of the branch.
+ *
+ * This is only possible if the branch is the only predecessor of the target block. For conditional branches, the instructions are also executed if the branch is not taken,
+ * so the locals written must not be live on that path.
+ */
+static std::vector<InstructionWalker> findInstructionsFromTarget(Method& method, InstructionWalker branchIt, const analysis::LivenessAnalysis& liveness, const std::size_t maxInstructions)
+{
+	std::vector<InstructionWalker> candidates;
+	const Branch* branch = branchIt.get<Branch>();
+	BasicBlock* target = method.findBasicBlock(branch->getTarget());
+	if(target == nullptr || target == branchIt.getBasicBlock() || target->isStartOfMethod())
+		return candidates;
+	bool isOnlyPredecessor = true;
+	target->forPredecessors([&isOnlyPredecessor, branch](InstructionWalker it) -> void
+	{
+		isOnlyPredecessor = isOnlyPredecessor && it.get() == branch;
+	});
+	if(!isOnlyPredecessor)
+		return candidates;
+
+	//the instructions executed if the branch is not taken and the blocks continued with
+	std::vector<const IntermediateInstruction*> notTakenInstructions;
+	std::vector<const BasicBlock*> notTakenBlocks;
+	if(!branch->isUnconditional())
+	{
+		for(InstructionWalker it = branchIt.copy().nextInBlock(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has())
+				continue;
+			notTakenInstructions.push_back(it.get());
+			if(it.has<Branch>())
+				notTakenBlocks.push_back(method.findBasicBlock(it.get<Branch>()->getTarget()));
+		}
+		if(branchIt.getBasicBlock()->fallsThroughToNextBlock())
+		{
+			auto blockIt = method.getBasicBlocks().begin();
+			while(blockIt != method.getBasicBlocks().end() && &(*blockIt) != branchIt.getBasicBlock())
+				++blockIt;
+			if(blockIt != method.getBasicBlocks().end() && ++blockIt != method.getBasicBlocks().end())
+				notTakenBlocks.push_back(&(*blockIt));
+		}
+	}
+	auto isUsedIfNotTaken = [&](const Local* local) -> bool
+	{
+		for(const IntermediateInstruction* instr : notTakenInstructions)
+		{
+			if(instr->readsLocal(local) || instr->writesLocal(local))
+				return true;
+		}
+		const Optional<std::size_t> number = liveness.getLocalNumbering().getNumber(local);
+		for(const BasicBlock* block : notTakenBlocks)
+		{
+			if(block == nullptr || (number && liveness.getLiveIn(*block).test(number.value())))
+				return true;
+		}
+		return false;
+	};
+
+	//only the first instructions are moved, so no distance between instructions in the target block is shortened
+	InstructionWalker it = target->begin().nextInBlock();
+	while(candidates.size() < maxInstructions && !it.isEndOfBlock())
+	{
+		if(it.has())
+		{
+			if(!canBeMovedIntoDelaySlot(it.get()) || (!branch->isUnconditional() && isUsedIfNotTaken(it->getOutput()->local)))
+				break;
+			candidates.push_back(it);
+		}
+		it.nextInBlock();
+	}
+	return candidates;
+}
+
+static void fillBranchDelaySlots(Method& method, optimizations::AnalysisManager& analyses)
+{
+	logging::debug() << "-----" << logging::endl;
+	std::size_t numSlots = 0;
+	std::size_t numFilledSlots = 0;
+	//the instructions moved into delay slots, which cannot be moved any further
+	FastSet<const IntermediateInstruction*> delaySlotInstructions;
+	/*
+	 * The liveness needs to be calculated before any instruction is moved, since the positions moved away from stay empty until the end.
+	 * Moving instructions does not change the locals live at the start of any block checked afterwards:
+	 * instructions are only moved out of blocks with a single predecessor, which therefore are never checked for another branch.
+	 */
+	const analysis::LivenessAnalysis& liveness = analyses.getLiveness(false);
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has<Branch>())
+				continue;
+			std::vector<InstructionWalker> slots;
+			InstructionWalker slot = it.copy().nextInBlock();
+			while(slots.size() < 3 && !slot.isEndOfBlock() && slot.has<Nop>() && slot.get<Nop>()->type == DelayType::BRANCH_DELAY)
+			{
+				slots.push_back(slot);
+				slot.nextInBlock();
+			}
+			numSlots += slots.size();
+			if(slots.size() != 3)
+				continue;
+
+			const IntermediateInstruction* notTakenSuccessor = findNextExecutedInstruction(slot);
+			const BasicBlock* target = method.findBasicBlock(it.get<Branch>()->getTarget());
+			const IntermediateInstruction* takenSuccessor = target == nullptr ? nullptr : findNextExecutedInstruction(const_cast<BasicBlock*>(target)->begin());
+
+			std::vector<InstructionWalker> instructions = findInstructionsBeforeBranch(it, delaySlotInstructions, slots.size());
+			if(instructions.size() == slots.size() && isReadInNextInstruction(instructions.front().get(), takenSuccessor, notTakenSuccessor))
+				//the instruction found first would be in the last delay slot, so leave the instruction found last in front of the branch instead
+				instructions.pop_back();
+			std::reverse(instructions.begin(), instructions.end());
+			if(instructions.size() < slots.size())
+			{
+				const std::vector<InstructionWalker> targetInstructions = findInstructionsFromTarget(method, it, liveness, slots.size() - instructions.size());
+				instructions.insert(instructions.end(), targetInstructions.begin(), targetInstructions.end());
+				if(!targetInstructions.empty() && instructions.size() == slots.size())
+				{
+					//the branch now jumps to the instruction following the ones moved
+					takenSuccessor = findNextExecutedInstruction(targetInstructions.back().copy().nextInBlock());
+					if(isReadInNextInstruction(instructions.back().get(), takenSuccessor, notTakenSuccessor))
+						instructions.pop_back();
+				}
+			}
+
+			for(std::size_t i = 0; i < instructions.size(); ++i)
+			{
+				IntermediateInstruction* instr = instructions[i].release();
+				logging::debug() << "Moving instruction into branch delay slot: " << instr->to_string() << logging::endl;
+				delete slots[i].release();
+				slots[i].reset(instr);
+				delaySlotInstructions.emplace(instr);
+			}
+			numFilledSlots += instructions.size();
+		}
+	}
+	//remove the positions the instructions were moved away from
+	method.cleanEmptyInstructions();
+	if(numFilledSlots > 0)
+		analyses.invalidate();
+	logging::debug() << "Filled " << numFilledSlots << " of " << numSlots << " branch delay slots in kernel " << method.name << logging::endl;
+	PROFILE_COUNTER(1000900, "Branch delay slots filled", numFilledSlots);
+}
+
+/*
+ * Whether any instruction of the block following the given one reads the flags before they are set again
+ */
+static bool readsFlagsBeforeSet(InstructionWalker it)
+{
+	for(; !it.isEndOfBlock(); it.nextInBlock())
+	{
+		if(!it.has())
+			continue;
+		const CombinedOperation* combined = it.get<CombinedOperation>();
+		if(it->hasConditionalExecution() || (combined != nullptr && ((combined->op1 && combined->op1->hasConditionalExecution()) || (combined->op2 && combined->op2->hasConditionalExecution()))))
+			return true;
+		if(setsFlags(it.get()))
+			return false;
+	}
+	return false;
+}
+
+/*
+ * Inserts a switch to the other hardware-thread in front of the instructions waiting for the result of a TMU load,
+ * so the other thread can run while this thread would be stalled by the TMU.
+ *
+ * No thread-switch is inserted, if
+ * - the mutex is locked, since the other thread would stall the QPU when trying to lock it too, or
+ * - the flags are read afterwards, since they are not preserved across a thread-switch
+ *
+ * Returns the number of thread-switches inserted
+ */
+static std::size_t insertThreadSwitches(Method& method)
+{
+	std::size_t numSwitches = 0;
+	bool isMutexLocked = false;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		//the TMU load could have been requested in a previous block
+		bool hasPendingRequest = true;
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has())
+				continue;
+			if(it->writesRegister(REG_MUTEX))
+				isMutexLocked = false;
+			else if(it->readsRegister(REG_MUTEX))
+				isMutexLocked = true;
+			if(it->writesRegister(REG_TMU0_COORD_S_U_X) || it->writesRegister(REG_TMU1_COORD_S_U_X))
+				hasPendingRequest = true;
+			if((it->signal == SIGNAL_LOAD_TMU0 || it->signal == SIGNAL_LOAD_TMU1) && hasPendingRequest && !isMutexLocked && !readsFlagsBeforeSet(it.copy()))
+			{
+				//the thread-switch takes effect after 2 delay-slots
+				it.emplace(new Nop(DelayType::THREAD_SWITCH, SIGNAL_SWITCH_THREAD));
+				it.nextInBlock();
+				it.emplace(new Nop(DelayType::THREAD_SWITCH));
+				it.nextInBlock();
+				it.emplace(new Nop(DelayType::THREAD_SWITCH));
+				it.nextInBlock();
+				hasPendingRequest = false;
+				++numSwitches;
+			}
+		}
+	}
+	logging::debug() << "Inserted " << numSwitches << " thread-switches" << logging::endl;
+	return numSwitches;
+}
+
+static void removeThreadSwitches(Method& method)
+{
+	InstructionWalker it = method.walkAllInstructions();
+	while(!it.isEndOfMethod())
+	{
+		const Nop* nop = it.get<Nop>();
+		if(nop != nullptr && nop->type == DelayType::THREAD_SWITCH)
+			it.erase();
+		else
+			it.nextInMethod();
+	}
+}
+
 static FastMap<const Local*, std::size_t> mapLabels(Method& method)
 {
     logging::debug() << "-----" << logging::endl;
@@ -242,6 +597,290 @@ static FastMap<const Local*, std::size_t> mapLabels(Method& method)
     return labelsMap;
 }
 
+static FastMap<const Local*, Register> allocateWithGraphColoring(Method& method, optimizations::AnalysisManager& analyses, std::size_t& spillRound)
+{
+	PROFILE_START(initializeLocalsUses);
+	std::unique_ptr<GraphColoring> coloring(new GraphColoring(method, method.walkAllInstructions(), analyses));
+	PROFILE_END(initializeLocalsUses);
+	PROFILE_START(colorGraph);
+	std::size_t round = 0;
+	while(true)
+	{
+		round = 0;
+		while(round < REGISTER_RESOLVER_MAX_ROUNDS && !coloring->colorGraph())
+		{
+			if(coloring->fixErrors())
+				break;
+			++round;
+		}
+		if(round < REGISTER_RESOLVER_MAX_ROUNDS || spillRound >= REGISTER_SPILLING_MAX_ROUNDS)
+			break;
+		//the conflicts cannot be resolved by re-assigning the locals, so free some registers by spilling locals
+		if(!spillLocals(method, coloring->getSpillCandidates(), analyses))
+			break;
+		++spillRound;
+		coloring.reset(new GraphColoring(method, method.walkAllInstructions(), analyses));
+	}
+	if(round >= REGISTER_RESOLVER_MAX_ROUNDS)
+	{
+		logging::warn() << "Register conflict resolver has exceeded its maximum rounds, there might still be errors!" << logging::endl;
+	}
+	PROFILE_END(colorGraph);
+
+	PROFILE_START(toRegisterMap);
+	PROFILE_START(toRegisterMapGraph);
+	auto registerMapping = coloring->toRegisterMap();
+	PROFILE_END(toRegisterMapGraph);
+	PROFILE_END(toRegisterMap);
+	return registerMapping;
+}
+
+static FastMap<const Local*, Register> allocateWithLinearScan(Method& method, optimizations::AnalysisManager& analyses, std::size_t& spillRound)
+{
+	std::unique_ptr<LinearScan> linearScan(new LinearScan(method, analyses));
+	while(!linearScan->allocateRegisters() && spillRound < REGISTER_SPILLING_MAX_ROUNDS && spillLocals(method, linearScan->getSpillCandidates(), analyses))
+	{
+		++spillRound;
+		linearScan.reset(new LinearScan(method, analyses));
+	}
+	return linearScan->toRegisterMap();
+}
+
+/*
+ * Tries to allocate the registers for the threaded mode, where only half of the physical registers are available.
+ *
+ * No locals are spilled, since the per-QPU areas for spilled locals would be shared by both hardware-threads
+ */
+static bool allocateThreaded(Method& method, optimizations::AnalysisManager& analyses, const bool useLinearScan, FastMap<const Local*, Register>& registerMapping)
+{
+	if(useLinearScan)
+	{
+		LinearScan linearScan(method, analyses, true);
+		if(!linearScan.allocateRegisters())
+			return false;
+		registerMapping = linearScan.toRegisterMap();
+		return true;
+	}
+	GraphColoring coloring(method, method.walkAllInstructions(), analyses, true);
+	bool success = coloring.colorGraph();
+	for(std::size_t round = 0; !success && round < REGISTER_RESOLVER_MAX_ROUNDS && coloring.fixErrors(); ++round)
+		success = coloring.colorGraph();
+	if(!success)
+		return false;
+	registerMapping = coloring.toRegisterMap();
+	return true;
+}
+
+static FastMap<const Local*, Register> allocateRegisters(Method& method, const Configuration& config, optimizations::AnalysisManager& analyses)
+{
+	const std::size_t numInstructions = method.countInstructions();
+	bool useLinearScan = config.registerAllocator == RegisterAllocator::LINEAR_SCAN;
+	if(config.registerAllocator == RegisterAllocator::AUTO)
+		useLinearScan = numInstructions > config.linearScanThreshold;
+
+	const auto start = std::chrono::steady_clock::now();
+	std::size_t spillRounds = 0;
+	FastMap<const Local*, Register> registerMapping;
+	//both hardware-threads of a QPU would share the per-QPU stack-frame and the per-QPU areas of the VPM
+	if(config.threadableKernels && method.calculateStackSize() == 0 && !method.vpm->hasAreasPerQPU() && insertThreadSwitches(method) > 0)
+	{
+		analyses.invalidate();
+		method.metaData.isThreadable = allocateThreaded(method, analyses, useLinearScan, registerMapping);
+		if(!method.metaData.isThreadable)
+		{
+			//the register pressure is too high for the halved register-file, so fall back to the non-threaded mode
+			logging::info() << "Failed to allocate registers for threaded mode, falling back to non-threaded mode for kernel " << method.name << logging::endl;
+			removeThreadSwitches(method);
+			analyses.invalidate();
+		}
+		PROFILE_COUNTER(1000080, "Threaded mode fall-backs", !method.metaData.isThreadable);
+	}
+	if(!method.metaData.isThreadable)
+		registerMapping = useLinearScan ? allocateWithLinearScan(method, analyses, spillRounds) : allocateWithGraphColoring(method, analyses, spillRounds);
+	const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+	logging::info() << "Register allocation with " << (useLinearScan ? "linear-scan" : "graph coloring") << (method.metaData.isThreadable ? " in threaded mode" : "") << " for kernel " << method.name
+			<< " (" << numInstructions << " instructions, " << registerMapping.size() << " locals) took " << duration.count() << " us with " << spillRounds << " rounds of spilling" << logging::endl;
+	PROFILE_COUNTER(1000050, "Register allocation spill rounds", spillRounds);
+	PROFILE_COUNTER(1000090, "Register allocation time (us)", static_cast<std::size_t>(duration.count()));
+	return registerMapping;
+}
+
+/*
+ * Whether the instruction is a simple copy between two locals assigned to the same register, which does not change any value
+ */
+static bool isCoalescedMove(const IntermediateInstruction* instr, const FastMap<const Local*, Register>& registerMapping)
+{
+	const MoveOperation* move = dynamic_cast<const MoveOperation*>(instr);
+	if(move == nullptr || dynamic_cast<const VectorRotation*>(move) != nullptr)
+		return false;
+	if(move->signal != SIGNAL_NONE || move->hasSideEffects() || move->hasPackMode() || move->hasUnpackMode())
+		return false;
+	if(!move->getSource().hasType(ValueType::LOCAL) || !move->getOutput() || !move->getOutput()->hasType(ValueType::LOCAL))
+		return false;
+	auto sourceIt = registerMapping.find(move->getSource().local);
+	auto outputIt = registerMapping.find(move->getOutput()->local);
+	if(sourceIt == registerMapping.end() || outputIt == registerMapping.end() || sourceIt->second != outputIt->second)
+		return false;
+	const Register reg = sourceIt->second;
+	return reg.isGeneralPurpose() || (reg.file == RegisterFile::ACCUMULATOR && reg.getAccumulatorNumber() >= 0 && reg.getAccumulatorNumber() < 4);
+}
+
+/*
+ * Whether the reader reads a physical register written by the writer, which requires an instruction in between
+ */
+static bool readsPhysicalRegisterWrittenBy(const IntermediateInstruction* reader, const IntermediateInstruction* writer, const FastMap<const Local*, Register>& registerMapping)
+{
+	bool conflict = false;
+	const auto checkWriter = [&](const IntermediateInstruction* w) -> void
+	{
+		if(!w->hasValueType(ValueType::LOCAL))
+			return;
+		auto writtenIt = registerMapping.find(w->getOutput()->local);
+		if(writtenIt == registerMapping.end() || writtenIt->second.isAccumulator())
+			return;
+		const auto checkReader = [&](const IntermediateInstruction* r) -> void
+		{
+			for(const Value& arg : r->getArguments())
+			{
+				auto readIt = arg.hasType(ValueType::LOCAL) ? registerMapping.find(arg.local) : registerMapping.end();
+				if(readIt != registerMapping.end() && readIt->second == writtenIt->second)
+					conflict = true;
+			}
+		};
+		const CombinedOperation* combined = dynamic_cast<const CombinedOperation*>(reader);
+		if(combined != nullptr)
+		{
+			if(combined->op1)
+				checkReader(combined->op1.get());
+			if(combined->op2)
+				checkReader(combined->op2.get());
+		}
+		else
+			checkReader(reader);
+	};
+	const CombinedOperation* combined = dynamic_cast<const CombinedOperation*>(writer);
+	if(combined != nullptr)
+	{
+		if(combined->op1)
+			checkWriter(combined->op1.get());
+		if(combined->op2)
+			checkWriter(combined->op2.get());
+	}
+	else
+		checkWriter(writer);
+	return conflict;
+}
+
+/*
+ * Removes the moves between locals which were assigned the same register (e.g. the copies inserted for phi-nodes or to fix register-conflicts).
+ *
+ * Since removing an instruction shortens the distance between the instructions around it, moves are kept, if
+ * - they are located in a branch delay slot,
+ * - they are the first instruction of a basic block, since the previously executed instruction is not known,
+ * - any of the following two instructions requires its input to be written more than one instruction before (see #hasInputLatency()) or
+ * - the previous instruction writes a physical register read by the next instruction
+ */
+static std::size_t removeCoalescedMoves(Method& method, const FastMap<const Local*, Register>& registerMapping)
+{
+	std::size_t numRemoved = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		//the last (up to 3) instructions kept in this block, the last one first
+		std::vector<const IntermediateInstruction*> previousInstructions;
+		InstructionWalker it = block.begin();
+		while(!it.isEndOfBlock())
+		{
+			if(!it.has() || !it->mapsToASMInstruction())
+			{
+				it.nextInBlock();
+				continue;
+			}
+			bool canBeRemoved = !previousInstructions.empty() && isCoalescedMove(it.get(), registerMapping);
+			for(const IntermediateInstruction* previous : previousInstructions)
+				canBeRemoved = canBeRemoved && dynamic_cast<const Branch*>(previous) == nullptr;
+			const IntermediateInstruction* next = nullptr;
+			if(canBeRemoved)
+			{
+				InstructionWalker nextIt = it.copy().nextInMethod();
+				for(std::size_t numNext = 0; numNext < 2 && !nextIt.isEndOfMethod(); nextIt.nextInMethod())
+				{
+					if(nextIt.isEndOfBlock() || !nextIt.has() || !nextIt->mapsToASMInstruction())
+						continue;
+					if(next == nullptr)
+						next = nextIt.get();
+					canBeRemoved = canBeRemoved && !hasInputLatency(nextIt.get());
+					++numNext;
+				}
+			}
+			if(canBeRemoved && next != nullptr && readsPhysicalRegisterWrittenBy(next, previousInstructions.front(), registerMapping))
+				canBeRemoved = false;
+			if(canBeRemoved)
+			{
+				logging::debug() << "Removing move between locals assigned to the same register: " << it->to_string() << logging::endl;
+				it.erase();
+				++numRemoved;
+				continue;
+			}
+			previousInstructions.insert(previousInstructions.begin(), it.get());
+			if(previousInstructions.size() > 3)
+				previousInstructions.pop_back();
+			it.nextInBlock();
+		}
+	}
+	return numRemoved;
+}
+
+/*
+ * The instruction in the last branch delay slot is directly followed by the first instruction of the branch target or by the instruction following the delay slots.
+ * Since filling the delay slots only checks the locals accessed, a register-file register written in the last delay slot can still be read by the next instruction,
+ * if e.g. the locals are coalesced, so a NOP is inserted in front of the reading instruction.
+ */
+static std::size_t separateDelaySlotsFromSuccessors(Method& method, const FastMap<const Local*, Register>& registerMapping)
+{
+	std::size_t numInserted = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has<Branch>())
+				continue;
+			InstructionWalker lastSlot = it.copy();
+			for(std::size_t numSlots = 0; numSlots < 3 && !lastSlot.isEndOfBlock();)
+			{
+				lastSlot.nextInBlock();
+				if(!lastSlot.isEndOfBlock() && lastSlot.has() && lastSlot->mapsToASMInstruction())
+					++numSlots;
+			}
+			if(lastSlot.isEndOfBlock() || lastSlot.has<Nop>() || lastSlot.has<Branch>())
+				continue;
+			BasicBlock* target = method.findBasicBlock(it.get<Branch>()->getTarget());
+			const IntermediateInstruction* takenSuccessor = target == nullptr ? nullptr : findNextExecutedInstruction(target->begin());
+			if(takenSuccessor != nullptr && readsPhysicalRegisterWrittenBy(takenSuccessor, lastSlot.get(), registerMapping))
+			{
+				logging::debug() << "Inserting NOP in front of branch target, which reads the register written in the last delay slot: " << lastSlot->to_string() << logging::endl;
+				target->begin().nextInBlock().emplace(new Nop(DelayType::WAIT_REGISTER));
+				++numInserted;
+			}
+			if(it.get<Branch>()->isUnconditional())
+				continue;
+			InstructionWalker notTakenIt = lastSlot.copy().nextInBlock();
+			const IntermediateInstruction* notTakenSuccessor = findNextExecutedInstruction(notTakenIt);
+			if(notTakenSuccessor != nullptr && readsPhysicalRegisterWrittenBy(notTakenSuccessor, lastSlot.get(), registerMapping))
+			{
+				logging::debug() << "Inserting NOP behind delay slots, since the next instruction reads the register written in the last delay slot: " << lastSlot->to_string() << logging::endl;
+				//if the delay slots end the block, the control-flow falls through to the next block
+				if(!notTakenIt.isEndOfBlock())
+					notTakenIt.emplace(new Nop(DelayType::WAIT_REGISTER));
+				else
+					lastSlot.copy().nextInMethod().nextInBlock().emplace(new Nop(DelayType::WAIT_REGISTER));
+				++numInserted;
+			}
+		}
+	}
+	return numInserted;
+}
+
 const FastModificationList<std::unique_ptr<qpu_asm::Instruction>>& CodeGenerator::generateInstructions(Method& method)
 {
 	PROFILE_COUNTER(100000, "CodeGeneration (before)", method.countInstructions());
@@ -259,45 +898,37 @@ const FastModificationList<std::unique_ptr<qpu_asm::Instruction>>& CodeGenerator
 
     //expand branches (add 3 NOPs)
     extendBranches(method);
+    //the liveness is shared by filling the delay slots and the register-allocation, until one of them modifies the method
+    optimizations::AnalysisManager analyses(method);
+    //move instructions into the branch delay slots (replacing the NOPs)
+    fillBranchDelaySlots(method, analyses);
 
     //check and fix possible errors with register-association
-    PROFILE_START(initializeLocalsUses);
-	GraphColoring coloring(method, method.walkAllInstructions());
-	PROFILE_END(initializeLocalsUses);
-	PROFILE_START(colorGraph);
-	std::size_t round = 0;
-	while(round < REGISTER_RESOLVER_MAX_ROUNDS && !coloring.colorGraph())
-	{
-		if(coloring.fixErrors())
-			break;
-		++round;
-	}
-	if(round >= REGISTER_RESOLVER_MAX_ROUNDS)
-	{
-		logging::warn() << "Register conflict resolver has exceeded its maximum rounds, there might still be errors!" << logging::endl;
-	}
-	PROFILE_END(colorGraph);
-    
+    auto registerMapping = allocateRegisters(method, config, analyses);
+    //remove the copies made redundant by assigning the same register to source and destination
+    const std::size_t numRemovedMoves = removeCoalescedMoves(method, registerMapping);
+    logging::info() << "Removed " << numRemovedMoves << " moves between coalesced locals for kernel " << method.name << logging::endl;
+    PROFILE_COUNTER(1000075, "Coalesced moves removed", numRemovedMoves);
+    //fix the register-file accesses across the branch delay slots, which are only visible with the physical registers
+    const std::size_t numDelaySlotNops = separateDelaySlotsFromSuccessors(method, registerMapping);
+    logging::info() << "Inserted " << numDelaySlotNops << " NOPs behind branch delay slots for kernel " << method.name << logging::endl;
+
     //create label-map + remove labels
     const auto labelMap = mapLabels(method);
 
     //IMPORTANT: DO NOT OPTIMIZE, RE-ORDER, COMBINE, INSERT OR REMOVE ANY INSTRUCTION AFTER THIS POINT!!!
     //otherwise, labels/branches will be wrong
 
-    //map to registers
-    PROFILE_START(toRegisterMap);
-	PROFILE_START(toRegisterMapGraph);
-	auto registerMapping = coloring.toRegisterMap();
-	PROFILE_END(toRegisterMapGraph);
-	PROFILE_END(toRegisterMap);
-
     logging::debug() << "-----" << logging::endl;
     std::size_t index = 0;
-    method.forAllInstructions([&generatedInstructions, &index, &registerMapping, &labelMap](const IntermediateInstruction* instr) -> bool
+    std::size_t numNops = 0;
+    method.forAllInstructions([&generatedInstructions, &index, &numNops, &registerMapping, &labelMap](const IntermediateInstruction* instr) -> bool
 	{
     	Instruction* mapped = instr->convertToAsm(registerMapping, labelMap, index);
 		if (mapped != nullptr) {
 			generatedInstructions.emplace_back(mapped);
+			if(dynamic_cast<const Nop*>(instr) != nullptr)
+				++numNops;
 		}
 		++index;
 		return true;
@@ -310,6 +941,7 @@ const FastModificationList<std::unique_ptr<qpu_asm::Instruction>>& CodeGenerator
         index += 8;
     }
     logging::debug() << "Generated " << std::dec << generatedInstructions.size() << " instructions!" << logging::endl;
+    logging::info() << "Generated " << generatedInstructions.size() << " instructions (" << numNops << " NOPs) for kernel " << method.name << logging::endl;
 
     PROFILE_COUNTER_WITH_PREV(1001000, "CodeGeneration (after)", generatedInstructions.size(), 100000);
     return generatedInstructions;
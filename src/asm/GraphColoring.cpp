@@ -7,7 +7,8 @@
 #include "GraphColoring.h"
 
 #include "RegisterAllocation.h"
-#include "../ControlFlowGraph.h"
+#include "../analysis/LivenessAnalysis.h"
+#include "../optimization/Optimizer.h"
 #include "../DebugGraph.h"
 #include "../Profiler.h"
 #include "log.h"
@@ -23,7 +24,7 @@ LocalUsage::LocalUsage(InstructionWalker first, InstructionWalker last) : firstO
 	associatedInstructions.insert(last);
 }
 
-static void forLocalsUsedTogether(const Local* local, const std::function<void(const Local*)>& func)
+void qpu_asm::forLocalsUsedTogether(const Local* local, const std::function<void(const Local*)>& func)
 {
 	for(const auto& pair : local->getUsers())
 	{
@@ -31,7 +32,10 @@ static void forLocalsUsedTogether(const Local* local, const std::function<void(c
 			continue;
 		if(pair.second.readsLocal())
 		{
-			pair.first->forUsedLocals([local, &func](const Local* l, LocalUser::Type type) -> void
+			//the locals read by both parts of a combined instruction are read in the same instruction
+			const intermediate::Operation* op = dynamic_cast<const intermediate::Operation*>(pair.first);
+			const LocalUser* instr = op != nullptr && op->parent != nullptr ? static_cast<const LocalUser*>(op->parent) : pair.first;
+			instr->forUsedLocals([local, &func](const Local* l, LocalUser::Type type) -> void
 			{
 				if(has_flag(type, LocalUser::Type::READER) && l != local)
 					func(l);
@@ -55,11 +59,55 @@ static void forLocalsUsedTogether(const Local* local, const std::function<void(c
 	}
 }
 
+void qpu_asm::forLocalsMovedTogether(const Local* local, const std::function<void(const Local*)>& func)
+{
+	for(const auto& pair : local->getUsers())
+	{
+		const intermediate::MoveOperation* move = dynamic_cast<const intermediate::MoveOperation*>(pair.first);
+		//rotations and (un)packing modify the value, so the source and destination cannot be the same register
+		if(move == nullptr || dynamic_cast<const intermediate::VectorRotation*>(move) != nullptr || move->hasPackMode() || move->hasUnpackMode())
+			continue;
+		if(!move->getSource().hasType(ValueType::LOCAL) || !move->getOutput() || !move->getOutput()->hasType(ValueType::LOCAL))
+			continue;
+		if(move->getSource().local == move->getOutput()->local)
+			continue;
+		func(move->getSource().hasLocal(local) ? move->getOutput()->local : move->getSource().local);
+	}
+}
+
+void qpu_asm::forLocalsLiveAcrossThreadSwitches(Method& method, const analysis::LivenessAnalysis& liveness, const std::function<void(const Local*)>& func)
+{
+	const analysis::LocalNumbering& numbering = liveness.getLocalNumbering();
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		liveness.forInstructionsInBlock(block, [&numbering, &func](InstructionWalker it, const analysis::BitSet& liveAfter) -> void
+		{
+			if(it->signal != SIGNAL_SWITCH_THREAD)
+				return;
+			liveAfter.forAll([&numbering, &func](std::size_t number) -> void
+			{
+				func(numbering.getLocal(number));
+			});
+		});
+	}
+}
+
 ColoredNode::ColoredNode(const Local* local, const RegisterFile possibleFiles) : Node(local), initialFile(possibleFiles), possibleFiles(possibleFiles)
 {
 
 }
 
+static RegisterFile removeExhaustedFiles(RegisterFile files, const std::bitset<4>& availableAcc, const std::bitset<32>& availableA, const std::bitset<32>& availableB)
+{
+	if(availableAcc.none())
+		files = remove_flag(files, RegisterFile::ACCUMULATOR);
+	if(availableA.none())
+		files = remove_flag(files, RegisterFile::PHYSICAL_A);
+	if(availableB.none())
+		files = remove_flag(files, RegisterFile::PHYSICAL_B);
+	return files;
+}
+
 void ColoredNode::blockRegister(RegisterFile file, const std::size_t index)
 {
 	if(file == RegisterFile::ACCUMULATOR)
@@ -68,12 +116,7 @@ void ColoredNode::blockRegister(RegisterFile file, const std::size_t index)
 		availableA.reset(index);
 	else if(file == RegisterFile::PHYSICAL_B)
 		availableB.reset(index);
-	if(availableAcc.none())
-		possibleFiles = remove_flag(possibleFiles, RegisterFile::ACCUMULATOR);
-	if(availableA.none())
-		possibleFiles = remove_flag(possibleFiles, RegisterFile::PHYSICAL_A);
-	if(availableB.none())
-		possibleFiles = remove_flag(possibleFiles, RegisterFile::PHYSICAL_B);
+	possibleFiles = removeExhaustedFiles(possibleFiles, availableAcc, availableA, availableB);
 }
 
 bool ColoredNode::hasFreeRegisters(const RegisterFile file) const
@@ -106,6 +149,28 @@ void ColoredNode::takeValues(const ColoredNode& other)
 	neighbors.insert(other.neighbors.begin(), other.neighbors.end());
 }
 
+std::size_t ColoredNode::countCommonFreeRegisters(const ColoredNode& other) const
+{
+	const RegisterFile files = intersect_flags(possibleFiles, other.possibleFiles);
+	std::size_t numRegisters = 0;
+	if(has_flag(files, RegisterFile::ACCUMULATOR))
+		numRegisters += (availableAcc & other.availableAcc).count();
+	if(has_flag(files, RegisterFile::PHYSICAL_A))
+		numRegisters += (availableA & other.availableA).count();
+	if(has_flag(files, RegisterFile::PHYSICAL_B))
+		numRegisters += (availableB & other.availableB).count();
+	return numRegisters;
+}
+
+void ColoredNode::restrictTo(const ColoredNode& other)
+{
+	availableAcc &= other.availableAcc;
+	availableA &= other.availableA;
+	availableB &= other.availableB;
+	initialFile = intersect_flags(initialFile, other.initialFile);
+	possibleFiles = removeExhaustedFiles(intersect_flags(possibleFiles, other.possibleFiles), availableAcc, availableA, availableB);
+}
+
 Register ColoredNode::getRegisterFixed() const
 {
 	if(possibleFiles == RegisterFile::NONE)
@@ -143,6 +208,17 @@ Register ColoredNode::getRegisterFixed() const
 	throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Unhandled case in fixing node to register", to_string());
 }
 
+Optional<Register> ColoredNode::getSingleRegister() const
+{
+	if(possibleFiles == RegisterFile::PHYSICAL_A && availableA.count() == 1)
+		return getRegisterFixed();
+	if(possibleFiles == RegisterFile::PHYSICAL_B && availableB.count() == 1)
+		return getRegisterFixed();
+	if(possibleFiles == RegisterFile::ACCUMULATOR && availableAcc.count() == 1)
+		return getRegisterFixed();
+	return Optional<Register>(false, REG_NOP);
+}
+
 template<std::size_t size>
 static std::size_t fixToRegisterFile(std::bitset<size>& set)
 {
@@ -184,6 +260,38 @@ std::size_t ColoredNode::fixToRegister()
 	throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Cannot fix local to file with no registers left", to_string());
 }
 
+template<std::size_t size>
+static bool fixToRegisterIndex(std::bitset<size>& set, const std::size_t index)
+{
+	if(index >= set.size() || !set.test(index))
+		return false;
+	set.reset();
+	set.set(index);
+	return true;
+}
+
+std::size_t ColoredNode::fixToRegister(const Register& preferredRegister)
+{
+	if(!has_flag(possibleFiles, preferredRegister.file))
+		return fixToRegister();
+	if(preferredRegister.isAccumulator() && fixToRegisterIndex(availableAcc, static_cast<std::size_t>(preferredRegister.getAccumulatorNumber())))
+	{
+		possibleFiles = RegisterFile::ACCUMULATOR;
+		return static_cast<std::size_t>(preferredRegister.getAccumulatorNumber());
+	}
+	if(preferredRegister.file == RegisterFile::PHYSICAL_A && fixToRegisterIndex(availableA, preferredRegister.num))
+	{
+		possibleFiles = RegisterFile::PHYSICAL_A;
+		return preferredRegister.num;
+	}
+	if(preferredRegister.file == RegisterFile::PHYSICAL_B && fixToRegisterIndex(availableB, preferredRegister.num))
+	{
+		possibleFiles = RegisterFile::PHYSICAL_B;
+		return preferredRegister.num;
+	}
+	return fixToRegister();
+}
+
 std::string ColoredNode::to_string(bool longDescription) const
 {
 	std::string res = (key->name + " init: ").append(toString(initialFile)).append(", avail: ").append(toString(possibleFiles))
@@ -325,7 +433,7 @@ static void updateFixedLocals(const intermediate::IntermediateInstruction& instr
 	}
 }
 
-static void fixLocals(const InstructionWalker it, FastMap<const Local*, LocalUsage>& localUses, Optional<const Local*>& lastWrittenLocal0, Optional<const Local*>& lastWrittenLocal1)
+void qpu_asm::fixLocals(const InstructionWalker it, FastMap<const Local*, LocalUsage>& localUses, Optional<const Local*>& lastWrittenLocal0, Optional<const Local*>& lastWrittenLocal1)
 {
 	static const Optional<const Local*> EMPTY(false, nullptr);
 
@@ -371,7 +479,7 @@ static void fixLocals(const InstructionWalker it, FastMap<const Local*, LocalUsa
 	}
 }
 
-GraphColoring::GraphColoring(Method& method, InstructionWalker it) : method(method), closedSet(), openSet(), localUses()
+GraphColoring::GraphColoring(Method& method, InstructionWalker it, optimizations::AnalysisManager& analyses, const bool isThreaded) : method(method), analyses(analyses), closedSet(), openSet(), localUses(), isThreaded(isThreaded)
 {
 	closedSet.reserve(method.readLocals().size());
 	openSet.reserve(method.readLocals().size());
@@ -432,108 +540,8 @@ GraphColoring::GraphColoring(Method& method, InstructionWalker it) : method(meth
 	}
 }
 
-static void walkUsageRange(InstructionWalker start, const Local* local, FastMap<intermediate::IntermediateInstruction*, FastSet<const Local*>>& localRanges, ControlFlowGraph* blockGraph = nullptr)
-{
-	//to prevent infinite recursions
-	//TODO is tracking labels enough or need we track all instructions (or branches, since we jump backwards?)??
-	//FIXME this check is wrong, e.g. doesn't find reads, if <label1> ... <label2> x = a ... a = y; br <label1> (e.g. ./testing/rodinia/find_ellipse_kernel.cl, ./testing/rodinia/track_ellipse_kernel.cl, ./testing/NVIDIA/BlackScholes.cl)
-	FastSet<intermediate::IntermediateInstruction*> processedLabels;
-	ConditionCode conditionalWrite = COND_NEVER;
-	const auto consumer = [start, local, &localRanges, &processedLabels, &conditionalWrite](InstructionWalker& it) -> InstructionVisitResult
-	{
-		intermediate::BranchLabel* label = it.get<intermediate::BranchLabel>();
-		if(label != nullptr)
-		{
-			if(processedLabels.find(label) != processedLabels.end())
-				return InstructionVisitResult::STOP_BRANCH;
-			processedLabels.emplace(label);
-		}
-		if(it != start)
-		{
-			//don't set usage-range for last read to not block the written local
-			localRanges[it.get()].insert(local);
-			if(it->readsLocal(local))
-				//another reading found, abort here and continue for the other reading
-				return InstructionVisitResult::STOP_BRANCH;
-		}
-		if(it->writesLocal(local))
-		{
-			//we found a write, stop this branch (and continue with others)
-			//only abort if we have found writes for all conditions (e.g. required for vector insertions, or selects)
-			const std::function<InstructionVisitResult(const intermediate::IntermediateInstruction*)> checkWritePerInstruction = [start, &conditionalWrite, local](const intermediate::IntermediateInstruction* inst) -> InstructionVisitResult
-			{
-				//if start is a combined instruction
-				ConditionCode realStartCondition = start.get()->conditional;
-				if(start.get<const intermediate::CombinedOperation>() != nullptr)
-				{
-					const intermediate::CombinedOperation* comb = start.get<const intermediate::CombinedOperation>();
-					if(comb->op1 && comb->op1->readsLocal(local) && comb->op2 && comb->op2->readsLocal(local) && comb->op1->conditional.isInversionOf(comb->op2->conditional))
-						realStartCondition = COND_ALWAYS;
-					else if(comb->op1 && comb->op1->readsLocal(local))
-						realStartCondition = comb->op1->conditional;
-					else if(comb->op2 && comb->op2->readsLocal(local))
-						realStartCondition = comb->op2->conditional;
-					else //neither part reads the local
-						throw CompilationError(CompilationStep::CODE_GENERATION, "Combined operation reads local, but none of its part do", start->to_string());
-				}
-				if(!inst->writesLocal(local) || has_flag(inst->decoration, intermediate::InstructionDecorations::ELEMENT_INSERTION))
-					return InstructionVisitResult::CONTINUE;
-				if(inst->conditional == COND_ALWAYS || inst->conditional == realStartCondition || inst->conditional.isInversionOf(conditionalWrite))
-					conditionalWrite = COND_ALWAYS;
-				else if(conditionalWrite == COND_NEVER)
-					conditionalWrite = inst->conditional;
-				if(conditionalWrite == COND_ALWAYS)
-					return InstructionVisitResult::STOP_BRANCH;
-				//TODO to be exact, we would need a check here, if the condition of the PHI-value setter is the same as the branch-condition jumping to the target label
-				if(has_flag(inst->decoration, intermediate::InstructionDecorations::PHI_NODE))
-					//we found a (conditional) instruction setting this PHI-node value
-					return InstructionVisitResult::STOP_BRANCH;
-				return InstructionVisitResult::CONTINUE;
-			};
-			if(it.has<intermediate::CombinedOperation>())
-			{
-				intermediate::CombinedOperation* combined = it.get<intermediate::CombinedOperation>();
-				if(combined->op1 != nullptr)
-				{
-					InstructionVisitResult tmp = checkWritePerInstruction(combined->op1.get());
-					if(tmp == InstructionVisitResult::STOP_ALL || tmp == InstructionVisitResult::STOP_BRANCH)
-						return tmp;
-				}
-				if(combined->op2 != nullptr)
-				{
-					InstructionVisitResult tmp = checkWritePerInstruction(combined->op2.get());
-					if(tmp == InstructionVisitResult::STOP_ALL || tmp == InstructionVisitResult::STOP_BRANCH)
-						return tmp;
-				}
-			}
-			else
-			{
-				return checkWritePerInstruction(it.get());
-			}
-		}
-		if(it.isStartOfMethod() || (it.has<intermediate::BranchLabel>() && it.get<intermediate::BranchLabel>()->getLabel()->name.compare(BasicBlock::DEFAULT_BLOCK) == 0))
-		{
-			//we arrived at the beginning of the method with no write found -> abort
-			return InstructionVisitResult::STOP_ALL;
-		}
-		return InstructionVisitResult::CONTINUE;
-	};
-
-	InstructionVisitor visitor{consumer, false, true};
-	bool allFound = visitor.visitReverse(start, blockGraph);
-
-	if(!allFound)
-	{
-		logging::error() << "Found a path for local " << local->to_string() << " for which it isn't written before, starting at: " << start->to_string() << logging::endl;
-		throw CompilationError(CompilationStep::CODE_GENERATION, "Not all path generate a valid value for local", local->to_string());
-	}
-}
-
 void GraphColoring::createGraph()
 {
-	FastMap<intermediate::IntermediateInstruction*, FastSet<const Local*>> localRanges;
-	localRanges.reserve(method.countInstructions());
-
 	// 1. iteration: set files and locals used together and map to start/end of range
 	PROFILE_START(createColoredNodes);
 	for(const auto& pair : localUses)
@@ -562,6 +570,15 @@ void GraphColoring::createGraph()
 			openSet.erase(node.key);
 			continue;
 		}
+		if(isThreaded)
+		{
+			//the upper half of the physical registers is used by the other hardware-thread
+			for(std::size_t i = NUM_REGISTERS_PER_THREAD; i < 32; ++i)
+			{
+				node.blockRegister(RegisterFile::PHYSICAL_A, i);
+				node.blockRegister(RegisterFile::PHYSICAL_B, i);
+			}
+		}
 		forLocalsUsedTogether(pair.first, [&node, this](const Local* l) -> void
 		{
 			node.addNeighbor(&(graph.getOrCreateNode(l)), LocalRelation::USED_TOGETHER);
@@ -570,47 +587,77 @@ void GraphColoring::createGraph()
 	}
 	PROFILE_END(createColoredNodes);
 
-	auto blockGraph = ControlFlowGraph::createCFG(method);
-
+	//2. iteration: associate locals used simultaneously, e.g. all locals live after an instruction and the locals written by it
 	PROFILE_START(createUsageRanges);
-	InstructionWalker it = method.walkAllInstructions();
-	while(!it.isEndOfMethod())
+	//the liveness is only re-calculated, if fixing the errors of the previous round modified the method
+	const analysis::LivenessAnalysis& liveness = analyses.getLiveness(true);
+	const analysis::LocalNumbering& numbering = liveness.getLocalNumbering();
+	PROFILE_END(createUsageRanges);
+	liveness.getLiveIn(method.getBasicBlocks().front()).forAll([&numbering](std::size_t number) -> void
 	{
-		//from all reading instructions, walk up to the writes of the locals and add all instructions in between to the local usage-range
-		if(!it.has<intermediate::BranchLabel>() && !it.has<intermediate::Branch>())
+		const Local* local = numbering.getLocal(number);
+		if(!local->is<Parameter>())
 		{
-			it->forUsedLocals([it, &localRanges, &blockGraph](const Local* local, LocalUser::Type usageType) -> void
-			{
-				if(has_flag(usageType, LocalUser::Type::READER))
-				{
-					PROFILE(walkUsageRange, it, local, localRanges, &blockGraph);
-				}
-			});
+			logging::error() << "Found a path for local " << local->to_string() << " for which it isn't written before" << logging::endl;
+			throw CompilationError(CompilationStep::CODE_GENERATION, "Not all path generate a valid value for local", local->to_string());
 		}
-		it.nextInMethod();
-	}
-	PROFILE_END(createUsageRanges);
-	//TODO if this method works, could here spill all locals with more than XX (64) neighbors!?!
-	for(const auto& node : graph)
+	});
+	std::vector<ColoredNode*> nodes(numbering.size(), nullptr);
+	for(std::size_t i = 0; i < numbering.size(); ++i)
 	{
-		PROFILE_COUNTER(1000005, "SpillCandidates", node.second.getNeighbors().size() >= 64);
+		auto nodeIt = graph.find(numbering.getLocal(i));
+		if(nodeIt != graph.end())
+			nodes[i] = &nodeIt->second;
 	}
-	//2. iteration: associate locals used together
 	PROFILE_START(addEdges);
-	for(const auto& range : localRanges)
+	std::vector<ColoredNode*> usedNodes;
+	for(BasicBlock& block : method.getBasicBlocks())
 	{
-		for(const Local* loc1 : range.second)
+		liveness.forInstructionsInBlock(block, [&numbering, &nodes, &usedNodes](InstructionWalker it, const analysis::BitSet& liveAfter) -> void
 		{
-			ColoredNode& node = graph.at(loc1);
-			for(const Local* loc2 : range.second)
+			usedNodes.clear();
+			liveAfter.forAll([&nodes, &usedNodes](std::size_t number) -> void
+			{
+				if(nodes[number] != nullptr)
+					usedNodes.push_back(nodes[number]);
+			});
+			it->forUsedLocals([&numbering, &nodes, &usedNodes](const Local* local, LocalUser::Type usageType) -> void
+			{
+				const Optional<std::size_t> number = numbering.getNumber(local);
+				//the written register is blocked at the writing instruction, even if the value is never read afterwards
+				if(has_flag(usageType, LocalUser::Type::WRITER) && number && nodes[number.value()] != nullptr &&
+					std::find(usedNodes.begin(), usedNodes.end(), nodes[number.value()]) == usedNodes.end())
+					usedNodes.push_back(nodes[number.value()]);
+			});
+			for(ColoredNode* node1 : usedNodes)
 			{
-				if(loc1 == loc2)
-					continue;
-				node.addNeighbor(&graph.at(loc2), LocalRelation::USED_SIMULTANEOUSLY);
+				for(ColoredNode* node2 : usedNodes)
+				{
+					if(node1 != node2)
+						node1->addNeighbor(node2, LocalRelation::USED_SIMULTANEOUSLY);
+				}
 			}
-		}
+		});
 	}
 	PROFILE_END(addEdges);
+	if(isThreaded)
+	{
+		forLocalsLiveAcrossThreadSwitches(method, liveness, [this](const Local* local) -> void
+		{
+			auto nodeIt = graph.find(local);
+			if(nodeIt == graph.end() || nodeIt->second.initialFile == RegisterFile::NONE || !has_flag(nodeIt->second.possibleFiles, RegisterFile::ACCUMULATOR))
+				return;
+			//the accumulators are not preserved across a thread-switch
+			for(std::size_t i = 0; i < ACCUMULATORS.size(); ++i)
+				nodeIt->second.blockRegister(RegisterFile::ACCUMULATOR, i);
+			if(nodeIt->second.possibleFiles == RegisterFile::NONE || isFixed(nodeIt->second.possibleFiles))
+			{
+				//locals which could only be on accumulators are reported as errors (and fixed to be on physical files) by processing the closed-set
+				closedSet.insert(local);
+				openSet.erase(local);
+			}
+		});
+	}
 
 	logging::debug() << "Colored graph with " << graph.size() << " nodes created!" << logging::endl;
 #ifdef DEBUG_MODE
@@ -624,6 +671,27 @@ void GraphColoring::createGraph()
 #endif
 }
 
+/*
+ * Biased coloring for the locals whose nodes could not be merged (see GraphColoring#coalesceNodes()):
+ * If a local copied from or into the given node is already assigned to a register, which is still available for the node,
+ * the node is assigned to the same register to allow the move to be removed.
+ * Since only registers not blocked by any neighbor are considered, this never introduces any additional conflicts.
+ */
+static Optional<Register> getCoalescingRegister(const ColoredGraph& graph, const ColoredNode& node, const FastSet<const Local*>& closedSet, const FastSet<const Local*>& openSet)
+{
+	Optional<Register> preferredRegister(false, REG_NOP);
+	forLocalsMovedTogether(node.key, [&](const Local* local) -> void
+	{
+		//nodes not yet processed could have a single register left, which they are not yet assigned to
+		if(preferredRegister || closedSet.find(local) != closedSet.end() || openSet.find(local) != openSet.end())
+			return;
+		auto it = graph.find(local);
+		if(it != graph.end())
+			preferredRegister = it->second.getSingleRegister();
+	});
+	return preferredRegister;
+}
+
 static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedSet, FastSet<const Local*>& openSet, FastSet<const Local*>& errorSet)
 {
 	PROFILE_START(processClosedSet);
@@ -645,7 +713,9 @@ static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedS
 		}
 		else
 		{
-			const std::size_t fixedRegister = node.fixToRegister();
+			const Optional<Register> preferredRegister = getCoalescingRegister(graph, node, closedSet, openSet);
+			const std::size_t fixedRegister = preferredRegister ? node.fixToRegister(preferredRegister.value()) : node.fixToRegister();
+			PROFILE_COUNTER(1000070, "Coalescing register hints", preferredRegister ? 1 : 0);
 			for(auto& pair : node.getNeighbors())
 			{
 				ColoredNode* neighbor = reinterpret_cast<ColoredNode*>(pair.first);
@@ -667,13 +737,118 @@ static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedS
 	PROFILE_END(processClosedSet);
 }
 
+/*
+ * Adds the neighbor to a merged node, locals used together with either of the merged locals block the whole register-file of the merged node
+ */
+static void addMergedNeighbor(Node<const Local*, LocalRelation>& node, Node<const Local*, LocalRelation>& neighbor, const LocalRelation relation)
+{
+	auto it = node.getNeighbors().emplace(&neighbor, relation).first;
+	if(relation == LocalRelation::USED_TOGETHER)
+		it->second = LocalRelation::USED_TOGETHER;
+}
+
+std::size_t GraphColoring::coalesceNodes()
+{
+	std::vector<const Local*> locals;
+	locals.reserve(graph.size());
+	for(const auto& pair : graph)
+		locals.push_back(pair.first);
+
+	std::size_t numMerged = 0;
+	std::vector<const Local*> copiedLocals;
+	for(const Local* local : locals)
+	{
+		auto nodeIt = graph.find(local);
+		if(nodeIt == graph.end() || nodeIt->second.initialFile == RegisterFile::NONE)
+			continue;
+		ColoredNode& node = nodeIt->second;
+		copiedLocals.clear();
+		forLocalsMovedTogether(local, [&copiedLocals](const Local* other) -> void
+		{
+			copiedLocals.push_back(other);
+		});
+		for(const Local* other : copiedLocals)
+		{
+			//the other local could already be merged into another node
+			auto aliasIt = coalescedLocals.find(other);
+			if(aliasIt != coalescedLocals.end())
+				other = aliasIt->second;
+			auto otherIt = graph.find(other);
+			if(other == local || otherIt == graph.end() || otherIt->second.initialFile == RegisterFile::NONE)
+				continue;
+			ColoredNode& otherNode = otherIt->second;
+			if(node.getNeighbors().find(&otherNode) != node.getNeighbors().end() || otherNode.getNeighbors().find(&node) != otherNode.getNeighbors().end())
+				continue;
+			const std::size_t numRegisters = node.countCommonFreeRegisters(otherNode);
+			if(numRegisters == 0)
+				continue;
+			FastSet<const Node<const Local*, LocalRelation>*> significantNeighbors;
+			for(const ColoredNode* n : {&node, &otherNode})
+			{
+				for(const auto& pair : n->getNeighbors())
+				{
+					if(pair.first->getNeighbors().size() >= numRegisters)
+						significantNeighbors.insert(pair.first);
+				}
+			}
+			if(significantNeighbors.size() >= numRegisters)
+				continue;
+
+			logging::debug() << "Merging nodes of locals copied into each other: " << local->name << " and " << other->name << logging::endl;
+			node.restrictTo(otherNode);
+			for(const auto& pair : otherNode.getNeighbors())
+			{
+				pair.first->getNeighbors().erase(&otherNode);
+				addMergedNeighbor(*pair.first, node, pair.second);
+				addMergedNeighbor(node, *pair.first, pair.second);
+			}
+			openSet.erase(other);
+			closedSet.erase(other);
+			openSet.erase(local);
+			closedSet.erase(local);
+			if(isFixed(node.possibleFiles))
+				closedSet.insert(local);
+			else
+				openSet.insert(local);
+			for(auto& alias : coalescedLocals)
+			{
+				if(alias.second == other)
+					alias.second = local;
+			}
+			coalescedLocals[other] = local;
+			graph.erase(otherIt);
+			++numMerged;
+		}
+	}
+	return numMerged;
+}
+
 bool GraphColoring::colorGraph()
 {
-	if(!graph.empty())
+	//merging the nodes restricts the registers of both locals, so the coloring could fail, where it would succeed for the separate nodes
+	if(colorGraph(true))
+		return true;
+	if(coalescedLocals.empty())
+		return false;
+	logging::debug() << "Coloring the graph with merged nodes failed, retrying without merging nodes" << logging::endl;
+	return colorGraph(false);
+}
+
+bool GraphColoring::colorGraph(const bool mergeNodes)
+{
+	if(!graph.empty() || !coalescedLocals.empty())
 	{
 		PROFILE(resetGraph);
 	}
 	PROFILE(createGraph);
+	if(mergeNodes)
+	{
+		PROFILE_START(coalesceNodes);
+		const std::size_t numMerged = coalesceNodes();
+		PROFILE_END(coalesceNodes);
+		logging::debug() << "Merged " << numMerged << " nodes of locals copied into each other" << logging::endl;
+		PROFILE_COUNTER(1000071, "Coalesced nodes", numMerged);
+	}
 
 	//process all nodes fixed initially to a register-file
 	processClosedSet(graph, closedSet, openSet, errorSet);
@@ -685,8 +860,12 @@ bool GraphColoring::colorGraph()
 		if(graph.find(*openSet.begin()) == graph.end())
 			logging::debug() << "3) Error getting local " << (*openSet.begin())->name << " from graph" << logging::endl;
 		auto& node = graph.at(*openSet.begin());
+		//only locals with short live-ranges are preferably put on accumulators, since the few accumulators are blocked for all neighbors of the local.
+		//Long-living locals are only put on accumulators if there are no more free registers on the physical files
+		const Optional<LiveInterval> interval = method.getLiveInterval(node.key);
+		const bool isShortLiving = interval && interval->block != nullptr && interval->last - interval->first < ACCUMULATOR_THRESHOLD_HINT;
 		RegisterFile currentFile = RegisterFile::NONE;
-		if(has_flag(node.possibleFiles, RegisterFile::ACCUMULATOR))
+		if(has_flag(node.possibleFiles, RegisterFile::ACCUMULATOR) && (isShortLiving || !node.hasFreeRegisters(remove_flag(node.possibleFiles, RegisterFile::ACCUMULATOR))))
 			currentFile = RegisterFile::ACCUMULATOR;
 		else if(has_flag(node.possibleFiles, RegisterFile::PHYSICAL_A))
 			currentFile = RegisterFile::PHYSICAL_A;
@@ -727,23 +906,21 @@ static RegisterFile getBlockedInputs(const InstructionWalker it, const ColoredGr
 	return blockedFiles;
 }
 
-static LocalUse checkUser(const OrderedMap<const LocalUser*, LocalUse>& users, const InstructionWalker it)
+static LocalUse checkUser(const Local* local, const InstructionWalker it)
 {
 	LocalUse use;
-	it.forAllInstructions([&users, &use](const intermediate::IntermediateInstruction* instr)
+	it.forAllInstructions([local, &use](const intermediate::IntermediateInstruction* instr)
 	{
-		if(users.find(instr) != users.end())
-		{
-			use.numReads += users.at(instr).numReads;
-			use.numWrites += users.at(instr).numWrites;
-		}
+		const LocalUse instrUse = local->getUse(*instr);
+		use.numReads += instrUse.numReads;
+		use.numWrites += instrUse.numWrites;
 	});
 	return use;
 }
 
-static LocalUse assertUser(const OrderedMap<const LocalUser*, LocalUse>& users, const InstructionWalker it)
+static LocalUse assertUser(const Local* local, const InstructionWalker it)
 {
-	auto use = checkUser(users, it);
+	auto use = checkUser(local, it);
 	if(!use.readsLocal() && !use.writesLocal())
 	{
 		throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "User is not listed in the list of users", it->to_string());
@@ -768,10 +945,10 @@ static bool reassignNodeToRegister(ColoredGraph& graph, ColoredNode& node)
 	return fixed;
 }
 
-static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, ColoredNode& node, FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse, const RegisterFile file)
+static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, ColoredNode& node, FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse, const RegisterFile file, bool& modifiedMethod)
 {
 	bool needNextRound = false;
-	const auto& users = node.key->getUsers();
+	const Local* local = node.key;
 
 	//this might strain the accumulators, which can be fixed by the next iteration in CASE 1)
 
@@ -780,7 +957,7 @@ static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, Colored
 	for(InstructionWalker it : copy)
 	{
 		//1) check if instruction reads this local
-		if(!assertUser(users, it).readsLocal())
+		if(!assertUser(local, it).readsLocal())
 		{
 			continue;
 		}
@@ -800,7 +977,8 @@ static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, Colored
 		const Value tmp = method.addNewLocal(node.key->type, "%register_fix");
 		logging::debug() << "Fixing register-conflict by using temporary as input for: " << it->to_string() << logging::endl;
 		it.emplace(new intermediate::MoveOperation(tmp, node.key->createReference()));
-		auto tmpUse = localUses.emplace(tmp.local, LocalUsage(it, it)).first->second;
+		modifiedMethod = true;
+		auto& tmpUse = localUses.emplace(tmp.local, LocalUsage(it, it)).first->second;
 		it.nextInBlock();
 		it->replaceLocal(node.key, tmp.local, LocalUser::Type::READER);
 		//4) add temporary to graph (and local usage) with same blocked registers as local, but accumulator as file (since it is read in the next instruction)
@@ -840,7 +1018,7 @@ static bool blocksLocal(const ColoredNode* neighbor, LocalRelation relation)
 	return relation == LocalRelation::USED_TOGETHER && isFixed(neighbor->possibleFiles) && !has_flag(neighbor->possibleFiles, RegisterFile::ACCUMULATOR);
 }
 
-static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& node, FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse)
+static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& node, FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse, bool& modifiedMethod)
 {
 	/*
 	 * The following cases can occur:
@@ -875,7 +1053,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 	//we could skip re-creating the whole graph and simply try to assign a register to the node
 	//by re-checking which registers are not used by any neighbor
 
-	const auto& users = node.key->getUsers();
+	const Local* local = node.key;
 
 	//CASE 1)
 	if(node.initialFile == RegisterFile::ACCUMULATOR && !node.hasFreeRegisters(RegisterFile::ACCUMULATOR))
@@ -890,11 +1068,11 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 		for(InstructionWalker it : localUse.associatedInstructions)
 		{
 			//1) check if usage is a write
-			if(assertUser(users, it).writesLocal())
+			if(assertUser(local, it).writesLocal())
 			{
 				//2) check if next instruction reads this local
 				it.nextInMethod();
-				bool localRead = checkUser(users, it).readsLocal();
+				bool localRead = checkUser(local, it).readsLocal();
 				if(localRead && it.has<intermediate::VectorRotation>())
 				{
 					//TODO for locals used in vector rotations, this fix is wrong
@@ -905,10 +1083,11 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 				{
 					logging::debug() << "Fixing register-conflict by inserting NOP before: " << it->to_string() << logging::endl;
 					it.emplace(new intermediate::Nop(intermediate::DelayType::WAIT_REGISTER));
+					modifiedMethod = true;
 					PROFILE_COUNTER(1000011, "NOP insertions", 1);
 				}
 			}
-			else if(assertUser(users, it).readsLocal())
+			else if(assertUser(local, it).readsLocal())
 			{
 				freeFiles = remove_flag(freeFiles, getBlockedInputs(it, graph, node.key));
 			}
@@ -955,7 +1134,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 		if(!has_flag(localUses.at(node.key).blockedFiles, RegisterFile::ACCUMULATOR))
 		{
 			//the "easier" solution is to copy the local into an accumulator before each use, where it conflicts with other inputs
-			return moveLocalToRegisterFile(method, graph, node, localUses, localUse, fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B);
+			return moveLocalToRegisterFile(method, graph, node, localUses, localUse, fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, modifiedMethod);
 		}
 		else
 		{
@@ -991,9 +1170,9 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 		else if(!moveToFileA && !moveToFileB)
 		{
 			//there are no more free register AT ALL
-			//since we do not spill, we can only about
-			logging::error() << "Local " << node.key->to_string() << " cannot be assigned to ANY register, aborting!" << logging::endl;
-			throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Failed to assign local to ANY register", node.key->to_string());
+			//this can only be fixed by spilling any of the locals involved (see #getSpillCandidates())
+			logging::debug() << "Local " << node.key->to_string() << " cannot be assigned to ANY register, requires spilling" << logging::endl;
+			return false;
 		}
 
 		logging::debug() << "Trying to fix local to register-file " << toString(add_flag(moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::NONE, moveToFileB ? RegisterFile::PHYSICAL_B : RegisterFile::NONE)) << logging::endl;
@@ -1004,7 +1183,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 			throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Cannot fix register-conflict with local used as packed input", node.key->to_string());
 		}
 
-		return moveLocalToRegisterFile(method, graph, node, localUses, localUse, moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B);
+		return moveLocalToRegisterFile(method, graph, node, localUses, localUse, moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, modifiedMethod);
 	}
 	else
 		throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Unhandled conflict in register-mapping node", node.to_string());
@@ -1021,6 +1200,7 @@ bool GraphColoring::fixErrors()
 	}
 
 	bool allFixed = true;
+	bool modifiedMethod = false;
 	for(const Local* local : errorSet)
 	{
 		ColoredNode& node = graph.at(local);
@@ -1033,13 +1213,37 @@ bool GraphColoring::fixErrors()
 				s << neighbor->to_string() << ", ";
 		}
 		s << logging::endl;
-		if(!fixSingleError(method, graph, node, localUses, localUses.at(local)))
+		if(!fixSingleError(method, graph, node, localUses, localUses.at(local), modifiedMethod))
 			allFixed = false;
 	}
+	//the next round needs to re-calculate the liveness for the inserted instructions and temporaries
+	if(modifiedMethod)
+		analyses.invalidate();
 	PROFILE_END(fixRegisterErrors);
 	return allFixed;
 }
 
+std::vector<FastSet<const Local*>> GraphColoring::getSpillCandidates() const
+{
+	std::vector<FastSet<const Local*>> candidates;
+	candidates.reserve(errorSet.size());
+	for(const Local* local : errorSet)
+	{
+		const ColoredNode& node = graph.at(local);
+		FastSet<const Local*> conflict;
+		conflict.insert(local);
+		for(const auto& pair : node.getNeighbors())
+		{
+			//any neighbor assigned to a register occupies one the erroneous local could be assigned to
+			const ColoredNode* neighbor = reinterpret_cast<const ColoredNode*>(pair.first);
+			if(neighbor->possibleFiles != RegisterFile::NONE)
+				conflict.insert(neighbor->key);
+		}
+		candidates.emplace_back(std::move(conflict));
+	}
+	return candidates;
+}
+
 FastMap<const Local*, Register> GraphColoring::toRegisterMap() const
 {
 	if(!errorSet.empty())
@@ -1056,6 +1260,12 @@ FastMap<const Local*, Register> GraphColoring::toRegisterMap() const
 		result.emplace(pair.first, pair.second.getRegisterFixed());
 		logging::debug() << "Assigned local " << pair.first->name << " to register " << result.at(pair.first).to_string(true, false) << logging::endl;
 	}
+	//the locals merged into another node share its register
+	for(const auto& pair : coalescedLocals)
+	{
+		result.emplace(pair.first, result.at(pair.second));
+		logging::debug() << "Assigned local " << pair.first->name << " to register " << result.at(pair.first).to_string(true, false) << " of coalesced local " << pair.second->name << logging::endl;
+	}
 
 	return result;
 }
@@ -1067,6 +1277,7 @@ void GraphColoring::resetGraph()
 	closedSet.clear();
 	errorSet.clear();
 	graph.clear();
+	coalescedLocals.clear();
 	for(const auto& pair : localUses)
 	{
 		if(isFixed(pair.second.possibleFiles))
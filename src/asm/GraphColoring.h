@@ -12,9 +12,20 @@
 #include "../performance.h"
 
 #include <bitset>
+#include <vector>
 
 namespace vc4c
 {
+	namespace analysis
+	{
+		class LivenessAnalysis;
+	} // namespace analysis
+
+	namespace optimizations
+	{
+		class AnalysisManager;
+	} // namespace optimizations
+
 	namespace qpu_asm
 	{
 		enum class LocalRelation
@@ -42,6 +53,28 @@ namespace vc4c
 			LocalUsage(InstructionWalker first, InstructionWalker last);
 		};
 
+		/*
+		 * Restricts the register-files of the locals used by the given instruction, according to the restrictions of the hardware (see RegisterAllocation.h).
+		 *
+		 * The locals written by the previous instruction are tracked across calls, since they can only be read from accumulators
+		 */
+		void fixLocals(InstructionWalker it, FastMap<const Local*, LocalUsage>& localUses, Optional<const Local*>& lastWrittenLocal0, Optional<const Local*>& lastWrittenLocal1);
+		/*
+		 * Runs the given function for all locals used together with the given local by the same instruction,
+		 * which therefore cannot be on the same physical register-file
+		 */
+		void forLocalsUsedTogether(const Local* local, const std::function<void(const Local*)>& func);
+		/*
+		 * Runs the given function for all locals the given local is copied from or into by a simple move.
+		 * If both locals of such a move are assigned to the same register, the move can be removed (coalesced)
+		 */
+		void forLocalsMovedTogether(const Local* local, const std::function<void(const Local*)>& func);
+		/*
+		 * Runs the given function for all locals live across a switch of the hardware-thread (see intermediate::DelayType::THREAD_SWITCH),
+		 * which therefore cannot be on an accumulator
+		 */
+		void forLocalsLiveAcrossThreadSwitches(Method& method, const analysis::LivenessAnalysis& liveness, const std::function<void(const Local*)>& func);
+
 		class ColoredNode : public Node<const Local*, LocalRelation>
 		{
 		public:
@@ -55,6 +88,14 @@ namespace vc4c
 			bool hasFreeRegisters(RegisterFile file) const;
 			std::size_t countFreeRegisters(RegisterFile file) const;
 			void takeValues(const ColoredNode& other);
+			/*!
+			 * \return The number of registers available to both this and the other node, which would be left after merging the nodes
+			 */
+			std::size_t countCommonFreeRegisters(const ColoredNode& other) const;
+			/*!
+			 * Restricts the register-files and registers available to this node to the ones also available to the other node
+			 */
+			void restrictTo(const ColoredNode& other);
 
 			/*
 			 * \return The fixed register, this node has
@@ -66,6 +107,15 @@ namespace vc4c
 			 * \return the register-index in the corresponding bit-set
 			 */
 			std::size_t fixToRegister();
+			/*!
+			 * Fixes this node to the given register, if it is still available, to any other register otherwise.
+			 * \return the register-index in the corresponding bit-set
+			 */
+			std::size_t fixToRegister(const Register& preferredRegister);
+			/*
+			 * \return The register this node is fixed to, if there is only a single register left
+			 */
+			Optional<Register> getSingleRegister() const;
 
 			std::string to_string(bool longDescription = false) const;
 
@@ -108,9 +158,20 @@ namespace vc4c
 		public:
 			/*!
 			 * Initializes all internal data structures with a single iteration over all instructions
+			 *
+			 * In threaded mode, only the registers of the physical files available to a single hardware-thread are used
+			 * and locals live across a thread-switch are not mapped to accumulators.
+			 *
+			 * The liveness is taken from the given analyses, which are invalidated whenever fixing the errors modifies the method
 			 */
-			GraphColoring(Method& method, InstructionWalker it);
+			GraphColoring(Method& method, InstructionWalker it, optimizations::AnalysisManager& analyses, bool isThreaded = false);
 
+			/*!
+			 * Colors the graph, merging the nodes of locals copied into each other beforehand, if this does not restrict the coloring (see #coalesceNodes()).
+			 * If the coloring fails, it is repeated without merging any nodes, so the errors to be fixed refer to single locals.
+			 *
+			 * \return Whether all locals were assigned to registers
+			 */
 			bool colorGraph();
 
 			/*!
@@ -118,18 +179,40 @@ namespace vc4c
 			 */
 			bool fixErrors();
 
+			/*!
+			 * \return For every local which could not be assigned to a register, the local itself and all the neighbors occupying registers.
+			 * Spilling any of the locals of a set frees the registers required to resolve this conflict
+			 */
+			std::vector<FastSet<const Local*>> getSpillCandidates() const;
+
 			FastMap<const Local*, Register> toRegisterMap() const;
 		private:
 			Method& method;
+			optimizations::AnalysisManager& analyses;
 			FastSet<const Local*> closedSet;
 			FastSet<const Local*> openSet;
 			FastMap<const Local*, LocalUsage> localUses;
+			const bool isThreaded;
 
 			ColoredGraph graph;
 			FastSet<const Local*> errorSet;
+			//the locals whose nodes were merged into the node of another local, which they share the register with
+			FastMap<const Local*, const Local*> coalescedLocals;
 
 			void createGraph();
 			void resetGraph();
+			bool colorGraph(bool mergeNodes);
+			/*
+			 * Conservative coalescing (Briggs): Merges the nodes of two locals copied into each other by a simple move, if
+			 * - the locals do not interfere (are not neighbors),
+			 * - there are registers available to both locals and
+			 * - the merged node has fewer neighbors of significant degree (at least as many neighbors as free registers) than free registers.
+			 * The last condition guarantees, the merged node can be colored whenever the separate nodes could be colored by simplification,
+			 * the moves between merged locals are then removed after the register allocation.
+			 *
+			 * Returns the number of merged nodes
+			 */
+			std::size_t coalesceNodes();
 		};
 	} // namespace qpu_asm
 } // namespace vc4c
@@ -111,7 +111,7 @@ std::size_t KernelInfo::write(std::ostream& stream, const OutputMode mode) const
 
 std::string KernelInfo::to_string() const
 {
-	return std::string("Kernel '") + (name + "' with ") + (std::to_string(getLength().getValue()) + " instructions, offset ") + (std::to_string(getOffset().getValue()) + ", with following parameters: ") + ::to_string<ParamInfo>(parameters);
+	return std::string("Kernel '") + (name + "' with ") + (std::to_string(getLength().getValue()) + " instructions, offset ") + (std::to_string(getOffset().getValue()) + (isThreadable() ? ", threadable" : "") + ", with following parameters: ") + ::to_string<ParamInfo>(parameters);
 }
 
 static void toBinary(const Value& val, std::vector<uint8_t>& queue)
@@ -294,6 +294,7 @@ KernelInfo qpu_asm::getKernelInfos(const Method& method, const std::size_t initi
             logging::warn() << "Work-group size hint " << requiredSize << " exceeds the limit of " << KernelInfo::MAX_WORK_GROUP_SIZES << logging::endl;
         }
     }
+    info.setThreadable(method.metaData.isThreadable);
     for(const Parameter& param : method.parameters)
     {
     	std::string paramName = param.parameterName;
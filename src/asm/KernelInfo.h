@@ -118,7 +118,7 @@ namespace vc4c
 		 * Binary layout:
 		 *
 		 * | offset | length | name-length | parameter count |
-		 * | work-group size compilation hint                |
+		 * | work-group size compilation hint        | flags |
 		 * | name ...
 		 *   ...                                             |
 		 *
@@ -154,10 +154,29 @@ namespace vc4c
 			 */
 			BITFIELD_ENTRY(ParamCount, uint8_t, 56, Byte)
 			/*
-			 * The 3 dimensions for the work-group size specified in the source code
+			 * The 3 dimensions (16 bits each) for the work-group size specified in the source code, followed by the kernel flags (upper 16 bits)
 			 */
 			uint64_t workGroupSize;
 
+			/*
+			 * Flag for kernels, which can be executed by two hardware-threads per QPU (see KernelMetaData#isThreadable)
+			 *
+			 * NOTE: This changes the binary format! The kernel flags occupy the upper 16 bits of the work-group size hint, which have always been zero before.
+			 * The VC4CL runtime needs to mask them out when reading the work-group sizes and may only run kernels in threaded mode, if this flag is set.
+			 * Kernels are only marked as threadable, if compiled with Configuration#threadableKernels, so the output of the default configuration is unchanged.
+			 */
+			static constexpr uint64_t FLAG_THREADABLE = uint64_t{1} << 48;
+
+			inline bool isThreadable() const
+			{
+				return (workGroupSize & FLAG_THREADABLE) != 0;
+			}
+
+			inline void setThreadable(bool threadable)
+			{
+				workGroupSize = threadable ? (workGroupSize | FLAG_THREADABLE) : (workGroupSize & ~FLAG_THREADABLE);
+			}
+
 			std::size_t write(std::ostream& stream, OutputMode mode) const;
 			std::string to_string() const;
 
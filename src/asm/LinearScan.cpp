@@ -0,0 +1,371 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "LinearScan.h"
+
+#include "GraphColoring.h"
+#include "RegisterAllocation.h"
+#include "../analysis/LivenessAnalysis.h"
+#include "../optimization/Optimizer.h"
+#include "../Profiler.h"
+#include "log.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace vc4c;
+using namespace vc4c::qpu_asm;
+
+static constexpr std::size_t NO_INTERVAL = std::numeric_limits<std::size_t>::max();
+static constexpr std::size_t NUM_ACCUMULATORS{4};
+static constexpr std::size_t NUM_PHYSICAL_REGISTERS{32};
+
+namespace
+{
+	/*
+	 * The occupation of a single register by the intervals assigned to it
+	 */
+	struct RegisterState
+	{
+		//the interval last assigned to this register, which is also the one ending last
+		std::size_t lastInterval = NO_INTERVAL;
+		//the interval assigned before, which occupies the register again, if the last interval is moved to another register
+		std::size_t previousInterval = NO_INTERVAL;
+	};
+}
+
+LinearScan::LinearScan(Method& method, optimizations::AnalysisManager& analyses, const bool isThreaded) : numPhysicalRegisters(isThreaded ? NUM_REGISTERS_PER_THREAD : NUM_PHYSICAL_REGISTERS)
+{
+	PROFILE_START(createLiveIntervals);
+	FastMap<const Local*, LocalUsage> localUses;
+	Optional<const Local*> lastWrittenLocal0(false, nullptr);
+	Optional<const Local*> lastWrittenLocal1(false, nullptr);
+	std::vector<std::pair<const BasicBlock*, std::pair<std::size_t, std::size_t>>> blockRanges;
+	std::size_t index = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		const std::size_t blockStart = index;
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock(), ++index)
+		{
+			if(!it.has() || it.has<intermediate::Branch>() || it.has<intermediate::BranchLabel>() || it.has<intermediate::MemoryBarrier>())
+				continue;
+			it->forUsedLocals([this, &localUses, it, index](const Local* local, const LocalUser::Type type) -> void
+			{
+				if(local->type == TYPE_LABEL)
+					throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Created use for label", it->to_string());
+				auto pos = intervalIndices.find(local);
+				if(pos == intervalIndices.end())
+				{
+					pos = intervalIndices.emplace(local, intervals.size()).first;
+					intervals.push_back(LiveInterval{local, index, index, true, true, RegisterFile::ANY, REG_NOP, false});
+					localUses.emplace(local, LocalUsage(it, it));
+				}
+				LiveInterval& interval = intervals[pos->second];
+				if(interval.end != index)
+					interval.endsWithRead = true;
+				interval.end = index;
+				//the operations of a combined instruction report their locals separately
+				interval.endsWithRead = interval.endsWithRead && type == LocalUser::Type::READER;
+				if(interval.start == index)
+					interval.startsWithWrite = interval.startsWithWrite && type == LocalUser::Type::WRITER;
+			});
+			PROFILE(fixLocals, it, localUses, lastWrittenLocal0, lastWrittenLocal1);
+		}
+		blockRanges.emplace_back(&block, std::make_pair(blockStart, index - 1));
+	}
+
+	//locals live across the borders of a block are live for the whole block
+	const analysis::LivenessAnalysis& liveness = analyses.getLiveness(true);
+	const analysis::LocalNumbering& numbering = liveness.getLocalNumbering();
+	for(const auto& range : blockRanges)
+	{
+		liveness.getLiveIn(*range.first).forAll([this, &numbering, &range](std::size_t number) -> void
+		{
+			auto pos = intervalIndices.find(numbering.getLocal(number));
+			if(pos == intervalIndices.end())
+				return;
+			LiveInterval& interval = intervals[pos->second];
+			interval.start = std::min(interval.start, range.second.first);
+			interval.startsWithWrite = interval.startsWithWrite && interval.start != range.second.first;
+		});
+		liveness.getLiveOut(*range.first).forAll([this, &numbering, &range](std::size_t number) -> void
+		{
+			auto pos = intervalIndices.find(numbering.getLocal(number));
+			if(pos == intervalIndices.end())
+				return;
+			LiveInterval& interval = intervals[pos->second];
+			interval.end = std::max(interval.end, range.second.second);
+			interval.endsWithRead = interval.endsWithRead && interval.end != range.second.second;
+		});
+	}
+
+	for(LiveInterval& interval : intervals)
+		interval.possibleFiles = localUses.at(interval.local).possibleFiles;
+	//parameters are used from the beginning
+	for(const Parameter& param : method.parameters)
+	{
+		auto pos = intervalIndices.find(&param);
+		if(pos != intervalIndices.end())
+		{
+			LiveInterval& interval = intervals[pos->second];
+			interval.start = 0;
+			interval.startsWithWrite = false;
+			if(!isFixed(interval.possibleFiles))
+				//make sure, parameters are not mapped to accumulators
+				interval.possibleFiles = remove_flag(interval.possibleFiles, RegisterFile::ACCUMULATOR);
+		}
+	}
+	if(isThreaded)
+	{
+		//the accumulators are not preserved across a thread-switch
+		forLocalsLiveAcrossThreadSwitches(method, liveness, [this](const Local* local) -> void
+		{
+			auto pos = intervalIndices.find(local);
+			if(pos != intervalIndices.end())
+				intervals[pos->second].possibleFiles = remove_flag(intervals[pos->second].possibleFiles, RegisterFile::ACCUMULATOR);
+		});
+	}
+	PROFILE_END(createLiveIntervals);
+	logging::debug() << "Created " << intervals.size() << " live-intervals for " << index << " instructions" << logging::endl;
+}
+
+static RegisterFile getFile(const std::size_t registerIndex)
+{
+	if(registerIndex < NUM_ACCUMULATORS)
+		return RegisterFile::ACCUMULATOR;
+	return registerIndex < NUM_ACCUMULATORS + NUM_PHYSICAL_REGISTERS ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B;
+}
+
+static Register toRegister(const std::size_t registerIndex)
+{
+	if(registerIndex < NUM_ACCUMULATORS)
+		return ACCUMULATORS.at(registerIndex);
+	if(registerIndex < NUM_ACCUMULATORS + NUM_PHYSICAL_REGISTERS)
+		return Register{RegisterFile::PHYSICAL_A, static_cast<unsigned char>(registerIndex - NUM_ACCUMULATORS)};
+	return Register{RegisterFile::PHYSICAL_B, static_cast<unsigned char>(registerIndex - NUM_ACCUMULATORS - NUM_PHYSICAL_REGISTERS)};
+}
+
+static std::size_t toRegisterIndex(const Register& reg)
+{
+	if(reg.file == RegisterFile::ACCUMULATOR && reg.getAccumulatorNumber() >= 0 && static_cast<std::size_t>(reg.getAccumulatorNumber()) < NUM_ACCUMULATORS)
+		return static_cast<std::size_t>(reg.getAccumulatorNumber());
+	if(reg.file == RegisterFile::PHYSICAL_A && reg.num < NUM_PHYSICAL_REGISTERS)
+		return NUM_ACCUMULATORS + reg.num;
+	if(reg.file == RegisterFile::PHYSICAL_B && reg.num < NUM_PHYSICAL_REGISTERS)
+		return NUM_ACCUMULATORS + NUM_PHYSICAL_REGISTERS + reg.num;
+	return NO_INTERVAL;
+}
+
+static std::pair<std::size_t, std::size_t> getRegisterIndices(const RegisterFile file, const std::size_t numPhysicalRegisters)
+{
+	if(file == RegisterFile::ACCUMULATOR)
+		return std::make_pair(std::size_t{0}, NUM_ACCUMULATORS);
+	if(file == RegisterFile::PHYSICAL_A)
+		return std::make_pair(NUM_ACCUMULATORS, NUM_ACCUMULATORS + numPhysicalRegisters);
+	return std::make_pair(NUM_ACCUMULATORS + NUM_PHYSICAL_REGISTERS, NUM_ACCUMULATORS + NUM_PHYSICAL_REGISTERS + numPhysicalRegisters);
+}
+
+RegisterFile LinearScan::getBlockedFiles(const LiveInterval& interval) const
+{
+	//locals used together by an instruction cannot be on the same physical file
+	RegisterFile blockedFiles = RegisterFile::NONE;
+	forLocalsUsedTogether(interval.local, [this, &blockedFiles](const Local* local) -> void
+	{
+		auto pos = intervalIndices.find(local);
+		if(pos == intervalIndices.end())
+			return;
+		const LiveInterval& other = intervals[pos->second];
+		if(other.isAssigned && (other.reg.file == RegisterFile::PHYSICAL_A || other.reg.file == RegisterFile::PHYSICAL_B))
+			blockedFiles = add_flag(blockedFiles, other.reg.file);
+		//also reserve the file for locals which can only be on a single physical file
+		else if(!other.isAssigned && (other.possibleFiles == RegisterFile::PHYSICAL_A || other.possibleFiles == RegisterFile::PHYSICAL_B))
+			blockedFiles = add_flag(blockedFiles, other.possibleFiles);
+	});
+	return blockedFiles;
+}
+
+bool LinearScan::allocateRegisters()
+{
+	PROFILE_START(linearScan);
+	errors.clear();
+	std::vector<std::size_t> order;
+	order.reserve(intervals.size());
+	for(std::size_t i = 0; i < intervals.size(); ++i)
+	{
+		LiveInterval& interval = intervals[i];
+		interval.isAssigned = false;
+		interval.reg = REG_NOP;
+		if(interval.start == interval.end)
+		{
+			logging::debug() << "Local " << interval.local->name << " is never read!" << logging::endl;
+			interval.isAssigned = true;
+		}
+		else
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [this](std::size_t i1, std::size_t i2) -> bool { return intervals[i1].start < intervals[i2].start; });
+
+	std::vector<RegisterState> registers(NUM_ACCUMULATORS + 2 * NUM_PHYSICAL_REGISTERS);
+	const auto isFree = [this, &registers](std::size_t registerIndex, const LiveInterval& interval) -> bool
+	{
+		if(registers[registerIndex].lastInterval == NO_INTERVAL)
+			return true;
+		const LiveInterval& last = intervals[registers[registerIndex].lastInterval];
+		//a register read for the last time can be written by the same instruction
+		return last.end < interval.start || (last.end == interval.start && last.endsWithRead && interval.startsWithWrite);
+	};
+	const auto findFreeRegister = [this, &isFree](RegisterFile file, const LiveInterval& interval) -> std::size_t
+	{
+		const auto range = getRegisterIndices(file, numPhysicalRegisters);
+		for(std::size_t i = range.first; i < range.second; ++i)
+		{
+			if(isFree(i, interval))
+				return i;
+		}
+		return NO_INTERVAL;
+	};
+	const auto countFreeRegisters = [this, &isFree](RegisterFile file, const LiveInterval& interval) -> std::size_t
+	{
+		const auto range = getRegisterIndices(file, numPhysicalRegisters);
+		std::size_t count = 0;
+		for(std::size_t i = range.first; i < range.second; ++i)
+		{
+			if(isFree(i, interval))
+				++count;
+		}
+		return count;
+	};
+	const auto assignRegister = [this, &registers](std::size_t registerIndex, std::size_t intervalIndex) -> void
+	{
+		registers[registerIndex].previousInterval = registers[registerIndex].lastInterval;
+		registers[registerIndex].lastInterval = intervalIndex;
+		intervals[intervalIndex].reg = toRegister(registerIndex);
+		intervals[intervalIndex].isAssigned = true;
+	};
+	const auto findPhysicalRegister = [&findFreeRegister, &countFreeRegisters](RegisterFile files, const LiveInterval& interval) -> std::size_t
+	{
+		//use the file with more free registers left, so the other file is available for the locals used together with this one
+		if(has_flag(files, RegisterFile::PHYSICAL_A) && has_flag(files, RegisterFile::PHYSICAL_B))
+		{
+			const bool preferA = countFreeRegisters(RegisterFile::PHYSICAL_A, interval) >= countFreeRegisters(RegisterFile::PHYSICAL_B, interval);
+			const std::size_t registerIndex = findFreeRegister(preferA ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, interval);
+			return registerIndex != NO_INTERVAL ? registerIndex : findFreeRegister(preferA ? RegisterFile::PHYSICAL_B : RegisterFile::PHYSICAL_A, interval);
+		}
+		if(has_flag(files, RegisterFile::PHYSICAL_A))
+			return findFreeRegister(RegisterFile::PHYSICAL_A, interval);
+		if(has_flag(files, RegisterFile::PHYSICAL_B))
+			return findFreeRegister(RegisterFile::PHYSICAL_B, interval);
+		return NO_INTERVAL;
+	};
+
+	//conservative coalescing: use the register of a local copied from or into, if it is free for the whole interval
+	const auto findCoalescingRegister = [this, &isFree](RegisterFile files, const LiveInterval& interval) -> std::size_t
+	{
+		std::size_t registerIndex = NO_INTERVAL;
+		forLocalsMovedTogether(interval.local, [this, &isFree, &registerIndex, files, &interval](const Local* local) -> void
+		{
+			auto pos = intervalIndices.find(local);
+			if(registerIndex != NO_INTERVAL || pos == intervalIndices.end())
+				return;
+			const LiveInterval& other = intervals[pos->second];
+			if(!other.isAssigned || !has_flag(files, other.reg.file))
+				return;
+			const std::size_t otherIndex = toRegisterIndex(other.reg);
+			if(otherIndex != NO_INTERVAL && isFree(otherIndex, interval))
+				registerIndex = otherIndex;
+		});
+		return registerIndex;
+	};
+
+	std::size_t numMoved = 0;
+	std::size_t numCoalesced = 0;
+	for(const std::size_t intervalIndex : order)
+	{
+		const LiveInterval& interval = intervals[intervalIndex];
+		const RegisterFile files = remove_flag(interval.possibleFiles, getBlockedFiles(interval));
+		const bool accumulatorOnly = files == RegisterFile::ACCUMULATOR;
+		std::size_t registerIndex = findCoalescingRegister(files, interval);
+		if(registerIndex != NO_INTERVAL)
+			++numCoalesced;
+		//accumulators are scarce, so only short-living locals (and locals which have to) are mapped to them
+		if(registerIndex == NO_INTERVAL && has_flag(files, RegisterFile::ACCUMULATOR) && (accumulatorOnly || interval.end - interval.start < ACCUMULATOR_THRESHOLD_HINT))
+			registerIndex = findFreeRegister(RegisterFile::ACCUMULATOR, interval);
+		if(registerIndex == NO_INTERVAL)
+			registerIndex = findPhysicalRegister(files, interval);
+		if(registerIndex == NO_INTERVAL && has_flag(files, RegisterFile::ACCUMULATOR))
+			registerIndex = findFreeRegister(RegisterFile::ACCUMULATOR, interval);
+		if(registerIndex == NO_INTERVAL && accumulatorOnly)
+		{
+			//try to move a local occupying an accumulator to a physical register
+			for(std::size_t acc = 0; acc < NUM_ACCUMULATORS && registerIndex == NO_INTERVAL; ++acc)
+			{
+				const std::size_t otherIndex = registers[acc].lastInterval;
+				if(otherIndex == NO_INTERVAL)
+					continue;
+				const LiveInterval& other = intervals[otherIndex];
+				const std::size_t physicalIndex = findPhysicalRegister(remove_flag(other.possibleFiles, getBlockedFiles(other)), other);
+				if(physicalIndex == NO_INTERVAL)
+					continue;
+				logging::debug() << "Moving local " << other.local->name << " from accumulator to register-file " << toString(getFile(physicalIndex)) << " to make room for local " << interval.local->name << logging::endl;
+				registers[acc].lastInterval = registers[acc].previousInterval;
+				registers[acc].previousInterval = NO_INTERVAL;
+				assignRegister(physicalIndex, otherIndex);
+				registerIndex = acc;
+				++numMoved;
+			}
+		}
+		if(registerIndex == NO_INTERVAL)
+		{
+			logging::debug() << "Failed to assign local " << interval.local->to_string() << " with live-range [" << interval.start << ", " << interval.end << "] to any register of " << toString(files) << logging::endl;
+			errors.push_back(intervalIndex);
+			continue;
+		}
+		assignRegister(registerIndex, intervalIndex);
+	}
+	PROFILE_COUNTER(1000060, "Linear-scan moved locals", numMoved);
+	PROFILE_COUNTER(1000061, "Linear-scan errors", errors.size());
+	PROFILE_COUNTER(1000062, "Linear-scan coalescing register hints", numCoalesced);
+	PROFILE_END(linearScan);
+	return errors.empty();
+}
+
+std::vector<FastSet<const Local*>> LinearScan::getSpillCandidates() const
+{
+	std::vector<FastSet<const Local*>> candidates;
+	candidates.reserve(errors.size());
+	for(const std::size_t errorIndex : errors)
+	{
+		const LiveInterval& interval = intervals[errorIndex];
+		FastSet<const Local*> conflict;
+		conflict.insert(interval.local);
+		for(const LiveInterval& other : intervals)
+		{
+			if(other.isAssigned && other.reg != REG_NOP && has_flag(interval.possibleFiles, other.reg.file) && other.start <= interval.end && interval.start <= other.end)
+				conflict.insert(other.local);
+		}
+		candidates.emplace_back(std::move(conflict));
+	}
+	return candidates;
+}
+
+FastMap<const Local*, Register> LinearScan::toRegisterMap() const
+{
+	if(!errors.empty())
+	{
+		for(const std::size_t errorIndex : errors)
+			logging::error() << "Error assigning local to register: " << intervals[errorIndex].local->name << logging::endl;
+		throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "There are erroneous register-associations!");
+	}
+
+	FastMap<const Local*, Register> result;
+	result.reserve(intervals.size());
+	for(const LiveInterval& interval : intervals)
+	{
+		result.emplace(interval.local, interval.reg);
+		logging::debug() << "Assigned local " << interval.local->name << " to register " << interval.reg.to_string(true, false) << logging::endl;
+	}
+	return result;
+}
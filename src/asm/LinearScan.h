@@ -0,0 +1,83 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef LINEAR_SCAN_H
+#define LINEAR_SCAN_H
+
+#include "../Module.h"
+
+#include <vector>
+
+namespace vc4c
+{
+	namespace optimizations
+	{
+		class AnalysisManager;
+	} // namespace optimizations
+
+	namespace qpu_asm
+	{
+		/*
+		 * Linear-scan register allocator
+		 *
+		 * Every local is assigned to a single register for its whole live-interval, which spans from the first to the last instruction (in the order of the method) the local is live at.
+		 * The intervals are processed by their start and assigned to the first suitable register which is free for the whole interval,
+		 * heeding the same restrictions as the graph coloring (see RegisterAllocation.h), e.g. the register-files a local can be on and locals used together being on different physical files.
+		 *
+		 * Compared to the GraphColoring, no interference graph is created and the allocation runs in a single pass over the sorted intervals,
+		 * at the cost of more conservative live-ranges. This makes it suitable for huge kernels (e.g. with fully unrolled loops).
+		 */
+		class LinearScan
+		{
+		public:
+			/*
+			 * In threaded mode, only the registers of the physical files available to a single hardware-thread are used
+			 * and locals live across a thread-switch are not mapped to accumulators.
+			 *
+			 * The liveness is taken from the given analyses, the allocation itself never modifies the method
+			 */
+			LinearScan(Method& method, optimizations::AnalysisManager& analyses, bool isThreaded = false);
+
+			/*!
+			 * \return Whether all locals were assigned to registers
+			 */
+			bool allocateRegisters();
+
+			/*!
+			 * \return For every local which could not be assigned to a register, the local itself and the locals occupying the registers it could be assigned to
+			 */
+			std::vector<FastSet<const Local*>> getSpillCandidates() const;
+
+			FastMap<const Local*, Register> toRegisterMap() const;
+
+		private:
+			struct LiveInterval
+			{
+				const Local* local;
+				//the indices of the first and last instruction the local is live at
+				std::size_t start;
+				std::size_t end;
+				//whether the local is only written by the first and only read by the last instruction, so the register can be shared with the neighboring intervals
+				bool startsWithWrite;
+				bool endsWithRead;
+				RegisterFile possibleFiles;
+				//the register assigned, REG_NOP for locals which are never read
+				Register reg;
+				bool isAssigned;
+			};
+
+			std::vector<LiveInterval> intervals;
+			FastMap<const Local*, std::size_t> intervalIndices;
+			std::vector<std::size_t> errors;
+			//the number of registers per physical file which can be assigned
+			const std::size_t numPhysicalRegisters;
+
+			RegisterFile getBlockedFiles(const LiveInterval& interval) const;
+		};
+	} // namespace qpu_asm
+} // namespace vc4c
+
+#endif /* LINEAR_SCAN_H */
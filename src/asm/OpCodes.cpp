@@ -10,6 +10,7 @@
 #include "../intrinsics/Operators.h"
 #include "CompilationError.h"
 
+#include <algorithm>
 #include <cmath>
 #include <map>
 
@@ -229,7 +230,7 @@ std::string Pack::toString() const
 Optional<Value> Pack::pack(const Value& val) const
 {
 	//we never can pack complex types (even pointer, there are always 32-bit)
-	if(val.type.complexType)
+	if(val.type.isComplexType())
 		return NO_VALUE;
 	//for now, we can't pack floats
 	if(val.type.isFloatingType())
@@ -315,6 +316,18 @@ bool OpCode::operator<(const OpCode& right) const
 	return opAdd < right.opAdd || opMul < right.opMul;
 }
 
+template<typename Func>
+static int64_t calculatePerByte(const Literal& first, const Literal& second, const Func& func)
+{
+	//the packed 8-bit operations are applied to each of the 4 bytes of the 32-bit values separately, floating-point literals (e.g. small immediates) by their bit-representation
+	const uint32_t a = first.type == LiteralType::INTEGER ? static_cast<uint32_t>(first.integer) : first.toImmediate();
+	const uint32_t b = second.type == LiteralType::INTEGER ? static_cast<uint32_t>(second.integer) : second.toImmediate();
+	uint32_t result = 0;
+	for(uint32_t shift = 0; shift < 32; shift += 8)
+		result |= (static_cast<uint32_t>(func((a >> shift) & 0xFF, (b >> shift) & 0xFF)) & 0xFF) << shift;
+	return static_cast<int64_t>(result);
+}
+
 Optional<Value> OpCode::calculate(Optional<Value> firstOperand, Optional<Value> secondOperand, const std::function<Optional<Value>(const Value&)>& valueSupplier) const
 {
 	if(!firstOperand)
@@ -405,7 +418,18 @@ Optional<Value> OpCode::calculate(Optional<Value> firstOperand, Optional<Value>
 		return Value(Literal(firstLit.integer >> secondLit.integer), resultType);
 	if(*this == OP_SUB)
 		return Value(Literal(firstLit.integer - secondLit.integer), resultType);
-	//XXX v8xxx?
+	//the packed 8-bit operations return integer values, even for floating-point operands
+	const DataType packedResultType = resultType.isFloatingType() ? TYPE_INT32.toVectorType(resultType.num) : resultType;
+	if(*this == OP_V8ADDS)
+		return Value(Literal(calculatePerByte(firstLit, secondLit, [](uint32_t a, uint32_t b) -> uint32_t { return std::min(a + b, 255u); })), packedResultType);
+	if(*this == OP_V8SUBS)
+		return Value(Literal(calculatePerByte(firstLit, secondLit, [](uint32_t a, uint32_t b) -> uint32_t { return a > b ? a - b : 0u; })), packedResultType);
+	if(*this == OP_V8MIN)
+		return Value(Literal(calculatePerByte(firstLit, secondLit, [](uint32_t a, uint32_t b) -> uint32_t { return std::min(a, b); })), packedResultType);
+	if(*this == OP_V8MAX)
+		return Value(Literal(calculatePerByte(firstLit, secondLit, [](uint32_t a, uint32_t b) -> uint32_t { return std::max(a, b); })), packedResultType);
+	if(*this == OP_V8MULD)
+		return Value(Literal(calculatePerByte(firstLit, secondLit, [](uint32_t a, uint32_t b) -> uint32_t { return (a * b + 127) / 255; })), packedResultType);
 	if(*this == OP_XOR)
 		return Value(Literal(firstLit.integer ^ secondLit.integer), resultType);
 
@@ -35,9 +35,16 @@ namespace vc4c
 		 * - a vector-rotation by accumulator r5 cannot follow an instruction writing to r5
 		 * - a vector-rotation of an accumulator cannot follow an instruction writing to that accumulator
 		 *
+		 * In threaded mode (two hardware-threads per QPU, see Configuration#threadableKernels), additionally:
+		 * - each thread can only use half of the registers of both physical register-files
+		 * - the accumulators are not preserved across a thread-switch, so any local live across a thread-switch must be on a physical register
+		 *
 		 * For the best performance (the least delay-instructions required to be inserted), as much locals as possible should be mapped to accumulators.
 		 */
 
+		//the number of registers per physical register-file available to a single hardware-thread in threaded mode
+		static constexpr std::size_t NUM_REGISTERS_PER_THREAD{16};
+
 //general purpose registers, with no special functions
 		const std::vector<Register> GP_REGISTERS = { { RegisterFile::PHYSICAL_A, 0 }, { RegisterFile::PHYSICAL_B, 0 }, { RegisterFile::PHYSICAL_A, 1 }, { RegisterFile::PHYSICAL_B, 1 }, { RegisterFile::PHYSICAL_A, 2 }, {
 				RegisterFile::PHYSICAL_B, 2 }, { RegisterFile::PHYSICAL_A, 3 }, { RegisterFile::PHYSICAL_B, 3 }, { RegisterFile::PHYSICAL_A, 4 }, { RegisterFile::PHYSICAL_B, 4 }, { RegisterFile::PHYSICAL_A, 5 }, { RegisterFile::PHYSICAL_B,
@@ -0,0 +1,411 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "RegisterSpilling.h"
+
+#include "../InstructionWalker.h"
+#include "../Profiler.h"
+#include "../analysis/LivenessAnalysis.h"
+#include "../optimization/Optimizer.h"
+#include "../periphery/VPM.h"
+#include "log.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+using namespace vc4c;
+using namespace vc4c::qpu_asm;
+using namespace vc4c::intermediate;
+using namespace vc4c::periphery;
+
+//the number of instructions executed after a branch
+static constexpr std::size_t NUM_DELAY_SLOTS{3};
+//the maximum loop-depth taken into account for weighting the accesses of a local
+static constexpr std::size_t MAX_LOOP_DEPTH{4};
+//spilled locals are always stored as a whole SIMD vector of 32-bit elements (a row of the VPM)
+static const DataType SPILL_TYPE{TYPE_INT32.toVectorType(NATIVE_VECTOR_SIZE)};
+static constexpr std::size_t SPILL_SLOT_SIZE{NATIVE_VECTOR_SIZE * sizeof(uint32_t)};
+
+using SpillFunction = std::function<InstructionWalker(InstructionWalker, const Value&)>;
+
+namespace
+{
+	struct SpillInfo
+	{
+		//the number of instructions the local is live after
+		std::size_t liveInstructions = 0;
+		//the number of accesses, weighted by the depth of the loops they are located in
+		std::size_t weightedUses = 0;
+		//the number of groups of accesses (see AccessGroup), spilling a local accessed by a single group only moves the conflict to the temporary
+		std::size_t numGroups = 0;
+		std::size_t lastCriticalSection = std::numeric_limits<std::size_t>::max();
+		//whether there is an access we cannot insert spill-code around
+		bool canBeSpilled = true;
+	};
+
+	/*
+	 * Accesses to a spilled local, which share a single temporary.
+	 *
+	 * All accesses within a critical section (guarded by the hardware mutex) are grouped, so the spill-code (which could lock the mutex itself) is inserted outside of it
+	 */
+	struct AccessGroup
+	{
+		//the position to reload the value before
+		InstructionWalker start;
+		//the position to write the value back after
+		InstructionWalker end;
+		std::vector<InstructionWalker> accesses;
+	};
+}
+
+/*
+ * Determines the loop-depth of every instruction (by its index within the method).
+ *
+ * Every branch to a block located before (or equal to) the block containing the branch is considered to close a loop
+ */
+static std::vector<std::size_t> determineLoopDepths(Method& method)
+{
+	FastMap<const Local*, std::size_t> labelPositions;
+	std::vector<std::pair<std::size_t, std::size_t>> loops;
+	std::size_t index = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock(), ++index)
+		{
+			if(it.has<BranchLabel>())
+				labelPositions.emplace(it.get<BranchLabel>()->getLabel(), index);
+			else if(it.has<Branch>())
+			{
+				auto labelIt = labelPositions.find(it.get<Branch>()->getTarget());
+				if(labelIt != labelPositions.end())
+					loops.emplace_back(labelIt->second, index);
+			}
+		}
+	}
+	std::vector<std::size_t> depths(index, 0);
+	for(const auto& loop : loops)
+	{
+		for(std::size_t i = loop.first; i <= loop.second; ++i)
+			++depths[i];
+	}
+	return depths;
+}
+
+static bool hasUnpackMode(const IntermediateInstruction* instr)
+{
+	if(const CombinedOperation* combined = dynamic_cast<const CombinedOperation*>(instr))
+		return (combined->op1 && combined->op1->hasUnpackMode()) || (combined->op2 && combined->op2->hasUnpackMode());
+	return instr->hasUnpackMode();
+}
+
+static FastMap<const Local*, SpillInfo> analyzeLocals(Method& method, const analysis::LivenessAnalysis& liveness)
+{
+	const std::vector<std::size_t> loopDepths = determineLoopDepths(method);
+	const Local* globalDataAddress = method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_DATA_ADDRESS);
+	FastMap<const Local*, SpillInfo> infos;
+	//the spilling into memory requires the global data address, so only locals accessed after it is loaded can be spilled
+	bool globalDataAddressLoaded = false;
+	std::size_t index = 0;
+	std::size_t criticalSection = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		bool inCriticalSection = false;
+		std::vector<const Local*> criticalSectionLocals;
+		std::size_t remainingDelaySlots = 0;
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock(), ++index)
+		{
+			if(!it.has() || it.has<BranchLabel>())
+				continue;
+			const bool inDelaySlot = remainingDelaySlots > 0;
+			if(inDelaySlot)
+				--remainingDelaySlots;
+			if(it.has<MutexLock>())
+			{
+				inCriticalSection = it.get<MutexLock>()->locksMutex();
+				criticalSectionLocals.clear();
+				++criticalSection;
+				continue;
+			}
+			if(it.has<Branch>())
+			{
+				//the condition is not read by the branch itself, but by the instruction setting the flags (see #extendBranches)
+				remainingDelaySlots = NUM_DELAY_SLOTS;
+				continue;
+			}
+			//rotated and unpacked inputs cannot be read from the accumulator written by the preceding instruction
+			const bool hasRestrictedInputs = it.has<VectorRotation>() || hasUnpackMode(it.get());
+			const std::size_t weight = std::size_t{1} << (3 * std::min(loopDepths[index], MAX_LOOP_DEPTH));
+			it->forUsedLocals([&](const Local* local, LocalUser::Type type) -> void
+			{
+				if(local->type == TYPE_LABEL)
+					return;
+				SpillInfo& info = infos[local];
+				info.weightedUses += weight;
+				if(!inCriticalSection || info.lastCriticalSection != criticalSection)
+					++info.numGroups;
+				if(inCriticalSection)
+					info.lastCriticalSection = criticalSection;
+				if(inDelaySlot || !globalDataAddressLoaded || !it->mapsToASMInstruction() || (has_flag(type, LocalUser::Type::READER) && hasRestrictedInputs))
+					info.canBeSpilled = false;
+				if(inCriticalSection)
+					criticalSectionLocals.push_back(local);
+			});
+			if(it->writesLocal(globalDataAddress))
+				globalDataAddressLoaded = true;
+		}
+		if(inCriticalSection)
+		{
+			//the spill-code for critical sections spanning several blocks cannot be placed outside of them
+			for(const Local* local : criticalSectionLocals)
+				infos[local].canBeSpilled = false;
+		}
+	}
+
+	//the length of the live-range also includes the instructions between the accesses, e.g. the rest of a loop the local is live across
+	const analysis::LocalNumbering& numbering = liveness.getLocalNumbering();
+	std::vector<std::size_t> liveInstructions(numbering.size(), 0);
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		liveness.forInstructionsInBlock(block, [&liveInstructions](InstructionWalker it, const analysis::BitSet& liveAfter) -> void
+		{
+			liveAfter.forAll([&liveInstructions](std::size_t number) -> void
+			{
+				++liveInstructions[number];
+			});
+		});
+	}
+	for(auto& pair : infos)
+	{
+		const Optional<std::size_t> number = numbering.getNumber(pair.first);
+		if(number)
+			pair.second.liveInstructions = liveInstructions[number.value()];
+	}
+	return infos;
+}
+
+/*
+ * Greedily selects a local to spill for every conflict, preferring the locals with the lowest spill-cost relative to the number of conflicts they are involved in
+ */
+static std::vector<const Local*> selectSpilledLocals(const FastMap<const Local*, SpillInfo>& infos, const std::vector<FastSet<const Local*>>& conflicts)
+{
+	FastMap<const Local*, double> spillCosts;
+	for(const FastSet<const Local*>& conflict : conflicts)
+	{
+		for(const Local* local : conflict)
+		{
+			auto infoIt = infos.find(local);
+			if(infoIt == infos.end() || !infoIt->second.canBeSpilled || infoIt->second.numGroups < 2)
+				continue;
+			const std::size_t range = infoIt->second.liveInstructions;
+			//spilling locals with short live-ranges does not free any registers, since they are mapped to accumulators anyway
+			if(range < ACCUMULATOR_THRESHOLD_HINT)
+				continue;
+			spillCosts.emplace(local, static_cast<double>(infoIt->second.weightedUses) / static_cast<double>(range));
+		}
+	}
+
+	std::vector<const Local*> spilledLocals;
+	std::vector<bool> resolvedConflicts(conflicts.size(), false);
+	while(true)
+	{
+		FastMap<const Local*, std::size_t> numConflicts;
+		for(std::size_t i = 0; i < conflicts.size(); ++i)
+		{
+			if(resolvedConflicts[i])
+				continue;
+			for(const Local* local : conflicts[i])
+			{
+				if(spillCosts.find(local) != spillCosts.end())
+					++numConflicts[local];
+			}
+		}
+		const Local* cheapestLocal = nullptr;
+		double lowestCost = std::numeric_limits<double>::max();
+		for(const auto& pair : numConflicts)
+		{
+			const double cost = spillCosts.at(pair.first) / static_cast<double>(pair.second);
+			if(cost < lowestCost || (cost == lowestCost && pair.first->name < cheapestLocal->name))
+			{
+				cheapestLocal = pair.first;
+				lowestCost = cost;
+			}
+		}
+		if(cheapestLocal == nullptr)
+			break;
+		logging::debug() << "Selected local for spilling: " << cheapestLocal->to_string() << " (spill-cost " << spillCosts.at(cheapestLocal) << ", involved in " << numConflicts.at(cheapestLocal) << " conflicts)" << logging::endl;
+		spilledLocals.push_back(cheapestLocal);
+		spillCosts.erase(cheapestLocal);
+		//spilling a local frees a single register, which can only be used to resolve a single of the conflicts
+		for(std::size_t i = 0; i < conflicts.size(); ++i)
+		{
+			if(!resolvedConflicts[i] && conflicts[i].find(cheapestLocal) != conflicts[i].end())
+			{
+				resolvedConflicts[i] = true;
+				break;
+			}
+		}
+	}
+	return spilledLocals;
+}
+
+static void rewriteAccesses(Method& method, const Local* local, const SpillFunction& insertReload, const SpillFunction& insertStore)
+{
+	std::vector<AccessGroup> groups;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		bool inCriticalSection = false;
+		InstructionWalker criticalSectionStart;
+		//the index of the group of accesses within the current critical section, if any
+		std::size_t sectionGroup = std::numeric_limits<std::size_t>::max();
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has())
+				continue;
+			if(it.has<MutexLock>())
+			{
+				inCriticalSection = it.get<MutexLock>()->locksMutex();
+				if(inCriticalSection)
+					criticalSectionStart = it;
+				else if(sectionGroup < groups.size())
+					groups[sectionGroup].end = it;
+				sectionGroup = std::numeric_limits<std::size_t>::max();
+				continue;
+			}
+			if(it.has<Branch>() || !(it->readsLocal(local) || it->writesLocal(local)))
+				continue;
+			if(!inCriticalSection)
+				groups.push_back(AccessGroup{it, it, {it}});
+			else
+			{
+				if(sectionGroup >= groups.size())
+				{
+					sectionGroup = groups.size();
+					groups.push_back(AccessGroup{criticalSectionStart, it, {}});
+				}
+				groups[sectionGroup].accesses.push_back(it);
+			}
+		}
+	}
+
+	for(AccessGroup& group : groups)
+	{
+		const Value tmp = method.addNewLocal(local->type, "%spill");
+		const IntermediateInstruction* firstAccess = group.accesses.front().get();
+		//the value only needs to be reloaded, if it is not completely overwritten before being read
+		const bool needsReload = firstAccess->readsLocal(local) || dynamic_cast<const CombinedOperation*>(firstAccess) != nullptr || firstAccess->hasConditionalExecution() ||
+				firstAccess->hasPackMode() || has_flag(firstAccess->decoration, InstructionDecorations::ELEMENT_INSERTION);
+		const bool needsStore = std::any_of(group.accesses.begin(), group.accesses.end(), [local](const InstructionWalker& it) -> bool { return it->writesLocal(local); });
+		for(InstructionWalker& access : group.accesses)
+			access->replaceLocal(local, tmp.local, LocalUser::Type::BOTH);
+		if(needsReload)
+			insertReload(group.start, Value(tmp.local, SPILL_TYPE));
+		if(needsStore)
+			insertStore(group.end.copy().nextInBlock(), Value(tmp.local, SPILL_TYPE));
+	}
+	logging::debug() << "Spilled local " << local->to_string() << " with " << groups.size() << " groups of accesses" << logging::endl;
+}
+
+/*
+ * Calculates the address of a memory slot for spilled locals of the executing QPU
+ */
+static InstructionWalker insertCalculateSpillAddress(Method& method, InstructionWalker it, const Value& address, const std::size_t sizePerQPU, const std::size_t offset)
+{
+	const Value sizeValue = method.addNewLocal(TYPE_INT32, "%spill_size");
+	const Value qpuOffset = method.addNewLocal(TYPE_INT32, "%spill_offset");
+	const Value slotOffset = method.addNewLocal(TYPE_INT32, "%spill_offset");
+	const Value slotAddress = method.addNewLocal(TYPE_INT32, "%spill_addr");
+	it.emplace(new LoadImmediate(sizeValue, Literal(static_cast<int64_t>(sizePerQPU))));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_MUL24, qpuOffset, sizeValue, Value(REG_QPU_NUMBER, TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new LoadImmediate(slotOffset, Literal(static_cast<int64_t>(offset))));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ADD, slotAddress, slotOffset, method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_DATA_ADDRESS)->createReference()));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ADD, address, slotAddress, qpuOffset));
+	it.nextInBlock();
+	return it;
+}
+
+bool qpu_asm::spillLocals(Method& method, const std::vector<FastSet<const Local*>>& conflicts, optimizations::AnalysisManager& analyses)
+{
+	PROFILE_START(spillLocals);
+	const FastMap<const Local*, SpillInfo> infos = analyzeLocals(method, analyses.getLiveness(true));
+	std::vector<const Local*> spilledLocals = selectSpilledLocals(infos, conflicts);
+	if(spilledLocals.empty())
+	{
+		logging::debug() << "Found no local to be spilled to resolve the register conflicts" << logging::endl;
+		PROFILE_END(spillLocals);
+		return false;
+	}
+	//the locals accessed most often are spilled into the VPM, since accessing it is far cheaper than accessing memory
+	std::sort(spilledLocals.begin(), spilledLocals.end(), [&infos](const Local* l1, const Local* l2) -> bool
+	{
+		const std::size_t uses1 = infos.at(l1).weightedUses;
+		const std::size_t uses2 = infos.at(l2).weightedUses;
+		return uses1 > uses2 || (uses1 == uses2 && l1->name < l2->name);
+	});
+
+	//spilling into memory uses the scratch area of the VPM, which cannot grow after the area for spilled locals is reserved
+	if(method.vpm->getScratchArea().size < SPILL_SLOT_SIZE)
+		method.vpm->updateScratchSize(SPILL_SLOT_SIZE);
+	std::size_t numVPMSlots = spilledLocals.size();
+	const VPMArea* vpmArea = nullptr;
+	while(numVPMSlots > 0 && (vpmArea = method.vpm->addSpillingArea(static_cast<unsigned>(numVPMSlots))) == nullptr)
+		--numVPMSlots;
+
+	const std::size_t numMemorySlots = spilledLocals.size() - numVPMSlots;
+	const std::size_t memorySizePerQPU = numMemorySlots * SPILL_SLOT_SIZE;
+	//the memory for spilled locals is located behind the (current) stack-frames of all QPUs, so the addresses of the existing stack allocations do not change
+	std::size_t memoryBaseOffset = 0;
+	if(numMemorySlots > 0)
+	{
+		const std::size_t stackSize = method.calculateStackSize();
+		memoryBaseOffset = method.getStackBaseOffset() + NUM_QPUS * stackSize;
+		//reserving the memory as stack allocation behind all others grows the stack-frame by the size required, so the total memory allocated is sufficient
+		auto allocation = method.stackAllocations.emplace(StackAllocation(std::string("%register_spilling") + std::to_string(method.stackAllocations.size()), SPILL_TYPE.toPointerType(), memorySizePerQPU, 1));
+		const_cast<std::size_t&>(allocation.first->offset) = stackSize;
+	}
+
+	for(std::size_t slot = 0; slot < spilledLocals.size(); ++slot)
+	{
+		if(slot < numVPMSlots)
+		{
+			logging::debug() << "Spilling local " << spilledLocals[slot]->to_string() << " into VPM" << logging::endl;
+			rewriteAccesses(method, spilledLocals[slot], [&method, vpmArea, slot](InstructionWalker it, const Value& dest) -> InstructionWalker
+			{
+				return method.vpm->insertReloadRegister(method, it, dest, *vpmArea, static_cast<unsigned>(slot));
+			}, [&method, vpmArea, slot](InstructionWalker it, const Value& src) -> InstructionWalker
+			{
+				return method.vpm->insertSpillRegister(method, it, src, *vpmArea, static_cast<unsigned>(slot));
+			});
+		}
+		else
+		{
+			logging::debug() << "Spilling local " << spilledLocals[slot]->to_string() << " into memory" << logging::endl;
+			const std::size_t offset = memoryBaseOffset + (slot - numVPMSlots) * SPILL_SLOT_SIZE;
+			rewriteAccesses(method, spilledLocals[slot], [&method, memorySizePerQPU, offset](InstructionWalker it, const Value& dest) -> InstructionWalker
+			{
+				const Value address = method.addNewLocal(TYPE_INT32, "%spill_addr");
+				it = insertCalculateSpillAddress(method, it, address, memorySizePerQPU, offset);
+				return periphery::insertReadDMA(method, it, dest, address);
+			}, [&method, memorySizePerQPU, offset](InstructionWalker it, const Value& src) -> InstructionWalker
+			{
+				const Value address = method.addNewLocal(TYPE_INT32, "%spill_addr");
+				it = insertCalculateSpillAddress(method, it, address, memorySizePerQPU, offset);
+				return periphery::insertWriteDMA(method, it, src, address);
+			});
+		}
+	}
+	//the spill-code introduces new temporaries and splits the live-ranges of the spilled locals
+	analyses.invalidate();
+	logging::debug() << "Spilled " << numVPMSlots << " locals into VPM and " << numMemorySlots << " locals into memory" << logging::endl;
+	PROFILE_COUNTER(1000950, "Locals spilled into VPM", numVPMSlots);
+	PROFILE_COUNTER(1000951, "Locals spilled into memory", numMemorySlots);
+	PROFILE_END(spillLocals);
+	return true;
+}
@@ -0,0 +1,39 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef REGISTER_SPILLING_H
+#define REGISTER_SPILLING_H
+
+#include "../Module.h"
+
+#include <vector>
+
+namespace vc4c
+{
+	namespace optimizations
+	{
+		class AnalysisManager;
+	} // namespace optimizations
+
+	namespace qpu_asm
+	{
+		/*
+		 * Spills locals to resolve the register-conflicts the graph coloring could not fix.
+		 * Every conflict is given as the set of locals involved, spilling any of them frees a register for the others.
+		 *
+		 * For every conflict, the local with the lowest spill-cost (its accesses weighted by the loop-depth, relative to the number of instructions it is live at) is spilled.
+		 * Spilled locals are stored in a per-QPU area of the VPM or, if the VPM is full, in an additional per-QPU area behind the stack-frames in memory.
+		 * Every (group of) access(es) to a spilled local uses a new short-living temporary, which is reloaded before and written back after the access(es).
+		 *
+		 * The live-ranges are taken from the given analyses, which are invalidated if any local is spilled.
+		 *
+		 * Returns whether any local was spilled
+		 */
+		bool spillLocals(Method& method, const std::vector<FastSet<const Local*>>& conflicts, optimizations::AnalysisManager& analyses);
+	} // namespace qpu_asm
+} // namespace vc4c
+
+#endif /* REGISTER_SPILLING_H */
@@ -20,7 +20,7 @@
 using namespace vc4c;
 
 const configuration DEFAULT_CONFIG = {
-    MATH_TYPE_FAST, OUTPUT_BINARY, LOG_WARNING
+    MATH_TYPE_FAST, OUTPUT_BINARY, LOG_WARNING, 0
 };
 
 static CompilationErrorHandler errorCallback = NULL;
@@ -34,6 +34,7 @@ int convert(const storage* in, storage* out, const configuration config, const c
     realConfig.mathType = static_cast<MathType>(config.math_type);
     realConfig.outputMode = static_cast<OutputMode>(config.output_mode);
     realConfig.writeKernelInfo = true;
+    realConfig.numThreads = config.num_threads;
         
     std::unique_ptr<std::istream> is;
     if(in->is_file)
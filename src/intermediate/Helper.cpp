@@ -216,7 +216,7 @@ InstructionWalker intermediate::insertVectorShuffle(InstructionWalker it, Method
     }
     
     //zero out destination first, also required so register allocator finds unconditional write to destination
-    if(destination.hasType(ValueType::LOCAL) && destination.local->getUsers(LocalUser::Type::WRITER).empty())
+    if(destination.hasType(ValueType::LOCAL) && destination.local->countUsers(LocalUser::Type::WRITER) == 0)
     {
 		it.emplace(new intermediate::MoveOperation(destination, INT_ZERO));
 		it.nextInBlock();
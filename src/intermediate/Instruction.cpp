@@ -61,10 +61,7 @@ signal(SIGNAL_NONE), unpackMode(UNPACK_NOP),  packMode(packMode), conditional(co
 
 IntermediateInstruction::~IntermediateInstruction()
 {
-	//this can't be in LocalUser
-	//since at the time, the ~LocalUser() is called, the IntermediateInstruction "part" is already destroyed
-	for(const auto& pair : getUsedLocals())
-		const_cast<Local*>(pair.first)->removeUser(*this, LocalUser::Type::BOTH);
+	//the usages of the locals are removed in ~LocalUser(), which does not need to access the arguments/output
 }
 
 bool IntermediateInstruction::mapsToASMInstruction() const
@@ -161,6 +158,8 @@ bool IntermediateInstruction::hasSideEffects() const
 		return true;
 	if(dynamic_cast<const SemaphoreAdjustment*>(this) != nullptr)
 		return true;
+	if(dynamic_cast<const MemoryInstruction*>(this) != nullptr && dynamic_cast<const MemoryInstruction*>(this)->op != MemoryOperation::READ)
+		return true;
 	if(hasValueType(ValueType::REGISTER) && output->reg.hasSideEffectsOnWrite())
 		return true;
 	for(const Value& arg : arguments)
@@ -272,7 +272,9 @@ namespace vc4c
 			//waiting for the UNIFORM address-register to be changed before reading an UNIFORM value
 			WAIT_UNIFORM,
 			//waiting for a VPM operation (DMA read/write or VPM read) to finish. These types of nops can be removed, after they are replaced
-			WAIT_VPM
+			WAIT_VPM,
+			//switch to the other hardware-thread (and its 2 delay-slots), while waiting for a TMU load to finish
+			THREAD_SWITCH
 		};
 
 		struct Nop: public IntermediateInstruction
@@ -502,6 +504,53 @@ namespace vc4c
 			MutexAccess accessType;
 		};
 
+		enum class MemoryOperation
+		{
+			//reads the value located at the source address into the destination
+			READ,
+			//writes the source value to the destination address
+			WRITE,
+			//copies the given number of entries from the source address to the destination address
+			COPY,
+			//writes the given number of copies of the source value into memory, starting at the destination address
+			FILL
+		};
+
+		/*
+		 * Instruction accessing memory, independent of the hardware (TMU, VPM/DMA) the access is executed by.
+		 *
+		 * The memory instructions are created by the front-ends and lowered to the accesses of the periphery by the optimizer (see optimizations::lowerMemoryAccess),
+		 * so all optimizations running before can reason about the memory accessed.
+		 * NOTE: The lowering runs after all memory optimizations (e.g. CombineVPMAccess, CacheMemoryInVPM and PipelineTMULoads), which all run on the memory instructions.
+		 * The type of the memory accessed as well as its address-space are given by the (pointer-)types of the addresses,
+		 * the number of entries of copies and fills is given in elements of the type of the memory accessed.
+		 */
+		struct MemoryInstruction : IntermediateInstruction
+		{
+		public:
+			MemoryInstruction(MemoryOperation op, const Value& dest, const Value& src, const Value& numEntries = INT_ONE, bool useMutex = true);
+			~MemoryInstruction() override = default;
+
+			std::string to_string() const override;
+			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, std::size_t instructionIndex) const override;
+			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
+			bool mapsToASMInstruction() const override;
+
+			Value getSource() const;
+			Value getDestination() const;
+			Value getNumEntries() const;
+
+			/*
+			 * The type of a single entry read from the source / written to the destination
+			 */
+			DataType getSourceElementType() const;
+			DataType getDestinationElementType() const;
+
+			const MemoryOperation op;
+			//whether the access acquires the hardware-mutex, otherwise it is already guarded by a critical section (e.g. for built-in functions)
+			const bool useMutex;
+		};
+
 		using InstructionsIterator = FastModificationList<std::unique_ptr<IntermediateInstruction>>::iterator;
 		using ConstInstructionsIterator = FastModificationList<std::unique_ptr<IntermediateInstruction>>::const_iterator;
 	} // namespace intermediate
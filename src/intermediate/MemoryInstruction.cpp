@@ -0,0 +1,81 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "IntermediateInstruction.h"
+
+using namespace vc4c;
+using namespace vc4c::intermediate;
+
+MemoryInstruction::MemoryInstruction(const MemoryOperation op, const Value& dest, const Value& src, const Value& numEntries, const bool useMutex) :
+IntermediateInstruction(op == MemoryOperation::READ ? Optional<Value>(dest) : NO_VALUE), op(op), useMutex(useMutex)
+{
+	setArgument(0, src);
+	setArgument(1, numEntries);
+	if(op != MemoryOperation::READ)
+		setArgument(2, dest);
+}
+
+std::string MemoryInstruction::to_string() const
+{
+	switch(op)
+	{
+		case MemoryOperation::READ:
+			return getDestination().to_string(true) + " = mem-read " + getSource().to_string() + createAdditionalInfoString();
+		case MemoryOperation::WRITE:
+			return std::string("mem-write ") + (getSource().to_string() + " into ") + getDestination().to_string(true) + createAdditionalInfoString();
+		case MemoryOperation::COPY:
+			return std::string("mem-copy ") + (getNumEntries().to_string() + " entries from ") + (getSource().to_string() + " into ") + getDestination().to_string(true) + createAdditionalInfoString();
+		case MemoryOperation::FILL:
+			return std::string("mem-fill ") + (getDestination().to_string(true) + " with ") + (getNumEntries().to_string() + " copies of ") + getSource().to_string() + createAdditionalInfoString();
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Unhandled memory operation", std::to_string(static_cast<int>(op)));
+}
+
+qpu_asm::Instruction* MemoryInstruction::convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const
+{
+	throw CompilationError(CompilationStep::CODE_GENERATION, "There should be no more memory instructions at this point", to_string());
+}
+
+IntermediateInstruction* MemoryInstruction::copyFor(Method& method, const std::string& localPrefix) const
+{
+	return (new MemoryInstruction(op, renameValue(method, getDestination(), localPrefix), renameValue(method, getSource(), localPrefix), renameValue(method, getNumEntries(), localPrefix), useMutex))->copyExtrasFrom(this);
+}
+
+bool MemoryInstruction::mapsToASMInstruction() const
+{
+	return false;
+}
+
+Value MemoryInstruction::getSource() const
+{
+	return getArgument(0).value();
+}
+
+Value MemoryInstruction::getDestination() const
+{
+	if(op == MemoryOperation::READ)
+		return getOutput().value();
+	return getArgument(2).value();
+}
+
+Value MemoryInstruction::getNumEntries() const
+{
+	return getArgument(1).value();
+}
+
+DataType MemoryInstruction::getSourceElementType() const
+{
+	if(op == MemoryOperation::WRITE || op == MemoryOperation::FILL)
+		return getSource().type;
+	return getSource().type.getElementType();
+}
+
+DataType MemoryInstruction::getDestinationElementType() const
+{
+	if(op == MemoryOperation::READ)
+		return getDestination().type;
+	return getDestination().type.getElementType();
+}
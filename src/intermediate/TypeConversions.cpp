@@ -6,6 +6,8 @@
 
 #include "TypeConversions.h"
 
+#include <limits>
+
 using namespace vc4c;
 using namespace vc4c::intermediate;
 
@@ -44,6 +46,12 @@ InstructionWalker intermediate::insertZeroExtension(InstructionWalker it, Method
 		it.emplace(new MoveOperation(dest, src, conditional, setFlags));
 		it->setUnpackMode(UNPACK_CHAR_TO_INT_ZEXT);
 	}
+	else if(dest.type.getScalarBitCount() == 32 && src.hasType(ValueType::LOCAL) && src.type.getScalarBitCount() == 8)
+	{
+		//the local is fixed to register-file A by the register-allocation, the move can later be folded into the instruction using the value
+		it.emplace(new MoveOperation(dest, src, conditional, setFlags));
+		it->setUnpackMode(UNPACK_CHAR_TO_INT_ZEXT);
+	}
 	else if(allowLiteral)
 	{
 		it.emplace(new Operation(OP_AND, dest, src, Value(Literal(src.type.getScalarWidthMask()), TYPE_INT32), conditional, setFlags));
@@ -77,6 +85,13 @@ InstructionWalker intermediate::insertSignExtension(InstructionWalker it, Method
 		it.emplace(new MoveOperation(dest, src, conditional, setFlags));
 		it->setUnpackMode(UNPACK_SHORT_TO_INT_SEXT);
 	}
+	else if(dest.type.getScalarBitCount() == 32 && src.hasType(ValueType::LOCAL) && src.type.getScalarBitCount() == 16)
+	{
+		//the local is fixed to register-file A by the register-allocation, the move can later be folded into the instruction using the value
+		//NOTE: there is no unpack-mode sign-extending 8-bit values
+		it.emplace(new MoveOperation(dest, src, conditional, setFlags));
+		it->setUnpackMode(UNPACK_SHORT_TO_INT_SEXT);
+	}
 	else
 	{
 
@@ -102,39 +117,74 @@ InstructionWalker intermediate::insertSignExtension(InstructionWalker it, Method
     return it;
 }
 
-InstructionWalker intermediate::insertSaturation(InstructionWalker it, Method& method, const Value& src, const Value& dest, bool isSigned)
+InstructionWalker intermediate::insertSaturation(InstructionWalker it, Method& method, const Value& src, const Value& dest, bool isSigned, bool isSourceSigned)
 {
 	//saturation = clamping to min/max of type
 	//-> dest = max(min(src, destType.max), destType.min)
 	//-> or via pack-modes
 
-	if(dest.type.complexType || dest.type.isFloatingType())
+	if(dest.type.isComplexType() || dest.type.isFloatingType())
 		throw CompilationError(CompilationStep::GENERAL, "Invalid target type for saturation", dest.type.to_string());
 
 	if(src.hasType(ValueType::LITERAL))
 	{
+		//unsigned literals with the high bit set may be stored as negative values
+		const int64_t value = isSourceSigned || src.type.getScalarBitCount() > 32 ? src.literal.integer : static_cast<int64_t>(static_cast<uint64_t>(src.literal.integer) & src.type.getScalarWidthMask());
 		switch(dest.type.getScalarBitCount())
 		{
 			case 8:
-				return it.emplace(new MoveOperation(dest, Value(Literal(isSigned ? saturate<int8_t>(src.literal.integer) : saturate<uint8_t>(src.literal.integer)), dest.type)));
+				return it.emplace(new MoveOperation(dest, Value(Literal(isSigned ? saturate<int8_t>(value) : saturate<uint8_t>(value)), dest.type)));
 			case 16:
-				return it.emplace(new MoveOperation(dest, Value(Literal(isSigned ? saturate<int16_t>(src.literal.integer) : saturate<uint16_t>(src.literal.integer)), dest.type)));
+				return it.emplace(new MoveOperation(dest, Value(Literal(isSigned ? saturate<int16_t>(value) : saturate<uint16_t>(value)), dest.type)));
 			case 32:
-				return it.emplace(new MoveOperation(dest, Value(Literal(isSigned ? saturate<int32_t>(src.literal.integer) : saturate<uint32_t>(src.literal.integer)), dest.type)));
+				return it.emplace(new MoveOperation(dest, Value(Literal(isSigned ? saturate<int32_t>(value) : saturate<uint32_t>(value)), dest.type)));
 			default:
 				throw CompilationError(CompilationStep::GENERAL, "Invalid target type for saturation", dest.type.to_string());
 		}
 	}
+	else if(!isSourceSigned)
+	{
+		//the pack-modes and min/max interpret the source as signed, so unsigned values with the high bit set would be clamped to the lower bound.
+		//Instead, unsigned values only need to be clamped to the upper bound 2^n - 1, if any of their bits above n are set
+		const unsigned numBits = dest.type.getScalarBitCount() - (isSigned ? 1 : 0);
+		if(numBits >= src.type.getScalarBitCount())
+			return it.emplace(new MoveOperation(dest, src));
+		it.emplace(new Operation(OP_SHR, NOP_REGISTER, src, Value(Literal(static_cast<int64_t>(numBits)), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(dest, Value(Literal((static_cast<int64_t>(1) << numBits) - 1), TYPE_INT32), COND_ZERO_CLEAR));
+		it.nextInBlock();
+		return it.emplace(new MoveOperation(dest, src, COND_ZERO_SET));
+	}
 	else	//saturation can be easily done via pack-modes
 	{
 		if(dest.type.getScalarBitCount() == 8 && !isSigned)
 			return it.emplace((new MoveOperation(dest, src))->setPackMode(PACK_INT_TO_UNSIGNED_CHAR_SATURATE));
 		else if(dest.type.getScalarBitCount() == 16 && isSigned)
 			return it.emplace((new MoveOperation(dest, src))->setPackMode(PACK_INT_TO_SIGNED_SHORT_SATURATE));
-		else if(dest.type.getScalarBitCount() == 32)
+		else if(dest.type.getScalarBitCount() == 32 && isSigned)
 			return it.emplace((new MoveOperation(dest, src))->setPackMode(PACK_32_32));
-		//TODO need to saturate manually
-		throw CompilationError(CompilationStep::GENERAL, "Saturation to this type is not yet supported", dest.type.to_string());
+		else if(dest.type.getScalarBitCount() == 32)
+			//only negative values need to be clamped
+			return it.emplace(new Operation(OP_MAX, dest, src, INT_ZERO));
+		//there are no pack-modes for signed char and unsigned short, so saturate manually
+		int64_t minValue = 0;
+		int64_t maxValue = 0;
+		if(dest.type.getScalarBitCount() == 8)
+		{
+			minValue = std::numeric_limits<int8_t>::min();
+			maxValue = std::numeric_limits<int8_t>::max();
+		}
+		else if(dest.type.getScalarBitCount() == 16)
+		{
+			minValue = std::numeric_limits<uint16_t>::min();
+			maxValue = std::numeric_limits<uint16_t>::max();
+		}
+		else
+			throw CompilationError(CompilationStep::GENERAL, "Invalid target type for saturation", dest.type.to_string());
+		const Value tmp = method.addNewLocal(TYPE_INT32.toVectorType(src.type.num), "%saturate");
+		it.emplace(new Operation(OP_MIN, tmp, src, Value(Literal(maxValue), TYPE_INT32)));
+		it.nextInBlock();
+		return it.emplace(new Operation(OP_MAX, dest, tmp, Value(Literal(minValue), TYPE_INT32)));
 	}
 }
 
@@ -17,7 +17,12 @@ namespace vc4c
 				SetFlag::DONT_SET);
 		InstructionWalker insertSignExtension(InstructionWalker it, Method& method, const Value& src, const Value& dest, bool allowLiteral, ConditionCode conditional = COND_ALWAYS, SetFlag setFlags =
 				SetFlag::DONT_SET);
-		InstructionWalker insertSaturation(InstructionWalker it, Method& method, const Value& src, const Value& dest, bool isSigned);
+		/*
+		 * Saturates the source to the range of the destination type.
+		 *
+		 * isSigned determines the signedness of the destination, isSourceSigned whether the source is interpreted as signed or unsigned integer
+		 */
+		InstructionWalker insertSaturation(InstructionWalker it, Method& method, const Value& src, const Value& dest, bool isSigned, bool isSourceSigned);
 		InstructionWalker insertTruncate(InstructionWalker it, Method& method, const Value& src, const Value& dest);
 		InstructionWalker insertFloatingPointConversion(InstructionWalker it, Method& method, const Value& src, const Value& dest);
 	} /* namespace intermediate */
@@ -6,11 +6,10 @@
 
 #include "Intrinsics.h"
 
+#include "../analysis/ValueRange.h"
 #include "../intermediate/Helper.h"
 #include "../intermediate/TypeConversions.h"
 #include "../periphery/SFU.h"
-#include "../periphery/TMU.h"
-#include "../periphery/VPM.h"
 
 #include "Comparisons.h"
 #include "Images.h"
@@ -166,22 +165,24 @@ static IntrinsicFunction intrinsifyDMAAccess(DMAAccess access)
 			case DMAAccess::READ:
 			{
 				logging::debug() << "Intrinsifying memory read " << callSite->to_string() << logging::endl;
-				it = periphery::insertReadVectorFromTMU(method, it, callSite->getOutput().value(), callSite->getArgument(0).value());
+				it.emplace(new MemoryInstruction(MemoryOperation::READ, callSite->getOutput().value(), callSite->getArgument(0).value()));
+				it.nextInBlock();
 				break;
 			}
 			case DMAAccess::WRITE:
 			{
 				logging::debug() << "Intrinsifying memory write " << callSite->to_string() << logging::endl;
-				it = periphery::insertWriteDMA(method, it, callSite->getArgument(1).value(), callSite->getArgument(0).value(), false);
+				it.emplace(new MemoryInstruction(MemoryOperation::WRITE, callSite->getArgument(0).value(), callSite->getArgument(1).value(), INT_ONE, false));
+				it.nextInBlock();
 				break;
 			}
 			case DMAAccess::COPY:
 			{
-				logging::debug() << "Intrinsifying ternary '" << callSite->to_string() << "' to DMA copy operation " << logging::endl;
-				const DataType type = callSite->getArgument(0)->type.getElementType();
+				logging::debug() << "Intrinsifying ternary '" << callSite->to_string() << "' to memory copy operation " << logging::endl;
 				if(!callSite->getArgument(2) || !callSite->getArgument(2)->hasType(ValueType::LITERAL))
 					throw CompilationError(CompilationStep::OPTIMIZER, "Memory copy with non-constant size is not yet supported", callSite->to_string());
-				it = method.vpm->insertCopyRAM(method, it, callSite->getArgument(0).value(), callSite->getArgument(1).value(), callSite->getArgument(2)->literal.integer * type.getPhysicalWidth(), nullptr, false);
+				it.emplace(new MemoryInstruction(MemoryOperation::COPY, callSite->getArgument(0).value(), callSite->getArgument(1).value(), callSite->getArgument(2).value(), false));
+				it.nextInBlock();
 				break;
 			}
 			case DMAAccess::PREFETCH:
@@ -469,6 +470,12 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
             logging::debug() << "Intrinsifying multiplication of small integers to mul24" << logging::endl;
             op->setOpCode(OP_MUL24);
         }
+        else if(analysis::ValueRange::getValueRange(arg0, method).fitsIntoUnsignedBits(24) && analysis::ValueRange::getValueRange(arg1, method).fitsIntoUnsignedBits(24))
+        {
+            //mul24 calculates the lower 32 bits of the product correctly, as long as both operands fit into 24 bits
+            logging::debug() << "Intrinsifying multiplication of integers with small value-range to mul24" << logging::endl;
+            op->setOpCode(OP_MUL24);
+        }
         else
         {
             it = intrinsifySignedIntegerMultiplication(method, it, *op);
@@ -598,7 +605,9 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     	{
     		//let pack-mode handle saturation
     		logging::debug() << "Intrinsifying saturated truncate with move and pack-mode" << logging::endl;
-    		it = insertSaturation(it, method, op->getFirstArg(), op->getOutput().value(), !has_flag(op->decoration, InstructionDecorations::UNSIGNED_RESULT));
+    		//the saturated truncation does not change the signedness (e.g. OpUConvert/OpSConvert with SaturatedConversion decoration)
+    		const bool isSigned = !has_flag(op->decoration, InstructionDecorations::UNSIGNED_RESULT);
+    		it = insertSaturation(it, method, op->getFirstArg(), op->getOutput().value(), isSigned, isSigned);
     		it.nextInBlock();
     		it.erase();
     	}
@@ -776,7 +785,7 @@ static InstructionWalker intrinsifyReadWorkItemInfo(Method& method, InstructionW
 	const Value tmp1 = method.addNewLocal(TYPE_INT32, "%local_info");
 	it.emplace(new Operation(OP_SHR, tmp1, itemInfo->createReference(), tmp0));
 	it.nextInBlock();
-	return it.reset((new Operation(OP_AND, it->getOutput().value(), tmp1, Value(Literal(static_cast<int64_t>(0xFF)), TYPE_INT8)))->copyExtrasFrom(it.get()));
+	return it.reset((new Operation(OP_AND, it->getOutput().value(), tmp1, Value(Literal(static_cast<int64_t>(0xFF)), TYPE_INT8)))->copyExtrasFrom(it.get())->setDecorations(decoration));
 }
 
 static InstructionWalker intrinsifyWorkItemFunctions(Method& method, InstructionWalker it)
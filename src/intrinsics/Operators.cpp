@@ -6,12 +6,14 @@
 
 #include "Operators.h"
 
+#include "../analysis/ValueRange.h"
 #include "../intermediate/Helper.h"
 #include "../periphery/SFU.h"
 #include "Comparisons.h"
 #include "helper.h"
 #include "log.h"
 
+#include <algorithm>
 #include <bitset>
 #include <cmath>
 
@@ -20,6 +22,27 @@ using namespace vc4c::intermediate;
 
 //TODO reorder instructions, so no/less NOPs are inserted (and again reordered away)
 
+//the integer operands of divisions via floating-point operations need to fit into the mantissa (the remainder of the estimated quotient may grow a bit larger)
+static constexpr unsigned FLOAT_DIVISION_BITS = 23;
+
+static bool canDivideUnsignedViaFloat(Method& method, const Value& arg)
+{
+	//types with less bits can be masked to the bits of their type
+	return arg.type.getScalarBitCount() <= 16 || analysis::ValueRange::getValueRange(arg, method).fitsIntoUnsignedBits(FLOAT_DIVISION_BITS);
+}
+
+static Value maskForFloatDivision(Method& method, InstructionWalker& it, const Value& arg)
+{
+	const unsigned numBits = std::min(static_cast<unsigned>(arg.type.getScalarBitCount()), FLOAT_DIVISION_BITS);
+	if(analysis::ValueRange::getValueRange(arg, method).fitsIntoUnsignedBits(numBits))
+		return arg;
+	//the upper bits of the register of types with less than 32 bits are not guaranteed to be zero
+	const Value tmp = method.addNewLocal(arg.type, "%udiv.masked");
+	it.emplace(new Operation(OP_AND, tmp, arg, Value(Literal(static_cast<int64_t>((1 << numBits) - 1)), TYPE_INT32)));
+	it.nextInBlock();
+	return tmp;
+}
+
 InstructionWalker intermediate::intrinsifySignedIntegerMultiplication(Method& method, InstructionWalker it, Operation& op)
 {
 	Value opDest = op.getOutput().value();
@@ -42,7 +65,14 @@ InstructionWalker intermediate::intrinsifySignedIntegerMultiplication(Method& me
 	op.setOutput(tmpDest);
 
 	//do unsigned multiplication
-	it = intrinsifyUnsignedIntegerMultiplication(method, it, op);
+	if(analysis::ValueRange::getValueRange(arg0, method).absoluteFitsIntoBits(24) && analysis::ValueRange::getValueRange(arg1, method).absoluteFitsIntoBits(24))
+	{
+		//the positive operands fit into 24 bits, so a single mul24 is enough
+		logging::debug() << "Intrinsifying unsigned multiplication of integers with small value-range to mul24" << logging::endl;
+		op.setOpCode(OP_MUL24);
+	}
+	else
+		it = intrinsifyUnsignedIntegerMultiplication(method, it, op);
 	//skip the original instruction
 	it.nextInBlock();
 
@@ -101,6 +131,14 @@ InstructionWalker intermediate::intrinsifyUnsignedIntegerMultiplication(Method&
 		it.emplace(new MoveOperation(a0, Value(Literal(static_cast<int64_t>(arg0.literal.integer >> 16)), TYPE_INT16)));
 		it.nextInBlock();
     }
+    else if(analysis::ValueRange::getValueRange(arg0, method).fitsIntoUnsignedBits(16))
+    {
+        //the upper part is known to be zero
+        hasA0Part = false;
+        hasA1Part = true;
+        it.emplace(new MoveOperation(a1, arg0));
+        it.nextInBlock();
+    }
     else
     {
         hasA0Part = true;   //not known
@@ -119,6 +157,14 @@ InstructionWalker intermediate::intrinsifyUnsignedIntegerMultiplication(Method&
         it.emplace(new MoveOperation(b0, Value(Literal(static_cast<int64_t>(arg1.literal.integer >> 16)), TYPE_INT8)));
         it.nextInBlock();
     }
+    else if(analysis::ValueRange::getValueRange(arg1, method).fitsIntoUnsignedBits(16))
+    {
+        //the upper part is known to be zero
+        hasB0Part = false;
+        hasB1Part = true;
+        it.emplace(new MoveOperation(b1, arg1));
+        it.nextInBlock();
+    }
     else
     {
         //not known
@@ -184,6 +230,11 @@ InstructionWalker intermediate::intrinsifyUnsignedIntegerMultiplication(Method&
 InstructionWalker intermediate::intrinsifySignedIntegerDivision(Method& method, InstructionWalker it, Operation& op, const bool useRemainder)
 {
 	Value opDest = op.getOutput().value();
+	//the absolute values of types with at most 16 bits always fit into the floating-point mantissa
+	const bool divideViaFloat = std::all_of(op.getArguments().begin(), op.getArguments().end(), [&method](const Value& arg) -> bool
+	{
+		return arg.type.getScalarBitCount() <= 16 || analysis::ValueRange::getValueRange(arg, method).absoluteFitsIntoBits(FLOAT_DIVISION_BITS);
+	});
 	//check any operand is negative
 	Value op1Sign = method.addNewLocal(TYPE_BOOL, "%sign");
 	Value op2Sign = method.addNewLocal(TYPE_BOOL, "%sign");
@@ -209,12 +260,23 @@ InstructionWalker intermediate::intrinsifySignedIntegerDivision(Method& method,
 	op.setOutput(tmpDest);
     
     //calculate unsigned division
-    it = intrinsifyUnsignedIntegerDivision(method, it, op, useRemainder);
+    if(divideViaFloat)
+    	it = intrinsifyUnsignedIntegerDivisionViaFloat(method, it, op, useRemainder);
+    else
+    	it = intrinsifyUnsignedIntegerDivision(method, it, op, useRemainder);
     it.nextInBlock();
     
     //if exactly one operand was negative, invert sign of result
-	it.emplace(new Operation(OP_XOR, NOP_REGISTER, op1Sign, op2Sign, COND_ALWAYS, SetFlag::SET_FLAGS));
-	it.nextInBlock();
+    //the remainder has the sign of the numerator
+    if(useRemainder)
+    {
+        it.emplace(new MoveOperation(NOP_REGISTER, op1Sign, COND_ALWAYS, SetFlag::SET_FLAGS));
+    }
+    else
+    {
+        it.emplace(new Operation(OP_XOR, NOP_REGISTER, op1Sign, op2Sign, COND_ALWAYS, SetFlag::SET_FLAGS));
+    }
+    it.nextInBlock();
 	it = insertInvertSign(it, method, tmpDest, opDest, COND_ZERO_CLEAR);
 	return it;
 }
@@ -223,27 +285,56 @@ InstructionWalker intermediate::intrinsifyUnsignedIntegerDivision(Method& method
 {
     //https://en.wikipedia.org/wiki/Division_algorithm#Integer_division_.28unsigned.29_with_remainder
 	//see also: https://www.microsoft.com/en-us/research/wp-content/uploads/2008/08/tr-2008-141.pdf
-	//TODO for |type| < 24, use floating-point division??
 	//NOTE: the instructions are ordered in a way, that the insertion of NOPs to split read-after-write is minimal
     const Value& numerator = op.getFirstArg();
     const Value& divisor = op.getSecondArg().value_or(UNDEFINED_VALUE);
+
+    //for operands fitting into the floating-point mantissa, the division via the reciprocal is much shorter
+    if(canDivideUnsignedViaFloat(method, numerator) && canDivideUnsignedViaFloat(method, divisor))
+    {
+    	op.setArgument(0, maskForFloatDivision(method, it, numerator));
+    	op.setArgument(1, maskForFloatDivision(method, it, divisor));
+    	return intrinsifyUnsignedIntegerDivisionViaFloat(method, it, op, useRemainder);
+    }
     
     logging::debug() << "Intrinsifying division of unsigned integers" << logging::endl;
     
     //TODO divisor = 0 handling!
+
+    //the leading bits of the numerator known to be zero do not need to be handled
+    int numBits = numerator.type.getScalarBitCount();
+    const analysis::ValueRange numeratorRange = analysis::ValueRange::getValueRange(numerator, method);
+    while(numBits > 1 && numeratorRange.fitsIntoUnsignedBits(numBits - 1))
+    	--numBits;
+    //for a divisor of at least 2^m, the first m iterations only shift the leading bits of the numerator into the remainder
+    //(the upper bits of the register of types with less than 32 bits are not guaranteed to be zero, so they need to be known to be zero)
+    int numShiftedBits = 0;
+    if(numBits == 32 || numeratorRange.fitsIntoUnsignedBits(numBits))
+    {
+    	const analysis::ValueRange divisorRange = analysis::ValueRange::getValueRange(divisor, method);
+    	while(numShiftedBits < numBits && divisorRange.minValue >= (int64_t(1) << (numShiftedBits + 1)))
+    		++numShiftedBits;
+    }
     
     //Q := 0                 -- initialize quotient and remainder to zero
     //R := 0      
     Value quotient = method.addNewLocal(op.getOutput()->type, "%udiv.quotient");
     Value remainder = method.addNewLocal(op.getOutput()->type, "%udiv.remainder");
-    //set explicitly to zero
-	it.emplace( new MoveOperation(remainder, INT_ZERO));
-	it.nextInBlock();
+    //set explicitly to zero (or to the leading bits of the numerator, which are skipped)
+    if(numShiftedBits > 0)
+    {
+        it.emplace( new Operation(OP_SHR, remainder, numerator, Value(Literal(static_cast<int64_t>(numBits - numShiftedBits)), TYPE_INT8)));
+    }
+    else
+    {
+        it.emplace( new MoveOperation(remainder, INT_ZERO));
+    }
+    it.nextInBlock();
 	it.emplace( new MoveOperation(quotient, INT_ZERO));
 	it.nextInBlock();
 
     //for i := n ? 1 ... 0 do     -- where n is number of bits in N
-    for(int i = numerator.type.getScalarBitCount() - 1; i >= 0; --i)
+    for(int i = numBits - numShiftedBits - 1; i >= 0; --i)
     {
         //R := R << 1          -- left-shift R by 1 bit
     	Value newRemainder = method.addNewLocal(op.getOutput()->type, "%udiv.remainder");
@@ -302,6 +393,113 @@ InstructionWalker intermediate::intrinsifyUnsignedIntegerDivision(Method& method
     return it;
 }
 
+InstructionWalker intermediate::intrinsifyUnsignedIntegerDivisionViaFloat(Method& method, InstructionWalker it, Operation& op, const bool useRemainder)
+{
+	/*
+	 * Since both operands fit into the mantissa, they can be converted to floating-point values without loss of precision.
+	 * The quotient calculated via the reciprocal of the divisor (with a single Newton-Raphson step) is off by a few at most,
+	 * so a second estimation from the remainder and a final correction step yield the exact quotient and remainder.
+	 */
+	const Value numerator = op.getFirstArg();
+	const Value divisor = op.getSecondArg().value();
+	const DataType intType = op.getOutput()->type;
+	const DataType floatType = TYPE_FLOAT.toVectorType(intType.num);
+
+	logging::debug() << "Intrinsifying division of unsigned integers via floating-point reciprocal" << logging::endl;
+
+	const Value numeratorFloat = method.addNewLocal(floatType, "%udiv.numerator");
+	const Value divisorFloat = method.addNewLocal(floatType, "%udiv.divisor");
+	it.emplace(new Operation(OP_ITOF, numeratorFloat, numerator));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ITOF, divisorFloat, divisor));
+	it.nextInBlock();
+	const Value recip = method.addNewLocal(floatType, "%udiv.recip");
+	it = periphery::insertSFUCall(REG_SFU_RECIP, it, divisorFloat);
+	it.emplace(new MoveOperation(recip, Value(REG_SFU_OUT, floatType)));
+	it.nextInBlock();
+	//one Newton-Raphson step: P1 = P0(2 - D * P0)
+	const Value recipTmp0 = method.addNewLocal(floatType, "%udiv.recip");
+	const Value recipTmp1 = method.addNewLocal(floatType, "%udiv.recip");
+	const Value recipFinal = method.addNewLocal(floatType, "%udiv.recip");
+	it.emplace(new Operation(OP_FMUL, recipTmp0, divisorFloat, recip));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_FSUB, recipTmp1, Value(Literal(2.0), TYPE_FLOAT), recipTmp0));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_FMUL, recipFinal, recip, recipTmp1));
+	it.nextInBlock();
+
+	//first estimation: Q0 = ftoi(N * P1)
+	const Value quotientFloat = method.addNewLocal(floatType, "%udiv.quotient");
+	const Value quotient0 = method.addNewLocal(intType, "%udiv.quotient");
+	it.emplace(new Operation(OP_FMUL, quotientFloat, numeratorFloat, recipFinal));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_FTOI, quotient0, quotientFloat));
+	it.nextInBlock();
+	//second estimation: Q1 = max(Q0 + ftoi((N - Q0 * D) * P1), 0)
+	const Value product0 = method.addNewLocal(intType, "%udiv.product");
+	const Value remainder0 = method.addNewLocal(intType, "%udiv.remainder");
+	const Value remainderFloat = method.addNewLocal(floatType, "%udiv.remainder");
+	const Value deltaFloat = method.addNewLocal(floatType, "%udiv.delta");
+	const Value delta = method.addNewLocal(intType, "%udiv.delta");
+	const Value quotientTmp = method.addNewLocal(intType, "%udiv.quotient");
+	const Value quotient1 = method.addNewLocal(intType, "%udiv.quotient");
+	it.emplace(new Operation(OP_MUL24, product0, quotient0, divisor));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_SUB, remainder0, numerator, product0));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ITOF, remainderFloat, remainder0));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_FMUL, deltaFloat, remainderFloat, recipFinal));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_FTOI, delta, deltaFloat));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ADD, quotientTmp, quotient0, delta));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_MAX, quotient1, quotientTmp, INT_ZERO));
+	it.nextInBlock();
+
+	//correction: Q1 is off by at most one
+	const Value product1 = method.addNewLocal(intType, "%udiv.product");
+	const Value remainder1 = method.addNewLocal(intType, "%udiv.remainder");
+	it.emplace(new Operation(OP_MUL24, product1, quotient1, divisor));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_SUB, remainder1, numerator, product1, COND_ALWAYS, SetFlag::SET_FLAGS));
+	it.nextInBlock();
+	//if R < 0 then Q := Q - 1, R := R + D
+	const Value quotient2 = method.addNewLocal(intType, "%udiv.quotient");
+	const Value remainder2 = method.addNewLocal(intType, "%udiv.remainder");
+	it.emplace(new Operation(OP_SUB, quotient2, quotient1, INT_ONE, COND_NEGATIVE_SET));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(quotient2, quotient1, COND_NEGATIVE_CLEAR));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ADD, remainder2, remainder1, divisor, COND_NEGATIVE_SET));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(remainder2, remainder1, COND_NEGATIVE_CLEAR));
+	it.nextInBlock();
+	//if R >= D then Q := Q + 1, R := R - D
+	const Value remainderTmp = method.addNewLocal(intType, "%udiv.remainder");
+	const Value quotient3 = method.addNewLocal(intType, "%udiv.quotient");
+	const Value remainder3 = method.addNewLocal(intType, "%udiv.remainder");
+	it.emplace(new Operation(OP_SUB, remainderTmp, remainder2, divisor, COND_ALWAYS, SetFlag::SET_FLAGS));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ADD, quotient3, quotient2, INT_ONE, COND_NEGATIVE_CLEAR));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(quotient3, quotient2, COND_NEGATIVE_SET));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(remainder3, remainderTmp, COND_NEGATIVE_CLEAR));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(remainder3, remainder2, COND_NEGATIVE_SET));
+	it.nextInBlock();
+
+	//make move from original instruction
+	op.setOpCode(OP_OR);
+	op.decoration = add_flag(op.decoration, InstructionDecorations::UNSIGNED_RESULT);
+	op.setArgument(0, useRemainder ? remainder3 : quotient3);
+	op.setArgument(1, useRemainder ? remainder3 : quotient3);
+
+	return it;
+}
+
 InstructionWalker intermediate::intrinsifySignedIntegerDivisionByConstant(Method& method, InstructionWalker it, Operation& op, bool useRemainder)
 {
 	Value opDest = op.getOutput().value();
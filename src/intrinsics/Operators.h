@@ -17,6 +17,11 @@ namespace vc4c
 		InstructionWalker intrinsifyUnsignedIntegerMultiplication(Method& method, InstructionWalker it, Operation& op);
 		InstructionWalker intrinsifySignedIntegerDivision(Method& method, InstructionWalker it, Operation& op, bool useRemainder = false);
 		InstructionWalker intrinsifyUnsignedIntegerDivision(Method& method, InstructionWalker it, Operation& op, bool useRemainder = false);
+		/*
+		 * Calculates the unsigned division via the floating-point reciprocal of the divisor.
+		 * NOTE: Both operands need to fit into 23 bits
+		 */
+		InstructionWalker intrinsifyUnsignedIntegerDivisionViaFloat(Method& method, InstructionWalker it, Operation& op, bool useRemainder = false);
 		InstructionWalker intrinsifySignedIntegerDivisionByConstant(Method& method, InstructionWalker it, Operation& op, bool useRemainder = false);
 		InstructionWalker intrinsifyUnsignedIntegerDivisionByConstant(Method& method, InstructionWalker it, Operation& op, bool useRemainder = false);
 
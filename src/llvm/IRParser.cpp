@@ -126,15 +126,30 @@ void IRParser::parse(Module& module)
 	this->module = &module;
     const std::string declarationKeyword = "declare";
     const std::string methodKeyword = "define";
+    bool hasUnresolvedStructs = false;
+    const auto resolveStructTypes = [&]()
+	{
+		if(!hasUnresolvedStructs)
+			return;
+		//struct definitions allow forward references, so we need to re-resolve them here.
+		//Since types are immutable, this needs to be done before any global or method uses them, otherwise they would keep the unresolved types
+		for(auto& pair : complexTypes)
+		{
+			pair.second = resolveStructType(pair.second);
+		}
+		hasUnresolvedStructs = false;
+	};
     while (scanner.hasInput()) {
         Token nextToken{};
         do {
             nextToken = scanner.peek();
             if (nextToken.hasValue('%')) {
                 complexTypes.emplace(nextToken.getText().value(), parseStructDefinition());
+                hasUnresolvedStructs = true;
             }
             if (nextToken.hasValue('@')) {
                 //read global
+            	resolveStructTypes();
                 parseGlobalData();
             }
             else if (nextToken.hasValue(declarationKeyword)) {
@@ -147,20 +162,7 @@ void IRParser::parse(Module& module)
                 scanner.pop();
         }
         while (scanner.hasInput() && !nextToken.hasValue(methodKeyword));
-        //struct definitions allow forward references, so we need to re-resolve them here
-        for(auto& pair : complexTypes)
-        {
-        	if(pair.second.getStructType())
-        	{
-        		for(DataType& childType : pair.second.getStructType().value()->elementTypes)
-        		{
-        			if(childType.complexType == nullptr && complexTypes.find(childType.typeName) != complexTypes.end())
-        			{
-        				childType = complexTypes.at(childType.typeName);
-        			}
-        		}
-        	}
-        }
+        resolveStructTypes();
         if (!scanner.hasInput()) {
             break;
         }
@@ -289,13 +291,11 @@ DataType IRParser::parseType()
     }
     //correct i1 to bool
     if(typeName.compare("i1") == 0)
-    	typeName = TYPE_BOOL.typeName;
+    	typeName = TYPE_BOOL.getBaseName();
     DataType type = TYPE_UNKNOWN;
     if(isArray)
     {
-    	type.num = 1;
-    	type.complexType.reset(new ArrayType{childType, num});
-    	type.typeName = (childType.to_string() + "[") + std::to_string(num) +"]";
+    	type = childType.toArrayType(num);
     }
     else if(isVector)
     {
@@ -305,12 +305,11 @@ DataType IRParser::parseType()
     else //scalar or complex type
     	type = DataType(typeName, static_cast<uint8_t>(num));
     if(complexTypes.find(typeName) != complexTypes.end())
-    	type.complexType = complexTypes.at(typeName).complexType;
+    	type = complexTypes.at(typeName);
     for(unsigned i = 0; i < numPointerTypes; ++i)
     {
     	//wrap in pointer type
-    	std::shared_ptr<ComplexType> elementType(new PointerType(type, addressSpace.value_or(AddressSpace::PRIVATE)));
-    	type = DataType(type.to_string() + "*", 1, elementType);
+    	type = type.toPointerType(addressSpace.value_or(AddressSpace::PRIVATE));
     }
     return type;
 }
@@ -440,12 +439,8 @@ DataType IRParser::parseStructDefinition()
     std::string name(scanner.pop().getText().value());
     expectSkipToken(scanner, '=');
     expectSkipToken(scanner, "type");
-    DataType type;
-    type.typeName = name;
-    type.complexType.reset(new StructType({}));
-    if (skipToken(scanner, '<')) {
-        type.getStructType().value()->isPacked = true;
-    }
+    std::vector<DataType> elementTypes;
+    const bool isPacked = skipToken(scanner, '<');
     if(skipToken(scanner, "opaque"))
     {
     	//e.g. "%struct.Node.0 = type opaque"
@@ -456,20 +451,43 @@ DataType IRParser::parseStructDefinition()
 		{
 			//pops initial '{' and following ','s
 			scanner.pop();
-			type.getStructType().value()->elementTypes.push_back(parseType());
+			elementTypes.push_back(parseType());
 		}
 		while (scanner.peek().hasValue(','));
 		expectSkipToken(scanner, '}');
     }
-    if (type.getStructType().value()->isPacked) {
+    if (isPacked) {
     	expectSkipToken(scanner, '>');
     }
+    const DataType type = DataType::createStructType(name, elementTypes, isPacked);
     logging::debug() << "Struct type: " << type.to_string() << (type.getStructType().value()->isPacked ? " (packed)" : "") << logging::endl;
     if(!type.getStructType().value()->elementTypes.empty())
     	logging::debug() << "with elements: " << to_string<DataType>(type.getStructType().value()->elementTypes) << logging::endl;
     return type;
 }
 
+DataType IRParser::resolveStructType(const DataType& type) const
+{
+	//since types are immutable, the struct (and all structs containing it) need to be re-created with the resolved element-types
+	if(!type.getStructType())
+		return type;
+	std::vector<DataType> elementTypes = type.getStructType().value()->elementTypes;
+	bool anyResolved = false;
+	for(DataType& childType : elementTypes)
+	{
+		DataType resolvedType = childType;
+		if(!childType.isComplexType() && complexTypes.find(childType.getBaseName()) != complexTypes.end())
+			resolvedType = resolveStructType(complexTypes.at(childType.getBaseName()));
+		else
+			resolvedType = resolveStructType(childType);
+		anyResolved = anyResolved || resolvedType != childType;
+		childType = resolvedType;
+	}
+	if(!anyResolved)
+		return type;
+	return DataType::createStructType(type.getBaseName(), elementTypes, type.getStructType().value()->isPacked);
+}
+
 static void skipLinkage(Scanner& scanner)
 {
 	//http://llvm.org/docs/LangRef.html#linkage
@@ -874,10 +892,7 @@ void IRParser::parseAssignment(LLVMMethod& method, FastModificationList<std::uni
         	const Value numEntries = parseValue();
         	if(!numEntries.hasType(ValueType::LITERAL))
         		throw CompilationError(CompilationStep::PARSER, "Cannot allocate a non-constant number of entries", numEntries.to_string());
-        	const DataType childType = type;
-        	type.num = 1;
-			type.complexType.reset(new ArrayType{childType, static_cast<unsigned>(numEntries.literal.integer)});
-			type.typeName = (childType.to_string() + "[") + std::to_string(numEntries.literal.integer) +"]";
+        	type = type.toArrayType(static_cast<unsigned>(numEntries.literal.integer));
         }
         std::size_t alignment = 1;
         skipToken(scanner, ',');
@@ -1641,9 +1656,10 @@ void IRParser::extractKernelInfo()
             	{
             		for(std::size_t i = 0; i < values.size(); ++i)
             		{
-            			Optional<PointerType*> ptrType = method.method->parameters.at(i).type.getPointerType();
+            			Parameter& param = method.method->parameters.at(i);
+            			const Optional<const PointerType*> ptrType = param.type.getPointerType();
             			if(ptrType && ptrType.value()->addressSpace == AddressSpace::GENERIC)
-            				ptrType.value()->addressSpace = toAddressSpace(std::atoi(values.at(i).data()));
+            				param.setType(ptrType.value()->elementType.toPointerType(toAddressSpace(std::atoi(values.at(i).data())), ptrType.value()->alignment));
             		}
             		break;
             	}
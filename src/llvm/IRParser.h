@@ -55,6 +55,7 @@ namespace vc4c
 			Value toValue(const Token& token, const DataType& type = { "" });
 			Value parseValue(bool withType = true, const DataType& typeArg = TYPE_UNKNOWN);
 			DataType parseStructDefinition();
+			DataType resolveStructType(const DataType& type) const;
 			std::vector<Value> parseIndices();
 
 			bool parseGlobalData();
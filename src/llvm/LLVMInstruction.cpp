@@ -8,8 +8,6 @@
 
 #include "../intermediate/IntermediateInstruction.h"
 #include "../intermediate/Helper.h"
-#include "../periphery/TMU.h"
-#include "../periphery/VPM.h"
 #include "config.h"
 #include "log.h"
 
@@ -159,7 +157,7 @@ bool CallSite::mapInstruction(Method& method) const
     	//FIXME for now skip unsupported case, since errors here seem to crash the test-runner, but errors later on dont??
     	//@llvm.memcpy.p0i8.p0i8.i32(i8* <dest>, i8* <src>, i32 <len>, i32 <align>, i1 <isvolatile>)
     	logging::debug() << "Intrinsifying llvm.memcpy function-call" << logging::endl;
-    	method.vpm->insertCopyRAM(method, method.appendToEnd(), arguments.at(0), arguments.at(1), arguments.at(2).literal.integer);
+    	method.appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::COPY, arguments.at(0), arguments.at(1), arguments.at(2)));
     	return true;
     }
     if(methodName.find("llvm.memset") == 0 && arguments.at(2).hasType(ValueType::LITERAL))
@@ -169,12 +167,9 @@ bool CallSite::mapInstruction(Method& method) const
 		const Value& memAddr = arguments.at(0);
 		const Value& fillByte = arguments.at(1);
 		const Value& numBytes = arguments.at(2);
-		const Value& volatileAccess = arguments.at(4);
-		method.appendToEnd(new intermediate::MutexLock(intermediate::MutexAccess::LOCK));
 		//TODO could be optimized, write multiple bytes at once
-		method.vpm->insertWriteVPM(method.appendToEnd(), fillByte, nullptr, false);
-		method.vpm->insertFillRAM(method, method.appendToEnd(), memAddr, TYPE_INT8, numBytes.literal.integer, nullptr, false);
-		method.appendToEnd( new intermediate::MutexLock(intermediate::MutexAccess::RELEASE));
+		method.appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::FILL, memAddr, fillByte, numBytes));
+		return true;
 	}
     logging::debug() << "Generating immediate call to " << methodName << " -> " << returnType.to_string() << logging::endl;
     if(dest == nullptr)
@@ -222,12 +217,12 @@ bool Copy::mapInstruction(Method& method) const
         if(isRead)
         {
             logging::debug() << "Generating reading from " << orig.to_string() << " into " << dest.to_string() << logging::endl;
-            periphery::insertReadVectorFromTMU(method, method.appendToEnd(), dest, orig);
+            method.appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::READ, dest, orig));
         }
         else
         {
             logging::debug() << "Generating writing of " << orig.to_string() << " into " << dest.to_string() << logging::endl;
-            periphery::insertWriteDMA(method, method.appendToEnd(), orig, dest);
+            method.appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::WRITE, dest, orig));
         }
     }
     else
@@ -513,8 +508,6 @@ bool ShuffleVector::mapInstruction(Method& method) const
 {
     //shuffling = iteration over all elements in both vectors and re-ordering in order given
     logging::debug() << "Generating operations mixing " << v1.to_string() << " and " << v2.to_string() << " into " << dest.to_string() << logging::endl;
-    DataType destType = v1.type;
-    destType.num = mask.type.num;
     intermediate::insertVectorShuffle(method.appendToEnd(), method, dest, v1, v2, mask);
     return true;
 }
@@ -43,6 +43,10 @@ int main(int argc, char** argv)
         std::cerr << "\t--spirv\t\t\tExplicitely use the SPIR-V front-end" << std::endl;
         std::cerr << "\t--llvm\t\t\tExplicitely use the LLVM-IR front-end" << std::endl;
         std::cerr << "\t--disassemble\t\tDisassembles the binary input to either hex or assembler output" << std::endl;
+        std::cerr << "\t--graph-coloring\tAlways use the graph coloring register allocator" << std::endl;
+        std::cerr << "\t--linear-scan\t\tAlways use the linear-scan register allocator (default for huge kernels)" << std::endl;
+        std::cerr << "\t--threadable\t\tCompile kernels to be executed by two hardware-threads per QPU, if possible. These kernels are marked with a flag in the kernel info, which needs to be supported by VC4CL" << std::endl;
+        std::cerr << "\t--threads=<num>\t\tUse the given number of threads for compilation, 0 for the hardware concurrency (default)" << std::endl;
         std::cerr << "\tany other option is passed to the pre-compiler" << std::endl;
         return 1;
     }
@@ -79,6 +83,14 @@ int main(int argc, char** argv)
         	config.frontend = Frontend::LLVM_IR;
         else if(strcmp("--disassemble", argv[i]) == 0)
         	runDisassembler = true;
+        else if(strcmp("--graph-coloring", argv[i]) == 0)
+        	config.registerAllocator = RegisterAllocator::GRAPH_COLORING;
+        else if(strcmp("--linear-scan", argv[i]) == 0)
+        	config.registerAllocator = RegisterAllocator::LINEAR_SCAN;
+        else if(strcmp("--threadable", argv[i]) == 0)
+        	config.threadableKernels = true;
+        else if(strncmp("--threads=", argv[i], strlen("--threads=")) == 0)
+        	config.numThreads = static_cast<unsigned>(std::stoul(argv[i] + strlen("--threads=")));
         else if(strcmp("-o", argv[i]) == 0)
         {
         	outputFile = argv[i+1];
@@ -7,12 +7,15 @@
 #include "Combiner.h"
 
 #include "../InstructionWalker.h"
+#include "../Profiler.h"
+#include "../analysis/ValueRange.h"
 #include "../intermediate/Helper.h"
 #include "helper.h"
 #include "log.h"
 
 #include <algorithm>
 #include <cstdlib>
+#include <functional>
 #include <memory>
 
 using namespace vc4c;
@@ -372,9 +375,10 @@ static const std::vector<MergeCondition> mergeConditions = {
     }
 };
 
-void optimizations::combineOperations(const Module& module, Method& method, const Configuration& config)
+bool optimizations::combineOperations(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
 	//TODO can combine operation x and y if y is something like (result of x & 0xFF/0xFFFF) -> pack-mode
+	bool changedMethod = false;
 	for(BasicBlock& bb : method.getBasicBlocks())
 	{
 		auto it = bb.begin();
@@ -513,6 +517,7 @@ void optimizations::combineOperations(const Module& module, Method& method, cons
 							throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled combination, type", (instr->to_string() + ", ") + nextInstr->to_string());
 						if(it.get<CombinedOperation>() != nullptr)
 						{
+							changedMethod = true;
 							//move instruction usable on both ALUs to the free ALU
 							CombinedOperation* comb = it.get<CombinedOperation>();
 							if(comb->getFirstOp()->op.runsOnAddALU() && comb->getFirstOp()->op.runsOnMulALU())
@@ -542,6 +547,7 @@ void optimizations::combineOperations(const Module& module, Method& method, cons
 			it.nextInBlock();
 		}
 	}
+	return changedMethod;
 }
 
 static Optional<Literal> getSourceLiteral(InstructionWalker it)
@@ -578,15 +584,16 @@ static bool canReplaceLiteralLoad(InstructionWalker it, const InstructionWalker
 	return false;
 }
 
-void optimizations::combineLoadingLiterals(const Module& module, Method& method, const Configuration& config)
+bool optimizations::combineLoadingLiterals(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
+	bool changedMethod = false;
 	for(BasicBlock& block : method.getBasicBlocks())
 	{
 		FastMap<int64_t, InstructionWalker> lastLoadImmediate;
 		InstructionWalker it = block.begin();
 		while(!it.isEndOfBlock())
 		{
-			if(it->hasValueType(ValueType::LOCAL) && it->getOutput()->local->getUsers(LocalUser::Type::WRITER).size() == 1 && block.isLocallyLimited(it, it->getOutput()->local))
+			if(it->hasValueType(ValueType::LOCAL) && it->getOutput()->local->countUsers(LocalUser::Type::WRITER) == 1 && block.isLocallyLimited(it, it->getOutput()->local))
 			{
 				Optional<Literal> literal = getSourceLiteral(it);
 				if(literal)
@@ -603,6 +610,7 @@ void optimizations::combineLoadingLiterals(const Module& module, Method& method,
 							const_cast<LocalUser*>(reader)->replaceLocal(oldLocal, newLocal);
 						};
 						it.erase();
+						changedMethod = true;
 						continue;
 					}
 					else
@@ -612,9 +620,10 @@ void optimizations::combineLoadingLiterals(const Module& module, Method& method,
 			it.nextInBlock();
 		}
 	}
+	return changedMethod;
 }
 
-void optimizations::unrollWorkGroups(const Module& module, Method& method, const Configuration& config)
+bool optimizations::unrollWorkGroups(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
 	/*
 	 * Kernel Loop Optimization:
@@ -633,6 +642,7 @@ void optimizations::unrollWorkGroups(const Module& module, Method& method, const
 	const Local* loopSize = method.findOrCreateLocal(TYPE_INT32, Method::GROUP_LOOP_SIZE);
 	method.appendToEnd(new MoveOperation(loopSize->createReference(), UNIFORM_REGISTER));
 	method.appendToEnd(new Branch(startLabel, COND_ZERO_CLEAR, loopSize->createReference()));
+	return true;
 }
 
 
@@ -674,8 +684,9 @@ InstructionWalker optimizations::combineSelectionWithZero(const Module& module,
 	return it;
 }
 
-void optimizations::combineVectorRotations(const Module& module, Method& method, const Configuration& config)
+bool optimizations::combineVectorRotations(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
+	bool changedMethod = false;
 	for(BasicBlock& block : method.getBasicBlocks())
 	{
 		InstructionWalker it = block.begin();
@@ -709,6 +720,7 @@ void optimizations::combineVectorRotations(const Module& module, Method& method,
 									it.reset((new MoveOperation(rot->getOutput().value(), firstRot->getSource()))->copyExtrasFrom(rot));
 									it->copyExtrasFrom(firstRot);
 									firstIt->erase();
+									changedMethod = true;
 								}
 								else
 								{
@@ -716,6 +728,7 @@ void optimizations::combineVectorRotations(const Module& module, Method& method,
 									it.reset((new VectorRotation(rot->getOutput().value(), firstRot->getSource(), Value(SmallImmediate::fromRotationOffset(offset), TYPE_INT8)))->copyExtrasFrom(rot));
 									it->copyExtrasFrom(firstRot);
 									firstIt->erase();
+									changedMethod = true;
 								}
 							}
 						}
@@ -725,6 +738,7 @@ void optimizations::combineVectorRotations(const Module& module, Method& method,
 			it.nextInBlock();
 		}
 	}
+	return changedMethod;
 }
 
 InstructionWalker optimizations::combineSameFlags(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
@@ -762,3 +776,520 @@ InstructionWalker optimizations::combineSameFlags(const Module& module, Method&
 
 	return it;
 }
+
+static bool canFoldUnpackInto(const IntermediateInstruction* consumer, const Local* unpackedLocal)
+{
+	if(consumer == nullptr || consumer->hasUnpackMode() || dynamic_cast<const VectorRotation*>(consumer) != nullptr)
+		return false;
+	const Operation* op = dynamic_cast<const Operation*>(consumer);
+	if(op == nullptr && dynamic_cast<const MoveOperation*>(consumer) == nullptr)
+		return false;
+	//the unpack-mode is applied depending on the type of the consuming operation, moves (and the unpacking move) are integer operations
+	if(op != nullptr && op->op.acceptsFloat)
+		return false;
+	//the unpacked local is fixed to register-file A, the other input must not be read from it
+	for(const Value& arg : consumer->getArguments())
+	{
+		if(!arg.hasLocal(unpackedLocal) && (arg.hasType(ValueType::LOCAL) || arg.hasType(ValueType::REGISTER)))
+			return false;
+	}
+	return true;
+}
+
+static bool canFoldPackInto(const IntermediateInstruction* writer)
+{
+	if(writer == nullptr || writer->hasPackMode() || writer->hasConditionalExecution() || dynamic_cast<const VectorRotation*>(writer) != nullptr)
+		return false;
+	if(dynamic_cast<const MoveOperation*>(writer) != nullptr)
+		return true;
+	//only pack integer results of the add ALU, since the regfile A pack-modes convert floating-point results to half-floats
+	const Operation* op = dynamic_cast<const Operation*>(writer);
+	return op != nullptr && op->op.runsOnAddALU() && !op->op.returnsFloat;
+}
+
+static bool fitsIntoUnsignedByte(const Value& arg, const Unpack unpack, const Method& method)
+{
+	if(unpack == UNPACK_NOP)
+		return analysis::ValueRange::getValueRange(arg, method).fitsIntoUnsignedBits(8);
+	//the local is read from register-file A and zero-extended by the byte unpack-modes
+	if(arg.hasType(ValueType::LOCAL))
+		return unpack == UNPACK_8A_32 || unpack == UNPACK_8B_32 || unpack == UNPACK_8C_32 || unpack == UNPACK_8D_32;
+	return arg.isLiteralValue() && analysis::ValueRange::getValueRange(arg, method).fitsIntoUnsignedBits(8);
+}
+
+static bool canUsePackedByteOperation(const IntermediateInstruction* writer, const Method& method)
+{
+	//for byte operands, the (saturating) packed 8-bit operations calculate the saturated result in the lowest byte, and zero in all others
+	const Operation* op = dynamic_cast<const Operation*>(writer);
+	if(op == nullptr || (op->op != OP_ADD && op->op != OP_SUB) || !op->getSecondArg() || op->hasSideEffects() || op->hasPackMode() || op->hasConditionalExecution())
+		return false;
+	return fitsIntoUnsignedByte(op->getFirstArg(), op->unpackMode, method) && fitsIntoUnsignedByte(op->getSecondArg().value(), op->unpackMode, method);
+}
+
+static bool isPartialWritePack(const Pack pack)
+{
+	//full 32-bit (saturating) writes and the replicating 8888 pack-modes are not folded
+	return pack != PACK_NOP && pack != PACK_32_32 && pack != PACK_32_8888 && pack != PACK_32_8888_S;
+}
+
+bool optimizations::foldPackAndUnpackModes(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
+{
+	bool changedMethod = false;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		InstructionWalker it = block.begin();
+		while(!it.isEndOfBlock())
+		{
+			MoveOperation* move = it.get<MoveOperation>();
+			if(move == nullptr || it.has<VectorRotation>() || move->hasSideEffects() || move->hasConditionalExecution() || !move->getSource().hasType(ValueType::LOCAL) || !move->hasValueType(ValueType::LOCAL))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			const Local* src = move->getSource().local;
+			const Local* dest = move->getOutput()->local;
+			if(move->hasUnpackMode() && !move->hasPackMode() && dest->getSingleWriter() == move && dest->countUsers(LocalUser::Type::READER) == 1)
+			{
+				/*
+				 * %tmp = mov.unpack %src
+				 * [...]
+				 * %out = op %tmp, imm
+				 *
+				 * is converted to:
+				 *
+				 * [...]
+				 * %out = op.unpack %src, imm
+				 */
+				InstructionWalker checkIt = it.copy().nextInBlock();
+				while(!checkIt.isEndOfBlock() && (checkIt.get() == nullptr || !checkIt->readsLocal(dest)))
+				{
+					if(checkIt.get() != nullptr && checkIt->writesLocal(src))
+						break;
+					checkIt.nextInBlock();
+				}
+				if(!checkIt.isEndOfBlock() && checkIt.get() != nullptr && checkIt->readsLocal(dest) && canFoldUnpackInto(checkIt.get(), dest))
+				{
+					logging::debug() << "Folding unpack-mode of " << move->to_string() << " into " << checkIt->to_string() << logging::endl;
+					for(std::size_t i = 0; i < checkIt->getArguments().size(); ++i)
+					{
+						const Value arg = checkIt->getArgument(i).value();
+						if(arg.hasLocal(dest))
+							checkIt->setArgument(i, Value(src, arg.type));
+					}
+					checkIt->setUnpackMode(move->unpackMode);
+					it.erase();
+					changedMethod = true;
+					continue;
+				}
+			}
+			else if(isPartialWritePack(move->packMode) && !move->hasUnpackMode() && src->countUsers(LocalUser::Type::READER) == 1)
+			{
+				/*
+				 * %tmp = op %a, %b
+				 * [...]
+				 * %out = mov.pack %tmp
+				 *
+				 * is converted to:
+				 *
+				 * %out = op.pack %a, %b
+				 * [...]
+				 */
+				const IntermediateInstruction* writer = dynamic_cast<const IntermediateInstruction*>(src->getSingleWriter());
+				InstructionWalker checkIt = it.copy().previousInBlock();
+				while(!checkIt.isStartOfBlock() && checkIt.get() != writer)
+				{
+					if(checkIt.get() != nullptr && (checkIt->readsLocal(dest) || checkIt->writesLocal(dest)))
+						break;
+					checkIt.previousInBlock();
+				}
+				if(writer != nullptr && checkIt.get() == writer && checkIt->getOutput()->hasLocal(src) && move->packMode == PACK_INT_TO_UNSIGNED_CHAR_SATURATE && canUsePackedByteOperation(writer, method))
+				{
+					/*
+					 * Unsigned char saturation of the sum/difference of two unsigned chars can be calculated directly by the packed 8-bit operations,
+					 * which also write the whole register
+					 */
+					const Operation* op = checkIt.get<Operation>();
+					logging::debug() << "Replacing " << op->to_string() << " and saturation " << move->to_string() << " with packed 8-bit operation" << logging::endl;
+					const OpCode& packedOp = op->op == OP_ADD ? OP_V8ADDS : OP_V8SUBS;
+					checkIt.reset((new Operation(packedOp, move->getOutput().value(), op->getFirstArg(), op->getSecondArg().value()))->copyExtrasFrom(op));
+					checkIt->decoration = add_flag(checkIt->decoration, move->decoration);
+					it.erase();
+					changedMethod = true;
+					continue;
+				}
+				if(writer != nullptr && checkIt.get() == writer && checkIt->getOutput()->hasLocal(src) && canFoldPackInto(writer))
+				{
+					logging::debug() << "Folding pack-mode of " << move->to_string() << " into " << checkIt->to_string() << logging::endl;
+					checkIt->setOutput(move->getOutput());
+					checkIt->setPackMode(move->packMode);
+					checkIt->decoration = add_flag(checkIt->decoration, move->decoration);
+					it.erase();
+					changedMethod = true;
+					continue;
+				}
+			}
+			it.nextInBlock();
+		}
+	}
+	return changedMethod;
+}
+
+static bool isByteVectorType(const DataType& type)
+{
+	//uchar4 and uchar16 vectors fill exactly one or four 32-bit words, when packed 4 bytes per SIMD element
+	return !type.isComplexType() && !type.isFloatingType() && type.getScalarBitCount() == 8 && (type.num == 4 || type.num == 16);
+}
+
+static DataType getPackedByteVectorType(const DataType& type)
+{
+	return TYPE_INT32.toVectorType(static_cast<unsigned char>(type.num / 4));
+}
+
+static bool isPlainInstruction(const IntermediateInstruction* instr)
+{
+	return !instr->hasSideEffects() && !instr->hasConditionalExecution() && !instr->hasPackMode() && !instr->hasUnpackMode();
+}
+
+static Optional<Literal> getByteConstant(const Value& arg)
+{
+	Optional<Literal> literal = arg.getLiteralValue();
+	if(!literal && arg.hasType(ValueType::LOCAL))
+	{
+		//the literals are already loaded by the single steps
+		const IntermediateInstruction* writer = dynamic_cast<const IntermediateInstruction*>(arg.local->getSingleWriter());
+		if(dynamic_cast<const LoadImmediate*>(writer) != nullptr && isPlainInstruction(writer))
+			literal = dynamic_cast<const LoadImmediate*>(writer)->getImmediate();
+		else if(dynamic_cast<const MoveOperation*>(writer) != nullptr && dynamic_cast<const VectorRotation*>(writer) == nullptr && isPlainInstruction(writer))
+			literal = dynamic_cast<const MoveOperation*>(writer)->getSource().getLiteralValue();
+	}
+	if(literal && literal->type == LiteralType::INTEGER && literal->integer >= 0 && literal->integer <= 255)
+		return literal;
+	return Optional<Literal>(false, static_cast<int64_t>(0));
+}
+
+/*
+ * A byte-vector value, which is also calculated on the packed vector (4 bytes per SIMD element)
+ */
+struct PackedByteVector
+{
+	//the instruction writing the unpacked value
+	InstructionWalker writer;
+	//the packed 8-bit operation calculating the packed value, nothing for memory reads and zero-extensions/truncations
+	const OpCode* packedOperation;
+	//the addition/subtraction saturated by the writer, replaced by the saturating packed 8-bit operation
+	const Operation* saturatedOperation;
+	//the unpacked values (locals or byte constants) the value is calculated from
+	std::vector<Value> arguments;
+	Value packedValue;
+	//whether the unpacked value is read by any instruction not calculating on packed values
+	bool isUnpackedRead;
+
+	explicit PackedByteVector(InstructionWalker writer) : writer(writer), packedOperation(nullptr), saturatedOperation(nullptr), packedValue(UNDEFINED_VALUE), isUnpackedRead(false)
+	{
+	}
+};
+
+static bool determinePackedCalculation(PackedByteVector& value)
+{
+	const IntermediateInstruction* writer = value.writer.get();
+	const DataType type = writer->getOutput()->type;
+	if(const MemoryInstruction* mem = dynamic_cast<const MemoryInstruction*>(writer))
+	{
+		//reading a byte-vector from an area of byte-vectors can read the packed words instead
+		return mem->op == MemoryOperation::READ && !mem->hasConditionalExecution() && isByteVectorType(type) && mem->getSource().hasType(ValueType::LOCAL) &&
+				mem->getSourceElementType() == type && mem->getNumEntries().hasLiteral(INT_ONE.literal);
+	}
+	if(type.isComplexType() || type.isFloatingType() || (type.num != 4 && type.num != 16))
+		return false;
+	const MoveOperation* move = dynamic_cast<const MoveOperation*>(writer);
+	if(move != nullptr && dynamic_cast<const VectorRotation*>(writer) == nullptr)
+	{
+		//the zero-extension of the lowest byte does not modify the value of a byte
+		if(move->hasSideEffects() || move->hasConditionalExecution() || (move->hasUnpackMode() && (move->unpackMode != UNPACK_8A_32 || move->hasPackMode())) || !move->getSource().hasType(ValueType::LOCAL))
+			return false;
+		if(!move->hasPackMode())
+		{
+			value.arguments.push_back(move->getSource());
+			return true;
+		}
+		/*
+		 * The unsigned char saturation of the sum/difference of two bytes is calculated by the saturating packed 8-bit operations
+		 */
+		const Local* result = move->getSource().local;
+		const Operation* op = dynamic_cast<const Operation*>(result->getSingleWriter());
+		if(move->packMode != PACK_INT_TO_UNSIGNED_CHAR_SATURATE || op == nullptr || (op->op != OP_ADD && op->op != OP_SUB) || !op->getSecondArg() || !isPlainInstruction(op) || result->countUsers(LocalUser::Type::READER) != 1)
+			return false;
+		value.packedOperation = op->op == OP_ADD ? &OP_V8ADDS : &OP_V8SUBS;
+		value.saturatedOperation = op;
+		value.arguments = op->getArguments();
+		return true;
+	}
+	const Operation* op = dynamic_cast<const Operation*>(writer);
+	if(op == nullptr || !op->getSecondArg() || !isPlainInstruction(op))
+		return false;
+	if(op->op == OP_AND)
+	{
+		//zero-extension and truncation of bytes do not modify the value
+		const Value& first = op->getFirstArg();
+		const Value& second = op->getSecondArg().value();
+		if(getByteConstant(second) && getByteConstant(second)->integer == 0xFF)
+			value.arguments.push_back(first);
+		else if(getByteConstant(first) && getByteConstant(first)->integer == 0xFF)
+			value.arguments.push_back(second);
+		return !value.arguments.empty();
+	}
+	if(op->op == OP_MIN || op->op == OP_MAX)
+	{
+		//for bytes, the signed 32-bit minimum/maximum is the same as the unsigned 8-bit one
+		value.packedOperation = op->op == OP_MIN ? &OP_V8MIN : &OP_V8MAX;
+		value.arguments = op->getArguments();
+		return true;
+	}
+	return false;
+}
+
+static InstructionWalker insertUnpackByteVector(Method& method, InstructionWalker it, const Value& packedValue, const Value& dest)
+{
+	/*
+	 * The packed uchar4 vector is only guaranteed to be in element 0 (e.g. if read from the VPM), so it is replicated and element i extracts the byte i of the word:
+	 *
+	 * %word = mov %packed (replicated)
+	 * %shift = and elem_num, 3
+	 * %shift = shl %shift, 3
+	 * %tmp = shr %word, %shift
+	 * %dest = and %tmp, 255
+	 */
+	const DataType wordType = TYPE_INT32.toVectorType(dest.type.num);
+	const Value word = method.addNewLocal(wordType, "%byte_unpack");
+	it = insertReplication(it, packedValue, word);
+	const Value shift = method.addNewLocal(wordType, "%byte_unpack");
+	it.emplace(new Operation(OP_AND, shift, ELEMENT_NUMBER_REGISTER, Value(Literal(static_cast<uint64_t>(3)), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_SHL, shift, shift, Value(Literal(static_cast<uint64_t>(3)), TYPE_INT8)));
+	it.nextInBlock();
+	const Value tmp = method.addNewLocal(wordType, "%byte_unpack");
+	it.emplace(new Operation(OP_SHR, tmp, word, shift));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_AND, dest, tmp, Value(Literal(static_cast<uint64_t>(0xFF)), TYPE_INT32)));
+	it.nextInBlock();
+	return it;
+}
+
+FastSet<const LocalUser*> optimizations::packByteVectors(const Module& module, Method& method, const Configuration& config)
+{
+	/*
+	 * %in = read <16 x i8> %addr_in
+	 * %a = and %in, 255
+	 * %b = add %a, %c
+	 * %d = mov.pack(uchar saturate) %b
+	 * %out = and %d, 255
+	 * write <16 x i8> %out, %addr_out
+	 *
+	 * is converted to:
+	 *
+	 * %in_packed = read <4 x i32> %addr_in
+	 * %out_packed = v8adds %in_packed, %c_packed
+	 * write <4 x i32> %out_packed, %addr_out
+	 *
+	 * Values read by other instructions are unpacked after they are calculated, memory reads are always replaced by a packed read.
+	 */
+	FastMap<const Local*, PackedByteVector> packedValues;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == nullptr || !it->hasValueType(ValueType::LOCAL) || it->getOutput()->local->getSingleWriter() != it.get())
+				continue;
+			PackedByteVector value(it);
+			if(!determinePackedCalculation(value))
+				continue;
+			const DataType type = it->getOutput()->type;
+			//zero-extensions, truncations and operations need at least one non-constant input, which is checked to be packed below
+			bool hasLocalArgument = false;
+			bool argumentsPackable = true;
+			for(const Value& arg : value.arguments)
+			{
+				if(getByteConstant(arg))
+					continue;
+				if(arg.hasType(ValueType::LOCAL) && arg.type.num == type.num)
+					hasLocalArgument = true;
+				else
+					argumentsPackable = false;
+			}
+			if(argumentsPackable && (value.arguments.empty() || hasLocalArgument))
+				packedValues.emplace(it->getOutput()->local, value);
+		}
+	}
+
+	std::vector<InstructionWalker> packedWrites;
+	bool removedValues = true;
+	while(removedValues)
+	{
+		removedValues = false;
+		//all (non-constant) inputs need to be packed too
+		for(auto it = packedValues.begin(); it != packedValues.end();)
+		{
+			if(std::any_of(it->second.arguments.begin(), it->second.arguments.end(), [&packedValues](const Value& arg) -> bool
+			{
+				return arg.hasType(ValueType::LOCAL) && !getByteConstant(arg) && packedValues.find(arg.local) == packedValues.end();
+			}))
+			{
+				it = packedValues.erase(it);
+				removedValues = true;
+			}
+			else
+				++it;
+		}
+		if(removedValues)
+			continue;
+
+		//only values (transitively) written into byte-vector memory are worth packing
+		packedWrites.clear();
+		FastSet<const Local*> writtenValues;
+		std::vector<const Local*> pendingValues;
+		for(BasicBlock& block : method.getBasicBlocks())
+		{
+			for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+			{
+				const MemoryInstruction* mem = it.get<MemoryInstruction>();
+				if(mem == nullptr || mem->op != MemoryOperation::WRITE || mem->hasConditionalExecution() || !mem->getSource().hasType(ValueType::LOCAL) || !mem->getDestination().hasType(ValueType::LOCAL) ||
+						!isByteVectorType(mem->getDestinationElementType()) || mem->getDestinationElementType().num != mem->getSource().type.num || !mem->getNumEntries().hasLiteral(INT_ONE.literal) ||
+						packedValues.find(mem->getSource().local) == packedValues.end())
+					continue;
+				packedWrites.push_back(it);
+				if(writtenValues.emplace(mem->getSource().local).second)
+					pendingValues.push_back(mem->getSource().local);
+			}
+		}
+		while(!pendingValues.empty())
+		{
+			const Local* local = pendingValues.back();
+			pendingValues.pop_back();
+			for(const Value& arg : packedValues.at(local).arguments)
+			{
+				if(arg.hasType(ValueType::LOCAL) && packedValues.find(arg.local) != packedValues.end() && writtenValues.emplace(arg.local).second)
+					pendingValues.push_back(arg.local);
+			}
+		}
+		for(auto it = packedValues.begin(); it != packedValues.end();)
+		{
+			if(writtenValues.find(it->first) == writtenValues.end())
+				it = packedValues.erase(it);
+			else
+				++it;
+		}
+
+		FastSet<const LocalUser*> packedReaders;
+		for(const InstructionWalker& it : packedWrites)
+			packedReaders.emplace(it.get());
+		for(const auto& pair : packedValues)
+		{
+			packedReaders.emplace(pair.second.writer.get());
+			if(pair.second.saturatedOperation != nullptr)
+				packedReaders.emplace(pair.second.saturatedOperation);
+		}
+		for(auto it = packedValues.begin(); it != packedValues.end();)
+		{
+			it->second.isUnpackedRead = false;
+			it->first->forUsers(LocalUser::Type::READER, [&it, &packedReaders](const LocalUser* user) -> void
+			{
+				if(packedReaders.find(user) == packedReaders.end())
+					it->second.isUnpackedRead = true;
+			});
+			//unpacking a uchar16 vector takes more instructions than are saved by calculating it packed
+			if(it->second.isUnpackedRead && it->first->type.num == 16)
+			{
+				it = packedValues.erase(it);
+				removedValues = true;
+			}
+			else
+				++it;
+		}
+	}
+	if(packedValues.empty())
+		return {};
+
+	for(auto& pair : packedValues)
+	{
+		//zero-extensions and truncations re-use the packed value of their input
+		if(pair.second.packedOperation != nullptr || pair.second.arguments.empty())
+			pair.second.packedValue = method.addNewLocal(getPackedByteVectorType(pair.first->type), "%packed");
+	}
+	const std::function<Value(const Local*)> getPackedValue = [&packedValues, &getPackedValue](const Local* local) -> Value
+	{
+		PackedByteVector& value = packedValues.at(local);
+		if(value.packedValue.isUndefined())
+			value.packedValue = getPackedValue(value.arguments.front().local);
+		return value.packedValue;
+	};
+
+	FastSet<const LocalUser*> insertedInstructions;
+	FastSet<const IntermediateInstruction*> removedInstructions;
+	for(auto& pair : packedValues)
+	{
+		PackedByteVector& value = pair.second;
+		const Value packedValue = getPackedValue(pair.first);
+		InstructionWalker it = value.writer;
+		logging::debug() << "Calculating " << it->to_string() << " on packed byte-vector " << packedValue.to_string() << (value.isUnpackedRead ? " and unpacking it" : "") << logging::endl;
+		const Value unpackedValue = it->getOutput().value();
+		if(const MemoryInstruction* read = it.get<MemoryInstruction>())
+		{
+			const Value source = read->getSource();
+			const PointerType* pointerType = source.type.getPointerType().value();
+			it.reset((new MemoryInstruction(MemoryOperation::READ, packedValue, Value(source.local, packedValue.type.toPointerType(pointerType->addressSpace, pointerType->alignment)), INT_ONE, read->useMutex))->copyExtrasFrom(read));
+			insertedInstructions.emplace(it.get());
+			it.nextInBlock();
+		}
+		else
+		{
+			if(value.packedOperation != nullptr)
+			{
+				const Value firstArg = value.arguments[0].hasType(ValueType::LOCAL) && packedValues.find(value.arguments[0].local) != packedValues.end() ? getPackedValue(value.arguments[0].local) :
+						Value(Literal(static_cast<uint64_t>(getByteConstant(value.arguments[0])->integer * 0x01010101)), packedValue.type);
+				const Value secondArg = value.arguments[1].hasType(ValueType::LOCAL) && packedValues.find(value.arguments[1].local) != packedValues.end() ? getPackedValue(value.arguments[1].local) :
+						Value(Literal(static_cast<uint64_t>(getByteConstant(value.arguments[1])->integer * 0x01010101)), packedValue.type);
+				it.emplace(new Operation(*value.packedOperation, packedValue, firstArg, secondArg));
+				insertedInstructions.emplace(it.get());
+				it.nextInBlock();
+			}
+			removedInstructions.emplace(it.get());
+			if(value.saturatedOperation != nullptr)
+				removedInstructions.emplace(value.saturatedOperation);
+		}
+		if(value.isUnpackedRead)
+		{
+			InstructionWalker unpackIt = it.copy().previousInBlock();
+			insertUnpackByteVector(method, it, packedValue, unpackedValue);
+			for(unpackIt.nextInBlock(); unpackIt.get() != it.get(); unpackIt.nextInBlock())
+				insertedInstructions.emplace(unpackIt.get());
+		}
+	}
+
+	for(InstructionWalker it : packedWrites)
+	{
+		const MemoryInstruction* write = it.get<MemoryInstruction>();
+		const Value packedValue = getPackedValue(write->getSource().local);
+		const Value dest = write->getDestination();
+		const PointerType* pointerType = dest.type.getPointerType().value();
+		logging::debug() << "Writing packed byte-vector " << packedValue.to_string() << " instead of " << write->to_string() << logging::endl;
+		it.reset((new MemoryInstruction(MemoryOperation::WRITE, Value(dest.local, packedValue.type.toPointerType(pointerType->addressSpace, pointerType->alignment)), packedValue, INT_ONE, write->useMutex))->copyExtrasFrom(write));
+		insertedInstructions.emplace(it.get());
+	}
+
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		InstructionWalker it = block.begin();
+		while(!it.isEndOfBlock())
+		{
+			if(removedInstructions.find(it.get()) != removedInstructions.end())
+			{
+				insertedInstructions.erase(it.get());
+				it.erase();
+			}
+			else
+				it.nextInBlock();
+		}
+	}
+	PROFILE_COUNTER(9050, "Packed byte-vectors", packedValues.size());
+	return insertedInstructions;
+}
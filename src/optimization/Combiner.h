@@ -8,15 +8,19 @@
 #define COMBINER_H
 
 #include "config.h"
+#include "../performance.h"
 
 namespace vc4c
 {
 	class Method;
 	class Module;
 	class InstructionWalker;
+	class LocalUser;
 
 	namespace optimizations
 	{
+		class AnalysisManager;
+
 		/*
 		 * Combine successive branches to the same label into a single branch
 		 */
@@ -24,19 +28,19 @@ namespace vc4c
 		/*
 		 * Combine ALU-instructions which (can) use different ALUs into a single instruction accessing both ALUs
 		 */
-		void combineOperations(const Module& module, Method& method, const Configuration& config);
+		bool combineOperations(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 
 		/*
 		 * Combines the loading of the same literal within a small range in basic blocks
 		 */
-		void combineLoadingLiterals(const Module& module, Method& method, const Configuration& config);
+		bool combineLoadingLiterals(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 
 		/*
 		 * Adds a branch from the end to the start to allow for running several kernels (from several work-groups) in one execution.
 		 * Since the kernels have different group-IDs, all instructions (including loading of parameters) are repeated.
 		 * Otherwise, all parameters would need to reserve their registers over the whole range of the program, which would fail a lot of kernels.
 		 */
-		void unrollWorkGroups(const Module& module, Method& method, const Configuration& config);
+		bool unrollWorkGroups(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 
 		/*
 		 * Prepares selections (successive writes to same value with inverted conditions) which write to a local, have no side-effects and one of the sources is zero
@@ -47,12 +51,26 @@ namespace vc4c
 		/*
 		 * Combines vector several consecutive rotations with the same data
 		 */
-		void combineVectorRotations(const Module& module, Method& method, const Configuration& config);
+		bool combineVectorRotations(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 
 		/*
 		 * Combines successive setting of the same flag (e.g. introduced by PHI-nodes)
 		 */
 		InstructionWalker combineSameFlags(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
+
+		/*
+		 * Folds moves only converting a value via pack- or unpack-modes (e.g. for zero-/sign-extension or saturation) into the instruction writing or reading the value
+		 */
+		bool foldPackAndUnpackModes(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
+
+		/*
+		 * Keeps uchar4 and uchar16 vectors written to memory packed (4 bytes per SIMD element) and calculates them via the packed 8-bit operations (v8adds, v8subs, v8min, v8max),
+		 * so they are read from and written to memory as one/four 32-bit words.
+		 * uchar4 values also used by other (32-bit) operations are unpacked for these, uchar16 values are then kept unpacked, since unpacking them is too expensive.
+		 *
+		 * Returns the inserted instructions, which are not yet handled by the single steps
+		 */
+		FastSet<const LocalUser*> packByteVectors(const Module& module, Method& method, const Configuration& config);
 	} // namespace optimizations
 } // namespace vc4c
 #endif /* COMBINER_H */
@@ -530,17 +530,18 @@ static void vectorize(ControlFlowLoop& loop, LoopControl& loopControl, const Dat
 	logging::debug() << "Vectorization done, changed " << numVectorized << " instructions!" << logging::endl;
 }
 
-void optimizations::vectorizeLoops(const Module& module, Method& method, const Configuration& config)
+bool optimizations::vectorizeLoops(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
 	if(!config.autoVectorization)
-		return;
+		return false;
 
 	//1. find loops
-	auto cfg = ControlFlowGraph::createCFG(method);
-	auto loops = cfg.findLoops();
+	auto loops = analyses.getControlFlowGraph().findLoops();
 
 	//2. determine data dependencies of loop bodies
-	auto dependencyGraph = DataDependencyGraph::createDependencyGraph(method);
+	const DataDependencyGraph& dependencyGraph = analyses.getDependencyGraph();
+
+	bool changedMethod = false;
 
 	for(auto& loop : loops)
 	{
@@ -577,5 +578,7 @@ void optimizations::vectorizeLoops(const Module& module, Method& method, const C
 
 		//6. run vectorization
 		vectorize(loop, loopControl, dependencyGraph);
+		changedMethod = true;
 	}
+	return changedMethod;
 }
@@ -8,6 +8,7 @@
 #define VC4C_OPTIMIZATION_CONTROLFLOW_H
 
 #include "../Module.h"
+#include "Optimizer.h"
 
 namespace vc4c
 {
@@ -18,7 +19,7 @@ namespace vc4c
 		 *
 		 * NOTE: Currently only works with "standard" for-range loops
 		 */
-		void vectorizeLoops(const Module& module, Method& method, const Configuration& config);
+		bool vectorizeLoops(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 
 	} /* namespace optimizations */
 } /* namespace vc4c */
@@ -7,6 +7,8 @@
 #include "Eliminator.h"
 
 #include "../InstructionWalker.h"
+#include "../analysis/LivenessAnalysis.h"
+#include "Optimizer.h"
 #include "log.h"
 
 #include <algorithm>
@@ -16,8 +18,36 @@
 using namespace vc4c;
 using namespace vc4c::optimizations;
 
-void optimizations::eliminateDeadStore(const Module& module, Method& method, const Configuration& config)
+bool optimizations::eliminateDeadStore(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
+	bool changedMethod = false;
+	//remove all writes which are not read on any path before being overwritten
+	//since conditional writes might not overwrite the value in all elements, only unconditional writes end the live-range of a local here
+	{
+		const analysis::LivenessAnalysis& liveness = analyses.getLiveness(false);
+		const analysis::LocalNumbering& numbering = liveness.getLocalNumbering();
+		for(BasicBlock& block : method.getBasicBlocks())
+		{
+			std::vector<InstructionWalker> deadWrites;
+			liveness.forInstructionsInBlock(block, [&numbering, &deadWrites](InstructionWalker it, const analysis::BitSet& liveAfter) -> void
+			{
+				if((it.has<intermediate::Operation>() || it.has<intermediate::MoveOperation>() || it.has<intermediate::LoadImmediate>()) && !it->hasSideEffects() &&
+					it->hasValueType(ValueType::LOCAL) && !it->getOutput()->local->is<Parameter>())
+				{
+					const Optional<std::size_t> number = numbering.getNumber(it->getOutput()->local);
+					if(number && !liveAfter.test(number.value()))
+						deadWrites.push_back(it);
+				}
+			});
+			for(InstructionWalker& it : deadWrites)
+			{
+				logging::debug() << "Removing instruction " << it->to_string() << ", since its output is not read before being overwritten" << logging::endl;
+				it.erase();
+				changedMethod = true;
+			}
+		}
+	}
+
 	//TODO (additionally or instead of this) walk through locals, check whether they are never read and writings have no side-effects
 	//then walk through all writings of such locals and remove them (example: ./testing/test_vpm_write.cl)
 	auto it = method.walkAllInstructions();
@@ -43,11 +73,12 @@ void optimizations::eliminateDeadStore(const Module& module, Method& method, con
                 {
                     //b) never read at all
                 	//must check from the start, because in SPIR-V, locals can be read before they are written to (e.g. in phi-node and branch backwards)
-                    bool isRead = !dest->getUsers(LocalUser::Type::READER).empty();
+                    bool isRead = dest->countUsers(LocalUser::Type::READER) > 0;
                     if(!isRead)
                     {
                         logging::debug() << "Removing instruction " << instr->to_string() << ", since its output is never read" << logging::endl;
                         it.erase();
+                        changedMethod = true;
                         //if we removed this instruction, maybe the previous one can be removed too??
                         it.previousInBlock();
                         continue;
@@ -65,7 +96,7 @@ void optimizations::eliminateDeadStore(const Module& module, Method& method, con
 					const Local* inLoc = move->getSource().local;
 					const Local* outLoc = move->getOutput()->local;
 					//for instruction added by phi-elimination, the result could have been written to (with a different source) previously, so check
-					bool isWrittenTo = !outLoc->getUsers(LocalUser::Type::WRITER).empty();
+					bool isWrittenTo = outLoc->countUsers(LocalUser::Type::WRITER) > 0;
 					if(!isWrittenTo && inLoc->type == outLoc->type)
 					{
 						//TODO what if both locals are written before (and used differently), possible??
@@ -91,6 +122,7 @@ void optimizations::eliminateDeadStore(const Module& module, Method& method, con
 						});
 						//skip ++it, so next instructions is looked at too
 						it.erase();
+						changedMethod = true;
 						continue;
 					}
 				}
@@ -100,6 +132,7 @@ void optimizations::eliminateDeadStore(const Module& module, Method& method, con
     }
     //remove unused locals. This is actually not required, but gives us some feedback about the effect of this optimization
     method.cleanLocals();
+    return changedMethod;
 }
 
 InstructionWalker optimizations::eliminateUselessInstruction(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
@@ -17,7 +17,9 @@ namespace vc4c
 
 	namespace optimizations
 	{
-		void eliminateDeadStore(const Module& module, Method& method, const Configuration& config);
+		class AnalysisManager;
+
+		bool eliminateDeadStore(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 		void eliminatePhiNodes(const Module& module, Method& method, const Configuration& config);
 
 		InstructionWalker eliminateUselessInstruction(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
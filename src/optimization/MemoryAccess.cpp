@@ -7,13 +7,18 @@
 #include "MemoryAccess.h"
 
 #include "../intermediate/IntermediateInstruction.h"
+#include "../periphery/TMU.h"
 #include "../periphery/VPM.h"
 #include "../InstructionWalker.h"
 #include "../Profiler.h"
+#include "../analysis/LivenessAnalysis.h"
+#include "Optimizer.h"
 #include "log.h"
 
 #include <algorithm>
 #include <functional>
+#include <limits>
+#include <set>
 
 using namespace vc4c;
 using namespace vc4c::optimizations;
@@ -62,15 +67,15 @@ static BaseAndOffset findBaseAndOffset(const Value& val)
 	if(val.local->reference.first != nullptr && val.local->reference.second != ANY_ELEMENT)
 		return BaseAndOffset(val.local->reference.first->createReference(), static_cast<int64_t>(val.local->reference.second));
 
-	const auto writers = val.local->getUsers(LocalUser::Type::WRITER);
-	if(writers.size() != 1)
+	const LocalUser* writer = val.local->getSingleWriter();
+	if(writer == nullptr)
 		return BaseAndOffset();
 
 	//The reader can be one of several valid cases:
 	//1. a move from another local -> need to follow the move
-	if(dynamic_cast<const MoveOperation*>(*writers.begin()) != nullptr)
-		return findBaseAndOffset(dynamic_cast<const MoveOperation*>(*writers.begin())->getSource());
-	const auto& args = dynamic_cast<const IntermediateInstruction*>(*writers.begin())->getArguments();
+	if(dynamic_cast<const MoveOperation*>(writer) != nullptr)
+		return findBaseAndOffset(dynamic_cast<const MoveOperation*>(writer)->getSource());
+	const auto& args = dynamic_cast<const IntermediateInstruction*>(writer)->getArguments();
 	//2. an arithmetic operation with a local and a literal -> the local is the base, the literal the offset
 	if(args.size() == 2 && std::any_of(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LOCAL);}) && std::any_of(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LITERAL);}))
 	{
@@ -92,338 +97,1119 @@ static BaseAndOffset findBaseAndOffset(const Value& val)
 	return BaseAndOffset();
 }
 
-static InstructionWalker findDMASetup(InstructionWalker pos, const InstructionWalker end, bool isVPMWrite)
+/*
+ * Returns the TMU the instruction writes the (s-coordinate) address of a general memory lookup to, if any
+ */
+static const TMU* getTMURequest(const IntermediateInstruction* instr)
 {
-	while(!pos.isStartOfBlock())
-	{
-		if(pos.has<LoadImmediate>() && pos->hasValueType(ValueType::REGISTER))
-		{
-			if(isVPMWrite && pos->writesRegister(REG_VPM_OUT_SETUP) && VPWSetup::fromLiteral(pos.get<LoadImmediate>()->getImmediate().integer).isDMASetup())
-				return pos;
-			if(!isVPMWrite && pos->writesRegister(REG_VPM_IN_SETUP) && VPRSetup::fromLiteral(pos.get<LoadImmediate>()->getImmediate().integer).isDMASetup())
-				return pos;
-		}
-		if(pos.has<MutexLock>() && pos.get<MutexLock>()->locksMutex())
-			//only read up to the previous mutex acquire
-			break;
-		pos.previousInBlock();
-	}
-	return end;
+	if(instr->writesRegister(TMU0.s_coordinate))
+		return &TMU0;
+	if(instr->writesRegister(TMU1.s_coordinate))
+		return &TMU1;
+	return nullptr;
 }
 
-static InstructionWalker findGenericSetup(InstructionWalker it, const InstructionWalker end, bool isVPMWrite)
+/*
+ * Whether the instruction writes any TMU register other than the address of a general memory lookup (e.g. the coordinates of an image lookup)
+ */
+static bool writesOtherTMURegister(const IntermediateInstruction* instr)
 {
-	if(isVPMWrite)
+	for(const TMU* tmu : {&TMU0, &TMU1})
 	{
-		//for VPM writes, the generic setups is located before the address write
-		while(!it.isStartOfBlock())
-		{
-			if(it.has<LoadImmediate>() && it->writesRegister(REG_VPM_OUT_SETUP) && VPWSetup::fromLiteral(it.get<LoadImmediate>()->getImmediate().integer).isGenericSetup())
-			{
-				return it;
-			}
-			else if(it.has<MutexLock>() && it.get<MutexLock>()->locksMutex())
-				//only search up to the previous mutex write
-				break;
-			it.previousInBlock();
-		}
+		if(instr->writesRegister(tmu->t_coordinate) || instr->writesRegister(tmu->r_border_color) || instr->writesRegister(tmu->b_lod_bias))
+			return true;
 	}
-	else
+	return false;
+}
+
+/*
+ * Whether the memory areas referenced by the two base addresses are known to not overlap
+ */
+static bool isNonAliasing(const Value& base0, const Value& base1)
+{
+	if(!base0.hasType(ValueType::LOCAL) || !base1.hasType(ValueType::LOCAL) || base0.local == base1.local)
+		return false;
+	const Parameter* param0 = base0.local->as<Parameter>();
+	const Parameter* param1 = base1.local->as<Parameter>();
+	if(param0 != nullptr && param1 != nullptr)
+		return has_flag(param0->decorations, ParameterDecorations::RESTRICT) || has_flag(param1->decorations, ParameterDecorations::RESTRICT);
+	//different global data and stack allocations never overlap
+	return (base0.local->is<Global>() || base0.local->is<StackAllocation>()) && (base1.local->is<Global>() || base1.local->is<StackAllocation>());
+}
+
+/*
+ * Whether the instruction must not be located within the critical section of a combined memory access,
+ * since it accesses the VPM or the TMUs itself or synchronizes with other QPUs
+ */
+static bool isCriticalSectionBarrier(const IntermediateInstruction* instr)
+{
+	if(dynamic_cast<const MemoryBarrier*>(instr) != nullptr || dynamic_cast<const SemaphoreAdjustment*>(instr) != nullptr || dynamic_cast<const MutexLock*>(instr) != nullptr ||
+			dynamic_cast<const MethodCall*>(instr) != nullptr || instr->signal != SIGNAL_NONE)
+		return true;
+	if(getTMURequest(instr) != nullptr || writesOtherTMURegister(instr) || instr->writesRegister(REG_MUTEX) || instr->readsRegister(REG_MUTEX))
+		return true;
+	if(instr->hasValueType(ValueType::REGISTER) && instr->getOutput()->reg.isVertexPipelineMemory())
+		return true;
+	return std::any_of(instr->getArguments().begin(), instr->getArguments().end(), [](const Value& arg) -> bool
 	{
-		//for VPM reads, the generic setups is located after the address write
-		while(!it.isEndOfBlock())
-		{
-			if(it.has<LoadImmediate>() && it->writesRegister(REG_VPM_IN_SETUP) && VPRSetup::fromLiteral(it.get<LoadImmediate>()->getImmediate().integer).isGenericSetup())
-			{
-				return it;
-			}
-			else if(it.get() && it->writesRegister(REG_MUTEX))
-				//only search  to the next mutex release
-				break;
-			it.nextInBlock();
-		}
-	}
-	return end;
+		return arg.hasType(ValueType::REGISTER) && arg.reg.isVertexPipelineMemory();
+	});
+}
+
+/*
+ * Whether the memory instruction writes a single 32-bit scalar or vector, which occupies exactly one row of the VPM
+ */
+static bool isSingleRowWrite(const MemoryInstruction* instr)
+{
+	if(instr == nullptr || instr->op != MemoryOperation::WRITE || instr->hasConditionalExecution())
+		return false;
+	const Value src = instr->getSource();
+	if(!src.hasType(ValueType::LOCAL) && !src.hasType(ValueType::LITERAL))
+		return false;
+	return !src.type.isComplexType() && src.type.getScalarBitCount() == 32 && src.type == instr->getDestinationElementType();
 }
 
-struct VPMAccessGroup
+/*
+ * Writes of single values to consecutive memory, which are combined into a single DMA write
+ */
+struct MemoryWriteGroup
 {
-	bool isVPMWrite;
-	DataType groupType;
-	RandomAccessList<InstructionWalker> dmaSetups;
-	RandomAccessList<InstructionWalker> genericSetups;
-	RandomAccessList<InstructionWalker> addressWrites;
+	//the writes of the group, ordered by the memory address written to
+	RandomAccessList<InstructionWalker> writes;
+	//the writes to other memory located between the writes of this group
+	RandomAccessList<InstructionWalker> interleavedWrites;
 };
 
-static InstructionWalker findGroupOfVPMAccess(VPM& vpm, InstructionWalker start, const InstructionWalker end, VPMAccessGroup& group)
+static InstructionWalker findGroupOfWrites(VPM& vpm, InstructionWalker start, MemoryWriteGroup& group)
 {
 	Optional<Value> baseAddress = NO_VALUE;
 	int64_t nextOffset = -1;
-	group.groupType = TYPE_UNKNOWN;
-	group.dmaSetups.clear();
-	group.genericSetups.clear();
-	group.addressWrites.clear();
-	group.dmaSetups.reserve(64);
-	group.dmaSetups.reserve(64);
-	group.addressWrites.reserve(64);
+	//the writes to other memory after the last write of the group, which are only part of the group, if another write of the group follows
+	RandomAccessList<InstructionWalker> pendingInterleavedWrites;
 
 	//FIXME to not build too large critical sections, only combine, if the resulting critical section:
 	//1) is not too large: either in total numbers of instructions or in ratio instructions / VPW writes, since we save a few cycles per write (incl. delay for wait DMA)
 
 	auto it = start;
-	for(; !it.isEndOfBlock() && it != end; it.nextInBlock())
+	for(; !it.isEndOfBlock(); it.nextInBlock())
 	{
 		if(it.get() == nullptr)
 			continue;
-
-		if(it.has<MemoryBarrier>())
-			//memory barriers end groups, also don't check this barrier again
-			return it.nextInBlock();
-		if(it.has<SemaphoreAdjustment>())
-			//semaphore accesses end groups, also don't check this instruction again
-			return it.nextInBlock();
-
-		if(!(it->writesRegister(REG_VPM_IN_ADDR) || it->writesRegister(REG_VPM_OUT_ADDR)))
-			//for simplicity, we only check for VPM addresses and find all other instructions relative to it
-			continue;
-		if(!it.has<MoveOperation>())
-			throw CompilationError(CompilationStep::OPTIMIZER, "Setting VPM address with non-move is not supported", it->to_string());
-		const auto baseAndOffset = findBaseAndOffset(it.get<MoveOperation>()->getSource());
-		const bool isVPMWrite = it->writesRegister(REG_VPM_OUT_ADDR);
-		logging::debug() << "Found base address " << baseAndOffset.base.to_string() << " with offset " << std::to_string(baseAndOffset.offset.value_or(-1L)) << " for " << (isVPMWrite ? "writing into" : "reading from") << " memory" << logging::endl;
-
-		if(!baseAndOffset.base)
-			//this address-write could not be fixed to a base and an offset
-			//skip this address write for the next check
-			return it.nextInBlock();
-		if(baseAndOffset.base && baseAndOffset.base->hasType(ValueType::LOCAL) && baseAndOffset.base->local->is<Parameter>() && has_flag(baseAndOffset.base->local->as<Parameter>()->decorations, ParameterDecorations::VOLATILE))
-			//address points to a volatile parameter, which explicitly forbids combining reads/writes
-			//skip this address write for the next check
-			return it.nextInBlock();
-
-		//check if this address is consecutive to the previous one (if any)
-		if(baseAddress)
+		const MemoryInstruction* write = it.get<const MemoryInstruction>();
+		if(write == nullptr)
 		{
-			if(baseAndOffset.base && baseAddress.value() != baseAndOffset.base.value())
-				//a group exists, but the base addresses don't match
+			if(isCriticalSectionBarrier(it.get()))
 				break;
-			if(!baseAndOffset.offset || baseAndOffset.offset.value() != nextOffset)
-				//a group exists, but the offsets do not match
+			//the address of the first write is written to by the single DMA write at the end of the group
+			if(baseAddress && group.writes.at(0).get<const MemoryInstruction>()->getDestination().hasType(ValueType::LOCAL) &&
+					it->writesLocal(group.writes.at(0).get<const MemoryInstruction>()->getDestination().local))
 				break;
+			continue;
 		}
-
-		//check if the access mode (read/write) is the same as for the group
-		if(baseAddress && group.isVPMWrite != isVPMWrite)
+		if(!isSingleRowWrite(write))
+			//any other memory access ends groups, e.g. since it could read the memory not yet written
 			break;
+		const auto baseAndOffset = findBaseAndOffset(write->getDestination());
+		logging::debug() << "Found base address " << baseAndOffset.base.to_string() << " with offset " << std::to_string(baseAndOffset.offset.value_or(-1L)) << " for writing into memory" << logging::endl;
 
-		auto genericSetup = findGenericSetup(it, end, isVPMWrite);
-		auto dmaSetup = findDMASetup(it, end, isVPMWrite);
+		if(!baseAndOffset.base)
+			//this address could not be fixed to a base and an offset
+			break;
+		if(baseAndOffset.base->hasType(ValueType::LOCAL) && baseAndOffset.base->local->is<Parameter>() && has_flag(baseAndOffset.base->local->as<Parameter>()->decorations, ParameterDecorations::VOLATILE))
+			//address points to a volatile parameter, which explicitly forbids combining writes
+			break;
 
-		//check if the VPM and DMA configurations match with the previous one
-		if(baseAddress)
+		if(baseAddress && baseAddress.value() != baseAndOffset.base.value() && isNonAliasing(baseAddress.value(), baseAndOffset.base.value()))
 		{
-			if(genericSetup == end || dmaSetup == end)
-				//either there are no setups for this VPM access, or they are not loaded from literals (e.g. dynamic setup)
-				break;
-			if(!genericSetup.has<LoadImmediate>() || genericSetup.get<LoadImmediate>()->getImmediate().integer != group.genericSetups.at(0).get<LoadImmediate>()->getImmediate().integer)
-				//generic setups do not match
-				break;
-			if(!dmaSetup.has<LoadImmediate>() || dmaSetup.get<LoadImmediate>()->getImmediate().integer != group.dmaSetups.at(0).get<LoadImmediate>()->getImmediate().integer)
-				//DMA setups do not match
-				break;
+			//a write to other memory, which is not affected by deferring the writes of this group, can be skipped by moving it to another VPM row
+			pendingInterleavedWrites.push_back(it);
+			continue;
 		}
 
-		//check for complex types
-		DataType elementType = baseAndOffset.base->type.isPointerType() ? baseAndOffset.base->type.getPointerType().value()->elementType : baseAndOffset.base->type;
-		elementType = elementType.getArrayType() ? elementType.getArrayType().value()->elementType : elementType;
-		if(elementType.complexType)
-			//XXX for now, skip combining any access to complex types (here: only struct, image)
-			//don't check this read/write again
-			return it.nextInBlock();
+		//check if this address is consecutive to the previous one (if any) and the same type is written
+		if(baseAddress && (baseAddress.value() != baseAndOffset.base.value() || !baseAndOffset.offset || baseAndOffset.offset.value() != nextOffset ||
+				write->getSource().type != group.writes.at(0).get<const MemoryInstruction>()->getSource().type))
+			break;
 
 		//all matches so far, add to group (or create a new one)
-		group.isVPMWrite = isVPMWrite;
-		group.groupType = baseAndOffset.base->type;
 		baseAddress = baseAndOffset.base.value();
-		group.addressWrites.push_back(it);
-		group.dmaSetups.push_back(dmaSetup);
-		group.genericSetups.push_back(genericSetup);
+		group.writes.push_back(it);
+		group.interleavedWrites.insert(group.interleavedWrites.end(), pendingInterleavedWrites.begin(), pendingInterleavedWrites.end());
+		pendingInterleavedWrites.clear();
 		nextOffset = baseAndOffset.offset.value_or(-1L) + 1;
 
-		if(group.isVPMWrite && group.addressWrites.size() >= vpm.getMaxCacheVectors(elementType, true))
-		{
-			//since the current address write might be removed, skip to next instruction
-			//TODO could the following instruction(s) be removed too?? (See beneath)
+		if(group.writes.size() >= vpm.getMaxCacheVectors(write->getSource().type, true))
 			return it.nextInBlock();
-		}
-		if(!group.isVPMWrite && group.addressWrites.size() >= vpm.getMaxCacheVectors(elementType, false))
-		{
-			//since the current address write might be removed, skip to next instruction
-			//also need to skip the consecutive DMA wait and VPM setup
-			do {
-				it.nextInBlock();
-			}
-			while(!it.isEndOfBlock() && it.get() != nullptr && it->hasValueType(ValueType::REGISTER));
-			return it;
-		}
 	}
+	if(!pendingInterleavedWrites.empty())
+		//check the writes after the group again, they might start a group of their own
+		return pendingInterleavedWrites.front();
+	if(group.writes.empty() && !it.isEndOfBlock())
+		//this instruction cannot be part of any group, don't check it again
+		return it.nextInBlock();
 	//end group, but do check this instruction again
 	return it;
 }
 
-static void groupVPMWrites(VPM& vpm, VPMAccessGroup& group)
+/*
+ * Loads a literal value to be written into the VPM into a local, since it is not yet mapped to an immediate value
+ */
+static InstructionWalker insertLoadWrittenValue(Method& method, InstructionWalker it, Value& src)
 {
-	if(group.genericSetups.size() != group.addressWrites.size() || group.genericSetups.size() != group.dmaSetups.size())
-			throw CompilationError(CompilationStep::OPTIMIZER, "Number of instructions do not match for combining VPR reads!");
-	if(group.addressWrites.size() <= 1)
-		return;
-	logging::debug() << "Combining " << group.addressWrites.size() << " writes to consecutive memory into one DMA write... " << logging::endl;
-
-	//1. Update DMA setup to the number of rows written
+	if(src.hasType(ValueType::LITERAL))
 	{
-		VPWSetupWrapper dmaSetupValue(group.dmaSetups.at(0).get<LoadImmediate>());
-		dmaSetupValue.dmaSetup.setUnits(group.addressWrites.size());
+		const Value tmp = method.addNewLocal(src.type, "%vpm_write_value");
+		it.emplace(new LoadImmediate(tmp, src.literal));
+		it.nextInBlock();
+		src = tmp;
 	}
-	std::size_t numRemoved = 0;
-	vpm.updateScratchSize(group.addressWrites.size() * group.groupType.getElementType().getPhysicalWidth());
+	return it;
+}
+
+/*
+ * Inserts a write of the value into the given row of the VPM scratch area, the mutex needs to be already locked
+ */
+static InstructionWalker insertWriteVPMRow(Method& method, InstructionWalker it, Value src, const unsigned row)
+{
+	it = insertLoadWrittenValue(method, it, src);
+	it = method.vpm->insertWriteVPM(it, src, nullptr, false);
+	//the generic setup is followed by the write of the value
+	VPWSetupWrapper genericSetup(it.copy().previousInBlock().previousInBlock().get<LoadImmediate>());
+	genericSetup.genericSetup.setAddress(static_cast<uint8_t>(row));
+	return it;
+}
+
+/*
+ * Inserts a DMA write of the given number of rows of the VPM scratch area into the memory address, the mutex needs to be already locked
+ */
+static InstructionWalker insertWriteRows(Method& method, InstructionWalker it, const Value& address, const DataType& type, const unsigned firstRow, const unsigned numRows)
+{
+	it = method.vpm->insertWriteRAM(it, address, type, nullptr, false);
+	//the DMA setup is followed by the stride setup, the address write and the wait for the DMA
+	VPWSetupWrapper dmaSetup(it.copy().previousInBlock().previousInBlock().previousInBlock().previousInBlock().get<LoadImmediate>());
+	dmaSetup.dmaSetup.setUnits(static_cast<uint8_t>(numRows));
+	//the VPM base is given in words: {Y[6:0], X[3:0]}
+	dmaSetup.dmaSetup.setVPMBase(static_cast<uint16_t>(firstRow * 16));
+	return it;
+}
 
-	//2. Remove all but the first generic and DMA setups
-	for(std::size_t i = 1; i < group.genericSetups.size(); ++i)
+/*
+ * Replaces the writes of the group with writes of the single values into consecutive rows of the VPM and a single DMA write of all these rows.
+ * The writes to other memory between the writes of the group are moved to the VPM row after the rows of this group.
+ */
+static void combineWrites(Method& method, const MemoryWriteGroup& group)
+{
+	logging::debug() << "Combining " << group.writes.size() << " writes to consecutive memory into one DMA write... " << logging::endl;
+	const MemoryInstruction* firstWrite = group.writes.front().get<const MemoryInstruction>();
+	const Value address = firstWrite->getDestination();
+	const DataType type = firstWrite->getSource().type;
+	const bool useMutex = std::any_of(group.writes.begin(), group.writes.end(), [](const InstructionWalker& write) -> bool { return write.get<const MemoryInstruction>()->useMutex; }) ||
+			std::any_of(group.interleavedWrites.begin(), group.interleavedWrites.end(), [](const InstructionWalker& write) -> bool { return write.get<const MemoryInstruction>()->useMutex; });
+	//every write occupies a whole row of the VPM
+	const unsigned numRows = static_cast<unsigned>(group.writes.size());
+	method.vpm->updateScratchSize((numRows + (group.interleavedWrites.empty() ? 0 : 1)) * 64);
+
+	//the critical section covers all rows written, since the scratch area is shared by all QPUs
+	if(useMutex)
+		group.writes.front().copy().emplace(new MutexLock(MutexAccess::LOCK));
+	for(InstructionWalker write : group.interleavedWrites)
 	{
-		group.genericSetups.at(i).erase();
-		const LoadImmediate* strideSetup = group.dmaSetups.at(i).copy().nextInBlock().get<LoadImmediate>();
-		if(strideSetup == nullptr || !strideSetup->writesRegister(REG_VPM_OUT_SETUP) || !VPWSetup::fromLiteral(strideSetup->getImmediate().integer).isStrideSetup())
-			throw CompilationError(CompilationStep::OPTIMIZER, "Failed to find VPW DMA stride setup for DMA setup", group.dmaSetups.at(i)->to_string());
-		group.dmaSetups.at(i).copy().nextInBlock().erase();
-		group.dmaSetups.at(i).erase();
-		numRemoved += 3;
+		const MemoryInstruction* interleavedWrite = write.get<const MemoryInstruction>();
+		auto it = insertWriteVPMRow(method, write, interleavedWrite->getSource(), numRows);
+		insertWriteRows(method, it, interleavedWrite->getDestination(), interleavedWrite->getSource().type, numRows, 1);
+		write.erase();
 	}
+	if(!group.interleavedWrites.empty())
+		logging::debug() << "Moved " << group.interleavedWrites.size() << " writes to other memory to VPM row " << numRows << logging::endl;
+	for(unsigned row = 0; row < numRows; ++row)
+	{
+		InstructionWalker write = group.writes.at(row);
+		auto it = insertWriteVPMRow(method, write, write.get<const MemoryInstruction>()->getSource(), row);
+		if(row + 1 == numRows)
+		{
+			it = insertWriteRows(method, it, address, type, 0, numRows);
+			if(useMutex)
+				it.emplace(new MutexLock(MutexAccess::RELEASE));
+		}
+		write.erase();
+	}
+}
 
-	//3. remove all but the last address writes (and the following DMA waits), update the last write to write the first address written to
-	group.addressWrites.back().get<MoveOperation>()->setSource(group.addressWrites.at(0).get<MoveOperation>()->getSource());
-	for(std::size_t i = 0; i < group.addressWrites.size() - 1; ++i)
+//the maximum number of instructions between two critical sections to be merged into one
+static constexpr std::size_t MAX_MERGED_CRITICAL_SECTIONS_DISTANCE = 16;
+
+/*
+ * Merges successive critical sections (e.g. of several VPM writes) within the basic block, to amortize the cost of acquiring the mutex.
+ *
+ * The instructions between the critical sections are moved into the merged critical section, so only short distances without any waiting for other hardware are merged.
+ * Especially, the mutex must not be held while waiting for a TMU load, since this could switch the hardware-thread, which could then in turn wait for the mutex.
+ */
+static std::size_t mergeCriticalSections(BasicBlock& block)
+{
+	std::size_t numMerged = 0;
+	InstructionWalker lastRelease;
+	bool hasLastRelease = false;
+	std::size_t distance = 0;
+	for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
 	{
-		if(!group.addressWrites.at(i).copy().nextInBlock()->readsRegister(group.isVPMWrite ? REG_VPM_OUT_WAIT : REG_VPM_IN_WAIT))
-			throw CompilationError(CompilationStep::OPTIMIZER, "Failed to find VPW wait for address write", group.addressWrites.at(i)->to_string());
-		group.addressWrites.at(i).copy().nextInBlock().erase();
-		group.addressWrites.at(i).erase();
-		numRemoved += 2;
+		if(it.get() == nullptr)
+			continue;
+		if(it.has<MutexLock>() && it.get<MutexLock>()->locksMutex() && hasLastRelease && distance <= MAX_MERGED_CRITICAL_SECTIONS_DISTANCE)
+		{
+			lastRelease.erase();
+			it.reset(nullptr);
+			hasLastRelease = false;
+			++numMerged;
+		}
+		else if(it.has<MutexLock>() && it.get<MutexLock>()->releasesMutex())
+		{
+			lastRelease = it;
+			hasLastRelease = true;
+			distance = 0;
+		}
+		else if(it.has<MutexLock>() || it.has<MemoryBarrier>() || it.has<SemaphoreAdjustment>() || it->signal != SIGNAL_NONE || getTMURequest(it.get()) != nullptr || it->writesRegister(REG_MUTEX) || it->readsRegister(REG_MUTEX))
+			hasLastRelease = false;
+		else
+			++distance;
 	}
+	return numMerged;
+}
 
-	//4. remove all Mutex acquires and releases between the first and the last write, so memory consistency is restored
-	auto it = group.dmaSetups.front();
-	while(!it.isEndOfBlock() && it != group.addressWrites.back())
+bool optimizations::combineVPMAccess(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
+{
+	//combine the writes of single values to consecutive memory into a single DMA write
+	//the reads are executed via the TMU, see #pipelineTMULoads for combining them
+	std::size_t numCombinedWrites = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
 	{
-		if(it.get() && it->writesRegister(REG_MUTEX))
+		auto it = block.begin();
+		while(!it.isEndOfBlock())
 		{
-			it = it.erase();
-			++numRemoved;
+			MemoryWriteGroup group;
+			it = findGroupOfWrites(*method.vpm.get(), it, group);
+			if(group.writes.size() > 1)
+			{
+				combineWrites(method, group);
+				numCombinedWrites += group.writes.size();
+			}
 		}
-		else if(it.get() && it->readsRegister(REG_MUTEX))
+	}
+	logging::debug() << "Combined " << numCombinedWrites << " memory writes" << logging::endl;
+	PROFILE_COUNTER(9010, "Scratch memory size", method.vpm->getScratchArea().size);
+	return numCombinedWrites > 0;
+}
+
+/*
+ * Whether the instruction only calculates a local from other locals and therefore can be moved together with the memory read using it as address
+ */
+static bool canBeHoisted(const IntermediateInstruction* instr)
+{
+	if(dynamic_cast<const Operation*>(instr) == nullptr && dynamic_cast<const MoveOperation*>(instr) == nullptr && dynamic_cast<const LoadImmediate*>(instr) == nullptr)
+		return false;
+	if(dynamic_cast<const VectorRotation*>(instr) != nullptr || !instr->hasValueType(ValueType::LOCAL))
+		return false;
+	if(instr->hasSideEffects() || instr->hasConditionalExecution() || instr->hasPackMode() || instr->hasUnpackMode())
+		return false;
+	for(const Value& arg : instr->getArguments())
+	{
+		if(arg.hasType(ValueType::REGISTER) && arg.reg != REG_ELEMENT_NUMBER && arg.reg != REG_QPU_NUMBER)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Whether a memory read can never be moved across the instruction, e.g. other memory accesses, synchronization or accesses of the periphery
+ */
+static bool isMemoryReadBarrier(const IntermediateInstruction* instr)
+{
+	if(!instr->mapsToASMInstruction() || dynamic_cast<const Nop*>(instr) != nullptr)
+		return true;
+	if(dynamic_cast<const Operation*>(instr) == nullptr && dynamic_cast<const MoveOperation*>(instr) == nullptr && dynamic_cast<const LoadImmediate*>(instr) == nullptr)
+		//branches, semaphores, memory barriers, ...
+		return true;
+	if(instr->hasValueType(ValueType::REGISTER) && instr->getOutput()->reg.hasSideEffectsOnWrite())
+		return true;
+	for(const Value& arg : instr->getArguments())
+	{
+		if(arg.hasType(ValueType::REGISTER) && arg.reg.hasSideEffectsOnRead())
+			return true;
+	}
+	return instr->signal.hasSideEffects();
+}
+
+/*
+ * Whether the order of the two instructions cannot be changed, since they access the same locals
+ */
+static bool dependsOn(const IntermediateInstruction* instr, const IntermediateInstruction* other)
+{
+	if(!instr->hasValueType(ValueType::LOCAL))
+		return false;
+	const Local* output = instr->getOutput()->local;
+	if(other->readsLocal(output) || other->writesLocal(output))
+		return true;
+	return other->hasValueType(ValueType::LOCAL) && instr->readsLocal(other->getOutput()->local);
+}
+
+/*
+ * Returns the given instruction, if it is a memory read which can be issued together with other memory reads (see #lowerMemoryAccess)
+ */
+static const MemoryInstruction* getBatchableRead(const IntermediateInstruction* instr)
+{
+	const MemoryInstruction* read = dynamic_cast<const MemoryInstruction*>(instr);
+	if(read == nullptr || read->op != MemoryOperation::READ || read->hasConditionalExecution())
+		return nullptr;
+	return read;
+}
+
+/*
+ * The maximum number of memory reads issued at once, which are alternated between both TMUs
+ */
+static std::size_t getMaxBatchedReads(const Configuration& config)
+{
+	//the request FIFOs are shared by both hardware-threads of a QPU
+	return 2 * (config.threadableKernels ? MAX_PENDING_TMU_REQUESTS / 2 : MAX_PENDING_TMU_REQUESTS);
+}
+
+/*
+ * Moves the memory read at the given position up directly behind the previous memory read, so both are issued at once after lowering,
+ * the calculation of the address read is moved in front of all the reads issued at once.
+ *
+ * Returns whether the memory read was moved
+ */
+static bool hoistMemoryRead(std::vector<IntermediateInstruction*>& instructions, const std::size_t readIndex, const std::size_t maxBatchedReads)
+{
+	//the read and the instructions calculating its address, in reverse order
+	std::vector<IntermediateInstruction*> chain{instructions[readIndex]};
+	std::size_t position = readIndex;
+	for(; position > 0; --position)
+	{
+		IntermediateInstruction* instr = instructions[position - 1];
+		if(getBatchableRead(instr) != nullptr)
+			break;
+		const bool calculatesAddress = std::any_of(chain.begin(), chain.end(), [instr](const IntermediateInstruction* member) -> bool
+		{
+			return instr->hasValueType(ValueType::LOCAL) && member->readsLocal(instr->getOutput()->local);
+		});
+		if(calculatesAddress)
 		{
-			it = it.erase();
-			++numRemoved;
+			if(!canBeHoisted(instr))
+				return false;
+			chain.push_back(instr);
+			continue;
 		}
+		if(isMemoryReadBarrier(instr) || std::any_of(chain.begin(), chain.end(), [instr](const IntermediateInstruction* member) -> bool { return dependsOn(member, instr); }))
+			return false;
+	}
+	if(position == 0 || position == readIndex)
+		//there is no previous read to issue this read with, or this read already directly follows it
+		return false;
+
+	//the previous reads issued at once, all of which are independent of this read and the calculation of its address
+	std::size_t firstBatchedRead = position;
+	while(firstBatchedRead > 0 && getBatchableRead(instructions[firstBatchedRead - 1]) != nullptr)
+	{
+		IntermediateInstruction* read = instructions[firstBatchedRead - 1];
+		if(std::any_of(chain.begin(), chain.end(), [read](const IntermediateInstruction* member) -> bool { return dependsOn(member, read) || dependsOn(read, member); }))
+			break;
+		--firstBatchedRead;
+	}
+	if(firstBatchedRead == position || position - firstBatchedRead + 1 > maxBatchedReads)
+		return false;
+
+	//move the address calculation in front of the batched reads and the read directly behind them, keeping the relative order of all other instructions
+	std::vector<IntermediateInstruction*> others;
+	others.reserve(readIndex - firstBatchedRead);
+	for(std::size_t i = firstBatchedRead; i <= readIndex; ++i)
+	{
+		if(std::find(chain.begin(), chain.end(), instructions[i]) == chain.end())
+			others.push_back(instructions[i]);
+	}
+	std::size_t index = firstBatchedRead;
+	for(auto it = chain.rbegin(); it != chain.rend() - 1; ++it)
+		instructions[index++] = *it;
+	const std::size_t numBatchedReads = position - firstBatchedRead;
+	std::copy(others.begin(), others.begin() + static_cast<std::ptrdiff_t>(numBatchedReads), instructions.begin() + static_cast<std::ptrdiff_t>(index));
+	index += numBatchedReads;
+	instructions[index++] = chain.front();
+	std::copy(others.begin() + static_cast<std::ptrdiff_t>(numBatchedReads), others.end(), instructions.begin() + static_cast<std::ptrdiff_t>(index));
+	return true;
+}
+
+/*
+ * Software-pipelining of the memory reads within a single basic block.
+ *
+ * Returns the number of memory reads moved behind a previous read
+ */
+static std::size_t pipelineMemoryReadsInBlock(BasicBlock& block, const std::size_t maxBatchedReads)
+{
+	std::vector<InstructionWalker> positions;
+	std::vector<IntermediateInstruction*> instructions;
+	std::size_t numReads = 0;
+	//the label is skipped, since it cannot be moved anyway
+	for(InstructionWalker it = block.begin().nextInBlock(); !it.isEndOfBlock(); it.nextInBlock())
+	{
+		if(!it.has())
+			continue;
+		if(getBatchableRead(it.get()) != nullptr)
+			++numReads;
+		positions.push_back(it);
+		instructions.push_back(it.get());
+	}
+	if(numReads < 2)
+		return 0;
+
+	std::size_t numHoisted = 0;
+	for(std::size_t i = 0; i < instructions.size(); ++i)
+	{
+		if(getBatchableRead(instructions[i]) != nullptr && hoistMemoryRead(instructions, i, maxBatchedReads))
+			++numHoisted;
+	}
+
+	if(numHoisted > 0)
+	{
+		//write the new order back into the basic block
+		for(InstructionWalker& it : positions)
+			it.release();
+		for(std::size_t i = 0; i < positions.size(); ++i)
+			positions[i].reset(instructions[i]);
+	}
+	return numHoisted;
+}
+
+bool optimizations::pipelineTMULoads(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
+{
+	const std::size_t maxBatchedReads = getMaxBatchedReads(config);
+	std::size_t numHoisted = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		numHoisted += pipelineMemoryReadsInBlock(block, maxBatchedReads);
+	}
+	logging::debug() << "Moved " << numHoisted << " memory reads behind previous reads to be issued at once" << logging::endl;
+	PROFILE_COUNTER(9020, "Pipelined TMU requests", numHoisted);
+	return numHoisted > 0;
+}
+
+/*
+ * A single access to a memory region cached in the VPM
+ */
+struct CachedMemoryAccess
+{
+	//the memory instruction reading or writing the single value
+	InstructionWalker instruction;
+	//the offset (in bytes) accessed relative to the base address, either a literal or a local
+	Value offset;
+	bool isWrite;
+};
+
+/*
+ * The accesses to the memory region referenced by a single parameter
+ */
+struct CachedMemoryRegion
+{
+	std::vector<CachedMemoryAccess> accesses;
+	//the instructions calculating the addresses accessed from the base address
+	FastSet<const IntermediateInstruction*> addressCalculations;
+	//whether any access to this memory region cannot be cached
+	bool isCacheable = true;
+};
+
+//the minimum number of accesses to a memory region for it to be cached, where an access within a loop counts for several accesses
+static constexpr std::size_t MIN_CACHED_ACCESSES = 4;
+static constexpr std::size_t LOOP_ACCESS_WEIGHT = 8;
+
+static bool isSimpleInstruction(const IntermediateInstruction* instr)
+{
+	return !instr->hasConditionalExecution() && !instr->hasPackMode() && !instr->hasUnpackMode() && instr->setFlags != SetFlag::SET_FLAGS && instr->signal == SIGNAL_NONE;
+}
+
+/*
+ * Determines the parameter the given value is a (copy of a) reference to
+ */
+static const Parameter* findCachedParameter(const Value& val, FastSet<const IntermediateInstruction*>& calculations)
+{
+	if(!val.hasType(ValueType::LOCAL))
+		return nullptr;
+	if(val.local->is<Parameter>())
+		return val.local->as<Parameter>();
+	const MoveOperation* move = dynamic_cast<const MoveOperation*>(val.local->getSingleWriter());
+	if(move == nullptr || !isSimpleInstruction(move))
+		return nullptr;
+	calculations.emplace(move);
+	return findCachedParameter(move->getSource(), calculations);
+}
+
+/*
+ * Determines the parameter and the offset (in bytes) the given memory address refers to.
+ * The address needs to be either (a copy of) the parameter itself or the sum of the parameter and some offset
+ */
+static const Parameter* findCachedBaseAndOffset(const Value& address, Value& offset, FastSet<const IntermediateInstruction*>& calculations)
+{
+	if(!address.hasType(ValueType::LOCAL))
+		return nullptr;
+	if(const Parameter* param = findCachedParameter(address, calculations))
+	{
+		offset = Value(Literal(static_cast<int64_t>(0)), TYPE_INT32);
+		return param;
+	}
+	const IntermediateInstruction* writer = dynamic_cast<const IntermediateInstruction*>(address.local->getSingleWriter());
+	if(dynamic_cast<const MoveOperation*>(writer) != nullptr && isSimpleInstruction(writer))
+	{
+		calculations.emplace(writer);
+		return findCachedBaseAndOffset(dynamic_cast<const MoveOperation*>(writer)->getSource(), offset, calculations);
+	}
+	const Operation* op = dynamic_cast<const Operation*>(writer);
+	if(op == nullptr || op->op != OP_ADD || op->getArguments().size() != 2 || !isSimpleInstruction(op))
+		return nullptr;
+	for(std::size_t i = 0; i < 2; ++i)
+	{
+		const Value& other = op->getArgument(1 - i).value();
+		const Parameter* param = findCachedParameter(op->getArgument(i).value(), calculations);
+		if(param == nullptr)
+			continue;
+		if(other.getLiteralValue())
+			offset = Value(Literal(other.getLiteralValue()->integer), TYPE_INT32);
+		else if(findOffset(other).offset)
+			offset = Value(Literal(findOffset(other).offset.value()), TYPE_INT32);
+		else if(other.hasType(ValueType::LOCAL))
+			offset = other;
 		else
-			it.nextInBlock();
+			return nullptr;
+		calculations.emplace(op);
+		return param;
 	}
+	return nullptr;
+}
 
-	logging::debug() << "Removed " << numRemoved << " instructions by combining VPW writes" << logging::endl;
+/*
+ * Whether the memory address is a pointer to a single 32-bit value, which is the only type of access the VPM cache supports
+ */
+static bool isCachedWordAddress(const Value& address)
+{
+	if(!address.type.getPointerType())
+		return false;
+	const DataType& elementType = address.type.getPointerType().value()->elementType;
+	return !elementType.isComplexType() && elementType.num == 1 && elementType.getScalarBitCount() == 32;
 }
 
-static void groupVPMReads(VPM& vpm, VPMAccessGroup& group)
+/*
+ * Whether the memory instruction reads or writes a single 32-bit value from/to the memory address given
+ */
+static bool isCacheableAccess(const MemoryInstruction* instr, const Value& address)
+{
+	if(!isSimpleInstruction(instr) || !isCachedWordAddress(address))
+		return false;
+	if(instr->op == MemoryOperation::READ)
+		return address == instr->getSource() && instr->getDestination().hasType(ValueType::LOCAL);
+	if(instr->op == MemoryOperation::WRITE)
+		return address == instr->getDestination() && !instr->getSource().type.isComplexType() && instr->getSource().type.num == 1 &&
+				(instr->getSource().hasType(ValueType::LOCAL) || instr->getSource().hasType(ValueType::LITERAL));
+	return false;
+}
+
+/*
+ * Replaces the memory read with a read from the VPM cache area
+ */
+static void replaceCachedRead(Method& method, InstructionWalker it, const VPMArea& area, const Value& offset)
 {
-	if(group.genericSetups.size() != group.addressWrites.size() || group.genericSetups.size() != group.dmaSetups.size())
-		throw CompilationError(CompilationStep::OPTIMIZER, "Number of instructions do not match for combining VPR reads!");
+	const Value dest = it.get<const MemoryInstruction>()->getDestination();
+	it.erase();
+	method.vpm->insertReadCache(method, it, dest, area, offset);
+}
 
-	if(group.genericSetups.size() <= 1)
-		return;
-	logging::debug() << "Combining " << group.genericSetups.size() << " reads of consecutive memory into one DMA read... " << logging::endl;
+/*
+ * Replaces the memory write with a write into the VPM cache area
+ */
+static void replaceCachedWrite(Method& method, InstructionWalker it, const VPMArea& area, const unsigned offset)
+{
+	Value src = it.get<const MemoryInstruction>()->getSource();
+	it = insertLoadWrittenValue(method, it, src);
+	it.erase();
+	method.vpm->insertWriteCache(method, it, src, area, offset);
+}
 
-	//1. Update DMA setup to the number of rows read
+/*
+ * Whether the block is executed on every path from the start to the end of the method
+ */
+static bool isExecutedUnconditionally(Method& method, const BasicBlock& block)
+{
+	BasicBlock& startBlock = method.getBasicBlocks().front();
+	const BasicBlock& endBlock = method.getBasicBlocks().back();
+	if(&block == &startBlock || &block == &endBlock)
+		return true;
+	//check whether the end of the method can be reached without passing the block
+	FastSet<const BasicBlock*> visitedBlocks;
+	visitedBlocks.emplace(&startBlock);
+	std::vector<BasicBlock*> pendingBlocks{&startBlock};
+	while(!pendingBlocks.empty())
 	{
-		VPRSetupWrapper dmaSetupValue(group.dmaSetups.at(0).get<LoadImmediate>());
-		dmaSetupValue.dmaSetup.setNumberRows(group.genericSetups.size() % 16);
-		vpm.updateScratchSize(group.genericSetups.size() * group.groupType.getElementType().getPhysicalWidth());
+		BasicBlock* current = pendingBlocks.back();
+		pendingBlocks.pop_back();
+		if(current == &endBlock)
+			return false;
+		current->forSuccessiveBlocks([&](BasicBlock& next)
+		{
+			if(&next != &block && visitedBlocks.emplace(&next).second)
+				pendingBlocks.push_back(&next);
+		});
 	}
-	std::size_t numRemoved = 0;
+	return true;
+}
 
-	//1.1 Update generic Setup to the number of rows read
+/*
+ * Whether the block can be executed several times, since it can be reached from itself
+ */
+static bool isPartOfLoop(const BasicBlock& block)
+{
+	FastSet<const BasicBlock*> visitedBlocks;
+	std::vector<BasicBlock*> pendingBlocks;
+	block.forSuccessiveBlocks([&](BasicBlock& next)
+	{
+		if(visitedBlocks.emplace(&next).second)
+			pendingBlocks.push_back(&next);
+	});
+	while(!pendingBlocks.empty())
 	{
-		VPRSetupWrapper genericSetup(group.genericSetups.at(0).get<LoadImmediate>());
-		genericSetup.genericSetup.setNumber(group.genericSetups.size() % 16);
+		BasicBlock* current = pendingBlocks.back();
+		pendingBlocks.pop_back();
+		if(current == &block)
+			return true;
+		current->forSuccessiveBlocks([&](BasicBlock& next)
+		{
+			if(visitedBlocks.emplace(&next).second)
+				pendingBlocks.push_back(&next);
+		});
 	}
+	return false;
+}
 
-	//2. Remove all but the first generic and DMA setups
-	for(std::size_t i = 1; i < group.genericSetups.size(); ++i)
+/*
+ * Calculates the memory address of the given offset from the base address
+ */
+static InstructionWalker insertCalculateAddress(Method& method, InstructionWalker it, const Value& baseAddress, const unsigned offset, Value& address)
+{
+	if(offset == 0)
 	{
-		group.genericSetups.at(i).erase();
-		const LoadImmediate* strideSetup = group.dmaSetups.at(i).copy().nextInBlock().get<LoadImmediate>();
-		if(strideSetup == nullptr || !strideSetup->writesRegister(REG_VPM_IN_SETUP) || !VPRSetup::fromLiteral(strideSetup->getImmediate().integer).isStrideSetup())
-			throw CompilationError(CompilationStep::OPTIMIZER, "Failed to find VPR DMA stride setup for DMA setup", group.dmaSetups.at(i)->to_string());
-		group.dmaSetups.at(i).copy().nextInBlock().erase();
-		group.dmaSetups.at(i).erase();
-		numRemoved += 2;
+		address = baseAddress;
+		return it;
 	}
+	const Value offsetValue = method.addNewLocal(TYPE_INT32, "%vpm_cache_offset");
+	address = method.addNewLocal(baseAddress.type, "%vpm_cache_addr");
+	it.emplace(new LoadImmediate(offsetValue, Literal(static_cast<int64_t>(offset))));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ADD, address, baseAddress, offsetValue));
+	it.nextInBlock();
+	return it;
+}
 
-	//3. remove all Mutex acquires and releases between the first and the last write, so memory consistency is restored
-	auto it = group.addressWrites.front();
-	while(!it.isEndOfBlock() && it != group.addressWrites.back())
+bool optimizations::cacheMemoryInVPM(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
+{
+	if(method.getBasicBlocks().empty())
+		return false;
+	BasicBlock& startBlock = method.getBasicBlocks().front();
+	BasicBlock& endBlock = method.getBasicBlocks().back();
+	//the cached regions are loaded at the start of the kernel, which therefore must not be jumped to
+	bool isStartJumpedTo = false;
+	startBlock.forPredecessors([&isStartJumpedTo](InstructionWalker it) -> void
 	{
-		if(it.get() && it->writesRegister(REG_MUTEX))
+		isStartJumpedTo = true;
+	});
+	if(isStartJumpedTo)
+		return false;
+	//the written regions are written back at the end of the kernel
+	const bool hasEndBlock = endBlock.getLabel()->getLabel()->name == BasicBlock::LAST_BLOCK;
+
+	/*
+	 * 1. find all accesses to memory regions referenced by parameters
+	 */
+	FastMap<const Parameter*, CachedMemoryRegion> regions;
+	bool hasSynchronization = false;
+	bool hasMemoryWrites = false;
+	std::size_t numMemoryAccesses = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
 		{
-			it = it.erase();
-			++numRemoved;
+			if(it.get() == nullptr)
+				continue;
+			if(it.has<MemoryBarrier>() || it.has<SemaphoreAdjustment>())
+				hasSynchronization = true;
+			const MemoryInstruction* memoryInstruction = it.get<const MemoryInstruction>();
+			if(memoryInstruction != nullptr)
+			{
+				++numMemoryAccesses;
+				hasMemoryWrites = hasMemoryWrites || memoryInstruction->op != MemoryOperation::READ;
+				//the value written can be an address too, e.g. when storing a pointer
+				for(const Value& address : {memoryInstruction->getSource(), memoryInstruction->getDestination()})
+				{
+					Value offset(UNDEFINED_VALUE);
+					FastSet<const IntermediateInstruction*> calculations;
+					const Parameter* param = findCachedBaseAndOffset(address, offset, calculations);
+					if(param == nullptr)
+						continue;
+					CachedMemoryRegion& region = regions[param];
+					region.addressCalculations.insert(calculations.begin(), calculations.end());
+					if(isCacheableAccess(memoryInstruction, address))
+						region.accesses.push_back(CachedMemoryAccess{it, offset, memoryInstruction->op == MemoryOperation::WRITE});
+					else
+						region.isCacheable = false;
+				}
+				continue;
+			}
+			//memory accesses already mapped to the periphery, e.g. by intrinsics, cannot be cached
+			const bool isWrite = it->writesRegister(REG_VPM_OUT_ADDR);
+			if(getTMURequest(it.get()) == nullptr && !isWrite && !it->writesRegister(REG_VPM_IN_ADDR))
+				continue;
+			++numMemoryAccesses;
+			hasMemoryWrites = hasMemoryWrites || isWrite;
+			Value offset(UNDEFINED_VALUE);
+			FastSet<const IntermediateInstruction*> calculations;
+			const Parameter* param = it.has<MoveOperation>() ? findCachedBaseAndOffset(it.get<MoveOperation>()->getSource(), offset, calculations) : nullptr;
+			if(param != nullptr)
+				regions[param].isCacheable = false;
 		}
-		else if(it.get() && it->readsRegister(REG_MUTEX))
+	}
+
+	/*
+	 * 2. select the regions to cache and replace their accesses
+	 */
+	FastMap<const BasicBlock*, bool> loopBlocks;
+	std::size_t numCachedRegions = 0;
+	for(Parameter& param : method.parameters)
+	{
+		auto regionIt = regions.find(&param);
+		if(regionIt == regions.end() || !regionIt->second.isCacheable || !param.type.getPointerType())
+			continue;
+		const CachedMemoryRegion& region = regionIt->second;
+		const AddressSpace addressSpace = param.type.getPointerType().value()->addressSpace;
+		if((addressSpace != AddressSpace::GLOBAL && addressSpace != AddressSpace::CONSTANT) || has_flag(param.decorations, ParameterDecorations::VOLATILE))
+			continue;
+
+		//all uses of the parameter need to be accesses to be cached
+		FastSet<const LocalUser*> accessInstructions;
+		for(const CachedMemoryAccess& access : region.accesses)
+			accessInstructions.emplace(access.instruction.get());
+		bool allUsesCached = true;
+		FastSet<const Local*> visitedLocals;
+		std::vector<const Local*> pendingLocals{&param};
+		while(allUsesCached && !pendingLocals.empty())
 		{
-			it = it.erase();
-			++numRemoved;
+			const Local* local = pendingLocals.back();
+			pendingLocals.pop_back();
+			if(!visitedLocals.emplace(local).second)
+				continue;
+			local->forUsers(LocalUser::Type::READER, [&](const LocalUser* user) -> void
+			{
+				if(accessInstructions.find(user) != accessInstructions.end())
+					return;
+				const IntermediateInstruction* instr = dynamic_cast<const IntermediateInstruction*>(user);
+				if(instr == nullptr || region.addressCalculations.find(instr) == region.addressCalculations.end())
+					allUsesCached = false;
+				else
+					pendingLocals.push_back(instr->getOutput()->local);
+			});
+		}
+		if(!allUsesCached)
+			continue;
+
+		//the memory region must not be accessed via any other (possibly aliasing) pointer in a way which could observe the caching
+		const bool isWritten = std::any_of(region.accesses.begin(), region.accesses.end(), [](const CachedMemoryAccess& access) -> bool { return access.isWrite; });
+		const bool isAliasFree = addressSpace == AddressSpace::CONSTANT || has_flag(param.decorations, ParameterDecorations::RESTRICT);
+		if(isWritten)
+		{
+			//every QPU writes back its own copy at the end, so all writes need to be executed by every QPU and cannot be observed by other QPUs
+			if(!hasEndBlock || hasSynchronization || (!isAliasFree && numMemoryAccesses != region.accesses.size()))
+				continue;
+			if(std::any_of(region.accesses.begin(), region.accesses.end(), [&method](const CachedMemoryAccess& access) -> bool
+			{
+				return access.isWrite && (!access.offset.hasType(ValueType::LITERAL) || !isExecutedUnconditionally(method, *access.instruction.copy().getBasicBlock()));
+			}))
+				continue;
+		}
+		else if(!isAliasFree && hasMemoryWrites)
+			continue;
+
+		//determine the bounds of the cached region
+		bool hasVariableOffsets = false;
+		int64_t minOffset = std::numeric_limits<int64_t>::max();
+		int64_t maxOffset = std::numeric_limits<int64_t>::min();
+		std::size_t numAccesses = 0;
+		for(const CachedMemoryAccess& access : region.accesses)
+		{
+			if(access.offset.hasType(ValueType::LITERAL))
+			{
+				minOffset = std::min(minOffset, access.offset.literal.integer);
+				maxOffset = std::max(maxOffset, access.offset.literal.integer);
+				if(access.offset.literal.integer % 4 != 0)
+					//unaligned access
+					minOffset = -1;
+			}
+			else
+				hasVariableOffsets = true;
+			const BasicBlock* block = access.instruction.copy().getBasicBlock();
+			if(loopBlocks.find(block) == loopBlocks.end())
+				loopBlocks.emplace(block, isPartOfLoop(*block));
+			numAccesses += loopBlocks.at(block) ? LOOP_ACCESS_WEIGHT : 1;
+		}
+		if(numAccesses < MIN_CACHED_ACCESSES || (minOffset < 0 && minOffset != std::numeric_limits<int64_t>::max()))
+			continue;
+		unsigned startOffset = 0;
+		unsigned regionSize = 0;
+		if(hasVariableOffsets)
+		{
+			//accesses with offsets unknown at compile-time require the whole buffer to be cached, so its size needs to be known
+			if(param.maxByteOffset == SIZE_MAX || param.maxByteOffset > std::numeric_limits<unsigned>::max() || (maxOffset >= 0 && static_cast<std::size_t>(maxOffset + 4) > param.maxByteOffset))
+				continue;
+			regionSize = static_cast<unsigned>(param.maxByteOffset);
 		}
 		else
+		{
+			startOffset = static_cast<unsigned>(minOffset);
+			regionSize = static_cast<unsigned>(maxOffset + 4 - minOffset);
+		}
+
+		const VPMArea* area = method.vpm->addArea(&param, regionSize, isWritten);
+		if(area == nullptr)
+		{
+			logging::debug() << "Not enough VPM space left to cache " << regionSize << " bytes of " << param.to_string() << logging::endl;
+			continue;
+		}
+		logging::debug() << "Caching " << regionSize << " bytes at offset " << startOffset << " of " << param.to_string() << " in VPM for " << region.accesses.size() << " accesses" << logging::endl;
+
+		//load the cached region once at the start of the kernel
+		Value baseAddress(UNDEFINED_VALUE);
+		auto it = insertCalculateAddress(method, startBlock.begin().nextInBlock(), param.createReference(), startOffset, baseAddress);
+		method.vpm->insertFillCache(method, it, baseAddress, *area, regionSize);
+
+		std::set<unsigned> writtenWords;
+		for(const CachedMemoryAccess& access : region.accesses)
+		{
+			Value offset = access.offset;
+			if(offset.hasType(ValueType::LITERAL))
+				offset = Value(Literal(offset.literal.integer - static_cast<int64_t>(startOffset)), TYPE_INT32);
+			if(access.isWrite)
+			{
+				writtenWords.emplace(static_cast<unsigned>(offset.literal.integer / 4));
+				replaceCachedWrite(method, access.instruction, *area, static_cast<unsigned>(offset.literal.integer));
+			}
+			else
+				replaceCachedRead(method, access.instruction, *area, offset);
+		}
+
+		//write back all words written once at the end of the kernel, grouped into consecutive words of the same VPM row
+		if(isWritten)
+		{
+			it = endBlock.begin().nextInBlock();
+			it.emplace(new MutexLock(MutexAccess::LOCK));
 			it.nextInBlock();
+			auto wordIt = writtenWords.begin();
+			while(wordIt != writtenWords.end())
+			{
+				const unsigned firstWord = *wordIt;
+				unsigned numWords = 1;
+				while(++wordIt != writtenWords.end() && *wordIt == firstWord + numWords && *wordIt % 16 != 0)
+					++numWords;
+				Value address(UNDEFINED_VALUE);
+				it = insertCalculateAddress(method, it, param.createReference(), startOffset + firstWord * 4, address);
+				it = method.vpm->insertFlushCache(method, it, address, *area, firstWord, numWords, false);
+			}
+			it.emplace(new MutexLock(MutexAccess::RELEASE));
+		}
+		++numCachedRegions;
 	}
 
-	//4. remove all but the first address writes (and the following DMA writes)
-	for(std::size_t i = 1; i < group.addressWrites.size(); ++i)
+	logging::debug() << "Cached " << numCachedRegions << " memory regions in VPM" << logging::endl;
+	PROFILE_COUNTER(9030, "VPM cached memory regions", numCachedRegions);
+	return numCachedRegions > 0;
+}
+
+/*
+ * Whether the given instruction can change the memory accessed by other memory instructions, e.g. by writing memory or by synchronizing with other QPUs
+ */
+static bool mayChangeMemory(const IntermediateInstruction* instr)
+{
+	const MemoryInstruction* memoryInstruction = dynamic_cast<const MemoryInstruction*>(instr);
+	if(memoryInstruction != nullptr)
+		return memoryInstruction->op != MemoryOperation::READ;
+	//calls to built-in functions which are not yet intrinsified might access memory too
+	return dynamic_cast<const MethodCall*>(instr) != nullptr || dynamic_cast<const MemoryBarrier*>(instr) != nullptr || dynamic_cast<const SemaphoreAdjustment*>(instr) != nullptr ||
+			dynamic_cast<const MutexLock*>(instr) != nullptr || instr->writesRegister(REG_VPM_OUT_ADDR);
+}
+
+bool optimizations::copyMemoryViaVPM(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
+{
+	std::size_t numCopies = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
 	{
-		if(!group.addressWrites.at(i).copy().nextInBlock()->readsRegister(group.isVPMWrite ? REG_VPM_OUT_WAIT : REG_VPM_IN_WAIT))
-			throw CompilationError(CompilationStep::OPTIMIZER, "Failed to find VPR wait for address write", group.addressWrites.at(i)->to_string());
-		group.addressWrites.at(i).copy().nextInBlock().erase();
-		group.addressWrites.at(i).erase();
-		numRemoved += 2;
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			const MemoryInstruction* write = it.get<const MemoryInstruction>();
+			if(write == nullptr || write->op != MemoryOperation::WRITE || write->hasConditionalExecution())
+				continue;
+			//the value written needs to be read from memory and only be used for the write
+			const Value src = write->getSource();
+			if(!src.hasType(ValueType::LOCAL) || src.type.isComplexType() || src.type.getVectorWidth(true) != src.type.getVectorWidth() ||
+					src.local->getUsers(LocalUser::Type::READER).size() != 1 || write->getDestination().hasLocal(src.local))
+				continue;
+			const MemoryInstruction* read = dynamic_cast<const MemoryInstruction*>(src.local->getSingleWriter());
+			if(read == nullptr || read->op != MemoryOperation::READ || read->hasConditionalExecution() || read->getSourceElementType() != src.type)
+				continue;
+			//the memory is now read at the position of the write, so it must not be changed in between
+			const Value srcAddress = read->getSource();
+			bool hasHazards = false;
+			auto readIt = it.copy().previousInBlock();
+			while(!readIt.isStartOfBlock() && readIt.get() != read)
+			{
+				if(readIt.get() != nullptr && (mayChangeMemory(readIt.get()) || (srcAddress.hasType(ValueType::LOCAL) && readIt->writesLocal(srcAddress.local))))
+					hasHazards = true;
+				readIt.previousInBlock();
+			}
+			if(readIt.get() != read || hasHazards)
+				continue;
+
+			logging::debug() << "Copying " << src.type.to_string() << " from " << srcAddress.to_string() << " via VPM: " << write->to_string() << logging::endl;
+			it.reset((new MemoryInstruction(MemoryOperation::COPY, write->getDestination(), srcAddress, INT_ONE, write->useMutex))->copyExtrasFrom(write));
+			readIt.erase();
+			++numCopies;
+		}
 	}
+	PROFILE_COUNTER(9040, "Memory copies via VPM", numCopies);
+	return numCopies > 0;
+}
 
-	logging::debug() << "Removed " << numRemoved << " instructions by combining VPR reads" << logging::endl;
+/*
+ * Lowers the memory read into the request and the response of a general memory lookup via the TMU
+ */
+static InstructionWalker lowerMemoryRead(Method& method, InstructionWalker it)
+{
+	const MemoryInstruction* read = it.get<const MemoryInstruction>();
+	//reading via the TMU is faster than via DMA and does not need to lock the VPM
+	it = periphery::insertReadVectorFromTMU(method, it, read->getDestination(), read->getSource());
+	return it.erase();
 }
 
-void optimizations::combineVPMAccess(const Module& module, Method& method, const Configuration& config)
+/*
+ * Lowers the given memory reads (which directly follow each other) into general memory lookups, which are all issued at once:
+ * the requests are alternated between both TMUs and are all issued before the first response is read.
+ */
+static InstructionWalker lowerMemoryReads(Method& method, InstructionWalker it, const std::size_t numReads)
 {
-	//combine configurations of VPM (VPW/VPR) which have the same values
+	std::vector<Value> addresses;
+	addresses.reserve(numReads);
+	auto readIt = it;
+	for(std::size_t i = 0; i < numReads; ++i, readIt.nextInBlock())
+	{
+		const MemoryInstruction* read = readIt.get<const MemoryInstruction>();
+		addresses.push_back(UNDEFINED_VALUE);
+		it = periphery::insertTMURequest(method, it, read->getSource(), read->getDestination().type, addresses.back(), i % 2 == 0 ? TMU0 : TMU1);
+	}
+	//the responses are read in the order of the requests, so they match with the FIFOs of both TMUs
+	for(std::size_t i = 0; i < numReads; ++i)
+	{
+		it = periphery::insertTMUResponse(method, it, it.get<const MemoryInstruction>()->getDestination(), addresses[i], i % 2 == 0 ? TMU0 : TMU1);
+		it.erase();
+	}
+	return it;
+}
 
-	//TODO for now, this cannot handle RAM->VPM, VPM->RAM only access as well as VPM->QPU or QPU->VPM
+/*
+ * Returns the number of memory reads starting at the given position, which can be issued at once, since none of them reads the result of another one
+ */
+static std::size_t findBatchedReads(InstructionWalker it, const std::size_t maxBatchedReads)
+{
+	std::vector<const IntermediateInstruction*> reads;
+	while(!it.isEndOfBlock() && reads.size() < maxBatchedReads && getBatchableRead(it.get()) != nullptr)
+	{
+		const IntermediateInstruction* read = it.get();
+		if(std::any_of(reads.begin(), reads.end(), [read](const IntermediateInstruction* other) -> bool { return dependsOn(other, read); }))
+			break;
+		reads.push_back(read);
+		it.nextInBlock();
+	}
+	return reads.size();
+}
 
-	// run within all basic blocks
+FastSet<const LocalUser*> optimizations::lowerMemoryAccess(const Module& module, Method& method, const Configuration& config)
+{
+	const std::size_t maxBatchedReads = getMaxBatchedReads(config);
+	std::size_t numBatchedReads = 0;
+	FastSet<const LocalUser*> loweredInstructions;
 	for(BasicBlock& block : method.getBasicBlocks())
 	{
-		auto it = block.begin();
+		InstructionWalker it = block.begin();
 		while(!it.isEndOfBlock())
 		{
-			VPMAccessGroup group;
-			it = findGroupOfVPMAccess(*method.vpm.get(), it, block.end(), group);
-			if(group.addressWrites.size() > 1)
+			const MemoryInstruction* memoryInstruction = it.get<const MemoryInstruction>();
+			if(memoryInstruction == nullptr)
 			{
-				if(group.isVPMWrite)
-					groupVPMWrites(*method.vpm.get(), group);
-				else
-					groupVPMReads(*method.vpm.get(), group);
+				it.nextInBlock();
+				continue;
+			}
+			//the copies and fills are unrolled into the single accesses of the periphery
+			if(memoryInstruction->op != MemoryOperation::READ && memoryInstruction->op != MemoryOperation::WRITE && !memoryInstruction->getNumEntries().hasType(ValueType::LITERAL))
+				throw CompilationError(CompilationStep::OPTIMIZER, "Accessing memory with non-constant size is not yet supported", memoryInstruction->to_string());
+			logging::debug() << "Lowering memory access: " << memoryInstruction->to_string() << logging::endl;
+			//the lowered instructions are inserted between these two positions
+			const InstructionWalker previous = it.copy().previousInBlock();
+			switch(memoryInstruction->op)
+			{
+				case MemoryOperation::READ:
+				{
+					const std::size_t numReads = findBatchedReads(it, maxBatchedReads);
+					if(numReads > 1)
+					{
+						it = lowerMemoryReads(method, it, numReads);
+						numBatchedReads += numReads;
+					}
+					else
+						it = lowerMemoryRead(method, it);
+					break;
+				}
+				case MemoryOperation::WRITE:
+					it = periphery::insertWriteDMA(method, it, memoryInstruction->getSource(), memoryInstruction->getDestination(), memoryInstruction->useMutex);
+					it.erase();
+					break;
+				case MemoryOperation::COPY:
+					//copy the memory directly from RAM to RAM via the VPM
+					it = method.vpm->insertCopyRAM(method, it, memoryInstruction->getDestination(), memoryInstruction->getSource(),
+							static_cast<unsigned>(memoryInstruction->getNumEntries().literal.integer) * memoryInstruction->getSourceElementType().getPhysicalWidth(), nullptr, memoryInstruction->useMutex);
+					it.erase();
+					break;
+				case MemoryOperation::FILL:
+					if(memoryInstruction->useMutex)
+					{
+						it.emplace(new MutexLock(MutexAccess::LOCK));
+						it.nextInBlock();
+					}
+					it = method.vpm->insertWriteVPM(it, memoryInstruction->getSource(), nullptr, false);
+					it = method.vpm->insertFillRAM(method, it, memoryInstruction->getDestination(), memoryInstruction->getSourceElementType(), static_cast<unsigned>(memoryInstruction->getNumEntries().literal.integer), nullptr, false);
+					if(memoryInstruction->useMutex)
+					{
+						it.emplace(new MutexLock(MutexAccess::RELEASE));
+						it.nextInBlock();
+					}
+					it.erase();
+					break;
+			}
+			for(auto lowered = previous.copy().nextInBlock(); lowered != it; lowered.nextInBlock())
+			{
+				if(lowered.get() != nullptr)
+					loweredInstructions.emplace(lowered.get());
 			}
 		}
 	}
+	logging::debug() << "Issued " << numBatchedReads << " memory reads together with other reads" << logging::endl;
+
+	//the critical sections of successive memory writes can only be merged after they are inserted
+	std::size_t numMergedSections = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+		numMergedSections += mergeCriticalSections(block);
+	logging::debug() << "Merged " << numMergedSections << " critical sections" << logging::endl;
+	PROFILE_COUNTER(9011, "Merged critical sections", numMergedSections);
 
 	// clean up empty instructions
 	method.cleanEmptyInstructions();
-	PROFILE_COUNTER(9010, "Scratch memory size", method.vpm->getScratchArea().size);
+	return loweredInstructions;
 }
 
 InstructionWalker optimizations::accessGlobalData(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
@@ -460,7 +1246,7 @@ InstructionWalker optimizations::accessGlobalData(const Module& module, Method&
 	return it;
 }
 
-void optimizations::spillLocals(const Module& module, Method& method, const Configuration& config)
+bool optimizations::spillLocals(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
 	static const std::size_t MINIMUM_THRESHOLD = 128; /* TODO some better limit */
 	//TODO need to know how much of the VPM is still free (need per-kernel VPM object)
@@ -473,7 +1259,7 @@ void optimizations::spillLocals(const Module& module, Method& method, const Conf
 	 * 1. find all candidate locals for spilling:
 	 * - no labels (since they are never mapped to registers)
 	 * - only one write (for now, for easier handling)
-	 * - not used only locally within a minimum range, since those locals are more likely to be mapped to registers
+	 * - live for at least a minimum number of instructions, since locals used only locally are more likely to be mapped to registers
 	 */
 	//tracks the locals and their writing instructions
 	FastMap<const Local*, InstructionWalker> spillingCandidates;
@@ -485,47 +1271,53 @@ void optimizations::spillLocals(const Module& module, Method& method, const Conf
 		//or maybe never (not yet), e.g. for hidden parameter
 		//or written several times but read only once
 		//TODO also include explicit parameters
-		auto numWrites = pair.second.getUsers(LocalUser::Type::WRITER).size();
-		auto numReads = pair.second.getUsers(LocalUser::Type::READER).size();
+		auto numWrites = pair.second.countUsers(LocalUser::Type::WRITER);
+		auto numReads = pair.second.countUsers(LocalUser::Type::READER);
 		if((numWrites <= 1 && numReads > 0) || (numWrites >= 1 && numReads == 1))
 		{
 			spillingCandidates.emplace(&pair.second, InstructionWalker{});
 		}
 	}
 
-	InstructionWalker it = method.walkAllInstructions();
-	//skip all leading empty basic blocks
-	while(!it.isEndOfMethod() && it.has<intermediate::BranchLabel>())
-		it.nextInMethod();
+	//count the instructions the candidates are live at and find their writes
+	const analysis::LivenessAnalysis& liveness = analyses.getLiveness(true);
+	const analysis::LocalNumbering& numbering = liveness.getLocalNumbering();
+	std::vector<std::size_t> liveInstructions(numbering.size(), 0);
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		liveness.forInstructionsInBlock(block, [&liveInstructions, &spillingCandidates](InstructionWalker it, const analysis::BitSet& liveAfter) -> void
+		{
+			liveAfter.forAll([&liveInstructions](std::size_t number) -> void
+			{
+				++liveInstructions[number];
+			});
+			if(it->hasValueType(ValueType::LOCAL))
+			{
+				auto candIt = spillingCandidates.find(it->getOutput()->local);
+				//we walk backwards, so the first write is found last
+				if(candIt != spillingCandidates.end())
+					candIt->second = it;
+			}
+		});
+	}
 	auto candIt = spillingCandidates.begin();
-	while(!it.isEndOfMethod() && candIt != spillingCandidates.end())
+	while(candIt != spillingCandidates.end())
 	{
-		//check if only read the first X instructions (from the start of the kernel), e.g. for (hidden) parameter, where the next check fails,
-		//since they are not yet written anywhere
-		if(method.isLocallyLimited(it, candIt->first, MINIMUM_THRESHOLD))
+		const Optional<std::size_t> number = numbering.getNumber(candIt->first);
+		//locals live only for a short range are more likely to be mapped to registers
+		if(!number || liveInstructions[number.value()] < MINIMUM_THRESHOLD)
 			candIt = spillingCandidates.erase(candIt);
 		else
 			++candIt;
 	}
-	while(!it.isEndOfMethod() && !spillingCandidates.empty())
-	{
-		//TODO if at some point all Basic block have references to their used locals, remove all locals which are used just in one basic block instead of this logic??
-		if(it->hasValueType(ValueType::LOCAL) && spillingCandidates.find(it->getOutput()->local) != spillingCandidates.end())
-		{
-			if(method.isLocallyLimited(it, it->getOutput()->local, MINIMUM_THRESHOLD))
-				spillingCandidates.erase(it->getOutput()->local);
-			else
-				spillingCandidates.at(it->getOutput()->local) = it;
-		}
-		it.nextInMethod();
-	}
 
 	for(const auto& pair : spillingCandidates)
 	{
-		logging::debug() << "Spilling candidate: " << pair.first->to_string() << " (" << pair.first->getUsers(LocalUser::Type::WRITER).size() << " writes, " << pair.first->getUsers(LocalUser::Type::READER).size() << " reads)" << logging::endl;
+		logging::debug() << "Spilling candidate: " << pair.first->to_string() << " (" << pair.first->countUsers(LocalUser::Type::WRITER) << " writes, " << pair.first->countUsers(LocalUser::Type::READER) << " reads)" << logging::endl;
 	}
 
-	//TODO do not preemptively spill, only on register conflicts. Which case??
+	//locals are not spilled preemptively, the actual spilling happens on register conflicts (see qpu_asm::spillLocals)
+	return false;
 }
 
 static InstructionWalker accessStackAllocations(const Module& module, Method& method, InstructionWalker it)
@@ -579,7 +1371,7 @@ static InstructionWalker accessStackAllocations(const Module& module, Method& me
 	return it.nextInMethod();
 }
 
-void optimizations::resolveStackAllocations(const Module& module, Method& method, const Configuration& config)
+bool optimizations::resolveStackAllocations(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
 	//1. calculate the offsets from the start of one QPU's "stack", heed alignment!
 	method.calculateStackOffsets();
@@ -591,4 +1383,5 @@ void optimizations::resolveStackAllocations(const Module& module, Method& method
 	{
 		it = accessStackAllocations(module, method, it);
 	}
+	return true;
 }
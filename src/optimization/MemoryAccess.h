@@ -8,27 +8,70 @@
 #define OPTIMIZATION_MEMORYACCESS_H
 
 #include "config.h"
+#include "../performance.h"
 
 namespace vc4c
 {
 	class Method;
 	class Module;
 	class InstructionWalker;
+	class LocalUser;
 
 	namespace optimizations
 	{
+		class AnalysisManager;
+
+		/*
+		 * Combines the writes of single values to consecutive memory within a basic block into writes into consecutive rows of the VPM, followed by a single DMA write.
+		 * Writes to other (non-aliasing) memory in between are written via their own row of the VPM, so they do not interrupt the group.
+		 * NOTE: This runs on the abstract memory instructions and inserts the VPM/DMA accesses for the combined writes itself
+		 */
+		bool combineVPMAccess(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
+
+		/*
+		 * Software-pipelining of the memory reads within the basic blocks:
+		 * independent memory reads (together with the calculation of their addresses) are moved up directly behind the previous reads, as far as their dependencies allow.
+		 * Reads directly following each other are then issued at once when lowered (see #lowerMemoryAccess), keeping up to the depth of the request FIFOs of both TMUs in flight.
+		 * NOTE: This runs on the abstract memory instructions, before they are lowered
+		 */
+		bool pipelineTMULoads(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
+
+		/*
+		 * Replaces memory reads whose value is only written back to memory with a memory copy, which is lowered to a direct copy from RAM into VPM and back into RAM via DMA
+		 * and does not require the data to be read into the QPU.
+		 * The memory is now read at the position of the write, so the memory read must not be modified in between.
+		 * NOTE: This runs on the abstract memory instructions, before they are lowered (see #lowerMemoryAccess)
+		 */
+		bool copyMemoryViaVPM(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
+
+		/*
+		 * Caches memory regions (referenced by kernel parameters) which are accessed repeatedly in the VPM:
+		 * - the region is loaded into the VPM via DMA once at the start of the kernel
+		 * - all reads/writes of single 32-bit words are replaced with accesses to the VPM
+		 * - the words written are written back into memory once at the end of the kernel
+		 * Memory regions are only cached, if the caching cannot be observed, e.g. by other accesses via aliasing pointers
+		 * NOTE: This runs on the abstract memory instructions, before they are lowered
+		 */
+		bool cacheMemoryInVPM(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
+
 		/*
-		 * Combine consecutive configuration of VPW/VPR with the same settings
+		 * Lowers the abstract memory instructions remaining after the memory optimizations into the actual accesses:
+		 * - reads are executed via the TMU, reads directly following each other are issued at once, alternating between both TMUs
+		 * - writes are executed via VPM and DMA
+		 * - copies and fills are executed via DMA from/to the VPM
+		 * Afterwards, successive critical sections are merged.
+		 *
+		 * Returns the instructions inserted, which still need to be handled by the single steps (e.g. to load literal values)
 		 */
-		void combineVPMAccess(const Module& module, Method& method, const Configuration& config);
+		FastSet<const LocalUser*> lowerMemoryAccess(const Module& module, Method& method, const Configuration& config);
 
 		InstructionWalker accessGlobalData(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
 
 		/*
-		 * Spills long-living locals which are rarely read into the VPM to be cached there.
-		 * Also splits the uses before and after being spilled into several locals
+		 * Determines long-living locals which are rarely read as candidates for spilling into the VPM.
+		 * NOTE: This only reports the candidates, locals are spilled by the code generator for register-conflicts which cannot be resolved otherwise
 		 */
-		void spillLocals(const Module& module, Method& method, const Configuration& config);
+		bool spillLocals(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 
 		//TODO (Optional optimization): lower stack allocations into registers (e.g. for vectors/scalars)
 		/*
@@ -37,7 +80,7 @@ namespace vc4c
 		 * - removes the life-time instructions
 		 * - maps the addresses to offsets from global-data pointer (see #accessGlobalData)
 		 */
-		void resolveStackAllocations(const Module& module, Method& method, const Configuration& config);
+		bool resolveStackAllocations(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 	} // namespace optimizations
 } // namespace vc4c
 
@@ -6,10 +6,13 @@
 
 #include "Optimizer.h"
 
-#include "../BackgroundWorker.h"
+#include "../ControlFlowGraph.h"
+#include "../ThreadPool.h"
+#include "../analysis/LivenessAnalysis.h"
 #include "../intrinsics/Intrinsics.h"
 #include "../Profiler.h"
 #include "Combiner.h"
+#include "ControlFlow.h"
 #include "Eliminator.h"
 #include "Inliner.h"
 #include "LiteralValues.h"
@@ -20,7 +23,68 @@
 using namespace vc4c;
 using namespace vc4c::optimizations;
 
-OptimizationPass::OptimizationPass(const std::string& name, const Pass pass, const std::size_t index) : name(name), index(index), pass(pass)
+AnalysisManager::AnalysisManager(Method& method) : method(method)
+{
+}
+
+AnalysisManager::~AnalysisManager() = default;
+
+ControlFlowGraph& AnalysisManager::getControlFlowGraph()
+{
+	if(!cfg)
+		cfg.reset(new ControlFlowGraph(ControlFlowGraph::createCFG(method)));
+	return *cfg;
+}
+
+DataDependencyGraph& AnalysisManager::getDependencyGraph()
+{
+	if(!dependencyGraph)
+		dependencyGraph.reset(new DataDependencyGraph(DataDependencyGraph::createDependencyGraph(method)));
+	return *dependencyGraph;
+}
+
+const analysis::LivenessAnalysis& AnalysisManager::getLiveness(const bool trackConditionalWrites)
+{
+	std::unique_ptr<analysis::LivenessAnalysis>& result = trackConditionalWrites ? conditionalLiveness : liveness;
+	if(!result)
+		result.reset(new analysis::LivenessAnalysis(method, trackConditionalWrites));
+	return *result;
+}
+
+void AnalysisManager::require(const Analysis analyses)
+{
+	if(has_flag(analyses, Analysis::CONTROL_FLOW_GRAPH))
+		getControlFlowGraph();
+	if(has_flag(analyses, Analysis::DATA_DEPENDENCY_GRAPH))
+		getDependencyGraph();
+	//which kind of liveness is required is only known to the pass, so it is calculated on first access
+}
+
+void AnalysisManager::invalidate(const Analysis preserved)
+{
+	if(!has_flag(preserved, Analysis::CONTROL_FLOW_GRAPH))
+		cfg.reset();
+	if(!has_flag(preserved, Analysis::DATA_DEPENDENCY_GRAPH))
+		dependencyGraph.reset();
+	if(!has_flag(preserved, Analysis::LIVENESS))
+	{
+		liveness.reset();
+		conditionalLiveness.reset();
+	}
+}
+
+OptimizationPass::OptimizationPass(const std::string& name, const Pass pass, const std::size_t index) :
+	name(name), index(index), requiredAnalyses(Analysis::NONE), preservedAnalyses(Analysis::NONE),
+	pass([pass](const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses) -> bool
+	{
+		pass(module, method, config);
+		return true;
+	})
+{
+}
+
+OptimizationPass::OptimizationPass(const std::string& name, const AnalysisPass pass, const std::size_t index, const Analysis required, const Analysis preserved) :
+	name(name), index(index), requiredAnalyses(required), preservedAnalyses(preserved), pass(pass)
 {
 }
 
@@ -31,7 +95,15 @@ bool OptimizationPass::operator <(const OptimizationPass& other) const
 
 void OptimizationPass::operator ()(const Module& module, Method& method, const Configuration& config) const
 {
-	pass(module, method, config);
+	AnalysisManager analyses(method);
+	(*this)(module, method, config, analyses);
+}
+
+void OptimizationPass::operator ()(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses) const
+{
+	analyses.require(requiredAnalyses);
+	if(pass(module, method, config, analyses))
+		analyses.invalidate(preservedAnalyses);
 }
 
 bool OptimizationPass::operator ==(const OptimizationPass& other) const
@@ -81,7 +153,6 @@ static const std::set<OptimizationStep> SINGLE_STEPS = {
 		//maps access to global data to the offset in the code
 		OptimizationStep("MapGlobalDataToAddress", accessGlobalData, 50),
 		//calculates constant values where applicable
-		//TODO sometimes reverts immediate-loads which are then again converted to immediate-loads??
 		OptimizationStep("CalculateConstantValue", calculateConstantInstruction, 60),
 		//eliminates/rewrites useless instructions (e.g. y = x + 0 -> y = x)
 		OptimizationStep("EliminateUselessInstruction", eliminateUselessInstruction, 70),
@@ -99,50 +170,144 @@ static const std::set<OptimizationStep> SINGLE_STEPS = {
 		OptimizationStep("CombineSettingSameFlags", combineSameFlags, 130)
 };
 
-static void runSingleSteps(const Module& module, Method& method, const Configuration& config)
+/*
+ * Runs the single steps on all instructions (if visitAll is set) or only on the given instructions
+ *
+ * Returns whether any instruction was modified
+ */
+static bool runSingleStepsOn(const Module& module, Method& method, const Configuration& config, FastSet<const LocalUser*> pendingInstructions, const bool visitAll)
 {
 	auto& s = (logging::debug() << "Running steps: ");
 	for(const OptimizationStep& step : SINGLE_STEPS)
 		s << step.name << ", ";
 	s << logging::endl;
 
-	//since an optimization-step can be run on the result of the previous step,
-	//we can't just pass the resulting iterator (pointing behind the optimization result) into the next optimization-step
-	//but since lists do not reallocate elements at inserting/removing, we can re-use the previous iterator
-	auto it = method.walkAllInstructions();
-	//this construct with previous iterator is required, because the iterator could be invalidated (if the underlying node is removed)
-	auto prevIt = it;
-	while(!it.isEndOfMethod())
+	/*
+	 * A modification by a step can enable another step on a different instruction (e.g. a constant calculated can make an instruction using it useless).
+	 * For modifications of instructions not yet visited in the current round, this is handled by visiting them afterwards,
+	 * all other instructions using the locals of a modified instruction are re-visited in an additional round.
+	 *
+	 * The instructions are tracked by their address only, so an address re-used for a new instruction might result in an additional visit, which does not modify anything.
+	 */
+	std::vector<const Local*> usedLocals;
+	bool changedMethod = false;
+	for(unsigned round = 0; round <= config.additionalOptimizationRounds; ++round)
 	{
-		for(const OptimizationStep& step : SINGLE_STEPS)
+		if(!visitAll || round > 0)
+		{
+			if(pendingInstructions.empty())
+				break;
+			logging::debug() << "Re-visiting " << pendingInstructions.size() << " instructions affected by modifications" << logging::endl;
+			PROFILE_COUNTER(2050, "SingleSteps re-visits", pendingInstructions.size());
+		}
+
+		//since an optimization-step can be run on the result of the previous step,
+		//we can't just pass the resulting iterator (pointing behind the optimization result) into the next optimization-step
+		//but since lists do not reallocate elements at inserting/removing, we can re-use the previous iterator
+		auto it = method.walkAllInstructions();
+		//this construct with previous iterator is required, because the iterator could be invalidated (if the underlying node is removed)
+		auto prevIt = it;
+		while(!it.isEndOfMethod())
 		{
-			PROFILE_START_DYNAMIC(step.name);
-			auto newIt = step(module, method, it, config);
-			//we can't just test newIt == it here, since if we replace the content of the iterator instead of deleting it, the iterators are still the same, even if we emplace instructions before
-			if(newIt.copy().previousInMethod() != prevIt || newIt != it)
-				it = prevIt;
-			PROFILE_END_DYNAMIC(step.name);
+			const intermediate::IntermediateInstruction* instr = it.get();
+			//only the first round visits all instructions
+			if(instr != nullptr && (pendingInstructions.erase(instr) > 0 || (visitAll && round == 0)))
+			{
+				//the instruction could be removed by the steps, so we need to remember its locals
+				usedLocals.clear();
+				instr->forUsedLocals([&usedLocals](const Local* local, LocalUser::Type type) -> void
+				{
+					//re-visiting all branches to a label modified does not enable any optimization
+					if(local->type != TYPE_LABEL)
+						usedLocals.push_back(local);
+				});
+				bool modified = false;
+				for(const OptimizationStep& step : SINGLE_STEPS)
+				{
+					PROFILE_START_DYNAMIC(step.name);
+					auto newIt = step(module, method, it, config);
+					//we can't just test newIt == it here, since if we replace the content of the iterator instead of deleting it, the iterators are still the same, even if we emplace instructions before
+					if(newIt.copy().previousInMethod() != prevIt || newIt != it)
+					{
+						it = prevIt;
+						modified = true;
+					}
+					PROFILE_END_DYNAMIC(step.name);
+				}
+				//the instruction was replaced in-place
+				modified = modified || it.get() != instr;
+				if(modified)
+				{
+					changedMethod = true;
+					for(const Local* local : usedLocals)
+					{
+						local->forUsers(LocalUser::Type::BOTH, [&pendingInstructions](const LocalUser* user) -> void
+						{
+							pendingInstructions.emplace(user);
+						});
+					}
+				}
+			}
+			it.nextInMethod();
+			prevIt = it.copy().previousInMethod();
 		}
-		it.nextInMethod();
-		prevIt = it.copy().previousInMethod();
 	}
+	if(!pendingInstructions.empty())
+		logging::debug() << "Optimization budget exceeded, skipped re-visiting " << pendingInstructions.size() << " instructions" << logging::endl;
+	return changedMethod;
+}
+
+static bool runSingleSteps(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
+{
+	return runSingleStepsOn(module, method, config, {}, true);
 }
 
+static bool lowerMemoryAccesses(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
+{
+	//the lowered accesses are not yet handled by the single steps, e.g. their literal values are not yet loaded
+	runSingleStepsOn(module, method, config, lowerMemoryAccess(module, method, config), false);
+	//the returned instructions do not include the merged critical sections, so any method is treated as modified
+	return true;
+}
+
+static bool packByteVectorValues(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
+{
+	//the inserted packed operations and unpacking are not yet handled by the single steps, e.g. their literal values are not yet loaded
+	const FastSet<const LocalUser*> insertedInstructions = packByteVectors(module, method, config);
+	const bool changedMethod = !insertedInstructions.empty();
+	runSingleStepsOn(module, method, config, insertedInstructions, false);
+	return changedMethod;
+}
+
+//passes without required analyses only report whether they modified the method. Since the cached analyses refer to single instructions, they preserve none of them
 //need to run before mapping literals
-const OptimizationPass optimizations::RESOLVE_STACK_ALLOCATIONS = OptimizationPass("ResolveStackAllocations", resolveStackAllocations, 10);
-const OptimizationPass optimizations::RUN_SINGLE_STEPS = OptimizationPass("SingleSteps", runSingleSteps, 20);
-const OptimizationPass optimizations::SPILL_LOCALS = OptimizationPass("SpillLocals", spillLocals, 80);
-const OptimizationPass optimizations::COMBINE_VPM_SETUP = OptimizationPass("CombineVPMAccess", combineVPMAccess, 90);
-const OptimizationPass optimizations::COMBINE_LITERAL_LOADS = OptimizationPass("CombineLiteralLoads", combineLoadingLiterals, 100);
-const OptimizationPass optimizations::COMBINE_ROTATIONS = OptimizationPass("CombineRotations", combineVectorRotations, 110);
-const OptimizationPass optimizations::ELIMINATE = OptimizationPass("EliminateDeadStores", eliminateDeadStore, 120);
-const OptimizationPass optimizations::SPLIT_READ_WRITES = OptimizationPass("SplitReadAfterWrites", splitReadAfterWrites, 130);
-const OptimizationPass optimizations::REORDER = OptimizationPass("ReorderInstructions", reorderWithinBasicBlocks, 140);
-const OptimizationPass optimizations::COMBINE = OptimizationPass("CombineALUIinstructions", combineOperations, 150);
-const OptimizationPass optimizations::UNROLL_WORK_GROUPS = OptimizationPass("UnrollWorkGroups", unrollWorkGroups, 160);
+const OptimizationPass optimizations::RESOLVE_STACK_ALLOCATIONS = OptimizationPass("ResolveStackAllocations", resolveStackAllocations, 10, Analysis::NONE, Analysis::NONE);
+//needs to run before the memory accesses are lowered
+const OptimizationPass optimizations::COPY_MEMORY_VIA_VPM = OptimizationPass("CopyMemoryViaVPM", copyMemoryViaVPM, 15, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::RUN_SINGLE_STEPS = OptimizationPass("SingleSteps", runSingleSteps, 20, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::VECTORIZE_LOOPS = OptimizationPass("VectorizeLoops", vectorizeLoops, 30, combine_flags(Analysis::CONTROL_FLOW_GRAPH, Analysis::DATA_DEPENDENCY_GRAPH), Analysis::NONE);
+const OptimizationPass optimizations::SPILL_LOCALS = OptimizationPass("SpillLocals", spillLocals, 80, Analysis::LIVENESS, Analysis::ALL);
+//needs to run after the single steps, which intrinsify the zero-extensions, truncations and saturations, and before the optimizations of the memory accesses
+const OptimizationPass optimizations::PACK_BYTE_VECTORS = OptimizationPass("PackByteVectors", packByteVectorValues, 85, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::COMBINE_VPM_SETUP = OptimizationPass("CombineVPMAccess", combineVPMAccess, 90, Analysis::NONE, Analysis::NONE);
+//needs to run after the VPM setups are combined, since the size of the VPM scratch area is fixed afterwards
+const OptimizationPass optimizations::CACHE_MEMORY_IN_VPM = OptimizationPass("CacheMemoryInVPM", cacheMemoryInVPM, 92, Analysis::NONE, Analysis::NONE);
+//needs to run after the memory reads are cached, so only the remaining reads are moved
+const OptimizationPass optimizations::PIPELINE_TMU_LOADS = OptimizationPass("PipelineTMULoads", pipelineTMULoads, 94, Analysis::NONE, Analysis::NONE);
+//needs to run after all optimizations of the abstract memory accesses and before the literals are combined
+const OptimizationPass optimizations::LOWER_MEMORY_ACCESS = OptimizationPass("LowerMemoryAccess", lowerMemoryAccesses, 96, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::COMBINE_LITERAL_LOADS = OptimizationPass("CombineLiteralLoads", combineLoadingLiterals, 100, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::COMBINE_ROTATIONS = OptimizationPass("CombineRotations", combineVectorRotations, 110, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::ELIMINATE = OptimizationPass("EliminateDeadStores", eliminateDeadStore, 120, Analysis::LIVENESS, Analysis::NONE);
+//needs to run after the moves are eliminated, which skips moves with pack- and unpack-modes
+const OptimizationPass optimizations::FOLD_PACK_MODES = OptimizationPass("FoldPackModes", foldPackAndUnpackModes, 122, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::SPLIT_READ_WRITES = OptimizationPass("SplitReadAfterWrites", splitReadAfterWrites, 130, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::REORDER = OptimizationPass("ReorderInstructions", reorderWithinBasicBlocks, 140, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::COMBINE = OptimizationPass("CombineALUIinstructions", combineOperations, 150, Analysis::NONE, Analysis::NONE);
+const OptimizationPass optimizations::UNROLL_WORK_GROUPS = OptimizationPass("UnrollWorkGroups", unrollWorkGroups, 160, Analysis::NONE, Analysis::NONE);
 
 const std::set<OptimizationPass> optimizations::DEFAULT_PASSES = {
-		RUN_SINGLE_STEPS, /* SPILL_LOCALS, */ COMBINE_VPM_SETUP, COMBINE_LITERAL_LOADS, RESOLVE_STACK_ALLOCATIONS, COMBINE_ROTATIONS, ELIMINATE, SPLIT_READ_WRITES, REORDER, COMBINE, UNROLL_WORK_GROUPS
+		RUN_SINGLE_STEPS, COPY_MEMORY_VIA_VPM, /* SPILL_LOCALS, */ PACK_BYTE_VECTORS, COMBINE_VPM_SETUP, CACHE_MEMORY_IN_VPM, PIPELINE_TMU_LOADS, LOWER_MEMORY_ACCESS, COMBINE_LITERAL_LOADS, RESOLVE_STACK_ALLOCATIONS, COMBINE_ROTATIONS, ELIMINATE, FOLD_PACK_MODES, SPLIT_READ_WRITES, REORDER, COMBINE, UNROLL_WORK_GROUPS
 };
 
 Optimizer::Optimizer(const Configuration& config, const std::set<OptimizationPass>& passes) : config(config), passes(passes)
@@ -154,14 +319,16 @@ static void runOptimizationPasses(const Module& module, Method& method, const Co
     logging::debug() << "-----" << logging::endl;
     logging::info() << "Running optimization passes for: " << method.name << logging::endl;
     std::size_t numInstructions = method.countInstructions();
-    
+    //the analyses are shared by all passes, until a pass modifies the method
+    AnalysisManager analyses(method);
+
     for(const OptimizationPass& pass : passes)
     {
         logging::debug() << logging::endl;
         logging::debug() << "Running pass: " << pass.name << logging::endl;
         PROFILE_COUNTER(pass.index * 100, pass.name + " (before)", method.countInstructions());
         PROFILE_START_DYNAMIC(pass.name);
-        pass(module, method, config);
+        pass(module, method, config, analyses);
         PROFILE_END_DYNAMIC(pass.name);
         PROFILE_COUNTER_WITH_PREV((pass.index + 1) * 100, pass.name + " (after)", method.countInstructions(), pass.index * 100);
     }
@@ -178,8 +345,6 @@ static void runOptimizationPasses(const Module& module, Method& method, const Co
 
 void Optimizer::optimize(Module& module) const
 {
-	std::vector<threading::BackgroundWorker> workers;
-	workers.reserve(module.getKernels().size());
 	for(auto& method : module.methods)
 	{
 		//PHI-nodes need to be eliminated before inlining functions
@@ -196,14 +361,17 @@ void Optimizer::optimize(Module& module) const
 		inlineMethods(module, kernel, config);
 		PROFILE_COUNTER_WITH_PREV(110, "Inline (after)", kernel.countInstructions(), 100);
 	}
+	const std::shared_ptr<threading::ThreadPool> pool = threading::ThreadPool::getGlobalPool(config.numThreads);
+	std::vector<std::future<void>> tasks;
+	tasks.reserve(module.getKernels().size());
 	for(Method* kernelFunc : module.getKernels())
 	{
 		auto f = [kernelFunc, &module, this]() -> void {
 			runOptimizationPasses(module, *kernelFunc, config, passes);
 		};
-		workers.emplace(workers.end(), f, "Optimizer")->operator ()();
+		tasks.push_back(pool->schedule(f));
 	}
-	threading::BackgroundWorker::waitForAll(workers);
+	pool->waitForAll(tasks);
 }
 
 void Optimizer::addPass(const OptimizationPass& pass)
@@ -8,8 +8,10 @@
 #define OPTIMIZER_H
 
 #include "config.h"
+#include "helper.h"
 
 #include <functional>
+#include <memory>
 #include <set>
 
 namespace vc4c
@@ -17,9 +19,64 @@ namespace vc4c
 	class Method;
 	class Module;
 	class InstructionWalker;
+	class ControlFlowGraph;
+	class DataDependencyGraph;
+
+	namespace analysis
+	{
+		class LivenessAnalysis;
+	} // namespace analysis
 
 	namespace optimizations
 	{
+		/*
+		 * The analyses of a method, which can be cached between optimization passes
+		 */
+		enum class Analysis
+		{
+			NONE = 0,
+			//the control-flow graph of the basic blocks
+			CONTROL_FLOW_GRAPH = 1,
+			//the data-dependency graph between the basic blocks
+			DATA_DEPENDENCY_GRAPH = 2,
+			//the live locals (with and without tracking conditional writes)
+			LIVENESS = 4,
+			ALL = CONTROL_FLOW_GRAPH | DATA_DEPENDENCY_GRAPH | LIVENESS
+		};
+
+		/*
+		 * Calculates the analyses of a single method on demand and caches them until they are invalidated by a modification of the method.
+		 *
+		 * NOTE: The analyses reference the basic blocks, instructions and locals of the method, so they need to be invalidated by any optimization modifying the method,
+		 * unless the optimization guarantees to keep the analysis valid.
+		 */
+		class AnalysisManager : private NonCopyable
+		{
+		public:
+			explicit AnalysisManager(Method& method);
+			~AnalysisManager();
+
+			ControlFlowGraph& getControlFlowGraph();
+			DataDependencyGraph& getDependencyGraph();
+			const analysis::LivenessAnalysis& getLiveness(bool trackConditionalWrites);
+
+			/*
+			 * Calculates all the given analyses, which are not yet cached
+			 */
+			void require(Analysis analyses);
+			/*
+			 * Drops all cached analyses except the ones preserved
+			 */
+			void invalidate(Analysis preserved = Analysis::NONE);
+
+		private:
+			Method& method;
+			std::unique_ptr<ControlFlowGraph> cfg;
+			std::unique_ptr<DataDependencyGraph> dependencyGraph;
+			std::unique_ptr<analysis::LivenessAnalysis> liveness;
+			std::unique_ptr<analysis::LivenessAnalysis> conditionalLiveness;
+		};
+
 		/*
 		 * An OptimizationPass usually walks over all instructions within a single method
 		 */
@@ -31,17 +88,32 @@ namespace vc4c
 			 * The optimizations are only run in parallel for different methods, so any access to the method is thread-safe
 			 */
 			using Pass = std::function<void(const Module&, Method&, const Configuration&)>;
+			/*
+			 * A pass using the cached analyses of the method. Returns whether the method was modified
+			 */
+			using AnalysisPass = std::function<bool(const Module&, Method&, const Configuration&, AnalysisManager&)>;
 
+			/*
+			 * Passes not reporting modifications are assumed to always modify the method and to invalidate all analyses
+			 */
 			OptimizationPass(const std::string& name, const Pass pass, std::size_t index);
+			/*
+			 * The required analyses are calculated before the pass is run,
+			 * the preserved analyses are kept valid by the pass, even if it modifies the method
+			 */
+			OptimizationPass(const std::string& name, const AnalysisPass pass, std::size_t index, Analysis required, Analysis preserved);
 
 			bool operator<(const OptimizationPass& other) const;
 			void operator()(const Module& module, Method& method, const Configuration& config) const;
+			void operator()(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses) const;
 			bool operator==(const OptimizationPass& other) const;
 
 			std::string name;
 			std::size_t index;
+			Analysis requiredAnalyses;
+			Analysis preservedAnalyses;
 		private:
-			Pass pass;
+			AnalysisPass pass;
 		};
 
 		/*
@@ -77,14 +149,28 @@ namespace vc4c
 		extern const OptimizationPass COMBINE_LITERAL_LOADS;
 		//handles stack-allocations by calculating their offsets and indices
 		extern const OptimizationPass RESOLVE_STACK_ALLOCATIONS;
+		//vectorizes loops by combining several iterations, if enabled in the configuration. Not part of the default passes
+		extern const OptimizationPass VECTORIZE_LOOPS;
+		//replaces memory which is only read to be written back with a memory copy, which is executed directly between RAM and VPM
+		extern const OptimizationPass COPY_MEMORY_VIA_VPM;
 		//spills long-living, rarely written locals into the VPM
 		extern const OptimizationPass SPILL_LOCALS;
-		//tries to combine VPW/VPR configurations and reads/writes within basic blocks
+		//keeps uchar4/uchar16 vectors packed (4 bytes per SIMD element) and calculates them via the packed 8-bit operations
+		extern const OptimizationPass PACK_BYTE_VECTORS;
+		//combines the writes of single values to consecutive memory within basic blocks into a single DMA write
 		extern const OptimizationPass COMBINE_VPM_SETUP;
+		//caches memory regions accessed repeatedly in the VPM, loading them once at the start and writing them back once at the end of the kernel
+		extern const OptimizationPass CACHE_MEMORY_IN_VPM;
+		//moves independent memory reads behind each other, so they are issued at once to have several memory lookups in flight
+		extern const OptimizationPass PIPELINE_TMU_LOADS;
+		//lowers the memory accesses remaining after the memory optimizations into the accesses of TMU/VPM/DMA
+		extern const OptimizationPass LOWER_MEMORY_ACCESS;
 		//combines duplicate vector rotations, e.g. introduced by vector-shuffle into a single rotation
 		extern const OptimizationPass COMBINE_ROTATIONS;
 		//eliminates useless instructions (dead store, move to same, add with zero, ...)
 		extern const OptimizationPass ELIMINATE;
+		//folds the pack- and unpack-modes of type-conversion moves into the instructions writing or reading the converted values
+		extern const OptimizationPass FOLD_PACK_MODES;
 		//more like a de-optimization. Splits read-after-writes (except if the local is used only very locally), so the reordering and register-allocation have an easier job
 		extern const OptimizationPass SPLIT_READ_WRITES;
 		//re-order instructions to eliminate more NOPs and stall cycles
@@ -10,262 +10,559 @@
 #include "../Profiler.h"
 #include "log.h"
 
+#include <algorithm>
+
 using namespace vc4c;
 using namespace vc4c::optimizations;
 using namespace vc4c::intermediate;
 
+InstructionWalker optimizations::moveInstructionUp(InstructionWalker dest, InstructionWalker it)
+{
+	/*
+	 * a b c d e f
+	 * f b c d e a
+	 * f a c d e b
+	 * f a b d e c
+	 * f a b c e d
+	 * f a b c d e
+	 */
+//	InstructionsIterator next = dest;
+//	while(next != it)
+//	{
+//		std::iter_swap(next, it);
+//		++next;
+//	}
+
+	/*!
+	 * a b c d e f
+	 * f a b c d e nil
+	 * f a b c d e
+	 */
+	auto res = dest.emplace(it.release());
+	it.erase();
+	return res;
+}
+
+namespace
+{
+	/*
+	 * A dependency between two instructions of a scheduling region.
+	 *
+	 * The successor needs to be issued at least the given number of cycles after the predecessor, e.g. 1 to just keep the order or 3 to wait for the result of a SFU call.
+	 * Soft dependencies are only used as hint (e.g. for the VPM, which stalls until the operation is finished), they never require to insert NOPs.
+	 */
+	struct Dependency
+	{
+		std::size_t successor;
+		std::size_t latency;
+		DelayType reason;
+		bool isSoft;
+	};
+
+	/*
+	 * A single instruction within the dependency-graph of a scheduling region
+	 */
+	struct ScheduleNode
+	{
+		IntermediateInstruction* instr;
+		std::vector<Dependency> successors;
+		std::size_t numUnscheduledPredecessors = 0;
+		//the first cycle this instruction can be issued without violating any (hard) latency
+		std::size_t earliestCycle = 0;
+		//the first cycle this instruction should be issued to not stall the hardware
+		std::size_t preferredCycle = 0;
+		//the reason for NOPs inserted when waiting for this instruction to become available
+		DelayType delayReason = DelayType::WAIT_REGISTER;
+		//the length of the longest path (in cycles) from this instruction to the end of the region
+		std::size_t height = 1;
+		//whether this instruction needs to keep its order relative to all other ordered instructions (e.g. accesses a register or has side-effects)
+		bool isOrdered = false;
+		std::size_t cycle = 0;
+		bool isScheduled = false;
+
+		explicit ScheduleNode(IntermediateInstruction* instr) : instr(instr)
+		{
+		}
+	};
+
+	/*
+	 * A delay (represented by one or more NOPs in the input) between an instruction and all following instructions accessing the same resources
+	 */
+	struct PendingDelay
+	{
+		std::size_t reason;
+		std::size_t latency;
+		DelayType type;
+		//whether the delay still needs to be applied to the next ordered instruction
+		bool waitForOrdered;
+		//whether the delay still needs to be applied to the accesses of the local written by the reason (until it is overwritten)
+		bool waitForLocalRewrite;
+	};
+
+	/*
+	 * The last write and all reads since then of a resource (e.g. a local or the flags)
+	 */
+	struct ResourceAccess
+	{
+		Optional<std::size_t> lastWriter;
+		std::vector<std::size_t> readers;
+	};
+} // namespace
+
+static bool accessesOtherRegister(const IntermediateInstruction* instr)
+{
+	if(instr->hasValueType(ValueType::REGISTER) && !instr->writesRegister(REG_NOP))
+		return true;
+	for(const Value& arg : instr->getArguments())
+	{
+		if(arg.hasType(ValueType::REGISTER))
+			return true;
+	}
+	return instr->signal.hasSideEffects();
+}
+
 /*
- * Finds the last instruction before the (list of) NOP(s) that is not a NOP -> the reason for the insertion of NOPs
+ * Whether the instruction cannot be moved at all and therefore splits the basic block into independent scheduling regions
  */
-static InstructionWalker findPreviousInstruction(BasicBlock& basicBlock, const InstructionWalker pos)
+static bool isSchedulingBarrier(const IntermediateInstruction* instr)
 {
-	PROFILE_START(findPreviousInstruction);
-	auto it = pos;
-	while(!it.isStartOfBlock())
+	if(!instr->mapsToASMInstruction())
+		return true;
+	if(dynamic_cast<const Nop*>(instr) != nullptr)
 	{
-		if(it.get() != nullptr && it->mapsToASMInstruction() && it->getOutput())
-			break;
-		it.previousInBlock();
+		const DelayType type = dynamic_cast<const Nop*>(instr)->type;
+		return type == DelayType::BRANCH_DELAY || type == DelayType::THREAD_END || type == DelayType::THREAD_SWITCH;
 	}
-	PROFILE_END(findPreviousInstruction);
-	return it;
+	if(dynamic_cast<const Operation*>(instr) == nullptr && dynamic_cast<const MoveOperation*>(instr) == nullptr &&
+		dynamic_cast<const LoadImmediate*>(instr) == nullptr && dynamic_cast<const SemaphoreAdjustment*>(instr) == nullptr)
+		//branches, combined instructions, memory barriers, ...
+		return true;
+	//Re-ordering MUTEX_ACQUIRE would extend the critical section (maybe a lot!), so never move anything over it
+	return instr->readsRegister(REG_MUTEX);
+}
+
+/*
+ * Whether the NOP only exists to delay following instructions, so it can be replaced by any other instructions
+ */
+static bool isDelayNop(const IntermediateInstruction* instr)
+{
+	const Nop* nop = dynamic_cast<const Nop*>(instr);
+	return nop != nullptr && !nop->hasSideEffects();
+}
+
+static bool accessesDelayedValue(const IntermediateInstruction* instr, const IntermediateInstruction* reason)
+{
+	if(!reason->getOutput())
+		return false;
+	const Value& out = reason->getOutput().value();
+	if(out.hasType(ValueType::LOCAL))
+		return instr->readsLocal(out.local) || instr->writesLocal(out.local);
+	if(!out.hasType(ValueType::REGISTER) || out.reg == REG_NOP)
+		return false;
+	if(instr->readsRegister(out.reg) || instr->writesRegister(out.reg))
+		return true;
+	if(out.reg == REG_VPM_IN_ADDR && (instr->readsRegister(REG_VPM_IN_BUSY) || instr->readsRegister(REG_VPM_IO)))
+		return true;
+	return out.reg == REG_VPM_OUT_ADDR && (instr->readsRegister(REG_VPM_OUT_BUSY) || instr->readsRegister(REG_VPM_IO));
+}
+
+/*
+ * Whether the combiner could merge the two instructions, if they are scheduled directly after each other.
+ *
+ * This is only a simplified version of the checks done in #combineOperations, used to prefer instructions running on different ALUs
+ */
+static bool canBePaired(const IntermediateInstruction* first, const IntermediateInstruction* second)
+{
+	const Operation* firstOp = dynamic_cast<const Operation*>(first);
+	const Operation* secondOp = dynamic_cast<const Operation*>(second);
+	if((firstOp == nullptr && dynamic_cast<const MoveOperation*>(first) == nullptr) || (secondOp == nullptr && dynamic_cast<const MoveOperation*>(second) == nullptr))
+		return false;
+	if(dynamic_cast<const VectorRotation*>(first) != nullptr || dynamic_cast<const VectorRotation*>(second) != nullptr)
+		return false;
+	if(!first->canBeCombined || !second->canBeCombined || accessesOtherRegister(first) || accessesOtherRegister(second))
+		return false;
+	if(first->getOutput() && (first->getOutput()->hasType(ValueType::LOCAL) && (second->readsLocal(first->getOutput()->local) || second->writesLocal(first->getOutput()->local))))
+		return false;
+	if(first->setFlags == SetFlag::SET_FLAGS && (second->hasConditionalExecution() || second->setFlags == SetFlag::SET_FLAGS))
+		return false;
+	if(firstOp != nullptr && secondOp != nullptr)
+	{
+		if((firstOp->op.runsOnAddALU() && firstOp->op.runsOnMulALU()) || (secondOp->op.runsOnAddALU() && secondOp->op.runsOnMulALU()))
+			return true;
+		return firstOp->op.runsOnAddALU() != secondOp->op.runsOnAddALU();
+	}
+	return true;
+}
+
+static void addDependency(std::vector<ScheduleNode>& nodes, const std::size_t predecessor, const std::size_t successor, const std::size_t latency, const DelayType reason = DelayType::WAIT_REGISTER, const bool isSoft = false)
+{
+	if(predecessor == successor)
+		return;
+	nodes[predecessor].successors.push_back(Dependency{successor, latency, reason, isSoft});
+	++nodes[successor].numUnscheduledPredecessors;
 }
 
 /*
- * Finds an instruction within the basic block that does not access any of the given values
+ * Builds the dependency-graph for the instructions of a single scheduling region.
+ *
+ * The NOPs inserted to delay instructions are removed and converted to latencies between the instruction causing the delay and all following instructions accessing the same resources.
  */
-static InstructionWalker findInstructionNotAccessing(BasicBlock& basicBlock, const InstructionWalker pos, FastSet<Value>& excludedValues)
+static std::vector<ScheduleNode> createDependencyGraph(const std::vector<InstructionWalker>& region)
 {
-	std::size_t instructionsLeft = REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK;
-	auto it = pos;
-	while(instructionsLeft > 0 && !it.isEndOfBlock())
+	std::vector<ScheduleNode> nodes;
+	nodes.reserve(region.size());
+	//the positions of the nodes in the original order (including delay NOPs), to calculate the delays represented by the NOPs
+	std::vector<std::size_t> positions;
+	positions.reserve(region.size());
+
+	FastMap<const Local*, ResourceAccess> localAccesses;
+	ResourceAccess flags;
+	Optional<std::size_t> lastOrdered(false, 0);
+	std::vector<PendingDelay> delays;
+
+	for(std::size_t position = 0; position < region.size(); ++position)
 	{
-		if(it.get() == nullptr)
+		IntermediateInstruction* instr = InstructionWalker(region[position]).get();
+		if(isDelayNop(instr))
 		{
-			//skip already replaced instructions
-			it.nextInBlock();
-			--instructionsLeft;
+			const DelayType type = dynamic_cast<const Nop*>(instr)->type;
+			//find the instruction causing this delay, the last instruction writing a value for register and VPM delays
+			Optional<std::size_t> reason;
+			for(std::size_t i = nodes.size(); i > 0; --i)
+			{
+				if((type != DelayType::WAIT_REGISTER && type != DelayType::WAIT_VPM) || nodes[i - 1].instr->getOutput())
+				{
+					reason = i - 1;
+					break;
+				}
+			}
+			//regions are only split at NOPs without reason within the region, so there is always one
+			const std::size_t latency = position - positions.at(reason.value()) + 1;
+			auto it = std::find_if(delays.begin(), delays.end(), [&reason, type](const PendingDelay& delay) -> bool
+			{
+				return delay.reason == reason.value() && delay.type == type;
+			});
+			if(it != delays.end())
+				it->latency = std::max(it->latency, latency);
+			else
+			{
+				const IntermediateInstruction* reasonInstr = nodes[reason.value()].instr;
+				const bool writesLocal = reasonInstr->hasValueType(ValueType::LOCAL);
+				const bool writesRegister = reasonInstr->hasValueType(ValueType::REGISTER) && !reasonInstr->writesRegister(REG_NOP);
+				//delays for register-values only apply to the accessing instructions, all other delays also to the following ordered instructions (SFU, TMU, UNIFORM and VPM accesses)
+				delays.push_back(PendingDelay{reason.value(), latency, type, type != DelayType::WAIT_REGISTER || writesRegister, writesLocal});
+			}
 			continue;
 		}
-		bool validReplacement = true;
-		PROFILE_START(checkExcludedValues);
-		if(it->getOutput() && excludedValues.find(it->getOutput().value()) != excludedValues.end())
-		{
-			validReplacement = false;
-		}
-		for(const Value& arg : it->getArguments())
+
+		const std::size_t index = nodes.size();
+		nodes.emplace_back(instr);
+		positions.push_back(position);
+		ScheduleNode& node = nodes.back();
+		//setting flags is handled via the dependencies on the flags
+		node.isOrdered = accessesOtherRegister(instr) || dynamic_cast<const SemaphoreAdjustment*>(instr) != nullptr;
+
+		//data dependencies via locals
+		for(const Value& arg : instr->getArguments())
 		{
-			if(excludedValues.find(arg) != excludedValues.end())
+			if(!arg.hasType(ValueType::LOCAL))
+				continue;
+			ResourceAccess& access = localAccesses[arg.local];
+			if(access.lastWriter)
 			{
-				validReplacement = false;
-				break;
+				//vector rotations, pack- and unpack-modes require the value to be read from a physical register, which cannot be read in the instruction directly after being written
+				const IntermediateInstruction* writer = nodes[access.lastWriter.value()].instr;
+				const bool needsDelay = dynamic_cast<const VectorRotation*>(instr) != nullptr || instr->hasUnpackMode() || writer->hasPackMode();
+				addDependency(nodes, access.lastWriter.value(), index, needsDelay ? 2 : 1);
 			}
+			if(access.readers.empty() || access.readers.back() != index)
+				access.readers.push_back(index);
 		}
-		PROFILE_END(checkExcludedValues);
-		if(validReplacement && it->writesRegister(REG_MUTEX))
+		if(instr->hasValueType(ValueType::LOCAL))
 		{
-			//never move MUTEX_RELEASE
-			validReplacement = false;
-			//Allow instructions to be moved over MUTEX_RELEASE to replace the VPM wait nops
+			ResourceAccess& access = localAccesses[instr->getOutput()->local];
+			if(access.lastWriter)
+				addDependency(nodes, access.lastWriter.value(), index, 1);
+			for(std::size_t reader : access.readers)
+				addDependency(nodes, reader, index, 1);
+			access.lastWriter = index;
+			access.readers.clear();
 		}
-		if(validReplacement && it->readsRegister(REG_MUTEX))
-		{
-			//Re-ordering MUTEX_ACQUIRE would extend the critical section (maybe a lot!), so don't move it
-			validReplacement = false;
-			//Also, never move anything out of (or over) the critical section
-			return basicBlock.end();
 
-		}
-		//for now, skip everything setting and using flags/signals
-		if(validReplacement && (it->hasConditionalExecution() || it->hasSideEffects()))
+		//dependencies via the flags
+		if(instr->hasConditionalExecution())
 		{
-			validReplacement = false;
+			if(flags.lastWriter)
+				addDependency(nodes, flags.lastWriter.value(), index, 1);
+			flags.readers.push_back(index);
 		}
-		if(validReplacement && (it.has<Branch>() || it.has<BranchLabel>() || it.has<MemoryBarrier>()))
+		if(instr->setFlags == SetFlag::SET_FLAGS)
 		{
-			//NEVER RE-ORDER BRANCHES, LABELS OR BARRIERS!
-			validReplacement = false;
+			if(flags.lastWriter)
+				addDependency(nodes, flags.lastWriter.value(), index, 1);
+			for(std::size_t reader : flags.readers)
+				addDependency(nodes, reader, index, 1);
+			flags.lastWriter = index;
+			flags.readers.clear();
 		}
-		if(validReplacement && it.has<Nop>())
-		{
-			//replacing NOP with NOP will violate the delay (e.g. for branches, SFU)
-			validReplacement = false;
-		}
-		if(validReplacement && !it->mapsToASMInstruction())
+
+		//registers, signals and other side-effects are kept in their original order
+		if(node.isOrdered)
 		{
-			//skip every instruction, which is not mapped to machine code, since otherwise the delay for the NOP will be violated
-			validReplacement = false;
+			if(lastOrdered)
+				addDependency(nodes, lastOrdered.value(), index, 1);
+			lastOrdered = index;
 		}
-		if(validReplacement)
+
+		//delays represented by the NOPs removed
+		auto delayIt = delays.begin();
+		while(delayIt != delays.end())
 		{
-			logging::debug() << "Found instruction not using any of the excluded values (" << to_string<Value, FastSet<Value>>(excludedValues) << "): " << it->to_string() << logging::endl;
-			break;
+			const IntermediateInstruction* reasonInstr = nodes[delayIt->reason].instr;
+			const bool accessesValue = accessesDelayedValue(instr, reasonInstr);
+			const bool affectsOrdered = node.isOrdered && (delayIt->type != DelayType::WAIT_REGISTER || accessesValue);
+			//waiting for VPM DMA stalls the QPU anyway, but VPM reads directly after the read setup return undefined values
+			const bool isSoft = delayIt->type == DelayType::WAIT_VPM && !reasonInstr->writesRegister(REG_VPM_IN_SETUP);
+			if(accessesValue || affectsOrdered)
+				addDependency(nodes, delayIt->reason, index, delayIt->latency, delayIt->type, isSoft);
+			//all following ordered instructions or accesses of the local are ordered after this instruction, so the delay is already guaranteed for them
+			if(affectsOrdered)
+				delayIt->waitForOrdered = false;
+			if(delayIt->waitForLocalRewrite && instr->writesLocal(reasonInstr->getOutput()->local))
+				delayIt->waitForLocalRewrite = false;
+			if(!delayIt->waitForOrdered && !delayIt->waitForLocalRewrite)
+				delayIt = delays.erase(delayIt);
+			else
+				++delayIt;
 		}
+	}
 
-		//otherwise add all outputs by instructions in between (the NOP and the replacement), since they could be used as input in the following instructions
-		if(it->getOutput() && !it->writesRegister(REG_NOP))
+	//since all dependencies point forward in the original order, the critical paths can be calculated in reverse order
+	for(std::size_t i = nodes.size(); i > 0; --i)
+	{
+		ScheduleNode& node = nodes[i - 1];
+		for(const Dependency& dep : node.successors)
+			node.height = std::max(node.height, dep.latency + nodes[dep.successor].height);
+	}
+	return nodes;
+}
+
+//the maximum distance (in the original order) of an instruction moved up to be paired with the previous instruction
+static constexpr std::size_t MAX_PAIRING_DISTANCE = 4;
+
+/*
+ * Selects the next instruction to be issued in the given cycle, if any.
+ *
+ * To keep the register-pressure (and the usage-ranges of locals, which are mapped to accumulators) similar to the original order,
+ * the instructions are kept in their original order, unless the next instruction needs to wait for a previous one.
+ * In this case, the ready instruction on the longest remaining path is selected, as well as for instructions which can be paired with the previous instruction.
+ */
+static Optional<std::size_t> selectNextInstruction(const std::vector<ScheduleNode>& nodes, const std::vector<std::size_t>& readyNodes, const std::size_t nextInOrder, const std::size_t cycle, const Optional<std::size_t>& pairingCandidate)
+{
+	//prefers the next instruction in the original order, then the instruction with the longest remaining path
+	auto isBetter = [&nodes, nextInOrder](const std::size_t index, const Optional<std::size_t>& current) -> bool
+	{
+		if(!current || index == nextInOrder)
+			return true;
+		if(current.value() == nextInOrder)
+			return false;
+		return nodes[index].height > nodes[current.value()].height || (nodes[index].height == nodes[current.value()].height && index < current.value());
+	};
+	Optional<std::size_t> bestPaired(false, 0);
+	Optional<std::size_t> bestFiller(false, 0);
+	Optional<std::size_t> bestStalling(false, 0);
+	for(std::size_t index : readyNodes)
+	{
+		const ScheduleNode& node = nodes[index];
+		if(node.earliestCycle > cycle)
+			continue;
+		if(node.preferredCycle > cycle)
 		{
-			excludedValues.insert(it->getOutput().value());
-			//make sure, SFU/TMU calls are not moved over other SFU/TMU calls
-			//this prevents nop-sfu-... from being replaced with sfu-sfu-...
-			if(it->writesRegister(REG_SFU_EXP2) || it->writesRegister(REG_SFU_LOG2) || it->writesRegister(REG_SFU_RECIP)
-					|| it->writesRegister(REG_SFU_RECIP_SQRT) || it->writesRegister(REG_TMU0_ADDRESS) || it->writesRegister(REG_TMU1_ADDRESS))
-			{
-				excludedValues.emplace(Value(REG_SFU_EXP2, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_SFU_LOG2, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_SFU_OUT, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_SFU_RECIP, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_SFU_RECIP_SQRT, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_TMU0_ADDRESS, TYPE_VOID.toPointerType()));
-				excludedValues.emplace(Value(REG_TMU1_ADDRESS, TYPE_VOID.toPointerType()));
-			}
+			if(!bestStalling || node.preferredCycle < nodes[bestStalling.value()].preferredCycle)
+				bestStalling = index;
+			continue;
 		}
-		--instructionsLeft;
-		it.nextInBlock();
+		//only instructions close to their original position are paired, to not extend the live-ranges of the locals accessed too much
+		if(pairingCandidate && index < nextInOrder + MAX_PAIRING_DISTANCE && canBePaired(nodes[pairingCandidate.value()].instr, node.instr) && isBetter(index, bestPaired))
+			bestPaired = index;
+		if(isBetter(index, bestFiller))
+			bestFiller = index;
 	}
-	if(instructionsLeft == 0)
-		it = basicBlock.end();
-	return it;
+	if(bestPaired)
+		return bestPaired;
+	if(bestFiller)
+		return bestFiller;
+	//the hardware stalls anyway, so we do not need to insert NOPs
+	return bestStalling;
 }
 
 /*
- * Finds a suitable instruction within this basic block to replace the NOP with, without violating the reason for the NOP.
- * Also, this instruction MUST not be dependent on any instruction in between the NOP and the replacement-instruction
+ * Re-orders the instructions of a single scheduling region using list-scheduling over the dependency-graph of the region
  */
-static InstructionWalker findReplacementCandidate(BasicBlock& basicBlock, const InstructionWalker pos, const DelayType nopReason)
+static void scheduleRegion(const std::vector<InstructionWalker>& region, const InstructionWalker regionEnd)
 {
-	PROFILE_START(findReplacementCandidate);
-	FastSet<Value> excludedValues;
-	InstructionWalker replacementIt = basicBlock.end();
-	switch(nopReason)
+	if(region.empty())
+		return;
+	PROFILE_START(createDependencyGraph);
+	std::vector<ScheduleNode> nodes = createDependencyGraph(region);
+	PROFILE_END(createDependencyGraph);
+
+	PROFILE_START(scheduleInstructions);
+	std::vector<std::size_t> readyNodes;
+	for(std::size_t i = 0; i < nodes.size(); ++i)
 	{
-		case DelayType::BRANCH_DELAY:
-			//This type of NOPs do not yet exist (they are created in CodeGenerator)
-			PROFILE_END(findReplacementCandidate);
-			return basicBlock.end();
-		case DelayType::THREAD_END:
-			//there are no more instructions after THREND
-			PROFILE_END(findReplacementCandidate);
-			return basicBlock.end();
-		case DelayType::WAIT_VPM:
-		case DelayType::WAIT_REGISTER:
+		if(nodes[i].numUnscheduledPredecessors == 0)
+			readyNodes.push_back(i);
+	}
+	//the scheduled instructions, including the NOPs inserted, one per cycle
+	std::vector<IntermediateInstruction*> schedule;
+	std::vector<Optional<std::size_t>> scheduledNodes;
+	schedule.reserve(region.size());
+	scheduledNodes.reserve(region.size());
+	std::size_t nextInOrder = 0;
+	std::size_t numInsertedNops = 0;
+	Optional<std::size_t> pairingCandidate(false, 0);
+	while(nextInOrder < nodes.size())
+	{
+		const std::size_t cycle = schedule.size();
+		const Optional<std::size_t> next = selectNextInstruction(nodes, readyNodes, nextInOrder, cycle, pairingCandidate);
+		if(!next)
 		{
-			//can insert any instruction which does not access the given register/local
-			const InstructionWalker lastInstruction = findPreviousInstruction(basicBlock, pos);
-			if(lastInstruction.isStartOfBlock())
+			//all ready instructions need to wait for other instructions, so we need to insert a NOP
+			const ScheduleNode* waiting = nullptr;
+			for(std::size_t index : readyNodes)
 			{
-				//this can e.g. happen, if the vector rotation is the first instruction in a basic block
-				//TODO for now, we can't handle this case, since there may be several writing instructions jumping to the block
-				logging::debug() << "Can't find reason for NOP in block: " << basicBlock.begin()->to_string() << logging::endl;
-				return basicBlock.end();
+				if(waiting == nullptr || nodes[index].earliestCycle < waiting->earliestCycle)
+					waiting = &nodes[index];
 			}
-			excludedValues.insert(lastInstruction->getOutput().value());
-			if(lastInstruction->writesRegister(REG_VPM_IN_ADDR))
-			{
-				excludedValues.emplace(Value(REG_VPM_IN_BUSY, TYPE_UNKNOWN));
-				excludedValues.emplace(Value(REG_VPM_IO, TYPE_UNKNOWN));
-			}
-			if(lastInstruction->writesRegister(REG_VPM_OUT_ADDR))
+			//no instruction is ready although some are not scheduled yet, so the dependency-graph has a cycle
+			if(waiting == nullptr)
+				throw CompilationError(CompilationStep::OPTIMIZER, "Cyclic dependencies between instructions to schedule, first unscheduled", nodes[nextInOrder].instr->to_string());
+			schedule.push_back(new Nop(waiting->delayReason));
+			scheduledNodes.push_back(Optional<std::size_t>(false, 0));
+			pairingCandidate = Optional<std::size_t>(false, 0);
+			++numInsertedNops;
+			continue;
+		}
+		ScheduleNode& node = nodes[next.value()];
+		node.isScheduled = true;
+		node.cycle = cycle;
+		schedule.push_back(node.instr);
+		scheduledNodes.push_back(next);
+		readyNodes.erase(std::find(readyNodes.begin(), readyNodes.end(), next.value()));
+		//an instruction paired with the previous one closes the pair
+		pairingCandidate = pairingCandidate && canBePaired(nodes[pairingCandidate.value()].instr, node.instr) ? Optional<std::size_t>(false, 0) : next;
+		for(const Dependency& dep : node.successors)
+		{
+			ScheduleNode& successor = nodes[dep.successor];
+			if(dep.isSoft)
+				successor.preferredCycle = std::max(successor.preferredCycle, cycle + dep.latency);
+			else if(cycle + dep.latency > successor.earliestCycle)
 			{
-				excludedValues.emplace(Value(REG_VPM_OUT_BUSY, TYPE_UNKNOWN));
-				excludedValues.emplace(Value(REG_VPM_IO, TYPE_UNKNOWN));
+				successor.earliestCycle = cycle + dep.latency;
+				successor.preferredCycle = std::max(successor.preferredCycle, successor.earliestCycle);
+				successor.delayReason = dep.reason;
 			}
-			PROFILE_START(findInstructionNotAccessing);
-			replacementIt = findInstructionNotAccessing(basicBlock, pos, excludedValues);
-			PROFILE_END(findInstructionNotAccessing);
-			break;
+			if(--successor.numUnscheduledPredecessors == 0)
+				readyNodes.push_back(dep.successor);
 		}
-		case DelayType::WAIT_SFU:
-		case DelayType::WAIT_TMU:
+		while(nextInOrder < nodes.size() && nodes[nextInOrder].isScheduled)
+			++nextInOrder;
+	}
+
+	//instructions issued within a delay must not be combined, since combining them would shorten the delay
+	for(const ScheduleNode& node : nodes)
+	{
+		for(const Dependency& dep : node.successors)
 		{
-			//can insert any instruction which doesn't access SFU/TMU or accumulator r4
-			excludedValues.emplace(Value(REG_SFU_EXP2, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_SFU_LOG2, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_SFU_OUT, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_SFU_RECIP, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_SFU_RECIP_SQRT, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_TMU0_ADDRESS, TYPE_VOID.toPointerType()));
-			excludedValues.emplace(Value(REG_TMU1_ADDRESS, TYPE_VOID.toPointerType()));
-			PROFILE_START(findInstructionNotAccessing);
-			replacementIt = findInstructionNotAccessing(basicBlock, pos, excludedValues);
-			PROFILE_END(findInstructionNotAccessing);
-			break;
+			if(dep.isSoft || dep.latency < 2)
+				continue;
+			for(std::size_t cycle = node.cycle + 1; cycle < nodes[dep.successor].cycle; ++cycle)
+				schedule[cycle]->canBeCombined = false;
 		}
-		case DelayType::WAIT_UNIFORM:
-			//TODO could reorder, as long as we do not access uniforms ??
-			PROFILE_END(findReplacementCandidate);
-			return basicBlock.end();
 	}
-	PROFILE_END(findReplacementCandidate);
-	return replacementIt;
-}
-
-InstructionWalker optimizations::moveInstructionUp(InstructionWalker dest, InstructionWalker it)
-{
-	/*
-	 * a b c d e f
-	 * f b c d e a
-	 * f a c d e b
-	 * f a b d e c
-	 * f a b c e d
-	 * f a b c d e
-	 */
-//	InstructionsIterator next = dest;
-//	while(next != it)
-//	{
-//		std::iter_swap(next, it);
-//		++next;
-//	}
+	PROFILE_END(scheduleInstructions);
+	PROFILE_COUNTER(1400000, "Scheduling NOPs inserted", numInsertedNops);
 
-	/*!
-	 * a b c d e f
-	 * f a b c d e nil
-	 * f a b c d e
-	 */
-	auto res = dest.emplace(it.release());
-	it.erase();
-	return res;
+	//write the scheduled instructions back into the basic block
+	for(InstructionWalker it : region)
+	{
+		IntermediateInstruction* instr = it.release();
+		//the delay-NOPs are replaced by the latencies
+		if(isDelayNop(instr))
+			delete instr;
+	}
+	std::size_t cycle = 0;
+	for(; cycle < schedule.size() && cycle < region.size(); ++cycle)
+	{
+		InstructionWalker it = region[cycle];
+		it.reset(schedule[cycle]);
+	}
+	InstructionWalker insertPos = regionEnd;
+	for(; cycle < schedule.size(); ++cycle)
+	{
+		insertPos.emplace(schedule[cycle]);
+		insertPos.nextInBlock();
+	}
+	//the remaining positions are empty and removed by #Method::cleanEmptyInstructions()
 }
 
-static void replaceNOPs(BasicBlock& basicBlock, Method& method)
+/*
+ * List-scheduling of the instructions within a basic block.
+ *
+ * The basic block is split into regions at instructions which cannot be moved (e.g. labels, branches, MUTEX acquire), which are scheduled independently.
+ * Within a region, instructions are only constrained by their dependencies (data, flags, order of register accesses), so there is no limit on how far instructions can be moved.
+ */
+static void scheduleInstructions(BasicBlock& basicBlock, Method& method)
 {
+	std::vector<InstructionWalker> region;
+	//whether the current region contains a reason for the delay-NOPs
+	bool hasValueWritten = false;
+	bool hasInstructions = false;
 	InstructionWalker it = basicBlock.begin();
 	while(!it.isEndOfBlock())
 	{
-		const Nop* nop = it.get<Nop>();
-		//only replace NOPs without side-effects (e.g. signal)
-		if(nop != nullptr && !nop->hasSideEffects())
+		if(!it.has())
 		{
-			InstructionWalker replacementIt = findReplacementCandidate(basicBlock, it, nop->type);
-			if(!replacementIt.isEndOfBlock())
-			{
-				// replace NOP with instruction, reset instruction at position (do not yet erase, otherwise iterators are wrong!)
-				logging::debug() << "Replacing NOP with: " << replacementIt->to_string() << logging::endl;
-				bool cannotBeCombined = !it->canBeCombined;
-				it.reset(replacementIt.release());
-				if(cannotBeCombined)
-					it->canBeCombined = false;
-			}
-			else if(nop->type == DelayType::WAIT_VPM)
+			it.nextInBlock();
+			continue;
+		}
+		bool isBarrier = isSchedulingBarrier(it.get());
+		if(!isBarrier && isDelayNop(it.get()))
+		{
+			//NOPs with a reason outside of the region (e.g. in the previous basic block) cannot be replaced
+			const DelayType type = it.get<Nop>()->type;
+			isBarrier = (type == DelayType::WAIT_REGISTER || type == DelayType::WAIT_VPM) ? !hasValueWritten : !hasInstructions;
+		}
+		if(isBarrier)
+		{
+			scheduleRegion(region, it);
+			region.clear();
+			hasValueWritten = false;
+			hasInstructions = false;
+		}
+		else
+		{
+			region.push_back(it);
+			if(!isDelayNop(it.get()))
 			{
-				//nops inserted to wait for VPM to finish can be removed again,
-				//since the wait-instruction will correctly wait the remaining number of instructions
-				it.erase();
-				//to not skip the next nop
-				it.previousInBlock();
+				hasInstructions = true;
+				hasValueWritten = hasValueWritten || it->getOutput();
 			}
 		}
 		it.nextInBlock();
 	}
+	scheduleRegion(region, it);
 }
 
-void optimizations::splitReadAfterWrites(const Module& module, Method& method, const Configuration& config)
+bool optimizations::splitReadAfterWrites(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
 	//try to split up consecutive instructions writing/reading to the same local (so less locals are forced to accumulators) by inserting NOPs
 	//the NOP then can be replaced with other instructions by the next optimization (#reorderWithinBasicBlocks)
 	auto it = method.walkAllInstructions();
 	InstructionWalker lastInstruction = it;
 	const Local* lastWrittenTo = nullptr;
+	bool changedMethod = false;
 	//skip the first instruction, since we start the check at the read (and need to look back at the write)
 	it.nextInMethod();
 	while(!it.isEndOfMethod())
@@ -287,6 +584,7 @@ void optimizations::splitReadAfterWrites(const Module& module, Method& method, c
 						//emplacing after the last instruction instead of before this one fixes errors with wrote-label-read, which then becomes
 						//write-nop-label-read instead of write-label-nop-read and the combiner can find a reason for the NOP
 						lastInstruction.copy().nextInBlock().emplace(new Nop(DelayType::WAIT_REGISTER));
+						changedMethod = true;
 					}
 				}
 			}
@@ -310,29 +608,26 @@ void optimizations::splitReadAfterWrites(const Module& module, Method& method, c
 				{
 					it.emplace(new Nop(DelayType::WAIT_VPM));
 					it.nextInBlock();
+					changedMethod = true;
 				}
 			}
 		}
 		it.nextInMethod();
 	}
+	return changedMethod;
 }
 
-void optimizations::reorderWithinBasicBlocks(const Module& module, Method& method, const Configuration& config)
+bool optimizations::reorderWithinBasicBlocks(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses)
 {
-    /*
-     * TODO re-order instructions to:
-     * 2. combine instructions(try to pair instruction from ADD and MUL ALU together, or moves)
-     * 3. split up VPM setup and wait VPM wait, so the delay can be used productively (only possible if we allow reordering over mutex-release).
-     *    How many instructions to try to insert? 3?
-     */
 	for(BasicBlock& block : method.getBasicBlocks())
 	{
-		// remove NOPs by inserting instructions which do not violate the reason for the NOP
-		PROFILE(replaceNOPs, block, method);
+		// remove NOPs by re-ordering the instructions without violating the reasons for the NOPs
+		PROFILE(scheduleInstructions, block, method);
 	}
 
 	//after all re-orders are done, remove empty instructions
 	method.cleanEmptyInstructions();
+	return true;
 }
 
 InstructionWalker optimizations::moveRotationSourcesToAccumulators(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
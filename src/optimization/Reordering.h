@@ -17,15 +17,21 @@ namespace vc4c
 
 	namespace optimizations
 	{
+		class AnalysisManager;
+
 		/*
 		 * Moves an instruction up (to the front, dest) in the sequence of instructions by swapping all instructions in between.
 		 * We can't just simply insert the instruction at the original destination, since the iterators might get invalidated!
 		 */
 		InstructionWalker moveInstructionUp(InstructionWalker dest, InstructionWalker it);
 
-		void splitReadAfterWrites(const Module& module, Method& method, const Configuration& config);
+		bool splitReadAfterWrites(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 
-		void reorderWithinBasicBlocks(const Module& module, Method& method, const Configuration& config);
+		/*
+		 * Re-orders the instructions within the basic blocks (list-scheduling on the dependencies between the instructions)
+		 * to replace NOPs with independent instructions and to place instructions running on different ALUs next to each other, so they can be combined.
+		 */
+		bool reorderWithinBasicBlocks(const Module& module, Method& method, const Configuration& config, AnalysisManager& analyses);
 
 		InstructionWalker moveRotationSourcesToAccumulators(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
 	} // namespace optimizations
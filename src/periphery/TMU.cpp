@@ -129,16 +129,27 @@ static InstructionWalker insertExtractByteElements(Method& method, InstructionWa
 
 InstructionWalker periphery::insertReadVectorFromTMU(Method& method, InstructionWalker it, const Value& dest, const Value& addr, const TMU& tmu)
 {
-	if(dest.type.complexType && !dest.type.getPointerType())
-		throw CompilationError(CompilationStep::GENERAL, "Reading of this type via TMU is not (yet) implemented", dest.type.to_string());
-
 	Value addresses(UNDEFINED_VALUE);
-	it = insertCalculateAddressOffsets(method, it, addr, dest.type, addresses);
+	it = insertTMURequest(method, it, addr, dest.type, addresses, tmu);
+	return insertTMUResponse(method, it, dest, addresses, tmu);
+}
+
+InstructionWalker periphery::insertTMURequest(Method& method, InstructionWalker it, const Value& addr, const DataType& type, Value& addresses, const TMU& tmu)
+{
+	if(type.isComplexType() && !type.getPointerType())
+		throw CompilationError(CompilationStep::GENERAL, "Reading of this type via TMU is not (yet) implemented", type.to_string());
+
+	it = insertCalculateAddressOffsets(method, it, addr, type, addresses);
 
 	//"General-memory lookups are performed by writing to just the s-parameter, using the absolute memory address" (page 41)
 	//1) write address to TMU_S register
 	it.emplace(new intermediate::MoveOperation(tmu.getAddress(addr.type), addresses));
 	it.nextInBlock();
+	return it;
+}
+
+InstructionWalker periphery::insertTMUResponse(Method& method, InstructionWalker it, const Value& dest, const Value& addresses, const TMU& tmu)
+{
 	//2) trigger loading of TMU
 	it.emplace(new intermediate::Nop(intermediate::DelayType::WAIT_TMU));
 	it->setSignaling(tmu.signal);
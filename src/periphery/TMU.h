@@ -43,6 +43,9 @@ namespace vc4c
 		extern const TMU TMU0;
 		extern const TMU TMU1;
 
+		//the number of requests which can be pending for each of the TMUs per QPU
+		constexpr std::size_t MAX_PENDING_TMU_REQUESTS{4};
+
 		/*
 		 * TMU
 		 *
@@ -57,6 +60,17 @@ namespace vc4c
 		 * Reads the required number of 32-bit vectors from the given address via the TMU and performs the necessary type conversions and vector rotations (for non 32-bit types).
 		 */
 		InstructionWalker insertReadVectorFromTMU(Method& method, InstructionWalker it, const Value& dest, const Value& addr, const TMU& tmu = TMU0);
+		/*
+		 * Inserts only the request of a general memory lookup (see #insertReadVectorFromTMU) of the given type, without waiting for the result.
+		 *
+		 * Several requests can be issued before their responses are read (see #insertTMUResponse), as long as the FIFO of the TMU does not overflow (see #MAX_PENDING_TMU_REQUESTS).
+		 * The addresses written to the TMU are returned, since they are required to extract the elements of non 32-bit types from the response.
+		 */
+		InstructionWalker insertTMURequest(Method& method, InstructionWalker it, const Value& addr, const DataType& type, Value& addresses, const TMU& tmu = TMU0);
+		/*
+		 * Inserts the reading of the response of the oldest request pending for the given TMU (see #insertTMURequest) into dest
+		 */
+		InstructionWalker insertTMUResponse(Method& method, InstructionWalker it, const Value& dest, const Value& addresses, const TMU& tmu = TMU0);
 
 		/*
 		 * Perform a general 32-bit memory lookup via the TMU.
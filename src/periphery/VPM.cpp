@@ -6,8 +6,11 @@
 
 #include "VPM.h"
 
+#include "../intermediate/Helper.h"
 #include "log.h"
 
+#include <algorithm>
+
 using namespace vc4c;
 using namespace vc4c::periphery;
 using namespace vc4c::intermediate;
@@ -87,7 +90,7 @@ InstructionWalker periphery::insertWriteDMA(Method& method, InstructionWalker it
 	return it;
 }
 
-std::pair<DataType, uint8_t> getBestVectorSize(const int64_t numBytes)
+std::pair<DataType, unsigned> getBestVectorSize(const int64_t numBytes)
 {
 	for(uint8_t numElements = 16; numElements > 0; --numElements)
 	{
@@ -99,7 +102,7 @@ std::pair<DataType, uint8_t> getBestVectorSize(const int64_t numBytes)
 			{
 				DataType result = typeSize == 4 ? TYPE_INT32 : typeSize == 2 ? TYPE_INT16 : TYPE_INT8;
 				result.num = numElements;
-				uint8_t numVectors = static_cast<uint8_t>(numBytes / (static_cast<int64_t>(numElements) * static_cast<int64_t>(typeSize)));
+				unsigned numVectors = static_cast<unsigned>(numBytes / (static_cast<int64_t>(numElements) * static_cast<int64_t>(typeSize)));
 				return std::make_pair(result, numVectors);
 			}
 		}
@@ -143,6 +146,18 @@ static unsigned calculateOffset(const VPMArea* area)
 	return 0;
 }
 
+/*
+ * The VPM read setup only takes effect after some instructions, reading from VPM before returns undefined values
+ */
+static InstructionWalker insertReadSetupDelay(InstructionWalker it)
+{
+	it.emplace(new Nop(DelayType::WAIT_VPM));
+	it.nextInBlock();
+	it.emplace(new Nop(DelayType::WAIT_VPM));
+	it.nextInBlock();
+	return it;
+}
+
 InstructionWalker VPM::insertReadVPM(InstructionWalker it, const Value& dest, const VPMArea* area, bool useMutex)
 {
 	if(area != nullptr)
@@ -156,6 +171,7 @@ InstructionWalker VPM::insertReadVPM(InstructionWalker it, const Value& dest, co
 	const VPRSetup genericSetup(VPRGenericSetup(size, TYPE_INT32.getScalarBitCount() / dest.type.getScalarBitCount(), 1, calculateAddress(dest.type, calculateOffset(area))));
 	it.emplace( new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<int64_t>(genericSetup))));
 	it.nextInBlock();
+	it = insertReadSetupDelay(it);
 	//2) read value from VPM
 	it.emplace( new MoveOperation(dest, VPM_IO_REGISTER));
 	it.nextInBlock();
@@ -206,7 +222,8 @@ InstructionWalker VPM::insertReadRAM(InstructionWalker it, const Value& memoryAd
 	//initialize VPM DMA for reading from host
 	const int64_t dmaMode = getVPMDMAMode(type);
 	VPRSetup dmaSetup(VPRDMASetup(dmaMode, type.getVectorWidth(true) % 16 /* 0 => 16 */, 1 % 16 /* 0 => 16 */));
-	dmaSetup.dmaSetup.setAddress(calculateOffset(area));
+	//the address is given in words: {Y[6:0], X[3:0]}
+	dmaSetup.dmaSetup.setAddress(static_cast<uint16_t>(calculateOffset(area) / 4));
 	it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<int64_t>(dmaSetup))));
 	it.nextInBlock();
 	const VPRSetup strideSetup(VPRStrideSetup(type.getPhysicalWidth()));
@@ -246,7 +263,8 @@ InstructionWalker VPM::insertWriteRAM(InstructionWalker it, const Value& memoryA
 	//initialize VPM DMA for writing to host
 	const int64_t dmaMode = getVPMDMAMode(type);
 	VPWSetup dmaSetup(VPWDMASetup(dmaMode, type.getVectorWidth(true), 1 % 128 /* 0 => 128 */));
-	dmaSetup.dmaSetup.setVPMBase(calculateOffset(area));
+	//the VPM base is given in words: {Y[6:0], X[3:0]}
+	dmaSetup.dmaSetup.setVPMBase(static_cast<uint16_t>(calculateOffset(area) / 4));
 	it.emplace( new LoadImmediate(VPM_OUT_SETUP_REGISTER, Literal(static_cast<int64_t>(dmaSetup))));
 	it.nextInBlock();
 	//set stride to zero
@@ -266,36 +284,96 @@ InstructionWalker VPM::insertWriteRAM(InstructionWalker it, const Value& memoryA
 	return it;
 }
 
-InstructionWalker VPM::insertCopyRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& srcAddress, const unsigned numBytes, const VPMArea* area, bool useMutex)
+/*
+ * Calculates the memory address at the given offset from the base address
+ */
+static Value insertCalculateCopyAddress(Method& method, InstructionWalker& it, const Value& baseAddress, const unsigned offset)
 {
-	const auto size = getBestVectorSize(numBytes);
-	if(area != nullptr)
-		area->checkAreaSize(size.first.getPhysicalWidth());
-	else
-		updateScratchSize(size.first.getPhysicalWidth());
+	if(offset == 0)
+		return baseAddress;
+	const Value address = method.addNewLocal(baseAddress.type, "%mem_copy_addr");
+	it.emplace(new Operation(OP_ADD, address, baseAddress, Value(Literal(static_cast<int64_t>(offset)), TYPE_INT32)));
+	it.nextInBlock();
+	return address;
+}
 
-	it = insertLockMutex(it, useMutex);
+InstructionWalker VPM::insertCopyRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& srcAddress, const unsigned numBytes, const VPMArea* area, bool useMutex)
+{
+	//the number of whole rows of 16 words to copy at once, limited by the maximum number of rows a single DMA load can transfer
+	unsigned rowsPerCopy = 0;
+	if(numBytes % 4 == 0 && numBytes >= 2 * 64)
+	{
+		rowsPerCopy = std::min(numBytes / 64, 16u);
+		if(area != nullptr)
+			rowsPerCopy = std::min(rowsPerCopy, area->size / 64);
+		else if(isScratchLocked)
+			rowsPerCopy = std::min(rowsPerCopy, getScratchArea().size / 64);
+	}
+	if(rowsPerCopy < 2)
+	{
+		//copy single vectors of the best matching size
+		const auto size = getBestVectorSize(numBytes);
+		if(area != nullptr)
+			area->checkAreaSize(size.first.getPhysicalWidth());
+		else
+			updateScratchSize(size.first.getPhysicalWidth());
+
+		it = insertLockMutex(it, useMutex);
+		for(unsigned i = 0; i < size.second; ++i)
+		{
+			//increment offset from base address
+			const Value tmpSource = insertCalculateCopyAddress(method, it, srcAddress, i * size.first.getPhysicalWidth());
+			const Value tmpDest = insertCalculateCopyAddress(method, it, destAddress, i * size.first.getPhysicalWidth());
 
-	it = insertReadRAM(it, srcAddress, size.first, area, false);
-	it = insertWriteRAM(it, destAddress, size.first, area, false);
+			it = insertReadRAM(it, tmpSource, size.first, area, false);
+			it = insertWriteRAM(it, tmpDest, size.first, area, false);
+		}
+		return insertUnlockMutex(it, useMutex);
+	}
 
-	for(uint8_t i = 1; i < size.second; ++i)
+	if(area == nullptr)
+		updateScratchSize(rowsPerCopy * 64);
+	const uint16_t vpmWordOffset = static_cast<uint16_t>(calculateOffset(area) / 4);
+	it = insertLockMutex(it, useMutex);
+	//copy blocks of up to 16 rows of 16 words via a single DMA load and store each, the remaining words as a single shorter row
+	const unsigned numWords = numBytes / 4;
+	unsigned word = 0;
+	while(word < numWords)
 	{
-		const Value tmpSource = method.addNewLocal(srcAddress.type, "%mem_copy_addr");
-		const Value tmpDest = method.addNewLocal(destAddress.type, "%mem_copy_addr");
+		const unsigned numRows = std::max(std::min((numWords - word) / 16, rowsPerCopy), 1u);
+		const unsigned rowLength = std::min(numWords - word, 16u);
+		const Value tmpSource = insertCalculateCopyAddress(method, it, srcAddress, word * 4);
+		const Value tmpDest = insertCalculateCopyAddress(method, it, destAddress, word * 4);
+
+		VPRSetup loadSetup(VPRDMASetup(getVPMDMAMode(TYPE_INT32), rowLength % 16 /* 0 => 16 */, numRows % 16 /* 0 => 16 */));
+		//the address is given in words: {Y[6:0], X[3:0]}
+		loadSetup.dmaSetup.setAddress(vpmWordOffset);
+		it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<int64_t>(loadSetup))));
+		it.nextInBlock();
+		//the rows are consecutive in memory
+		it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<int64_t>(VPRSetup(VPRStrideSetup(static_cast<uint16_t>(rowLength * 4)))))));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(VPM_IN_ADDR_REGISTER, tmpSource));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(NOP_REGISTER, VPM_IN_WAIT_REGISTER));
+		it.nextInBlock();
 
-		//increment offset from base address
-		it.emplace(new Operation(OP_ADD, tmpSource, srcAddress, Value(Literal(static_cast<int64_t>(i * size.first.getPhysicalWidth())), TYPE_INT8)));
+		VPWSetup storeSetup(VPWDMASetup(getVPMDMAMode(TYPE_INT32), static_cast<uint8_t>(rowLength), static_cast<uint8_t>(numRows)));
+		//the VPM base is given in words: {Y[6:0], X[3:0]}
+		storeSetup.dmaSetup.setVPMBase(vpmWordOffset);
+		it.emplace(new LoadImmediate(VPM_OUT_SETUP_REGISTER, Literal(static_cast<int64_t>(storeSetup))));
 		it.nextInBlock();
-		it.emplace(new Operation(OP_ADD, tmpDest, destAddress, Value(Literal(static_cast<int64_t>(i * size.first.getPhysicalWidth())), TYPE_INT8)));
+		//no gap between the rows in memory
+		it.emplace(new LoadImmediate(VPM_OUT_SETUP_REGISTER, Literal(static_cast<int64_t>(VPWSetup(VPWStrideSetup(0))))));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(VPM_OUT_ADDR_REGISTER, tmpDest));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(NOP_REGISTER, VPM_OUT_WAIT_REGISTER));
 		it.nextInBlock();
 
-		it = insertReadRAM(it, tmpSource, size.first, area, false);
-		it = insertWriteRAM(it, tmpDest, size.first, area, false);
+		word += numRows * rowLength;
 	}
-	it = insertUnlockMutex(it, useMutex);
-
-	return it;
+	return insertUnlockMutex(it, useMutex);
 }
 
 InstructionWalker VPM::insertFillRAM(Method& method, InstructionWalker it, const Value& memoryAddress, const DataType& type, const unsigned numCopies, const VPMArea* area, bool useMutex)
@@ -325,6 +403,201 @@ InstructionWalker VPM::insertFillRAM(Method& method, InstructionWalker it, const
 	return it;
 }
 
+/*
+ * Calculates the setup-value accessing the part of an area reserved for the executing QPU,
+ * where the setup-value is incremented by the given offset for every QPU
+ */
+static InstructionWalker insertCalculatePerQPUSetup(Method& method, InstructionWalker it, const Value& setup, const int64_t baseSetup, const int64_t offsetPerQPU)
+{
+	const Value qpuFactor = method.addNewLocal(TYPE_INT32, "%vpm_qpu_factor");
+	const Value qpuOffset = method.addNewLocal(TYPE_INT32, "%vpm_qpu_offset");
+	const Value baseValue = method.addNewLocal(TYPE_INT32, "%vpm_setup");
+	//the QPU number and small immediates are both read via physical file B, so the factor needs to be loaded into a register
+	it.emplace(new LoadImmediate(qpuFactor, Literal(offsetPerQPU)));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_MUL24, qpuOffset, qpuFactor, Value(REG_QPU_NUMBER, TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new LoadImmediate(baseValue, Literal(baseSetup)));
+	it.nextInBlock();
+	it.emplace(new Operation(OP_ADD, setup, baseValue, qpuOffset));
+	it.nextInBlock();
+	return it;
+}
+
+/*
+ * Calculates the setup-value accessing the part of the register-spilling area reserved for the executing QPU
+ */
+static InstructionWalker insertCalculateSpillSetup(Method& method, InstructionWalker it, const Value& setup, const int64_t baseSetup, const VPMArea& area)
+{
+	//the row is located in the lowest bits of the setup-value
+	return insertCalculatePerQPUSetup(method, it, setup, baseSetup, static_cast<int64_t>(area.size / 64));
+}
+
+InstructionWalker VPM::insertSpillRegister(Method& method, InstructionWalker it, const Value& src, const VPMArea& area, const unsigned slot) const
+{
+	area.checkAreaSize((slot + 1) * 64);
+	const DataType type = TYPE_INT32.toVectorType(16);
+	const VPWSetup genericSetup(VPWGenericSetup(getVPMSize(type), 1, calculateAddress(type, area.baseOffset + slot * 64)));
+	const Value setup = method.addNewLocal(TYPE_INT32, "%spill_setup");
+	it = insertCalculateSpillSetup(method, it, setup, static_cast<int64_t>(genericSetup), area);
+	it.emplace(new MoveOperation(VPM_OUT_SETUP_REGISTER, setup));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(VPM_IO_REGISTER, src));
+	it.nextInBlock();
+	return it;
+}
+
+InstructionWalker VPM::insertReloadRegister(Method& method, InstructionWalker it, const Value& dest, const VPMArea& area, const unsigned slot) const
+{
+	area.checkAreaSize((slot + 1) * 64);
+	const DataType type = TYPE_INT32.toVectorType(16);
+	const VPRSetup genericSetup(VPRGenericSetup(getVPMSize(type), 1, 1, calculateAddress(type, area.baseOffset + slot * 64)));
+	const Value setup = method.addNewLocal(TYPE_INT32, "%spill_setup");
+	it = insertCalculateSpillSetup(method, it, setup, static_cast<int64_t>(genericSetup), area);
+	it.emplace(new MoveOperation(VPM_IN_SETUP_REGISTER, setup));
+	it.nextInBlock();
+	it = insertReadSetupDelay(it);
+	it.emplace(new MoveOperation(dest, VPM_IO_REGISTER));
+	it.nextInBlock();
+	return it;
+}
+
+/*
+ * Calculates the setup-value accessing the given cache area.
+ * For areas reserved per QPU, the setup-value is incremented by the given offset for every row of the area for every QPU
+ */
+static InstructionWalker insertCalculateCacheSetup(Method& method, InstructionWalker it, const Value& setup, const int64_t baseSetup, const VPMArea& area, const int64_t offsetPerRow)
+{
+	if(area.requiresSpacePerQPU())
+		return insertCalculatePerQPUSetup(method, it, setup, baseSetup, static_cast<int64_t>(area.size / 64) * offsetPerRow);
+	it.emplace(new LoadImmediate(setup, Literal(baseSetup)));
+	it.nextInBlock();
+	return it;
+}
+
+InstructionWalker VPM::insertFillCache(Method& method, InstructionWalker it, const Value& memoryAddress, const VPMArea& area, const unsigned numBytes, bool useMutex) const
+{
+	area.checkAreaSize(numBytes);
+	it = insertLockMutex(it, useMutex);
+
+	//load up to 16 whole rows of 16 words at once and the remaining words as a single shorter row
+	const unsigned numWords = (numBytes + 3) / 4;
+	unsigned word = 0;
+	while(word < numWords)
+	{
+		const unsigned numRows = std::max(std::min((numWords - word) / 16, 16u), 1u);
+		const unsigned rowLength = std::min(numWords - word, 16u);
+		VPRSetup dmaSetup(VPRDMASetup(getVPMDMAMode(TYPE_INT32), rowLength % 16 /* 0 => 16 */, numRows % 16 /* 0 => 16 */));
+		//the address is given in words: {Y[6:0], X[3:0]}
+		dmaSetup.dmaSetup.setAddress(static_cast<uint16_t>(area.baseOffset / 4 + word));
+		it = insertCalculateCacheSetup(method, it, VPM_IN_SETUP_REGISTER, static_cast<int64_t>(dmaSetup), area, 16);
+		const VPRSetup strideSetup(VPRStrideSetup(64));
+		it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<int64_t>(strideSetup))));
+		it.nextInBlock();
+
+		Value address = memoryAddress;
+		if(word != 0)
+		{
+			const Value offset = method.addNewLocal(TYPE_INT32, "%vpm_cache_offset");
+			address = method.addNewLocal(memoryAddress.type, "%vpm_cache_addr");
+			it.emplace(new LoadImmediate(offset, Literal(static_cast<int64_t>(word * 4))));
+			it.nextInBlock();
+			it.emplace(new Operation(OP_ADD, address, memoryAddress, offset));
+			it.nextInBlock();
+		}
+		it.emplace(new MoveOperation(VPM_IN_ADDR_REGISTER, address));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(NOP_REGISTER, VPM_IN_WAIT_REGISTER));
+		it.nextInBlock();
+		word += numRows * rowLength;
+	}
+
+	it = insertUnlockMutex(it, useMutex);
+	return it;
+}
+
+InstructionWalker VPM::insertFlushCache(Method& method, InstructionWalker it, const Value& memoryAddress, const VPMArea& area, const unsigned wordOffset, const unsigned numWords, bool useMutex) const
+{
+	area.checkAreaSize((wordOffset + numWords) * 4);
+	if(numWords == 0 || wordOffset / 16 != (wordOffset + numWords - 1) / 16)
+		throw CompilationError(CompilationStep::GENERAL, "Can only write words of a single VPM row at once", std::to_string(numWords));
+	it = insertLockMutex(it, useMutex);
+
+	VPWSetup dmaSetup(VPWDMASetup(getVPMDMAMode(TYPE_INT32), static_cast<uint8_t>(numWords), 1));
+	//the VPM base is given in words: {Y[6:0], X[3:0]}
+	dmaSetup.dmaSetup.setVPMBase(static_cast<uint16_t>(area.baseOffset / 4 + wordOffset));
+	//the VPM base is located at bit 3 of the setup-value
+	it = insertCalculateCacheSetup(method, it, VPM_OUT_SETUP_REGISTER, static_cast<int64_t>(dmaSetup), area, 16 << 3);
+	const VPWSetup strideSetup(VPWStrideSetup(0));
+	it.emplace(new LoadImmediate(VPM_OUT_SETUP_REGISTER, Literal(static_cast<int64_t>(strideSetup))));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(VPM_OUT_ADDR_REGISTER, memoryAddress));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(NOP_REGISTER, VPM_OUT_WAIT_REGISTER));
+	it.nextInBlock();
+
+	it = insertUnlockMutex(it, useMutex);
+	return it;
+}
+
+InstructionWalker VPM::insertReadCache(Method& method, InstructionWalker it, const Value& dest, const VPMArea& area, const Value& byteOffset) const
+{
+	//the row is located in the lowest bits of the setup-value
+	const int64_t baseSetup = static_cast<int64_t>(VPRSetup(VPRGenericSetup(getVPMSize(TYPE_INT32), 1, 1, calculateAddress(TYPE_INT32, area.baseOffset))));
+	Value element(UNDEFINED_VALUE);
+	if(byteOffset.hasType(ValueType::LITERAL))
+	{
+		const auto offset = static_cast<unsigned>(byteOffset.literal.integer);
+		area.checkAreaSize(offset + 4);
+		it = insertCalculateCacheSetup(method, it, VPM_IN_SETUP_REGISTER, baseSetup + offset / 64, area, 1);
+		element = Value(Literal(static_cast<int64_t>((offset % 64) / 4)), TYPE_INT8);
+	}
+	else
+	{
+		//setup = base-setup + offset / 64, element = (offset / 4) % 16
+		const Value baseValue = method.addNewLocal(TYPE_INT32, "%vpm_setup");
+		const Value rowOffset = method.addNewLocal(TYPE_INT32, "%vpm_row_offset");
+		const Value wordOffset = method.addNewLocal(TYPE_INT32, "%vpm_word_offset");
+		element = method.addNewLocal(TYPE_INT8, "%vpm_element");
+		it = insertCalculateCacheSetup(method, it, baseValue, baseSetup, area, 1);
+		it.emplace(new Operation(OP_SHR, wordOffset, byteOffset, Value(SmallImmediate(2), TYPE_INT8)));
+		it.nextInBlock();
+		it.emplace(new Operation(OP_AND, element, wordOffset, Value(SmallImmediate(15), TYPE_INT8)));
+		it.nextInBlock();
+		it.emplace(new Operation(OP_SHR, rowOffset, byteOffset, Value(SmallImmediate(6), TYPE_INT8)));
+		it.nextInBlock();
+		it.emplace(new Operation(OP_ADD, VPM_IN_SETUP_REGISTER, baseValue, rowOffset));
+		it.nextInBlock();
+	}
+	it = insertReadSetupDelay(it);
+	const Value row = method.addNewLocal(TYPE_INT32.toVectorType(16), "%vpm_cache_row");
+	it.emplace(new MoveOperation(row, VPM_IO_REGISTER));
+	it.nextInBlock();
+	//move the word into the first element and replicate it across the whole vector
+	const Value word = method.addNewLocal(dest.type, "%vpm_cache_word");
+	it = intermediate::insertVectorRotation(it, row, element, word, intermediate::Direction::DOWN);
+	return intermediate::insertReplication(it, word, dest);
+}
+
+InstructionWalker VPM::insertWriteCache(Method& method, InstructionWalker it, const Value& src, const VPMArea& area, const unsigned byteOffset) const
+{
+	area.checkAreaSize(byteOffset + 4);
+	const uint8_t address = calculateAddress(TYPE_INT32, area.baseOffset + byteOffset / 64 * 64);
+	const VPRSetup readSetup(VPRGenericSetup(getVPMSize(TYPE_INT32), 1, 1, address));
+	const VPWSetup writeSetup(VPWGenericSetup(getVPMSize(TYPE_INT32), 1, address));
+
+	const Value row = method.addNewLocal(TYPE_INT32.toVectorType(16), "%vpm_cache_row");
+	it = insertCalculateCacheSetup(method, it, VPM_IN_SETUP_REGISTER, static_cast<int64_t>(readSetup), area, 1);
+	it = insertReadSetupDelay(it);
+	it.emplace(new MoveOperation(row, VPM_IO_REGISTER));
+	it.nextInBlock();
+	it = intermediate::insertVectorInsertion(it, method, row, Value(SmallImmediate(static_cast<unsigned char>((byteOffset % 64) / 4)), TYPE_INT8), src);
+	it = insertCalculateCacheSetup(method, it, VPM_OUT_SETUP_REGISTER, static_cast<int64_t>(writeSetup), area, 1);
+	it.emplace(new MoveOperation(VPM_IO_REGISTER, row));
+	it.nextInBlock();
+	return it;
+}
+
 void VPMArea::checkAreaSize(const unsigned requestedSize) const
 {
 	if(requestedSize > size)
@@ -338,12 +611,12 @@ bool VPMArea::operator<(const VPMArea& other) const
 
 bool VPMArea::requiresSpacePerQPU() const
 {
-	return usageType == VPMUsage::REGISTER_SPILLING;
+	return usageType == VPMUsage::REGISTER_SPILLING || usageType == VPMUsage::SPECIFIC_DMA_PER_QPU;
 }
 
 unsigned VPMArea::getTotalSize() const
 {
-	return (requiresSpacePerQPU() ? 12 : 1) * size;
+	return (requiresSpacePerQPU() ? NUM_QPUS : 1) * size;
 }
 
 VPM::VPM(const unsigned totalVPMSize) : maximumVPMSize(totalVPMSize), areas(), isScratchLocked(false)
@@ -364,33 +637,50 @@ const VPMArea* VPM::findArea(const Local* local)
 	return nullptr;
 }
 
-const VPMArea* VPM::addArea(const Local* local, unsigned requestedSize, bool alignToBack)
+const VPMArea* VPM::addArea(const Local* local, unsigned requestedSize, bool isPerQPU)
 {
 	const VPMArea* area = findArea(local);
-	if(area != nullptr && area->size >= requestedSize)
-		return area;
+	if(area != nullptr)
+		return area->size >= requestedSize ? area : nullptr;
+
+	//every area occupies whole VPM rows (for every QPU, if required)
+	const VPMArea newArea{isPerQPU ? VPMUsage::SPECIFIC_DMA_PER_QPU : VPMUsage::SPECIFIC_DMA, 0, (requestedSize + 63) / 64 * 64, local};
+	//the scratch area needs to be able to hold at least a single vector (e.g. for spilling into memory), since it cannot grow afterwards
+	if(!isScratchLocked)
+		updateScratchSize(64);
+	const auto freeSpace = findFreeSpace();
+	if(requestedSize == 0 || freeSpace.first + newArea.getTotalSize() > freeSpace.second)
+		//no more (big enough) free space on VPM
+		return nullptr;
 
 	//lock scratch area, so it cannot expand over reserved VPM areas
 	isScratchLocked = true;
 
-	//find free consecutive space in VPM with the requested size and return it
-	unsigned baseOffset = 0;
-	for(const VPMArea& area : areas)
-	{
-		if(baseOffset + requestedSize < area.baseOffset)
-			//if the new area doesn't fit before the current one, place it after
-			baseOffset = area.baseOffset + area.size;
-	}
+	auto it = areas.emplace(VPMArea{newArea.usageType, freeSpace.first, newArea.size, local});
+	logging::debug() << "Reserved " << newArea.getTotalSize() << " bytes of VPM at offset " << it.first->baseOffset << " for caching " << local->to_string() << (isPerQPU ? " per QPU" : "") << logging::endl;
+	return &(*it.first);
+}
 
-	//check if we can fit at the end
-	if(baseOffset + requestedSize < maximumVPMSize)
-	{
-		auto it = areas.emplace(VPMArea{VPMUsage::SPECIFIC_DMA, baseOffset, requestedSize, local});
-		return &(*it.first);
-	}
+const VPMArea* VPM::addSpillingArea(const unsigned numRegisters)
+{
+	//every spilled register occupies a whole VPM row for every QPU
+	const VPMArea spillingArea{VPMUsage::REGISTER_SPILLING, 0, numRegisters * 64, nullptr};
+	const auto freeSpace = findFreeSpace();
+	//the scratch area is always located at offset 0
+	if(numRegisters == 0 || freeSpace.first + spillingArea.getTotalSize() > freeSpace.second || spillingArea.getTotalSize() == freeSpace.second)
+		return nullptr;
+
+	//lock scratch area, so it cannot expand over the spilled registers
+	isScratchLocked = true;
 
-	//no more (big enough) free space on VPM
-	return nullptr;
+	auto it = areas.emplace(VPMArea{VPMUsage::REGISTER_SPILLING, freeSpace.second - spillingArea.getTotalSize(), spillingArea.size, nullptr});
+	logging::debug() << "Reserved " << spillingArea.getTotalSize() << " bytes of VPM at offset " << it.first->baseOffset << " for spilling " << numRegisters << " registers" << logging::endl;
+	return &(*it.first);
+}
+
+bool VPM::hasAreasPerQPU() const
+{
+	return std::any_of(areas.begin(), areas.end(), [](const VPMArea& area) -> bool { return area.requiresSpacePerQPU(); });
 }
 
 unsigned VPM::getMaxCacheVectors(const DataType& type, bool writeAccess) const
@@ -400,9 +690,28 @@ unsigned VPM::getMaxCacheVectors(const DataType& type, bool writeAccess) const
 	return std::min(15u, (maximumVPMSize / 16) / (type.getScalarBitCount() / 8));
 }
 
+std::pair<unsigned, unsigned> VPM::findFreeSpace() const
+{
+	//the generic 32-bit VPM access can only address the first 64 rows
+	const unsigned usableSize = std::min(maximumVPMSize, 64u * 64u) / 64 * 64;
+	//the areas for spilling are located from the end of the VPM downwards, all other areas from the start upwards
+	unsigned endOfAreas = 0;
+	unsigned startOfSpillingAreas = usableSize;
+	for(const VPMArea& area : areas)
+	{
+		if(area.usageType == VPMUsage::REGISTER_SPILLING)
+			startOfSpillingAreas = std::min(startOfSpillingAreas, area.baseOffset);
+		else
+			endOfAreas = std::max(endOfAreas, area.baseOffset + area.getTotalSize());
+	}
+	//round up to a whole row
+	endOfAreas = (endOfAreas + 63) / 64 * 64;
+	return std::make_pair(endOfAreas, startOfSpillingAreas);
+}
+
 void VPM::updateScratchSize(unsigned requestedSize)
 {
-	if(isScratchLocked)
+	if(isScratchLocked && requestedSize > getScratchArea().size)
 		throw CompilationError(CompilationStep::GENERAL, "Size of the scratch area is already locked");
 	if(requestedSize > maximumVPMSize)
 		throw CompilationError(CompilationStep::GENERAL, "The requested size of the scratch area exceeds the total VPM size", std::to_string(requestedSize));
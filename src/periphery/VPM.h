@@ -480,6 +480,8 @@ namespace vc4c
 			GENERAL_DMA,
 			//part of the VPM used as cache for DMA access to specific memory regions
 			SPECIFIC_DMA,
+			//part of the VPM used as cache for DMA access to specific memory regions, where every QPU has its own copy of the cached region
+			SPECIFIC_DMA_PER_QPU,
 			//this area is used to spill registers into
 			REGISTER_SPILLING
 		};
@@ -516,7 +518,23 @@ namespace vc4c
 
 			const VPMArea& getScratchArea();
 			const VPMArea* findArea(const Local* local);
-			const VPMArea* addArea(const Local* local, unsigned requestedSize, bool alignToBack = false);
+			/*
+			 * Reserves an area (aligned to whole rows) after all other areas at the start of the VPM to cache the memory region referenced by the given local.
+			 * If the area is reserved per QPU, every QPU accesses its own copy of the cached region.
+			 *
+			 * Returns nullptr, if there is not enough free space left in the VPM
+			 */
+			const VPMArea* addArea(const Local* local, unsigned requestedSize, bool isPerQPU = false);
+			/*
+			 * Reserves an area at the end of the VPM to spill the given number of registers into, where every QPU has its own part of the area.
+			 *
+			 * Returns nullptr, if there is not enough free space left in the VPM
+			 */
+			const VPMArea* addSpillingArea(unsigned numRegisters);
+			/*
+			 * Whether any area is reserved per QPU (see VPMArea#requiresSpacePerQPU), which would be shared by both hardware-threads of a QPU in threaded mode
+			 */
+			bool hasAreasPerQPU() const;
 
 			/*
 			 * The maximum number of vectors (of the given type) which can be cached in this VPM.
@@ -550,10 +568,43 @@ namespace vc4c
 			 * Inserts a filling of a memory-area with a single value from VPM
 			 */
 			InstructionWalker insertFillRAM(Method& method, InstructionWalker it, const Value& memoryAddress, const DataType& type, unsigned numCopies, const VPMArea* area = nullptr, bool useMutex = true);
+			/*
+			 * Inserts a write of a whole register into the given slot of the part of the register-spilling area reserved for the executing QPU.
+			 *
+			 * Since no other QPU accesses this part of the VPM, the access does not need to be guarded by the mutex
+			 */
+			InstructionWalker insertSpillRegister(Method& method, InstructionWalker it, const Value& src, const VPMArea& area, unsigned slot) const;
+			/*
+			 * Inserts a read of a whole register from the given slot of the part of the register-spilling area reserved for the executing QPU
+			 */
+			InstructionWalker insertReloadRegister(Method& method, InstructionWalker it, const Value& dest, const VPMArea& area, unsigned slot) const;
+
+			/*
+			 * Inserts a DMA load of the given number of bytes from the memory address into the cache area (see #addArea).
+			 * For areas reserved per QPU, the data is loaded into the copy of the executing QPU.
+			 */
+			InstructionWalker insertFillCache(Method& method, InstructionWalker it, const Value& memoryAddress, const VPMArea& area, unsigned numBytes, bool useMutex = true) const;
+			/*
+			 * Inserts a DMA write of the given number of 32-bit words, starting at the given word of the cache area, into the memory address.
+			 * All words written need to be located within the same row of the VPM.
+			 */
+			InstructionWalker insertFlushCache(Method& method, InstructionWalker it, const Value& memoryAddress, const VPMArea& area, unsigned wordOffset, unsigned numWords, bool useMutex = true) const;
+			/*
+			 * Inserts a read of the 32-bit word at the given byte-offset (a literal or a local) within the cache area.
+			 * The word is replicated across all elements of the destination, same as for a scalar memory lookup via TMU.
+			 *
+			 * Since the cache area is not used for anything else, no mutex is required
+			 */
+			InstructionWalker insertReadCache(Method& method, InstructionWalker it, const Value& dest, const VPMArea& area, const Value& byteOffset) const;
+			/*
+			 * Inserts a write of the (scalar) 32-bit value into the word at the given byte-offset within the cache area.
+			 * Since the VPM can only be written in whole rows, the row containing the word is read, modified and written back.
+			 */
+			InstructionWalker insertWriteCache(Method& method, InstructionWalker it, const Value& src, const VPMArea& area, unsigned byteOffset) const;
 
 			/*
 			 * Updates the maximum size used by the scratch area.
-			 * This can only be called until the scratch-area is locked!
+			 * The scratch-area can only grow until it is locked!
 			 */
 			void updateScratchSize(unsigned requestedSize);
 
@@ -563,6 +614,10 @@ namespace vc4c
 			//whether the scratch area is locked to a fixed size
 			bool isScratchLocked;
 
+			/*
+			 * Returns the first free offset after all areas located at the start of the VPM and the offset of the first area located at the end of the VPM
+			 */
+			std::pair<unsigned, unsigned> findFreeSpace() const;
 			InstructionWalker insertLockMutex(InstructionWalker it, bool useMutex) const;
 			InstructionWalker insertUnlockMutex(InstructionWalker it, bool useMutex) const;
 		};
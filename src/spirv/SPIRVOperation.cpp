@@ -11,7 +11,6 @@
 #include "../intermediate/TypeConversions.h"
 #include "../intrinsics/Images.h"
 #include "../intrinsics/Operators.h"
-#include "../periphery/VPM.h"
 #include "helper.h"
 #include "log.h"
 
@@ -348,8 +347,9 @@ void SPIRVConversion::mapInstruction(std::map<uint32_t, DataType>& types, std::m
     		break;
     	case ConversionType::SIGNED:
     		if(isSaturated)
-    			intermediate::insertSaturation(method.method->appendToEnd(), *method.method.get(), source, dest, true);
-    		if(sourceWidth < destWidth)
+    			//unsigned to signed conversion
+    			intermediate::insertSaturation(method.method->appendToEnd(), *method.method.get(), source, dest, true, false);
+    		else if(sourceWidth < destWidth)
     			method.method->appendToEnd((new intermediate::Operation("sext", dest, source))->setDecorations(decorations));
     		else
     			//for |dest| > |source|, we do nothing (just move), since truncating would cut off the leading 1-bits for negative numbers
@@ -359,7 +359,8 @@ void SPIRVConversion::mapInstruction(std::map<uint32_t, DataType>& types, std::m
     		break;
     	case ConversionType::UNSIGNED:
     		if(isSaturated)
-    			intermediate::insertSaturation(method.method->appendToEnd(), *method.method.get(), source, dest, false);
+    			//signed to unsigned conversion
+    			intermediate::insertSaturation(method.method->appendToEnd(), *method.method.get(), source, dest, false, true);
     		else if(sourceWidth > destWidth)
     			method.method->appendToEnd((new intermediate::Operation("trunc", dest, source))->setDecorations(decorations));
     		else if(sourceWidth == destWidth)
@@ -431,12 +432,12 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
         if(memoryAccess == MemoryAccess::READ)
         {
             logging::debug() << "Generating reading of " << source.to_string() << " into " << dest.to_string() << logging::endl;
-            periphery::insertReadVectorFromTMU(*method.method.get(), method.method->appendToEnd(), dest, source);
+            method.method->appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::READ, dest, source));
         }
         else if(memoryAccess == MemoryAccess::WRITE)
         {
             logging::debug() << "Generating writing of " << source.to_string() << " into " << dest.to_string() << logging::endl;
-            periphery::insertWriteDMA(*method.method.get(), method.method->appendToEnd(), source, dest);
+            method.method->appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::WRITE, dest, source));
         }
         else if(memoryAccess == MemoryAccess::READ_WRITE)
         {
@@ -444,10 +445,15 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
         	{
         		//copy single object
 				logging::debug() << "Generating copying of " << source.to_string() << " into " << dest.to_string() << logging::endl;
-				const Value tmp = method.method->addNewLocal(source.type, "%copy_tmp");
-				//TODO use VPM#insertCopyRAM
-				periphery::insertReadDMA(*method.method.get(), method.method->appendToEnd(), tmp, source);
-				periphery::insertWriteDMA(*method.method.get(), method.method->appendToEnd(), tmp, dest);
+				if(source.type.getPointerType())
+					//copy the object directly from memory to memory
+					method.method->appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::COPY, dest, source));
+				else
+				{
+					const Value tmp = method.method->addNewLocal(source.type, "%copy_tmp");
+					method.method->appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::READ, tmp, source));
+					method.method->appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::WRITE, dest, tmp));
+				}
         	}
         	else
         	{
@@ -456,7 +462,16 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
         		logging::debug() << "Generating copying of " << size.to_string() << " bytes from " << source.to_string() << " into " << dest.to_string() << logging::endl;
         		if(size.hasType(ValueType::LITERAL))
         		{
-        			method.method->vpm->insertCopyRAM(*method.method, method.method->appendToEnd(), dest, source, size.literal.integer);
+        			//the size of memory instructions is given in entries of the memory copied, so copy partial entries byte-wise
+        			const unsigned elementWidth = source.type.getElementType().getPhysicalWidth();
+        			if(size.literal.integer % elementWidth == 0)
+        				method.method->appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::COPY, dest, source, Value(Literal(size.literal.integer / elementWidth), TYPE_INT32)));
+        			else if(source.hasType(ValueType::LOCAL) && dest.hasType(ValueType::LOCAL))
+        				method.method->appendToEnd(new intermediate::MemoryInstruction(intermediate::MemoryOperation::COPY,
+        						Value(dest.local, TYPE_INT8.toPointerType(dest.type.getPointerType().value()->addressSpace)),
+        						Value(source.local, TYPE_INT8.toPointerType(source.type.getPointerType().value()->addressSpace)), size));
+        			else
+        				throw CompilationError(CompilationStep::LLVM_2_IR, "Copying partial objects of memory is not yet implemented", size.to_string());
         		}
         		else
         			//TODO in any case, loop over copies, up to the size specified
@@ -551,18 +551,16 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     }
     case SpvOpTypeImage:
     {
-        ImageType* image = new ImageType();
-        image->dimensions = static_cast<uint8_t>(getWord(parsed_instruction, 3)) + 1;
-        image->isImageArray = getWord(parsed_instruction, 5);
-        if(image->dimensions == 6 /* buffered */)
+        uint8_t dimensions = static_cast<uint8_t>(getWord(parsed_instruction, 3)) + 1;
+        bool isImageBuffer = false;
+        if(dimensions == 6 /* buffered */)
         {
         	//there are only buffered 1D images
-        	image->dimensions = 1;
-        	image->isImageBuffer = true;
+        	dimensions = 1;
+        	isImageBuffer = true;
         }
-        image->isSampled = false;
-        typeMappings[parsed_instruction->result_id] = DataType(image->getImageTypeName());
-        typeMappings.at(parsed_instruction->result_id).complexType.reset(image);
+        typeMappings[parsed_instruction->result_id] = DataType::createImageType(dimensions, getWord(parsed_instruction, 5), isImageBuffer, false);
+        const ImageType* image = typeMappings.at(parsed_instruction->result_id).getImageType().value();
         logging::debug() << "Reading image-type '" << image->getImageTypeName() << "' with " << image->dimensions << " dimensions" << (image->isImageArray ? " (array)" : "") << (image->isImageBuffer ? " (buffer)" : "") << logging::endl;
         return SPV_SUCCESS;
     }
@@ -572,60 +570,49 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     case SpvOpTypeSampledImage:
     {
     	const ImageType* image = typeMappings.at(getWord(parsed_instruction, 2)).getImageType().value();
-    	ImageType* sampledImage = new ImageType();
-    	sampledImage->dimensions = image->dimensions;
-    	sampledImage->isImageArray = image->isImageArray;
-    	sampledImage->isImageBuffer = image->isImageBuffer;
-    	sampledImage->isSampled = true;
 
-        typeMappings[parsed_instruction->result_id] = typeMappings.at(getWord(parsed_instruction, 2));
-        typeMappings.at(parsed_instruction->result_id).complexType.reset(sampledImage);
+        typeMappings[parsed_instruction->result_id] = DataType::createImageType(image->dimensions, image->isImageArray, image->isImageBuffer, true);
         logging::debug() << "Reading sampled image-type '" << image->getImageTypeName() << "' with " << image->dimensions << " dimensions" << (image->isImageArray ? " (array)" : "") << (image->isImageBuffer ? " (buffer)" : "") << logging::endl;
         return SPV_SUCCESS;
     }
     case SpvOpTypeArray:
     {
         const DataType elementType = typeMappings.at(getWord(parsed_instruction, 2));
-        DataType arrayType((elementType.to_string() + "[") + std::to_string(constantMappings.at(getWord(parsed_instruction, 3)).literal.integer) + "]");
-        arrayType.complexType.reset(new ArrayType(elementType, constantMappings.at(getWord(parsed_instruction, 3)).literal.integer));
-        typeMappings[getWord(parsed_instruction, 1)] = arrayType;
+        typeMappings[getWord(parsed_instruction, 1)] = elementType.toArrayType(static_cast<unsigned>(constantMappings.at(getWord(parsed_instruction, 3)).literal.integer));
         return SPV_SUCCESS;
     }
     case SpvOpTypeStruct:
     {
-        StructType* structDef = new StructType({});
-        DataType type;
-        type.complexType.reset(structDef);
+        std::string name;
         if(names.find(parsed_instruction->result_id) != names.end())
-            type.typeName = names.at(parsed_instruction->result_id);
-        //add reference to this struct-type to type-mappings
-        typeMappings[parsed_instruction->result_id] = type;
+            name = names.at(parsed_instruction->result_id);
+        std::vector<DataType> elementTypes;
         const auto typeIDs = parseArguments(parsed_instruction, 2);
         for(const uint32_t typeID : typeIDs)
         {
-            structDef->elementTypes.push_back(typeMappings.at(typeID));
+            elementTypes.push_back(typeMappings.at(typeID));
         }
         //set "packed" decoration
+        bool isPacked = false;
         if(decorationMappings.find(parsed_instruction->result_id) != decorationMappings.end())
         {
             if(getDecoration(decorationMappings.at(parsed_instruction->result_id), SpvDecorationCPacked))
             {
-                structDef->isPacked = true;
+                isPacked = true;
             }
         }
+        //add this struct-type to type-mappings
+        typeMappings[parsed_instruction->result_id] = DataType::createStructType(name, elementTypes, isPacked);
         return SPV_SUCCESS;
     }
     case SpvOpTypeOpaque:
-        typeMappings[getWord(parsed_instruction, 1)] = TYPE_UNKNOWN;
-        typeMappings.at(getWord(parsed_instruction, 1)).typeName = readLiteralString(parsed_instruction, &parsed_instruction->operands[1]);
+        typeMappings[getWord(parsed_instruction, 1)] = DataType(readLiteralString(parsed_instruction, &parsed_instruction->operands[1]));
         //Since there is no memory-layout to them, they can only be used as pointers
         return SPV_SUCCESS;
     case SpvOpTypePointer:
     {
-        DataType type = typeMappings.at(getWord(parsed_instruction, 3));
-        std::shared_ptr<ComplexType> elemType(new PointerType(type, toAddressSpace(static_cast<SpvStorageClass>(getWord(parsed_instruction, 2)))));
-        type = DataType(type.to_string() + "*", 1, elemType);
-        typeMappings[getWord(parsed_instruction, 1)] = type;
+        const DataType elementType = typeMappings.at(getWord(parsed_instruction, 3));
+        typeMappings[getWord(parsed_instruction, 1)] = elementType.toPointerType(toAddressSpace(static_cast<SpvStorageClass>(getWord(parsed_instruction, 2))));
         return SPV_SUCCESS;
     }
     case SpvOpTypeFunction:
@@ -808,8 +795,8 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
         else
         {
         	//OpVariables outside of any function are global data
-        	module->globalData.emplace_back(Global(name, type, val));
-        	module->globalData.back().type.getPointerType().value()->alignment = alignment;
+        	const PointerType* pointerType = type.getPointerType().value();
+        	module->globalData.emplace_back(Global(name, pointerType->elementType.toPointerType(pointerType->addressSpace, alignment), val));
 			memoryAllocatedData.emplace(parsed_instruction->result_id, &module->globalData.back());
         }
         logging::debug() << "Reading variable: " << type.to_string() << " " << name << " with value: " << val.to_string(false, true) << logging::endl;
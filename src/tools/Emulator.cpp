@@ -0,0 +1,1518 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Emulator.h"
+
+#include "CompilationError.h"
+#include "Precompiler.h"
+#include "../Profiler.h"
+#include "../Values.h"
+#include "../asm/ALUInstruction.h"
+#include "../asm/BranchInstruction.h"
+#include "../asm/KernelInfo.h"
+#include "../asm/LoadInstruction.h"
+#include "../asm/SemaphoreInstruction.h"
+#include "../periphery/VPM.h"
+#include "log.h"
+
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+using namespace vc4c;
+using namespace vc4c::tools;
+
+static std::string toHex(uint32_t val)
+{
+	std::stringstream s;
+	s << "0x" << std::hex << val;
+	return s.str();
+}
+
+/*
+ * Floating-point helpers
+ *
+ * The QPU flushes denormals to zero for inputs and outputs
+ */
+static float toFloat(uint32_t val)
+{
+	float f;
+	std::memcpy(&f, &val, sizeof(f));
+	if(std::fpclassify(f) == FP_SUBNORMAL)
+		return std::copysign(0.0f, f);
+	return f;
+}
+
+static uint32_t fromFloat(float f)
+{
+	if(std::fpclassify(f) == FP_SUBNORMAL)
+		f = std::copysign(0.0f, f);
+	uint32_t val;
+	std::memcpy(&val, &f, sizeof(f));
+	return val;
+}
+
+static float halfToFloat(uint16_t half)
+{
+	const uint32_t sign = static_cast<uint32_t>(half >> 15) & 0x1;
+	const uint32_t exponent = static_cast<uint32_t>(half >> 10) & 0x1F;
+	const uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+	if(exponent == 0)
+		//zero and (flushed) denormals
+		bits = sign << 31;
+	else if(exponent == 0x1F)
+		//Inf and NaN
+		bits = (sign << 31) | 0x7F800000 | (mantissa << 13);
+	else
+		bits = (sign << 31) | ((exponent + 112) << 23) | (mantissa << 13);
+	return toFloat(bits);
+}
+
+static uint16_t floatToHalf(float f)
+{
+	const uint32_t bits = fromFloat(f);
+	const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+	const uint32_t mantissa = bits & 0x7FFFFF;
+	if(((bits >> 23) & 0xFF) == 0xFF)
+		//Inf and NaN
+		return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+	if(exponent >= 0x1F)
+		//overflow -> Inf
+		return static_cast<uint16_t>(sign | 0x7C00);
+	if(exponent <= 0)
+		//underflow -> (signed) zero
+		return sign;
+	return static_cast<uint16_t>(sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13));
+}
+
+template<typename T>
+static uint32_t saturateTo(uint32_t val)
+{
+	return static_cast<uint32_t>(saturate<T>(static_cast<int32_t>(val)));
+}
+
+/*
+ * Calculates the value of the (pm = 0) regfile A unpack or the (pm = 1) r4 unpack for the given consuming operation
+ */
+static uint32_t unpackValue(const Unpack unpack, const uint32_t val, const bool consumesFloat)
+{
+	switch(unpack.value)
+	{
+		case UNPACK_NOP.value:
+			return val;
+		case UNPACK_16A_32.value:
+			if(consumesFloat)
+				return fromFloat(halfToFloat(static_cast<uint16_t>(val & 0xFFFF)));
+			return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(val & 0xFFFF)));
+		case UNPACK_16B_32.value:
+			if(consumesFloat)
+				return fromFloat(halfToFloat(static_cast<uint16_t>(val >> 16)));
+			return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(val >> 16)));
+		case UNPACK_8888_32.value:
+			return (val >> 24) * 0x01010101;
+		case UNPACK_8A_32.value:
+		case UNPACK_8B_32.value:
+		case UNPACK_8C_32.value:
+		case UNPACK_8D_32.value:
+		{
+			const uint32_t byte = (val >> (8 * (unpack.value - UNPACK_8A_32.value))) & 0xFF;
+			if(consumesFloat)
+				return fromFloat(static_cast<float>(byte) / 255.0f);
+			return byte;
+		}
+		default:
+			throw CompilationError(CompilationStep::GENERAL, "Invalid unpack mode", std::to_string(static_cast<unsigned>(unpack.value)));
+	}
+}
+
+/*
+ * Calculates the value written by the (pm = 0) regfile A pack unit, for partial writes, the other bits of the old value are retained
+ */
+static uint32_t packValue(const Pack pack, const uint32_t oldVal, const uint32_t val, const bool isFloat, const bool overflow)
+{
+	switch(pack.value)
+	{
+		case PACK_NOP.value:
+			return val;
+		case PACK_32_16A.value:
+			return (oldVal & 0xFFFF0000) | (isFloat ? floatToHalf(toFloat(val)) : (val & 0xFFFF));
+		case PACK_32_16B.value:
+			return (oldVal & 0x0000FFFF) | (static_cast<uint32_t>(isFloat ? floatToHalf(toFloat(val)) : (val & 0xFFFF)) << 16);
+		case PACK_32_8888.value:
+			return (val & 0xFF) * 0x01010101;
+		case PACK_32_8A.value:
+		case PACK_32_8B.value:
+		case PACK_32_8C.value:
+		case PACK_32_8D.value:
+		{
+			const uint32_t shift = 8 * (pack.value - PACK_32_8A.value);
+			return (oldVal & ~(0xFFu << shift)) | ((val & 0xFF) << shift);
+		}
+		case PACK_32_32.value:
+			if(overflow)
+				//the sign of the overflown result is inverted
+				return static_cast<int32_t>(val) < 0 ? static_cast<uint32_t>(std::numeric_limits<int32_t>::max()) : static_cast<uint32_t>(std::numeric_limits<int32_t>::min());
+			return val;
+		case PACK_32_16A_S.value:
+			return (oldVal & 0xFFFF0000) | (isFloat ? floatToHalf(toFloat(val)) : (saturateTo<int16_t>(val) & 0xFFFF));
+		case PACK_32_16B_S.value:
+			return (oldVal & 0x0000FFFF) | ((isFloat ? floatToHalf(toFloat(val)) : (saturateTo<int16_t>(val) & 0xFFFF)) << 16);
+		case PACK_32_8888_S.value:
+			return saturateTo<uint8_t>(val) * 0x01010101;
+		case PACK_32_8A_S.value:
+		case PACK_32_8B_S.value:
+		case PACK_32_8C_S.value:
+		case PACK_32_8D_S.value:
+		{
+			const uint32_t shift = 8 * (pack.value - PACK_32_8A_S.value);
+			return (oldVal & ~(0xFFu << shift)) | (saturateTo<uint8_t>(val) << shift);
+		}
+		default:
+			throw CompilationError(CompilationStep::GENERAL, "Invalid pack mode", std::to_string(static_cast<unsigned>(pack.value)));
+	}
+}
+
+/*
+ * Calculates the value written by the (pm = 1) mul ALU color conversion
+ */
+static uint32_t packColor(const Pack pack, const uint32_t oldVal, const uint32_t val)
+{
+	const float f = std::round(toFloat(val) * 255.0f);
+	const uint32_t color = f <= 0.0f ? 0 : (f >= 255.0f ? 255 : static_cast<uint32_t>(f));
+	const unsigned char mode = pack.value & 0xF;
+	if(mode == PACK_NOP.value)
+		return val;
+	if(mode == PACK_32_8888.value)
+		return color * 0x01010101;
+	if(mode >= PACK_MUL_COLOR0.value && mode <= PACK_MUL_COLOR3.value)
+	{
+		const uint32_t shift = 8 * (mode - PACK_MUL_COLOR0.value);
+		return (oldVal & ~(0xFFu << shift)) | (color << shift);
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Invalid mul pack mode", std::to_string(static_cast<unsigned>(pack.value)));
+}
+
+template<typename Func>
+static uint32_t forEachByte(const uint32_t a, const uint32_t b, const Func& func)
+{
+	uint32_t result = 0;
+	for(uint32_t shift = 0; shift < 32; shift += 8)
+		result |= (static_cast<uint32_t>(func((a >> shift) & 0xFF, (b >> shift) & 0xFF)) & 0xFF) << shift;
+	return result;
+}
+
+/*
+ * Calculates the result of the add ALU for a single SIMD element.
+ *
+ * NOTE: The carry flag is only calculated for integer additions and subtractions, the overflow only for the PACK_32_32 saturation
+ */
+static uint32_t calculateAdd(const unsigned char opCode, const uint32_t a, const uint32_t b, bool& carry, bool& overflow)
+{
+	carry = false;
+	overflow = false;
+	switch(opCode)
+	{
+		case OP_NOP.opAdd:
+			return 0;
+		case OP_FADD.opAdd:
+			return fromFloat(toFloat(a) + toFloat(b));
+		case OP_FSUB.opAdd:
+			return fromFloat(toFloat(a) - toFloat(b));
+		case OP_FMIN.opAdd:
+			return fromFloat(std::min(toFloat(a), toFloat(b)));
+		case OP_FMAX.opAdd:
+			return fromFloat(std::max(toFloat(a), toFloat(b)));
+		case OP_FMINABS.opAdd:
+			return fromFloat(std::min(std::fabs(toFloat(a)), std::fabs(toFloat(b))));
+		case OP_FMAXABS.opAdd:
+			return fromFloat(std::max(std::fabs(toFloat(a)), std::fabs(toFloat(b))));
+		case OP_FTOI.opAdd:
+		{
+			const float f = toFloat(a);
+			if(std::isnan(f) || std::fabs(f) >= 2147483648.0f)
+				return 0;
+			return static_cast<uint32_t>(static_cast<int32_t>(f));
+		}
+		case OP_ITOF.opAdd:
+			return fromFloat(static_cast<float>(static_cast<int32_t>(a)));
+		case OP_ADD.opAdd:
+		{
+			const int64_t wide = static_cast<int64_t>(static_cast<int32_t>(a)) + static_cast<int64_t>(static_cast<int32_t>(b));
+			carry = (static_cast<uint64_t>(a) + static_cast<uint64_t>(b)) > 0xFFFFFFFFu;
+			overflow = wide > std::numeric_limits<int32_t>::max() || wide < std::numeric_limits<int32_t>::min();
+			return a + b;
+		}
+		case OP_SUB.opAdd:
+		{
+			const int64_t wide = static_cast<int64_t>(static_cast<int32_t>(a)) - static_cast<int64_t>(static_cast<int32_t>(b));
+			carry = a < b;
+			overflow = wide > std::numeric_limits<int32_t>::max() || wide < std::numeric_limits<int32_t>::min();
+			return a - b;
+		}
+		case OP_SHR.opAdd:
+			return a >> (b & 0x1F);
+		case OP_ASR.opAdd:
+			return static_cast<uint32_t>(static_cast<int32_t>(a) >> (b & 0x1F));
+		case OP_ROR.opAdd:
+			return (b & 0x1F) == 0 ? a : ((a >> (b & 0x1F)) | (a << (32 - (b & 0x1F))));
+		case OP_SHL.opAdd:
+			return a << (b & 0x1F);
+		case OP_MIN.opAdd:
+			return static_cast<uint32_t>(std::min(static_cast<int32_t>(a), static_cast<int32_t>(b)));
+		case OP_MAX.opAdd:
+			return static_cast<uint32_t>(std::max(static_cast<int32_t>(a), static_cast<int32_t>(b)));
+		case OP_AND.opAdd:
+			return a & b;
+		case OP_OR.opAdd:
+			return a | b;
+		case OP_XOR.opAdd:
+			return a ^ b;
+		case OP_NOT.opAdd:
+			return ~a;
+		case OP_CLZ.opAdd:
+		{
+			uint32_t count = 0;
+			for(uint32_t mask = 0x80000000; mask != 0 && (a & mask) == 0; mask >>= 1)
+				++count;
+			return count;
+		}
+		case OP_V8ADDS.opAdd:
+			return forEachByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return std::min(x + y, 255u); });
+		case OP_V8SUBS.opAdd:
+			return forEachByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return x > y ? x - y : 0u; });
+		default:
+			throw CompilationError(CompilationStep::GENERAL, "Invalid add ALU op-code", std::to_string(static_cast<unsigned>(opCode)));
+	}
+}
+
+/*
+ * Calculates the result of the mul ALU for a single SIMD element
+ */
+static uint32_t calculateMul(const unsigned char opCode, const uint32_t a, const uint32_t b)
+{
+	switch(opCode)
+	{
+		case OP_NOP.opMul:
+			return 0;
+		case OP_FMUL.opMul:
+			return fromFloat(toFloat(a) * toFloat(b));
+		case OP_MUL24.opMul:
+			return (a & 0xFFFFFF) * (b & 0xFFFFFF);
+		case OP_V8MULD.opMul:
+			return forEachByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return (x * y + 127) / 255; });
+		case OP_V8MIN.opMul:
+			return forEachByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return std::min(x, y); });
+		case OP_V8MAX.opMul:
+			return forEachByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return std::max(x, y); });
+		case OP_V8ADDS.opMul:
+			return forEachByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return std::min(x + y, 255u); });
+		case OP_V8SUBS.opMul:
+			return forEachByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return x > y ? x - y : 0u; });
+		default:
+			throw CompilationError(CompilationStep::GENERAL, "Invalid mul ALU op-code", std::to_string(static_cast<unsigned>(opCode)));
+	}
+}
+
+std::string tools::toString(const StallReason reason)
+{
+	switch(reason)
+	{
+		case StallReason::TMU:
+			return "TMU";
+		case StallReason::VPM_DMA_LOAD:
+			return "DMA load";
+		case StallReason::VPM_DMA_STORE:
+			return "DMA store";
+		case StallReason::MUTEX:
+			return "mutex";
+		case StallReason::SEMAPHORE:
+			return "semaphore";
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Unhandled stall reason", std::to_string(static_cast<unsigned>(reason)));
+}
+
+std::string tools::toString(const Hazard hazard)
+{
+	switch(hazard)
+	{
+		case Hazard::SFU_RESULT:
+			return "SFU result";
+		case Hazard::VPM_READ:
+			return "VPM read";
+		case Hazard::REGISTER_FILE:
+			return "register-file";
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Unhandled hazard", std::to_string(static_cast<unsigned>(hazard)));
+}
+
+ParameterValue ParameterValue::fromScalar(const uint32_t value)
+{
+	return ParameterValue{{value}, {}, false};
+}
+
+ParameterValue ParameterValue::fromVector(const std::vector<uint32_t>& values)
+{
+	return ParameterValue{values, {}, false};
+}
+
+ParameterValue ParameterValue::fromBuffer(const std::vector<uint32_t>& contents)
+{
+	return ParameterValue{{}, contents, true};
+}
+
+uint64_t QPUStatistics::getTotalStalls() const
+{
+	uint64_t sum = 0;
+	for(uint64_t stall : stalls)
+		sum += stall;
+	return sum;
+}
+
+uint64_t QPUStatistics::getTotalHazards() const
+{
+	uint64_t sum = 0;
+	for(uint64_t hazard : hazards)
+		sum += hazard;
+	return sum;
+}
+
+void EmulationResult::dumpStatistics(std::ostream& stream) const
+{
+	stream << "Kernel '" << kernelName << "' " << (completed ? "finished" : "aborted") << " after " << totalCycles << " cycles" << std::endl;
+	for(std::size_t i = 0; i < qpuStatistics.size(); ++i)
+	{
+		const QPUStatistics& stats = qpuStatistics[i];
+		stream << "QPU " << std::setw(2) << i << ": " << stats.cycles << " cycles, " << stats.instructions << " instructions (" << stats.nops << " nops), "
+				<< stats.branchesTaken << "/" << stats.branches << " branches taken, " << stats.uniformsRead << " UNIFORMs, " << stats.getTotalStalls() << " stall cycles";
+		for(std::size_t r = 0; r < NUM_STALL_REASONS; ++r)
+		{
+			if(stats.stalls[r] != 0)
+				stream << ", " << toString(static_cast<StallReason>(r)) << ": " << stats.stalls[r];
+		}
+		if(stats.getTotalHazards() != 0)
+		{
+			stream << ", " << stats.getTotalHazards() << " hazards";
+			for(std::size_t h = 0; h < NUM_HAZARDS; ++h)
+			{
+				if(stats.hazards[h] != 0)
+					stream << ", " << toString(static_cast<Hazard>(h)) << ": " << stats.hazards[h];
+			}
+		}
+		stream << std::endl;
+	}
+	stream << "Memory: " << memoryStatistics.tmuRequests << " TMU requests (" << memoryStatistics.tmuCacheMisses << " cache misses, " << memoryStatistics.tmuBytesRead << " bytes read), "
+			<< memoryStatistics.dmaLoads << " DMA loads (" << memoryStatistics.dmaBytesRead << " bytes), "
+			<< memoryStatistics.dmaStores << " DMA stores (" << memoryStatistics.dmaBytesWritten << " bytes), "
+			<< memoryStatistics.uniformBytesRead << " bytes of UNIFORMs" << std::endl;
+}
+
+MemoryAddress Memory::allocate(const std::vector<uint32_t>& contents)
+{
+	//align all buffers to cache-lines
+	data.resize(data.size() + Byte(data.size()).getPaddingTo(64));
+	const MemoryAddress address = static_cast<MemoryAddress>(MEMORY_BASE_ADDRESS + data.size());
+	const std::size_t offset = data.size();
+	//allocate at least one word, so every buffer has a distinct address
+	data.resize(data.size() + std::max(contents.size(), static_cast<std::size_t>(1)) * sizeof(uint32_t), 0);
+	std::memcpy(data.data() + offset, contents.data(), contents.size() * sizeof(uint32_t));
+	return address;
+}
+
+std::vector<uint32_t> Memory::readBuffer(const MemoryAddress address, const std::size_t numWords) const
+{
+	std::vector<uint32_t> result(numWords);
+	std::memcpy(result.data(), data.data() + toOffset(address, numWords * sizeof(uint32_t)), numWords * sizeof(uint32_t));
+	return result;
+}
+
+uint32_t Memory::readWord(const MemoryAddress address) const
+{
+	uint32_t val;
+	std::memcpy(&val, data.data() + toOffset(address, sizeof(uint32_t)), sizeof(uint32_t));
+	return val;
+}
+
+uint8_t Memory::readByte(const MemoryAddress address) const
+{
+	return data.at(toOffset(address, 1));
+}
+
+void Memory::writeByte(const MemoryAddress address, const uint8_t value)
+{
+	data.at(toOffset(address, 1)) = value;
+}
+
+std::size_t Memory::toOffset(const MemoryAddress address, const std::size_t numBytes) const
+{
+	if(address < MEMORY_BASE_ADDRESS || (address - MEMORY_BASE_ADDRESS) + numBytes > data.size())
+		throw CompilationError(CompilationStep::GENERAL, "Access to invalid memory address", toHex(address));
+	return address - MEMORY_BASE_ADDRESS;
+}
+
+bool Mutex::isLockable(const uint8_t qpu) const
+{
+	return !owner || owner.value() == qpu;
+}
+
+void Mutex::lock(const uint8_t qpu)
+{
+	if(!isLockable(qpu))
+		throw CompilationError(CompilationStep::GENERAL, "Mutex is already locked by another QPU", std::to_string(static_cast<unsigned>(owner.value())));
+	owner = qpu;
+}
+
+void Mutex::unlock(const uint8_t qpu)
+{
+	//unlocking a not locked mutex has no effect
+	if(owner && owner.value() == qpu)
+		owner = Optional<uint8_t>{};
+}
+
+bool Semaphores::isIncrementPossible(const uint8_t index) const
+{
+	return counters.at(index) < 15;
+}
+
+bool Semaphores::isDecrementPossible(const uint8_t index) const
+{
+	return counters.at(index) > 0;
+}
+
+void Semaphores::increment(const uint8_t index)
+{
+	++counters.at(index);
+}
+
+void Semaphores::decrement(const uint8_t index)
+{
+	--counters.at(index);
+}
+
+/*
+ * Truncates the mantissa of the exact result to the precision of the SFU
+ */
+static uint32_t approximate(const float f)
+{
+	return fromFloat(f) & ~((1u << (23 - SFU_MANTISSA_BITS)) - 1u);
+}
+
+void SFU::startCalculation(const uint8_t reg, const SIMDVector& input, const uint64_t cycle)
+{
+	SIMDVector output;
+	for(std::size_t i = 0; i < input.size(); ++i)
+	{
+		const float f = toFloat(input[i]);
+		switch(reg)
+		{
+			case REG_SFU_RECIP.num:
+				output[i] = approximate(1.0f / f);
+				break;
+			case REG_SFU_RECIP_SQRT.num:
+				output[i] = approximate(1.0f / std::sqrt(f));
+				break;
+			case REG_SFU_EXP2.num:
+				output[i] = approximate(std::exp2(f));
+				break;
+			case REG_SFU_LOG2.num:
+				output[i] = approximate(std::log2(f));
+				break;
+			default:
+				throw CompilationError(CompilationStep::GENERAL, "Invalid SFU register", std::to_string(static_cast<unsigned>(reg)));
+		}
+	}
+	result = output;
+	readyCycle = cycle + SFU_LATENCY;
+}
+
+bool SFU::isResultReady(const uint64_t cycle) const
+{
+	return result && cycle >= readyCycle;
+}
+
+bool SFU::hasPendingResult() const
+{
+	return result.has_value();
+}
+
+SIMDVector SFU::takeResult()
+{
+	const SIMDVector tmp = result.value();
+	result = Optional<SIMDVector>{};
+	return tmp;
+}
+
+TMU::TMU(Memory& memory, MemoryStatistics& statistics, FastSet<MemoryAddress>& cache) : memory(memory), statistics(statistics), cache(cache)
+{
+}
+
+void TMU::pushRequest(const SIMDVector& addresses, const uint64_t cycle)
+{
+	//the hardware would lock up, since the request FIFO is never emptied
+	if(responses.size() >= TMU_FIFO_DEPTH)
+		throw CompilationError(CompilationStep::GENERAL, "TMU request FIFO overflow, too many outstanding requests", std::to_string(responses.size()));
+	Response response;
+	bool cacheMiss = false;
+	for(std::size_t i = 0; i < addresses.size(); ++i)
+	{
+		//addresses in the zero-page are used by the code-generator for the unused elements, they return zero
+		if(addresses[i] < MEMORY_BASE_ADDRESS)
+		{
+			response.data[i] = 0;
+			continue;
+		}
+		//TMU reads are always word-aligned
+		response.data[i] = memory.readWord(addresses[i] & 0xFFFFFFFC);
+		statistics.tmuBytesRead += sizeof(uint32_t);
+		const MemoryAddress cacheLine = addresses[i] / 64;
+		if(cache.find(cacheLine) == cache.end())
+		{
+			cacheMiss = true;
+			//simple approximation of a bounded cache
+			if(cache.size() >= TMU_CACHE_LINES)
+				cache.clear();
+			cache.emplace(cacheLine);
+		}
+	}
+	++statistics.tmuRequests;
+	if(cacheMiss)
+		++statistics.tmuCacheMisses;
+	//the TMU processes the requests in order
+	const uint64_t previousReady = responses.empty() ? cycle : responses.back().readyCycle;
+	response.readyCycle = std::max(previousReady, cycle + (cacheMiss ? TMU_CACHE_MISS_LATENCY : TMU_CACHE_HIT_LATENCY));
+	responses.push_back(response);
+}
+
+bool TMU::isResponseReady(const uint64_t cycle) const
+{
+	return !responses.empty() && cycle >= responses.front().readyCycle;
+}
+
+bool TMU::hasPendingResponse() const
+{
+	return !responses.empty();
+}
+
+SIMDVector TMU::popResponse()
+{
+	const SIMDVector data = responses.front().data;
+	responses.pop_front();
+	return data;
+}
+
+VPM::VPM(Memory& memory, MemoryStatistics& statistics) : memory(memory), statistics(statistics), data(VPM_NUM_ROWS * 64, 0)
+{
+}
+
+/*
+ * Returns the byte offset in the VPM and the element width in bytes for a generic setup address
+ */
+static std::pair<std::size_t, uint8_t> toVPMOffset(const uint8_t size, const uint8_t address)
+{
+	switch(size)
+	{
+		case 0:
+			//ADDR[7:0] = {Y[5:0], B[1:0]}
+			return std::make_pair(static_cast<std::size_t>(address >> 2) * 64 + (address & 0x3) * 16, 1);
+		case 1:
+			//ADDR[7:0] = {Y[6:0], H[0]}
+			return std::make_pair(static_cast<std::size_t>(address >> 1) * 64 + (address & 0x1) * 32, 2);
+		case 2:
+			//ADDR[7:0] = Y[7:0]
+			return std::make_pair(static_cast<std::size_t>(address) * 64, 4);
+		default:
+			throw CompilationError(CompilationStep::GENERAL, "Invalid VPM access size", std::to_string(static_cast<unsigned>(size)));
+	}
+}
+
+SIMDVector VPM::readRow(uint32_t& setup)
+{
+	periphery::VPRSetup vpr(setup);
+	const auto offset = toVPMOffset(vpr.genericSetup.getSize(), vpr.genericSetup.getAddress());
+	SIMDVector result{};
+	for(std::size_t i = 0; i < result.size(); ++i)
+	{
+		const std::size_t byteIndex = (offset.first + i * offset.second) % data.size();
+		uint32_t val = 0;
+		std::memcpy(&val, data.data() + byteIndex, offset.second);
+		result[i] = val;
+	}
+	const uint8_t stride = vpr.genericSetup.getStride() == 0 ? 64 : vpr.genericSetup.getStride();
+	vpr.genericSetup.setAddress(static_cast<uint8_t>(vpr.genericSetup.getAddress() + stride));
+	setup = vpr.value;
+	return result;
+}
+
+void VPM::writeRow(uint32_t& setup, const SIMDVector& values)
+{
+	periphery::VPWSetup vpw(setup);
+	const auto offset = toVPMOffset(vpw.genericSetup.getSize(), vpw.genericSetup.getAddress());
+	for(std::size_t i = 0; i < values.size(); ++i)
+	{
+		const std::size_t byteIndex = (offset.first + i * offset.second) % data.size();
+		std::memcpy(data.data() + byteIndex, &values[i], offset.second);
+	}
+	const uint8_t stride = vpw.genericSetup.getStride() == 0 ? 64 : vpw.genericSetup.getStride();
+	vpw.genericSetup.setAddress(static_cast<uint8_t>(vpw.genericSetup.getAddress() + stride));
+	setup = vpw.value;
+}
+
+/*
+ * Returns the element width in bytes and the byte offset within the first word for the DMA mode
+ */
+static std::pair<uint8_t, uint8_t> toDMAWidth(const uint8_t mode)
+{
+	if(mode == 0)
+		return std::make_pair(4, 0);
+	if(mode == 2 || mode == 3)
+		return std::make_pair(2, (mode & 0x1) * 2);
+	if(mode >= 4)
+		return std::make_pair(1, mode & 0x3);
+	throw CompilationError(CompilationStep::GENERAL, "Invalid VPM DMA mode", std::to_string(static_cast<unsigned>(mode)));
+}
+
+uint64_t VPM::loadDMA(const uint32_t dmaSetup, const uint32_t strideSetup, const MemoryAddress address, const uint64_t cycle)
+{
+	const periphery::VPRSetup setup(dmaSetup);
+	const periphery::VPRSetup stride(strideSetup);
+	const auto width = toDMAWidth(setup.dmaSetup.getMode());
+	const std::size_t rowLength = setup.dmaSetup.getRowLength() == 0 ? 16 : setup.dmaSetup.getRowLength();
+	const std::size_t numRows = setup.dmaSetup.getNumberRows() == 0 ? 16 : setup.dmaSetup.getNumberRows();
+	const std::size_t vpitch = setup.dmaSetup.getVPitch() == 0 ? 16 : setup.dmaSetup.getVPitch();
+	//"If MPITCH is 0, selects MPITCHB from the extended pitch setup register. Otherwise, pitch = 8*2^MPITCH bytes."
+	const std::size_t memoryPitch = setup.dmaSetup.getMPitch() == 0 ? stride.strideSetup.getStride() : (8u << setup.dmaSetup.getMPitch());
+	//ADDR[10:0] = {Y[6:0], X[3:0]}
+	const std::size_t vpmStart = static_cast<std::size_t>(setup.dmaSetup.getAddress() >> 4) * 64 + (setup.dmaSetup.getAddress() & 0xF) * 4 + width.second;
+
+	for(std::size_t row = 0; row < numRows; ++row)
+	{
+		for(std::size_t e = 0; e < rowLength * width.first; ++e)
+		{
+			const std::size_t vpmIndex = (vpmStart + row * vpitch * 64 + e) % data.size();
+			data[vpmIndex] = memory.readByte(static_cast<MemoryAddress>(address + row * memoryPitch + e));
+		}
+	}
+	const uint64_t numBytes = numRows * rowLength * width.first;
+	++statistics.dmaLoads;
+	statistics.dmaBytesRead += numBytes;
+	//DMA loads are executed one after the other
+	loadEngineBusyUntil = std::max(loadEngineBusyUntil, cycle) + DMA_SETUP_LATENCY + numBytes / DMA_BYTES_PER_CYCLE;
+	return loadEngineBusyUntil;
+}
+
+uint64_t VPM::storeDMA(const uint32_t dmaSetup, const uint32_t strideSetup, const MemoryAddress address, const uint64_t cycle)
+{
+	const periphery::VPWSetup setup(dmaSetup);
+	const periphery::VPWSetup stride(strideSetup);
+	const auto width = toDMAWidth(setup.dmaSetup.getMode());
+	const std::size_t depth = setup.dmaSetup.getDepth() == 0 ? 128 : setup.dmaSetup.getDepth();
+	const std::size_t units = setup.dmaSetup.getUnits() == 0 ? 128 : setup.dmaSetup.getUnits();
+	//"Distance between last byte of a row and start of next row in memory, in bytes."
+	const std::size_t memoryPitch = depth * width.first + stride.strideSetup.getStride();
+	//ADDR[10:0] = {Y[6:0], X[3:0]}
+	const std::size_t vpmStart = static_cast<std::size_t>(setup.dmaSetup.getVPMBase() >> 4) * 64 + (setup.dmaSetup.getVPMBase() & 0xF) * 4 + width.second;
+
+	for(std::size_t row = 0; row < units; ++row)
+	{
+		for(std::size_t e = 0; e < depth * width.first; ++e)
+		{
+			const std::size_t vpmIndex = (vpmStart + row * 64 + e) % data.size();
+			memory.writeByte(static_cast<MemoryAddress>(address + row * memoryPitch + e), data[vpmIndex]);
+		}
+	}
+	const uint64_t numBytes = units * depth * width.first;
+	++statistics.dmaStores;
+	statistics.dmaBytesWritten += numBytes;
+	storeEngineBusyUntil = std::max(storeEngineBusyUntil, cycle) + DMA_SETUP_LATENCY + numBytes / DMA_BYTES_PER_CYCLE;
+	return storeEngineBusyUntil;
+}
+
+SharedState::SharedState(const std::vector<std::unique_ptr<qpu_asm::Instruction>>& instructions) : vpm(memory, statistics), instructions(instructions)
+{
+}
+
+QPU::QPU(const uint8_t number, SharedState& state, QPUStatistics& statistics, const std::size_t startOffset, const MemoryAddress uniformAddress) :
+		number(number), state(state), statistics(statistics), pc(startOffset), uniformAddress(uniformAddress), tmu0(state.memory, state.statistics, state.tmuCache),
+		tmu1(state.memory, state.statistics, state.tmuCache)
+{
+}
+
+bool QPU::isRunning() const
+{
+	return running;
+}
+
+bool QPU::isBlockedByOtherQPU() const
+{
+	return lastStall && (lastStall.value() == StallReason::MUTEX || lastStall.value() == StallReason::SEMAPHORE);
+}
+
+static bool usesInput(const qpu_asm::ALUInstruction* alu, const InputMutex mux)
+{
+	const OpCode& addCode = OpCode::toOpCode(alu->getAddition(), false);
+	const OpCode& mulCode = OpCode::toOpCode(alu->getMultiplication(), true);
+	return (addCode.numOperands > 0 && alu->getAddMutexA() == mux) || (addCode.numOperands > 1 && alu->getAddMutexB() == mux) ||
+			(mulCode.numOperands > 0 && alu->getMulMutexA() == mux) || (mulCode.numOperands > 1 && alu->getMulMutexB() == mux);
+}
+
+Optional<StallReason> QPU::checkStall(const qpu_asm::Instruction* instr, const uint64_t cycle)
+{
+	if(const qpu_asm::ALUInstruction* alu = dynamic_cast<const qpu_asm::ALUInstruction*>(instr))
+	{
+		const bool readsA = usesInput(alu, InputMutex::REGA);
+		const bool readsB = alu->getSig() != SIGNAL_ALU_IMMEDIATE && usesInput(alu, InputMutex::REGB);
+		if(alu->getSig() == SIGNAL_LOAD_TMU0 || alu->getSig() == SIGNAL_LOAD_TMU1)
+		{
+			const TMU& tmu = alu->getSig() == SIGNAL_LOAD_TMU0 ? tmu0 : tmu1;
+			if(!tmu.hasPendingResponse())
+				throw CompilationError(CompilationStep::GENERAL, "Loading TMU response without a request", instr->toASMString());
+			if(!tmu.isResponseReady(cycle))
+				return StallReason::TMU;
+		}
+		if(readsA && alu->getInputA() == REG_VPM_IN_WAIT.num && cycle < dmaLoadFinished)
+			return StallReason::VPM_DMA_LOAD;
+		if(readsB && alu->getInputB() == REG_VPM_OUT_WAIT.num && cycle < dmaStoreFinished)
+			return StallReason::VPM_DMA_STORE;
+		if(((readsA && alu->getInputA() == REG_MUTEX.num) || (readsB && alu->getInputB() == REG_MUTEX.num)) && !state.mutex.isLockable(number))
+			return StallReason::MUTEX;
+	}
+	else if(const qpu_asm::SemaphoreInstruction* semaphore = dynamic_cast<const qpu_asm::SemaphoreInstruction*>(instr))
+	{
+		const uint8_t index = static_cast<uint8_t>(semaphore->getSemaphore());
+		//the bit is set for acquiring (decrementing) the semaphore
+		if(semaphore->getIncrementSemaphore() ? !state.semaphores.isDecrementPossible(index) : !state.semaphores.isIncrementPossible(index))
+			return StallReason::SEMAPHORE;
+	}
+	return {};
+}
+
+bool QPU::execute(const uint64_t cycle)
+{
+	if(!running)
+		return true;
+	//the SFU writes its result to r4 as soon as it is available
+	if(sfu.isResultReady(cycle))
+		accumulators[4] = sfu.takeResult();
+	if(pc >= state.instructions.size())
+		throw CompilationError(CompilationStep::GENERAL, "Program counter is out of bounds", std::to_string(pc));
+	const qpu_asm::Instruction* instr = state.instructions[pc].get();
+
+	++statistics.cycles;
+	lastStall = checkStall(instr, cycle);
+	if(lastStall)
+	{
+		++statistics.stalls[static_cast<std::size_t>(lastStall.value())];
+		return false;
+	}
+
+	++statistics.instructions;
+	const bool inBranchDelay = branchTarget.has_value();
+	const bool inThreadEnd = threadEndDelay.has_value();
+	if(const qpu_asm::ALUInstruction* alu = dynamic_cast<const qpu_asm::ALUInstruction*>(instr))
+		executeALU(alu, cycle);
+	else if(const qpu_asm::BranchInstruction* branch = dynamic_cast<const qpu_asm::BranchInstruction*>(instr))
+		executeBranch(branch);
+	else if(const qpu_asm::LoadInstruction* load = dynamic_cast<const qpu_asm::LoadInstruction*>(instr))
+		executeLoad(load, cycle);
+	else if(const qpu_asm::SemaphoreInstruction* semaphore = dynamic_cast<const qpu_asm::SemaphoreInstruction*>(instr))
+		executeSemaphore(semaphore, cycle);
+	else
+		throw CompilationError(CompilationStep::GENERAL, "Unhandled instruction type", instr->toASMString());
+
+	++pc;
+	if(inBranchDelay && --branchDelay == 0)
+	{
+		pc = branchTarget.value();
+		branchTarget = Optional<std::size_t>{};
+	}
+	if(inThreadEnd && --threadEndDelay.value() == 0)
+		running = false;
+	return true;
+}
+
+void QPU::executeALU(const qpu_asm::ALUInstruction* alu, const uint64_t cycle)
+{
+	const OpCode& addCode = OpCode::toOpCode(alu->getAddition(), false);
+	const OpCode& mulCode = OpCode::toOpCode(alu->getMultiplication(), true);
+	const bool hasImmediate = alu->getSig() == SIGNAL_ALU_IMMEDIATE;
+	const bool unpackR4 = (alu->getPack().value & 0x10) != 0;
+	//r4 is only written when the SFU result is available, so reading it before returns an undefined value
+	const bool sfuHazard = usesInput(alu, InputMutex::ACC4) && sfu.hasPendingResult();
+	if(sfuHazard)
+		recordHazard(Hazard::SFU_RESULT);
+
+	//each register-file is read at most once per instruction
+	SIMDVector valueA{};
+	SIMDVector valueB{};
+	if(usesInput(alu, InputMutex::REGA))
+		valueA = readRegister(true, alu->getInputA(), cycle);
+	if(hasImmediate)
+	{
+		const unsigned char imm = alu->getInputB();
+		uint32_t val = 0;
+		if(imm <= 15)
+			val = imm;
+		else if(imm <= 31)
+			val = static_cast<uint32_t>(static_cast<int32_t>(imm) - 32);
+		else if(imm <= 47)
+			val = fromFloat(SmallImmediate(imm).getFloatingValue().value());
+		valueB.fill(val);
+	}
+	else if(usesInput(alu, InputMutex::REGB))
+		valueB = readRegister(false, alu->getInputB(), cycle);
+
+	auto getInput = [&](const InputMutex mux, const std::size_t element, const bool consumesFloat) -> uint32_t
+	{
+		switch(mux)
+		{
+			case InputMutex::REGA:
+				return unpackR4 ? valueA[element] : unpackValue(alu->getUnpack(), valueA[element], consumesFloat);
+			case InputMutex::REGB:
+				return valueB[element];
+			case InputMutex::ACC4:
+				if(sfuHazard)
+					return POISON_VALUE;
+				return unpackR4 ? unpackValue(alu->getUnpack(), accumulators[4][element], consumesFloat) : accumulators[4][element];
+			default:
+				return accumulators[static_cast<std::size_t>(mux)][element];
+		}
+	};
+
+	SIMDVector addResult{};
+	SIMDVector mulResult{};
+	std::array<bool, NATIVE_VECTOR_SIZE> carries{};
+	std::array<bool, NATIVE_VECTOR_SIZE> overflows{};
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		if(addCode != OP_NOP)
+			addResult[i] = calculateAdd(addCode.opAdd, getInput(alu->getAddMutexA(), i, addCode.acceptsFloat), getInput(alu->getAddMutexB(), i, addCode.acceptsFloat), carries[i], overflows[i]);
+		if(mulCode != OP_NOP)
+			mulResult[i] = calculateMul(mulCode.opMul, getInput(alu->getMulMutexA(), i, mulCode.acceptsFloat), getInput(alu->getMulMutexB(), i, mulCode.acceptsFloat));
+	}
+
+	if(hasImmediate && alu->getInputB() >= VECTOR_ROTATE_R5.value)
+	{
+		//"rotated upwards", so element 0 moves to element n
+		const std::size_t offset = alu->getInputB() == VECTOR_ROTATE_R5.value ? (accumulators[5][0] & 0xF) : (alu->getInputB() - VECTOR_ROTATE_R5.value);
+		const SIMDVector tmp = mulResult;
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+			mulResult[(i + offset) % NATIVE_VECTOR_SIZE] = tmp[i];
+	}
+
+	//the conditions need to be evaluated with the flags before they are (possibly) updated
+	std::array<bool, NATIVE_VECTOR_SIZE> addMask{};
+	std::array<bool, NATIVE_VECTOR_SIZE> mulMask{};
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		addMask[i] = addCode != OP_NOP && isConditionMet(alu->getAddCondition(), i);
+		mulMask[i] = mulCode != OP_NOP && isConditionMet(alu->getMulCondition(), i);
+	}
+
+	if(alu->getSetFlag() == SetFlag::SET_FLAGS)
+	{
+		if(addCode != OP_NOP && alu->getAddCondition() != COND_NEVER)
+			setFlags(addResult, carries, alu->getAddCondition());
+		else if(mulCode != OP_NOP)
+			setFlags(mulResult, std::array<bool, NATIVE_VECTOR_SIZE>{}, alu->getMulCondition());
+	}
+
+	const bool addToA = alu->getWriteSwap() == WriteSwap::DONT_SWAP;
+	const Pack pack = alu->getPack();
+	if(unpackR4 && (pack.value & 0xF) != PACK_NOP.value)
+	{
+		//pm = 1: the pack-mode is used for the color conversion of the mul ALU result
+		const SIMDVector& old = addToA ? (alu->getMulOut() < 32 ? registerFileB[alu->getMulOut()] : accumulators[0]) : (alu->getMulOut() < 32 ? registerFileA[alu->getMulOut()] : accumulators[0]);
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+			mulResult[i] = packColor(pack, old[i], mulResult[i]);
+	}
+	else if(!unpackR4 && pack != PACK_NOP)
+	{
+		//pm = 0: the pack-mode is applied to the write to the register-file A
+		const bool packAdd = addToA;
+		const Address out = packAdd ? alu->getAddOut() : alu->getMulOut();
+		if(out < 32)
+		{
+			SIMDVector& result = packAdd ? addResult : mulResult;
+			const bool isFloat = packAdd ? addCode.returnsFloat : mulCode.returnsFloat;
+			for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+				result[i] = packValue(pack, registerFileA[out][i], result[i], isFloat, overflows[i] && packAdd);
+		}
+	}
+
+	if(addCode != OP_NOP)
+		writeRegister(addToA, alu->getAddOut(), addResult, addMask, cycle);
+	if(mulCode != OP_NOP)
+		writeRegister(!addToA, alu->getMulOut(), mulResult, mulMask, cycle);
+
+	if(addCode == OP_NOP && mulCode == OP_NOP && (alu->getSig() == SIGNAL_NONE || alu->getSig() == SIGNAL_ALU_IMMEDIATE))
+		++statistics.nops;
+	executeSignal(alu->getSig(), cycle);
+}
+
+void QPU::executeBranch(const qpu_asm::BranchInstruction* branch)
+{
+	++statistics.branches;
+	bool taken = false;
+	auto all = [](const std::array<bool, NATIVE_VECTOR_SIZE>& flags, bool val) -> bool
+	{
+		return std::all_of(flags.begin(), flags.end(), [val](bool b) -> bool { return b == val; });
+	};
+	auto any = [](const std::array<bool, NATIVE_VECTOR_SIZE>& flags, bool val) -> bool
+	{
+		return std::any_of(flags.begin(), flags.end(), [val](bool b) -> bool { return b == val; });
+	};
+	switch(branch->getBranchCondition())
+	{
+		case BranchCond::ALL_Z_SET:
+			taken = all(flagZero, true);
+			break;
+		case BranchCond::ALL_Z_CLEAR:
+			taken = all(flagZero, false);
+			break;
+		case BranchCond::ANY_Z_SET:
+			taken = any(flagZero, true);
+			break;
+		case BranchCond::ANY_Z_CLEAR:
+			taken = any(flagZero, false);
+			break;
+		case BranchCond::ALL_N_SET:
+			taken = all(flagNegative, true);
+			break;
+		case BranchCond::ALL_N_CLEAR:
+			taken = all(flagNegative, false);
+			break;
+		case BranchCond::ANY_N_SET:
+			taken = any(flagNegative, true);
+			break;
+		case BranchCond::ANY_N_CLEAR:
+			taken = any(flagNegative, false);
+			break;
+		case BranchCond::ALL_C_SET:
+			taken = all(flagCarry, true);
+			break;
+		case BranchCond::ALL_C_CLEAR:
+			taken = all(flagCarry, false);
+			break;
+		case BranchCond::ANY_C_SET:
+			taken = any(flagCarry, true);
+			break;
+		case BranchCond::ANY_C_CLEAR:
+			taken = any(flagCarry, false);
+			break;
+		case BranchCond::ALWAYS:
+			taken = true;
+			break;
+		default:
+			throw CompilationError(CompilationStep::GENERAL, "Invalid branch condition", branch->toASMString());
+	}
+
+	//the link address (PC + 4) is written to the outputs, code addresses are relative to the start of the code-segment
+	const int64_t linkAddress = static_cast<int64_t>((pc + 4) * sizeof(uint64_t));
+	SIMDVector link;
+	link.fill(static_cast<uint32_t>(linkAddress));
+	std::array<bool, NATIVE_VECTOR_SIZE> mask;
+	mask.fill(true);
+	writeRegister(branch->getWriteSwap() == WriteSwap::DONT_SWAP, branch->getAddOut(), link, mask, 0);
+	writeRegister(branch->getWriteSwap() != WriteSwap::DONT_SWAP, branch->getMulOut(), link, mask, 0);
+
+	if(!taken)
+		return;
+	++statistics.branchesTaken;
+	int64_t target = branch->getImmediate();
+	if(branch->getBranchRelative() == BranchRel::BRANCH_RELATIVE)
+		target += linkAddress;
+	if(branch->getAddRegister() == BranchReg::BRANCH_REG)
+		target += static_cast<int32_t>(registerFileA.at(branch->getRegisterAddress())[0]);
+	if(target < 0 || target % sizeof(uint64_t) != 0 || static_cast<std::size_t>(target) / sizeof(uint64_t) >= state.instructions.size())
+		throw CompilationError(CompilationStep::GENERAL, "Invalid branch target", std::to_string(target));
+	if(branchTarget)
+		throw CompilationError(CompilationStep::GENERAL, "Branch within the delay slots of another branch", branch->toASMString());
+	branchTarget = static_cast<std::size_t>(target) / sizeof(uint64_t);
+	//the three instructions following the branch are always executed
+	branchDelay = 3;
+}
+
+void QPU::executeLoad(const qpu_asm::LoadInstruction* load, const uint64_t cycle)
+{
+	const uint64_t code = load->toBinaryCode();
+	const OpLoad type = static_cast<OpLoad>((code >> 57) & 0x7F);
+	SIMDVector values;
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		if(type == OpLoad::LOAD_IMM_32)
+			values[i] = load->getImmediateInt();
+		else
+		{
+			//per-element 2-bit values, the MSBs are stored in the upper half-word
+			const uint32_t bits = ((static_cast<uint32_t>(load->getImmediateShort0() >> i) & 0x1) << 1) | ((static_cast<uint32_t>(load->getImmediateShort1()) >> i) & 0x1);
+			values[i] = type == OpLoad::LOAD_SIGNED && (bits & 0x2) != 0 ? static_cast<uint32_t>(static_cast<int32_t>(bits) - 4) : bits;
+		}
+	}
+	std::array<bool, NATIVE_VECTOR_SIZE> addMask{};
+	std::array<bool, NATIVE_VECTOR_SIZE> mulMask{};
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		addMask[i] = isConditionMet(load->getAddCondition(), i);
+		mulMask[i] = isConditionMet(load->getMulCondition(), i);
+	}
+	if(load->getSetFlag() == SetFlag::SET_FLAGS)
+		setFlags(values, std::array<bool, NATIVE_VECTOR_SIZE>{}, load->getAddCondition() != COND_NEVER ? load->getAddCondition() : load->getMulCondition());
+
+	const bool addToA = load->getWriteSwap() == WriteSwap::DONT_SWAP;
+	SIMDVector packed = values;
+	if((load->getPack().value & 0x10) == 0 && load->getPack() != PACK_NOP && addToA && load->getAddOut() < 32)
+	{
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+			packed[i] = packValue(load->getPack(), registerFileA[load->getAddOut()][i], values[i], false, false);
+	}
+	writeRegister(addToA, load->getAddOut(), packed, addMask, cycle);
+	writeRegister(!addToA, load->getMulOut(), values, mulMask, cycle);
+}
+
+void QPU::executeSemaphore(const qpu_asm::SemaphoreInstruction* semaphore, const uint64_t cycle)
+{
+	const uint8_t index = static_cast<uint8_t>(semaphore->getSemaphore());
+	//the bit is set for acquiring (decrementing) the semaphore
+	if(semaphore->getIncrementSemaphore())
+		state.semaphores.decrement(index);
+	else
+		state.semaphores.increment(index);
+
+	//"The instruction otherwise behaves like a 32-bit load immediate instruction"
+	SIMDVector values;
+	values.fill(static_cast<uint32_t>(semaphore->toBinaryCode() & 0xFFFFFFFF));
+	std::array<bool, NATIVE_VECTOR_SIZE> addMask{};
+	std::array<bool, NATIVE_VECTOR_SIZE> mulMask{};
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		addMask[i] = isConditionMet(semaphore->getAddCondition(), i);
+		mulMask[i] = isConditionMet(semaphore->getMulCondition(), i);
+	}
+	if(semaphore->getSetFlag() == SetFlag::SET_FLAGS)
+		setFlags(values, std::array<bool, NATIVE_VECTOR_SIZE>{}, semaphore->getAddCondition());
+	writeRegister(semaphore->getWriteSwap() == WriteSwap::DONT_SWAP, semaphore->getAddOut(), values, addMask, cycle);
+	writeRegister(semaphore->getWriteSwap() != WriteSwap::DONT_SWAP, semaphore->getMulOut(), values, mulMask, cycle);
+}
+
+void QPU::executeSignal(const Signaling signal, const uint64_t cycle)
+{
+	switch(signal.value)
+	{
+		case SIGNAL_END_PROGRAM.value:
+			if(threadEndDelay)
+				throw CompilationError(CompilationStep::GENERAL, "Program end within the delay slots of another program end");
+			//the two instructions following the program end are still executed
+			threadEndDelay = 2u;
+			break;
+		case SIGNAL_LOAD_TMU0.value:
+			accumulators[4] = tmu0.popResponse();
+			break;
+		case SIGNAL_LOAD_TMU1.value:
+			accumulators[4] = tmu1.popResponse();
+			break;
+		default:
+			//thread-switches have no effect, since we only run a single thread per QPU.
+			//All other signals are only relevant for 3D graphics
+			break;
+	}
+}
+
+void QPU::recordHazard(const Hazard hazard)
+{
+	logging::debug() << "QPU " << static_cast<unsigned>(number) << " reads undefined value (" << toString(hazard) << ") at instruction " << pc << logging::endl;
+	++statistics.hazards[static_cast<std::size_t>(hazard)];
+}
+
+SIMDVector QPU::readRegister(const bool fileA, const Address reg, const uint64_t cycle)
+{
+	SIMDVector result{};
+	if(reg < 32)
+	{
+		//the register-file is written at the end of the pipeline, so the next instruction cannot read the new value yet
+		const uint64_t writtenBy = fileA ? registerFileAWritten[reg] : registerFileBWritten[reg];
+		if(writtenBy != 0 && writtenBy + 1 == statistics.instructions)
+		{
+			recordHazard(Hazard::REGISTER_FILE);
+			result.fill(POISON_VALUE);
+			return result;
+		}
+		return fileA ? registerFileA[reg] : registerFileB[reg];
+	}
+	switch(reg)
+	{
+		case REG_UNIFORM.num:
+			result.fill(state.memory.readWord(uniformAddress));
+			uniformAddress += sizeof(uint32_t);
+			++statistics.uniformsRead;
+			state.statistics.uniformBytesRead += sizeof(uint32_t);
+			break;
+		case REG_ELEMENT_NUMBER.num:
+			if(fileA)
+			{
+				for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+					result[i] = static_cast<uint32_t>(i);
+			}
+			else
+				result.fill(number);
+			break;
+		case REG_VPM_IO.num:
+			if(vpmReadsLeft == 0)
+				throw CompilationError(CompilationStep::GENERAL, "Reading from VPM without matching VPM read setup, the QPU would stall infinitely");
+			--vpmReadsLeft;
+			result = state.vpm.readRow(vpmReadSetup);
+			if(cycle < vpmReadSetupCycle + VPM_READ_LATENCY)
+			{
+				//the read still advances the VPM address, but returns undefined values
+				recordHazard(Hazard::VPM_READ);
+				result.fill(POISON_VALUE);
+			}
+			break;
+		case REG_VPM_IN_BUSY.num:
+			result.fill(cycle < (fileA ? dmaLoadFinished : dmaStoreFinished) ? 1 : 0);
+			break;
+		case REG_VPM_IN_WAIT.num:
+			//the stall is handled beforehand
+			break;
+		case REG_MUTEX.num:
+			state.mutex.lock(number);
+			result.fill(1);
+			break;
+		default:
+			//NOP register, varyings and 3D graphics registers are read as zero
+			break;
+	}
+	return result;
+}
+
+void QPU::writeRegister(const bool fileA, const Address reg, const SIMDVector& values, const std::array<bool, NATIVE_VECTOR_SIZE>& mask, const uint64_t cycle)
+{
+	if(std::none_of(mask.begin(), mask.end(), [](bool b) -> bool { return b; }))
+		return;
+	auto writeMasked = [&](SIMDVector& dest)
+	{
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+		{
+			if(mask[i])
+				dest[i] = values[i];
+		}
+	};
+	//the first written (active) element, used for the periphery expecting a scalar value
+	const uint32_t scalar = values[static_cast<std::size_t>(std::find(mask.begin(), mask.end(), true) - mask.begin())];
+
+	if(reg < 32)
+	{
+		writeMasked(fileA ? registerFileA[reg] : registerFileB[reg]);
+		(fileA ? registerFileAWritten : registerFileBWritten)[reg] = statistics.instructions;
+		return;
+	}
+	switch(reg)
+	{
+		case REG_ACC0.num:
+		case REG_ACC1.num:
+		case REG_ACC2.num:
+		case REG_ACC3.num:
+			writeMasked(accumulators[reg - REG_ACC0.num]);
+			break;
+		case REG_ACC5.num:
+			if(fileA)
+			{
+				//replicate per quad
+				for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+					accumulators[5][i] = values[i - (i % 4)];
+			}
+			else
+				accumulators[5].fill(values[0]);
+			break;
+		case REG_UNIFORM_ADDRESS.num:
+			uniformAddress = scalar;
+			break;
+		case REG_VPM_IO.num:
+			state.vpm.writeRow(vpmWriteSetup, values);
+			break;
+		case REG_VPM_IN_SETUP.num:
+			if(fileA)
+			{
+				const periphery::VPRSetup setup(scalar);
+				if(setup.isGenericSetup())
+				{
+					vpmReadSetup = scalar;
+					vpmReadsLeft = setup.genericSetup.getNumber() == 0 ? 16 : setup.genericSetup.getNumber();
+					vpmReadSetupCycle = cycle;
+				}
+				else if(setup.isStrideSetup())
+					dmaLoadStrideSetup = scalar;
+				else
+					dmaLoadSetup = scalar;
+			}
+			else
+			{
+				const periphery::VPWSetup setup(scalar);
+				if(setup.isGenericSetup())
+					vpmWriteSetup = scalar;
+				else if(setup.isStrideSetup())
+					dmaStoreStrideSetup = scalar;
+				else
+					dmaStoreSetup = scalar;
+			}
+			break;
+		case REG_VPM_IN_ADDR.num:
+			if(fileA)
+				dmaLoadFinished = state.vpm.loadDMA(dmaLoadSetup, dmaLoadStrideSetup, scalar, cycle);
+			else
+				dmaStoreFinished = state.vpm.storeDMA(dmaStoreSetup, dmaStoreStrideSetup, scalar, cycle);
+			break;
+		case REG_MUTEX.num:
+			state.mutex.unlock(number);
+			break;
+		case REG_SFU_RECIP.num:
+		case REG_SFU_RECIP_SQRT.num:
+		case REG_SFU_EXP2.num:
+		case REG_SFU_LOG2.num:
+			sfu.startCalculation(reg, values, cycle);
+			break;
+		case REG_TMU0_ADDRESS.num:
+		case REG_TMU1_ADDRESS.num:
+		{
+			SIMDVector addresses{};
+			writeMasked(addresses);
+			(reg == REG_TMU0_ADDRESS.num ? tmu0 : tmu1).pushRequest(addresses, cycle);
+			break;
+		}
+		default:
+			//NOP register, host interrupt, the TMU-swap flag and 3D graphics registers are ignored
+			break;
+	}
+}
+
+void QPU::setFlags(const SIMDVector& values, const std::array<bool, NATIVE_VECTOR_SIZE>& carries, const ConditionCode cond)
+{
+	//the flags are only updated for the elements the condition is met for
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		if(!isConditionMet(cond, i))
+			continue;
+		flagZero[i] = values[i] == 0;
+		flagNegative[i] = (values[i] & 0x80000000) != 0;
+		flagCarry[i] = carries[i];
+	}
+}
+
+bool QPU::isConditionMet(const ConditionCode cond, const std::size_t element) const
+{
+	switch(cond.value)
+	{
+		case COND_NEVER.value:
+			return false;
+		case COND_ALWAYS.value:
+			return true;
+		case COND_ZERO_SET.value:
+			return flagZero[element];
+		case COND_ZERO_CLEAR.value:
+			return !flagZero[element];
+		case COND_NEGATIVE_SET.value:
+			return flagNegative[element];
+		case COND_NEGATIVE_CLEAR.value:
+			return !flagNegative[element];
+		case COND_CARRY_SET.value:
+			return flagCarry[element];
+		case COND_CARRY_CLEAR.value:
+			return !flagCarry[element];
+		default:
+			throw CompilationError(CompilationStep::GENERAL, "Invalid condition code", cond.toString());
+	}
+}
+
+static std::string readString(std::istream& binary, uint16_t stringLength)
+{
+	std::array<char, 1024> buffer;
+
+	binary.read(buffer.data(), stringLength);
+	const std::string name(buffer.data(), stringLength);
+	uint16_t numPaddingBytes = static_cast<uint16_t>(Byte(stringLength).getPaddingTo(sizeof(uint64_t)));
+	//skip padding after name
+	binary.read(buffer.data(), numPaddingBytes);
+
+	return name;
+}
+
+/*
+ * Reads the module header, the global data and the instructions of the module.
+ *
+ * Returns the offset (in 64-bit words) of the first instruction from the start of the module
+ */
+static std::size_t readModule(std::istream& binary, qpu_asm::ModuleInfo& moduleInfo, std::vector<uint32_t>& globalData, std::vector<std::unique_ptr<qpu_asm::Instruction>>& instructions)
+{
+	//the source-type detection might have read past the end of small modules
+	binary.clear();
+	//skip magic number
+	binary.seekg(8);
+	binary.read(reinterpret_cast<char*>(&moduleInfo.value), sizeof(moduleInfo.value));
+
+	std::size_t totalInstructions = 0;
+	for(uint16_t k = 0; k < moduleInfo.getInfoCount(); ++k)
+	{
+		qpu_asm::KernelInfo kernelInfo(4);
+		binary.read(reinterpret_cast<char*>(&kernelInfo.value), sizeof(kernelInfo.value));
+		binary.read(reinterpret_cast<char*>(&kernelInfo.workGroupSize), sizeof(kernelInfo.workGroupSize));
+		kernelInfo.name = readString(binary, static_cast<uint16_t>(kernelInfo.getNameLength().getValue()));
+		totalInstructions += kernelInfo.getLength().getValue();
+		for(uint16_t p = 0; p < kernelInfo.getParamCount(); ++p)
+		{
+			qpu_asm::ParamInfo paramInfo;
+			binary.read(reinterpret_cast<char*>(&paramInfo.value), sizeof(paramInfo.value));
+			paramInfo.name = readString(binary, static_cast<uint16_t>(paramInfo.getNameLength().getValue()));
+			paramInfo.typeName = readString(binary, static_cast<uint16_t>(paramInfo.getTypeNameLength().getValue()));
+			kernelInfo.parameters.push_back(paramInfo);
+		}
+		moduleInfo.kernelInfos.push_back(kernelInfo);
+	}
+
+	//skip zero-word between kernels and globals
+	binary.seekg(sizeof(uint64_t), std::ios_base::cur);
+	globalData.resize(moduleInfo.getGlobalDataSize().getValue() * 2);
+	binary.read(reinterpret_cast<char*>(globalData.data()), static_cast<std::streamsize>(globalData.size() * sizeof(uint32_t)));
+	//skip zero-word between globals and kernel-code
+	binary.seekg(sizeof(uint64_t), std::ios_base::cur);
+
+	const std::size_t codeOffset = static_cast<std::size_t>(binary.tellg()) / sizeof(uint64_t);
+	instructions.reserve(totalInstructions);
+	for(std::size_t i = 0; i < totalInstructions; ++i)
+	{
+		uint64_t tmp64;
+		binary.read(reinterpret_cast<char*>(&tmp64), sizeof(tmp64));
+		if(!binary)
+			throw CompilationError(CompilationStep::GENERAL, "Unexpected end of module, instructions missing", std::to_string(totalInstructions - i));
+		qpu_asm::Instruction* instr = qpu_asm::Instruction::readFromBinary(tmp64);
+		if(instr == nullptr)
+			throw CompilationError(CompilationStep::GENERAL, "Unrecognized instruction", std::to_string(tmp64));
+		instructions.emplace_back(instr);
+	}
+	logging::debug() << "Read module with " << moduleInfo.kernelInfos.size() << " kernels, " << globalData.size() << " words of global data and " << instructions.size() << " instructions" << logging::endl;
+	return codeOffset;
+}
+
+static const qpu_asm::KernelInfo& findKernel(const qpu_asm::ModuleInfo& moduleInfo, const std::string& name)
+{
+	if(name.empty() && moduleInfo.kernelInfos.size() == 1)
+		return moduleInfo.kernelInfos.front();
+	for(const qpu_asm::KernelInfo& info : moduleInfo.kernelInfos)
+	{
+		if(info.name == name)
+			return info;
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Failed to find kernel in module", name);
+}
+
+EmulationResult tools::emulate(std::istream& module, const EmulationData& data)
+{
+	PROFILE_START(Emulator);
+	if(Precompiler::getSourceType(module) != SourceType::QPUASM_BIN)
+		throw CompilationError(CompilationStep::GENERAL, "Invalid input binary for emulation!");
+
+	qpu_asm::ModuleInfo moduleInfo;
+	std::vector<uint32_t> globalData;
+	std::vector<std::unique_ptr<qpu_asm::Instruction>> instructions;
+	const std::size_t codeOffset = readModule(module, moduleInfo, globalData, instructions);
+	const qpu_asm::KernelInfo& kernel = findKernel(moduleInfo, data.kernelName);
+
+	const uint32_t numQPUs = data.localSizes[0] * data.localSizes[1] * data.localSizes[2];
+	if(numQPUs == 0 || numQPUs > NUM_QPUS)
+		throw CompilationError(CompilationStep::GENERAL, "Invalid number of work-items per work-group", std::to_string(numQPUs));
+	if(data.parameters.size() != kernel.parameters.size())
+		throw CompilationError(CompilationStep::GENERAL, "Invalid number of kernel parameters", std::to_string(data.parameters.size()));
+
+	SharedState state(instructions);
+	EmulationResult result;
+	result.kernelName = kernel.name;
+	result.qpuStatistics.resize(numQPUs);
+
+	//the stack-frames for all QPUs are located after the global data
+	globalData.resize(globalData.size() + moduleInfo.getStackFrameSize().getValue() * 2 * NUM_QPUS, 0);
+	const MemoryAddress globalDataAddress = state.memory.allocate(globalData);
+
+	std::vector<std::vector<uint32_t>> parameterUniforms;
+	std::vector<MemoryAddress> bufferAddresses(data.parameters.size(), 0);
+	for(std::size_t p = 0; p < data.parameters.size(); ++p)
+	{
+		const ParameterValue& param = data.parameters[p];
+		const qpu_asm::ParamInfo& info = kernel.parameters[p];
+		if(param.isBuffer != info.getPointer())
+			throw CompilationError(CompilationStep::GENERAL, std::string("Parameter needs to be a ") + (info.getPointer() ? "buffer" : "direct value"), info.name);
+		if(param.isBuffer)
+		{
+			bufferAddresses[p] = state.memory.allocate(param.buffer);
+			parameterUniforms.push_back({bufferAddresses[p]});
+		}
+		else
+		{
+			//vector parameters are read element-wise
+			const std::size_t numElements = std::max(info.getElements(), static_cast<uint8_t>(1));
+			if(param.scalarValues.size() != numElements)
+				throw CompilationError(CompilationStep::GENERAL, "Invalid number of elements for parameter", info.name);
+			parameterUniforms.push_back(param.scalarValues);
+		}
+	}
+
+	const std::size_t startOffset = static_cast<std::size_t>(kernel.getOffset().getValue()) - codeOffset;
+	const uint32_t localSizes = data.localSizes[0] | (data.localSizes[1] << 8) | (data.localSizes[2] << 16);
+	const uint32_t workDimensions = data.numGroups[2] * data.localSizes[2] > 1 ? 3 : data.numGroups[1] * data.localSizes[1] > 1 ? 2 : 1;
+
+	result.completed = true;
+	for(uint32_t groupZ = 0; groupZ < data.numGroups[2] && result.completed; ++groupZ)
+	{
+		for(uint32_t groupY = 0; groupY < data.numGroups[1] && result.completed; ++groupY)
+		{
+			for(uint32_t groupX = 0; groupX < data.numGroups[0] && result.completed; ++groupX)
+			{
+				std::vector<std::unique_ptr<QPU>> qpus;
+				for(uint32_t q = 0; q < numQPUs; ++q)
+				{
+					const uint32_t localIDs = (q % data.localSizes[0]) | (((q / data.localSizes[0]) % data.localSizes[1]) << 8) | ((q / (data.localSizes[0] * data.localSizes[1])) << 16);
+					//see CodeGenerator#generateStartSegment for the UNIFORM layout
+					std::vector<uint32_t> uniforms{workDimensions, localSizes, localIDs, data.numGroups[0], data.numGroups[1], data.numGroups[2], groupX, groupY, groupZ,
+						data.globalOffsets[0], data.globalOffsets[1], data.globalOffsets[2], globalDataAddress};
+					for(const auto& values : parameterUniforms)
+						uniforms.insert(uniforms.end(), values.begin(), values.end());
+					//the number of work-group iterations left (see optimizations#unrollWorkGroups), the work-groups are emulated separately
+					uniforms.push_back(0);
+					const MemoryAddress uniformAddress = state.memory.allocate(uniforms);
+					qpus.emplace_back(new QPU(static_cast<uint8_t>(q), state, result.qpuStatistics[q], startOffset, uniformAddress));
+				}
+
+				uint64_t cycle = 0;
+				while(std::any_of(qpus.begin(), qpus.end(), [](const std::unique_ptr<QPU>& qpu) -> bool { return qpu->isRunning(); }))
+				{
+					if(cycle >= data.maxCycles)
+					{
+						logging::warn() << "Emulation of kernel '" << kernel.name << "' aborted after " << cycle << " cycles" << logging::endl;
+						result.completed = false;
+						break;
+					}
+					bool anyProgress = false;
+					for(auto& qpu : qpus)
+						anyProgress = qpu->execute(cycle) || anyProgress;
+					if(!anyProgress && std::all_of(qpus.begin(), qpus.end(), [](const std::unique_ptr<QPU>& qpu) -> bool { return !qpu->isRunning() || qpu->isBlockedByOtherQPU(); }))
+						throw CompilationError(CompilationStep::GENERAL, "Emulated QPUs are dead-locked in cycle", std::to_string(cycle));
+					++cycle;
+				}
+				result.totalCycles += cycle;
+			}
+		}
+	}
+
+	result.memoryStatistics = state.statistics;
+	for(std::size_t p = 0; p < data.parameters.size(); ++p)
+	{
+		if(data.parameters[p].isBuffer)
+			result.buffers.push_back(state.memory.readBuffer(bufferAddresses[p], data.parameters[p].buffer.size()));
+		else
+			result.buffers.emplace_back();
+	}
+	PROFILE_END(Emulator);
+	return result;
+}
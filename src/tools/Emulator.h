@@ -0,0 +1,275 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_EMULATOR_H
+#define VC4C_EMULATOR_H
+
+#include "tools.h"
+#include "helper.h"
+#include "../performance.h"
+#include "../asm/Instruction.h"
+
+#include <deque>
+#include <memory>
+
+namespace vc4c
+{
+	namespace qpu_asm
+	{
+		class ALUInstruction;
+		class BranchInstruction;
+		class LoadInstruction;
+		class SemaphoreInstruction;
+	} // namespace qpu_asm
+
+	namespace tools
+	{
+		using SIMDVector = std::array<uint32_t, NATIVE_VECTOR_SIZE>;
+		using MemoryAddress = uint32_t;
+
+		/*
+		 * The latencies (in instruction slots) of the periphery modeled by the emulator
+		 */
+		//"The result of the SFU calculation is available in r4 after 2 instructions" (page 38)
+		constexpr uint64_t SFU_LATENCY{3};
+		//the SFU only calculates approximations, modeled by truncating the mantissa of the exact result to this number of bits (estimated)
+		constexpr unsigned SFU_MANTISSA_BITS{16};
+		//minimum latency of a TMU lookup hitting the TMU cache
+		constexpr uint64_t TMU_CACHE_HIT_LATENCY{9};
+		//latency of a TMU lookup with at least one cache-miss
+		constexpr uint64_t TMU_CACHE_MISS_LATENCY{40};
+		//the number of 64-byte cache-lines kept in the TMU cache (4 KB)
+		constexpr std::size_t TMU_CACHE_LINES{64};
+		//the maximum number of outstanding TMU requests per QPU and TMU
+		constexpr std::size_t TMU_FIFO_DEPTH{4};
+		//"The VPM read setup takes effect 3 instructions after it is written"
+		constexpr uint64_t VPM_READ_LATENCY{3};
+		//the fixed overhead of a DMA transfer
+		constexpr uint64_t DMA_SETUP_LATENCY{20};
+		//the estimated number of bytes transferred per instruction slot via DMA
+		constexpr uint64_t DMA_BYTES_PER_CYCLE{16};
+		//the VPM consists of up to 256 rows of 16 words each (addressable by the 8-bit generic setup address)
+		constexpr std::size_t VPM_NUM_ROWS{256};
+		//the base address of the emulated memory, address 0 is reserved to detect invalid accesses
+		constexpr MemoryAddress MEMORY_BASE_ADDRESS{0x1000};
+
+		/*
+		 * The main memory, as accessed via TMU, DMA and the UNIFORM-cache
+		 */
+		class Memory : private NonCopyable
+		{
+		public:
+			/*
+			 * Allocates a new buffer with the given contents and returns its address
+			 */
+			MemoryAddress allocate(const std::vector<uint32_t>& contents);
+			std::vector<uint32_t> readBuffer(MemoryAddress address, std::size_t numWords) const;
+
+			uint32_t readWord(MemoryAddress address) const;
+			uint8_t readByte(MemoryAddress address) const;
+			void writeByte(MemoryAddress address, uint8_t value);
+
+		private:
+			std::vector<uint8_t> data;
+
+			std::size_t toOffset(MemoryAddress address, std::size_t numBytes) const;
+		};
+
+		/*
+		 * The hardware mutex shared by all QPUs
+		 */
+		class Mutex : private NonCopyable
+		{
+		public:
+			bool isLockable(uint8_t qpu) const;
+			void lock(uint8_t qpu);
+			void unlock(uint8_t qpu);
+
+		private:
+			Optional<uint8_t> owner;
+		};
+
+		/*
+		 * The 16 system-wide 4-bit counting semaphores
+		 */
+		class Semaphores : private NonCopyable
+		{
+		public:
+			bool isIncrementPossible(uint8_t index) const;
+			bool isDecrementPossible(uint8_t index) const;
+			void increment(uint8_t index);
+			void decrement(uint8_t index);
+
+		private:
+			std::array<uint8_t, 16> counters{};
+		};
+
+		/*
+		 * The special functions unit of a single QPU
+		 */
+		class SFU : private NonCopyable
+		{
+		public:
+			void startCalculation(uint8_t reg, const SIMDVector& input, uint64_t cycle);
+			bool isResultReady(uint64_t cycle) const;
+			bool hasPendingResult() const;
+			SIMDVector takeResult();
+
+		private:
+			Optional<SIMDVector> result;
+			uint64_t readyCycle = 0;
+		};
+
+		/*
+		 * The texture and memory lookup unit (in general memory lookup mode) of a single QPU
+		 */
+		class TMU : private NonCopyable
+		{
+		public:
+			TMU(Memory& memory, MemoryStatistics& statistics, FastSet<MemoryAddress>& cache);
+
+			void pushRequest(const SIMDVector& addresses, uint64_t cycle);
+			bool isResponseReady(uint64_t cycle) const;
+			bool hasPendingResponse() const;
+			SIMDVector popResponse();
+
+		private:
+			struct Response
+			{
+				SIMDVector data;
+				uint64_t readyCycle;
+			};
+
+			Memory& memory;
+			MemoryStatistics& statistics;
+			FastSet<MemoryAddress>& cache;
+			std::deque<Response> responses;
+		};
+
+		/*
+		 * The vertex pipe memory and the DMA engines shared by all QPUs.
+		 *
+		 * The VPM is modeled as 64 bytes per row, packed 8-bit and 16-bit accesses write the elements into consecutive bytes/half-words.
+		 */
+		class VPM : private NonCopyable
+		{
+		public:
+			VPM(Memory& memory, MemoryStatistics& statistics);
+
+			/*
+			 * Reads/writes a row via the generic block access (QPU to VPM) using the given generic setup
+			 */
+			SIMDVector readRow(uint32_t& setup);
+			void writeRow(uint32_t& setup, const SIMDVector& values);
+
+			/*
+			 * Executes the DMA transfers and returns the cycle the transfer is finished
+			 */
+			uint64_t loadDMA(uint32_t dmaSetup, uint32_t strideSetup, MemoryAddress address, uint64_t cycle);
+			uint64_t storeDMA(uint32_t dmaSetup, uint32_t strideSetup, MemoryAddress address, uint64_t cycle);
+
+		private:
+			Memory& memory;
+			MemoryStatistics& statistics;
+			std::vector<uint8_t> data;
+			uint64_t loadEngineBusyUntil = 0;
+			uint64_t storeEngineBusyUntil = 0;
+		};
+
+		/*
+		 * The components shared by all QPUs
+		 */
+		struct SharedState : private NonCopyable
+		{
+			Memory memory;
+			Mutex mutex;
+			Semaphores semaphores;
+			MemoryStatistics statistics;
+			FastSet<MemoryAddress> tmuCache;
+			VPM vpm;
+			const std::vector<std::unique_ptr<qpu_asm::Instruction>>& instructions;
+
+			explicit SharedState(const std::vector<std::unique_ptr<qpu_asm::Instruction>>& instructions);
+		};
+
+		/*
+		 * A single emulated QPU, running a single work-item
+		 */
+		class QPU : private NonCopyable
+		{
+		public:
+			QPU(uint8_t number, SharedState& state, QPUStatistics& statistics, std::size_t startOffset, MemoryAddress uniformAddress);
+
+			/*
+			 * Tries to execute the next instruction.
+			 *
+			 * Returns false, if the QPU stalled in this cycle
+			 */
+			bool execute(uint64_t cycle);
+
+			bool isRunning() const;
+			/*
+			 * Whether the last stall can only be resolved by another QPU (e.g. mutex or semaphore)
+			 */
+			bool isBlockedByOtherQPU() const;
+
+		private:
+			const uint8_t number;
+			SharedState& state;
+			QPUStatistics& statistics;
+
+			std::array<SIMDVector, 32> registerFileA{};
+			std::array<SIMDVector, 32> registerFileB{};
+			//the (1-based) number of the instruction last writing the register-file registers, to detect reads in the directly following instruction
+			std::array<uint64_t, 32> registerFileAWritten{};
+			std::array<uint64_t, 32> registerFileBWritten{};
+			std::array<SIMDVector, 6> accumulators{};
+			std::array<bool, NATIVE_VECTOR_SIZE> flagZero{};
+			std::array<bool, NATIVE_VECTOR_SIZE> flagNegative{};
+			std::array<bool, NATIVE_VECTOR_SIZE> flagCarry{};
+
+			std::size_t pc;
+			MemoryAddress uniformAddress;
+			//the target of a branch and the remaining delay slots until it is taken
+			Optional<std::size_t> branchTarget;
+			unsigned branchDelay = 0;
+			//the remaining delay slots after the thread end signal
+			Optional<unsigned> threadEndDelay;
+			bool running = true;
+			Optional<StallReason> lastStall;
+
+			SFU sfu;
+			TMU tmu0;
+			TMU tmu1;
+			uint32_t vpmReadSetup = 0;
+			uint8_t vpmReadsLeft = 0;
+			uint64_t vpmReadSetupCycle = 0;
+			uint32_t vpmWriteSetup = 0;
+			uint32_t dmaLoadSetup = 0;
+			uint32_t dmaLoadStrideSetup = 0;
+			uint32_t dmaStoreSetup = 0;
+			uint32_t dmaStoreStrideSetup = 0;
+			uint64_t dmaLoadFinished = 0;
+			uint64_t dmaStoreFinished = 0;
+
+			Optional<StallReason> checkStall(const qpu_asm::Instruction* instr, uint64_t cycle);
+
+			void executeALU(const qpu_asm::ALUInstruction* instr, uint64_t cycle);
+			void executeBranch(const qpu_asm::BranchInstruction* instr);
+			void executeLoad(const qpu_asm::LoadInstruction* instr, uint64_t cycle);
+			void executeSemaphore(const qpu_asm::SemaphoreInstruction* instr, uint64_t cycle);
+			void executeSignal(Signaling signal, uint64_t cycle);
+			void recordHazard(Hazard hazard);
+
+			SIMDVector readRegister(bool fileA, Address reg, uint64_t cycle);
+			void writeRegister(bool fileA, Address reg, const SIMDVector& values, const std::array<bool, NATIVE_VECTOR_SIZE>& mask, uint64_t cycle);
+			void setFlags(const SIMDVector& values, const std::array<bool, NATIVE_VECTOR_SIZE>& carries, ConditionCode cond);
+			bool isConditionMet(ConditionCode cond, std::size_t element) const;
+		};
+	} // namespace tools
+} // namespace vc4c
+
+#endif /* VC4C_EMULATOR_H */
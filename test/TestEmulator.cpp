@@ -0,0 +1,1302 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "TestEmulator.h"
+
+#include "asm/ALUInstruction.h"
+#include "asm/BranchInstruction.h"
+#include "asm/KernelInfo.h"
+#include "asm/LoadInstruction.h"
+#include "asm/CodeGenerator.h"
+#include "Compiler.h"
+#include "intermediate/IntermediateInstruction.h"
+#include "intermediate/TypeConversions.h"
+#include "llvm/IRParser.h"
+#include "optimization/Optimizer.h"
+#include "periphery/VPM.h"
+#include "tools.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+using namespace vc4c;
+using namespace vc4c::tools;
+
+TestEmulator::TestEmulator()
+{
+	TEST_ADD(TestEmulator::testArithmetics);
+	TEST_ADD(TestEmulator::testSFUHazard);
+	TEST_ADD(TestEmulator::testReadHazards);
+	TEST_ADD(TestEmulator::testBranches);
+	TEST_ADD(TestEmulator::testMultipleQPUs);
+	TEST_ADD(TestEmulator::testInstructionScheduling);
+	TEST_ADD(TestEmulator::testBranchDelaySlots);
+	TEST_ADD(TestEmulator::testRegisterSpilling);
+	TEST_ADD(TestEmulator::testThreadableKernels);
+	TEST_ADD(TestEmulator::testPipelinedTMULoads);
+	TEST_ADD(TestEmulator::testMemoryCachedInVPM);
+	TEST_ADD(TestEmulator::testCopyMultipleRows);
+	TEST_ADD(TestEmulator::testInterleavedWrites);
+	TEST_ADD(TestEmulator::testCriticalSections);
+	TEST_ADD(TestEmulator::testMemset);
+	TEST_ADD(TestEmulator::testMul24);
+	TEST_ADD(TestEmulator::testDivisionViaFloat);
+	TEST_ADD(TestEmulator::testDivisionSkippingIterations);
+	TEST_ADD(TestEmulator::testSignedRemainder);
+	TEST_ADD(TestEmulator::testSaturatedConversions);
+	TEST_ADD(TestEmulator::testPackedByteSaturation);
+	TEST_ADD(TestEmulator::testPackedByteVectors);
+}
+
+TestEmulator::~TestEmulator()
+{
+	//out-of-line virtual destructor
+}
+
+//the number of work-item UNIFORMs (work-dimensions, local sizes, local IDs, 3x number of groups, 3x group IDs, 3x global offsets, global data address)
+static constexpr unsigned NUM_IMPLICIT_UNIFORMS{13};
+
+static uint64_t alu(const OpCode& add, Address out, InputMutex muxA, InputMutex muxB, Address inA = REG_NOP.num, Address inB = REG_NOP.num,
+		WriteSwap ws = WriteSwap::DONT_SWAP, SetFlag sf = SetFlag::DONT_SET, Signaling sig = SIGNAL_NONE)
+{
+	return qpu_asm::ALUInstruction(sig, UNPACK_NOP, PACK_NOP, COND_ALWAYS, COND_NEVER, sf, ws, out, REG_NOP.num, OP_NOP, add, inA, inB, muxA, muxB, InputMutex::ACC0, InputMutex::ACC0).toBinaryCode();
+}
+
+static uint64_t aluImmediate(const OpCode& add, Address out, InputMutex muxA, unsigned char immediate)
+{
+	return qpu_asm::ALUInstruction(UNPACK_NOP, PACK_NOP, COND_ALWAYS, COND_NEVER, SetFlag::DONT_SET, WriteSwap::DONT_SWAP, out, REG_NOP.num, OP_NOP, add, REG_NOP.num, SmallImmediate(immediate), muxA, InputMutex::REGB, InputMutex::ACC0, InputMutex::ACC0).toBinaryCode();
+}
+
+static uint64_t nop(Signaling sig = SIGNAL_NONE)
+{
+	return alu(OP_NOP, REG_NOP.num, InputMutex::ACC0, InputMutex::ACC0, REG_NOP.num, REG_NOP.num, WriteSwap::DONT_SWAP, SetFlag::DONT_SET, sig);
+}
+
+static uint64_t loadImmediate(Address out, uint32_t value, WriteSwap ws = WriteSwap::DONT_SWAP)
+{
+	return qpu_asm::LoadInstruction(PACK_NOP, COND_ALWAYS, COND_NEVER, SetFlag::DONT_SET, ws, out, REG_NOP.num, value).toBinaryCode();
+}
+
+/*
+ * Skips the work-item UNIFORMs and reads the address of the single buffer parameter into r1
+ */
+static void readUniforms(std::vector<uint64_t>& instructions, Address localIDsOut = REG_NOP.num)
+{
+	for(unsigned i = 0; i < NUM_IMPLICIT_UNIFORMS; ++i)
+		instructions.push_back(alu(OP_OR, i == 2 ? localIDsOut : REG_NOP.num, InputMutex::REGA, InputMutex::REGA, REG_UNIFORM.num));
+	instructions.push_back(alu(OP_OR, REG_ACC1.num, InputMutex::REGA, InputMutex::REGA, REG_UNIFORM.num));
+}
+
+/*
+ * Writes r0 via VPM and DMA to the address in r1 and ends the program
+ */
+static void storeAndFinish(std::vector<uint64_t>& instructions)
+{
+	instructions.push_back(loadImmediate(REG_VPM_OUT_SETUP.num, periphery::VPWSetup(periphery::VPWGenericSetup(2, 1)).value, WriteSwap::SWAP));
+	instructions.push_back(alu(OP_OR, REG_VPM_IO.num, InputMutex::ACC0, InputMutex::ACC0));
+	instructions.push_back(loadImmediate(REG_VPM_OUT_SETUP.num, periphery::VPWSetup(periphery::VPWDMASetup(0, 16)).value, WriteSwap::SWAP));
+	instructions.push_back(alu(OP_OR, REG_VPM_OUT_ADDR.num, InputMutex::ACC1, InputMutex::ACC1, REG_NOP.num, REG_NOP.num, WriteSwap::SWAP));
+	instructions.push_back(alu(OP_OR, REG_NOP.num, InputMutex::REGB, InputMutex::REGB, REG_NOP.num, REG_VPM_OUT_WAIT.num));
+	instructions.push_back(nop(SIGNAL_END_PROGRAM));
+	instructions.push_back(nop());
+	instructions.push_back(nop());
+}
+
+/*
+ * Creates a binary module with a single kernel "test" taking a single buffer parameter
+ */
+static std::string createModule(const std::vector<uint64_t>& instructions)
+{
+	qpu_asm::KernelInfo kernelInfo(1);
+	kernelInfo.setName("test");
+	kernelInfo.workGroupSize = 0;
+	qpu_asm::ParamInfo paramInfo;
+	paramInfo.setSize(4);
+	paramInfo.setElements(1);
+	paramInfo.setPointer(true);
+	paramInfo.setName("out");
+	paramInfo.setTypeName("uint*");
+	kernelInfo.addParameter(paramInfo);
+	kernelInfo.setLength(Word(instructions.size()));
+	std::stringstream dummy;
+	//magic number, module info, the kernel info and the two delimiters
+	kernelInfo.setOffset(Word(2 + kernelInfo.write(dummy, OutputMode::BINARY) + 2));
+
+	qpu_asm::ModuleInfo moduleInfo;
+	moduleInfo.setInfoCount(1);
+
+	std::stringstream s;
+	const uint32_t magicNumbers[2] = {QPUASM_MAGIC_NUMBER, QPUASM_MAGIC_NUMBER};
+	const uint64_t zero = 0;
+	s.write(reinterpret_cast<const char*>(magicNumbers), sizeof(magicNumbers));
+	s.write(reinterpret_cast<const char*>(&moduleInfo.value), sizeof(moduleInfo.value));
+	kernelInfo.write(s, OutputMode::BINARY);
+	s.write(reinterpret_cast<const char*>(&zero), sizeof(zero));
+	s.write(reinterpret_cast<const char*>(&zero), sizeof(zero));
+	for(uint64_t instr : instructions)
+		s.write(reinterpret_cast<const char*>(&instr), sizeof(instr));
+	return s.str();
+}
+
+static EmulationResult runModule(const std::vector<uint64_t>& instructions, std::size_t bufferSize, uint32_t localSize = 1)
+{
+	std::stringstream module(createModule(instructions));
+	EmulationData data;
+	data.kernelName = "test";
+	data.parameters.push_back(ParameterValue::fromBuffer(std::vector<uint32_t>(bufferSize, 0)));
+	data.localSizes[0] = localSize;
+	data.maxCycles = 1000;
+	return emulate(module, data);
+}
+
+/*
+ * Compiles the given LLVM IR module (without the target specification) into the given output mode
+ */
+static void writeModule(std::ostream& input, const std::string& source)
+{
+	input << "target datalayout = \"e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024\"" << std::endl;
+	input << "target triple = \"spir-unknown-unknown\"" << std::endl;
+	input << source;
+}
+
+static std::string compile(const std::string& source, OutputMode outputMode, Configuration config = {})
+{
+	std::stringstream input;
+	writeModule(input, source);
+	std::stringstream output;
+	config.frontend = Frontend::LLVM_IR;
+	config.outputMode = outputMode;
+	config.writeKernelInfo = true;
+	Compiler compiler(input, output);
+	compiler.getConfiguration() = config;
+	compiler.convert();
+	return output.str();
+}
+
+/*
+ * Compiles the given LLVM IR module (without the target specification) and executes its kernel "test" for the given number of work-items
+ */
+static EmulationResult compileAndRun(const std::string& source, const std::vector<ParameterValue>& parameters, uint32_t localSize, Configuration config = {})
+{
+	std::stringstream binary(compile(source, OutputMode::BINARY, config));
+
+	EmulationData data;
+	data.kernelName = "test";
+	data.parameters = parameters;
+	data.localSizes[0] = localSize;
+	return emulate(binary, data);
+}
+
+/*
+ * Same as compileAndRun(), but replaces all truncations with the saturations the SPIR-V front-end inserts for the saturated conversions (e.g. convert_ushort_sat()),
+ * since LLVM IR has no saturated conversions
+ */
+static EmulationResult compileAndRunSaturated(const std::string& source, const std::vector<ParameterValue>& parameters, uint32_t localSize, bool isSigned, bool isSourceSigned)
+{
+	std::stringstream input;
+	writeModule(input, source);
+	Configuration config;
+	config.frontend = Frontend::LLVM_IR;
+	config.outputMode = OutputMode::BINARY;
+	config.writeKernelInfo = true;
+	Module module(config);
+	llvm2qasm::IRParser parser(input);
+	parser.parse(module);
+	for(Method* kernel : module.getKernels())
+	{
+		InstructionWalker it = kernel->walkAllInstructions();
+		while(!it.isEndOfMethod())
+		{
+			const intermediate::Operation* op = it.get<const intermediate::Operation>();
+			if(op != nullptr && op->opCode == "trunc")
+			{
+				const Value src = op->getFirstArg();
+				const Value dest = op->getOutput().value();
+				it = intermediate::insertSaturation(it, *kernel, src, dest, isSigned, isSourceSigned);
+				it.nextInBlock().erase();
+			}
+			else
+				it.nextInMethod();
+		}
+	}
+
+	optimizations::Optimizer optimizer(config);
+	qpu_asm::CodeGenerator codeGen(module, config);
+	optimizer.optimize(module);
+	for(Method* kernel : module.getKernels())
+	{
+		kernel->cleanLocals();
+		codeGen.generateInstructions(*kernel);
+	}
+	std::stringstream binary;
+	codeGen.writeOutput(binary);
+
+	EmulationData data;
+	data.kernelName = "test";
+	data.parameters = parameters;
+	data.localSizes[0] = localSize;
+	return emulate(binary, data);
+}
+
+static uint32_t floatBits(float f)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+void TestEmulator::testArithmetics()
+{
+	std::vector<uint64_t> instructions;
+	readUniforms(instructions);
+	instructions.push_back(loadImmediate(REG_ACC0.num, 5));
+	instructions.push_back(loadImmediate(REG_ACC2.num, 7));
+	//r3 = r0 + r2, r0 = r0 * r2
+	instructions.push_back(qpu_asm::ALUInstruction(SIGNAL_NONE, UNPACK_NOP, PACK_NOP, COND_ALWAYS, COND_ALWAYS, SetFlag::DONT_SET, WriteSwap::DONT_SWAP,
+			REG_ACC3.num, REG_ACC0.num, OP_MUL24, OP_ADD, REG_NOP.num, REG_NOP.num, InputMutex::ACC0, InputMutex::ACC2, InputMutex::ACC0, InputMutex::ACC2).toBinaryCode());
+	instructions.push_back(alu(OP_ADD, REG_ACC0.num, InputMutex::ACC0, InputMutex::ACC3));
+	storeAndFinish(instructions);
+
+	const EmulationResult result = runModule(instructions, 16);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT_EQUALS(1u, result.qpuStatistics.size());
+	TEST_ASSERT_EQUALS(static_cast<uint64_t>(instructions.size()), result.qpuStatistics[0].instructions);
+	TEST_ASSERT_EQUALS(static_cast<uint64_t>(NUM_IMPLICIT_UNIFORMS + 1), result.qpuStatistics[0].uniformsRead);
+	TEST_ASSERT(result.qpuStatistics[0].stalls[static_cast<std::size_t>(StallReason::VPM_DMA_STORE)] > 0);
+	TEST_ASSERT_EQUALS(1u, result.memoryStatistics.dmaStores);
+	TEST_ASSERT_EQUALS(64u, result.memoryStatistics.dmaBytesWritten);
+	for(uint32_t val : result.buffers.at(0))
+		TEST_ASSERT_EQUALS(47u, val);
+}
+
+void TestEmulator::testSFUHazard()
+{
+	std::vector<uint64_t> instructions;
+	readUniforms(instructions);
+	instructions.push_back(loadImmediate(REG_ACC0.num, floatBits(3.0f)));
+	instructions.push_back(alu(OP_OR, REG_SFU_RECIP.num, InputMutex::ACC0, InputMutex::ACC0));
+	//reading r4 directly after the SFU call does not stall, but reads an undefined value
+	instructions.push_back(alu(OP_OR, REG_ACC2.num, InputMutex::ACC4, InputMutex::ACC4));
+	instructions.push_back(nop());
+	instructions.push_back(alu(OP_OR, REG_ACC0.num, InputMutex::ACC4, InputMutex::ACC4));
+	storeAndFinish(instructions);
+
+	const EmulationResult result = runModule(instructions, 16);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT_EQUALS(static_cast<uint64_t>(instructions.size()), result.qpuStatistics[0].instructions);
+	TEST_ASSERT_EQUALS(1u, result.qpuStatistics[0].getTotalHazards());
+	TEST_ASSERT_EQUALS(1u, result.qpuStatistics[0].hazards[static_cast<std::size_t>(Hazard::SFU_RESULT)]);
+	//the SFU only approximates the reciprocal
+	float recip;
+	const uint32_t bits = result.buffers.at(0).at(0);
+	std::memcpy(&recip, &bits, sizeof(recip));
+	TEST_ASSERT(recip != 1.0f / 3.0f);
+	TEST_ASSERT(std::abs(recip - 1.0f / 3.0f) < 0.0001f);
+}
+
+void TestEmulator::testReadHazards()
+{
+	std::vector<uint64_t> instructions;
+	readUniforms(instructions);
+	//reads ra0 in the instruction directly following the write
+	instructions.push_back(loadImmediate(REG_ACC0.num, 17));
+	instructions.push_back(alu(OP_OR, 0, InputMutex::ACC0, InputMutex::ACC0));
+	instructions.push_back(alu(OP_OR, REG_ACC2.num, InputMutex::REGA, InputMutex::REGA, 0));
+	//reads ra0 with an instruction in between
+	instructions.push_back(alu(OP_OR, REG_ACC3.num, InputMutex::REGA, InputMutex::REGA, 0));
+	//reads from VPM before the read setup takes effect
+	instructions.push_back(loadImmediate(REG_VPM_IN_SETUP.num, periphery::VPRSetup(periphery::VPRGenericSetup(2, 1)).value));
+	instructions.push_back(alu(OP_OR, REG_ACC0.num, InputMutex::REGA, InputMutex::REGA, REG_VPM_IO.num));
+	//combines the results, so all of them are written to memory
+	instructions.push_back(alu(OP_OR, REG_ACC0.num, InputMutex::ACC0, InputMutex::ACC2));
+	instructions.push_back(alu(OP_ADD, REG_ACC0.num, InputMutex::ACC0, InputMutex::ACC3));
+	storeAndFinish(instructions);
+
+	const EmulationResult result = runModule(instructions, 16);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT_EQUALS(2u, result.qpuStatistics[0].getTotalHazards());
+	TEST_ASSERT_EQUALS(1u, result.qpuStatistics[0].hazards[static_cast<std::size_t>(Hazard::REGISTER_FILE)]);
+	TEST_ASSERT_EQUALS(1u, result.qpuStatistics[0].hazards[static_cast<std::size_t>(Hazard::VPM_READ)]);
+	TEST_ASSERT_EQUALS(POISON_VALUE + 17u, result.buffers.at(0).at(0));
+}
+
+void TestEmulator::testBranches()
+{
+	std::vector<uint64_t> instructions;
+	readUniforms(instructions);
+	instructions.push_back(loadImmediate(REG_ACC0.num, 0));
+	instructions.push_back(loadImmediate(REG_ACC2.num, 3));
+	const std::size_t loopStart = instructions.size();
+	instructions.push_back(aluImmediate(OP_ADD, REG_ACC0.num, InputMutex::ACC0, 1));
+	instructions.push_back(alu(OP_SUB, REG_NOP.num, InputMutex::ACC0, InputMutex::ACC2, REG_NOP.num, REG_NOP.num, WriteSwap::DONT_SWAP, SetFlag::SET_FLAGS));
+	const int32_t offset = static_cast<int32_t>(loopStart * sizeof(uint64_t)) - static_cast<int32_t>((instructions.size() + 4) * sizeof(uint64_t));
+	instructions.push_back(qpu_asm::BranchInstruction(BranchCond::ANY_Z_CLEAR, BranchRel::BRANCH_RELATIVE, BranchReg::NONE, 0, REG_NOP.num, REG_NOP.num, offset).toBinaryCode());
+	instructions.push_back(nop());
+	instructions.push_back(nop());
+	instructions.push_back(nop());
+	storeAndFinish(instructions);
+
+	const EmulationResult result = runModule(instructions, 16);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT_EQUALS(3u, result.qpuStatistics[0].branches);
+	TEST_ASSERT_EQUALS(2u, result.qpuStatistics[0].branchesTaken);
+	TEST_ASSERT_EQUALS(3u, result.buffers.at(0).at(0));
+}
+
+void TestEmulator::testMultipleQPUs()
+{
+	std::vector<uint64_t> instructions;
+	//r2 = local ID
+	readUniforms(instructions, REG_ACC2.num);
+	//acquire mutex
+	instructions.push_back(alu(OP_OR, REG_NOP.num, InputMutex::REGA, InputMutex::REGA, REG_MUTEX.num));
+	instructions.push_back(alu(OP_OR, REG_ACC0.num, InputMutex::ACC2, InputMutex::ACC2));
+	//r1 = r1 + (local ID * 64)
+	instructions.push_back(aluImmediate(OP_SHL, REG_ACC3.num, InputMutex::ACC2, 6));
+	instructions.push_back(alu(OP_ADD, REG_ACC1.num, InputMutex::ACC1, InputMutex::ACC3));
+	storeAndFinish(instructions);
+	//release mutex (before the thread-end delay slots)
+	instructions.insert(instructions.end() - 3, alu(OP_OR, REG_MUTEX.num, InputMutex::ACC0, InputMutex::ACC0));
+
+	const EmulationResult result = runModule(instructions, 4 * 16, 4);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT_EQUALS(4u, result.qpuStatistics.size());
+	uint64_t mutexStalls = 0;
+	for(const QPUStatistics& stats : result.qpuStatistics)
+		mutexStalls += stats.stalls[static_cast<std::size_t>(StallReason::MUTEX)];
+	TEST_ASSERT(mutexStalls > 0);
+	TEST_ASSERT_EQUALS(4u, result.memoryStatistics.dmaStores);
+	for(std::size_t i = 0; i < result.buffers.at(0).size(); ++i)
+		TEST_ASSERT_EQUALS(static_cast<uint32_t>(i / 16), result.buffers.at(0)[i]);
+}
+
+void TestEmulator::testInstructionScheduling()
+{
+	//independent TMU loads, SFU calculation and ALU operations, which are interleaved by the list scheduler
+	const std::string source = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %a, float addrspace(1)* nocapture readonly %b, i32 addrspace(1)* nocapture %out, float addrspace(1)* nocapture %fout) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pa = getelementptr inbounds i32, i32 addrspace(1)* %a, i32 %gid
+  %va = load i32, i32 addrspace(1)* %pa, align 4
+  %pb = getelementptr inbounds float, float addrspace(1)* %b, i32 %gid
+  %vb = load float, float addrspace(1)* %pb, align 4
+  %rcp = tail call float @vc4cl_sfu_recip(float %vb)
+  %x = shl i32 %va, 3
+  %y = xor i32 %va, 85
+  %z = lshr i32 %va, 2
+  %s = add i32 %x, %y
+  %r = sub i32 %s, %z
+  %f = fadd float %rcp, 1.000000e+00
+  %po = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid
+  store i32 %r, i32 addrspace(1)* %po, align 4
+  %pf = getelementptr inbounds float, float addrspace(1)* %fout, i32 %gid
+  store float %f, float addrspace(1)* %pf, align 4
+  ret void
+}
+
+declare i32 @vc4cl_global_id(i32)
+declare float @vc4cl_sfu_recip(float)
+
+!0 = !{i32 1, i32 1, i32 1, i32 1}
+)";
+	std::vector<uint32_t> a;
+	std::vector<uint32_t> b;
+	for(uint32_t i = 0; i < 8; ++i)
+	{
+		a.push_back(i * 1000 + 7);
+		b.push_back(floatBits(static_cast<float>(1u << i) / 4.0f));
+	}
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(a), ParameterValue::fromBuffer(b),
+		ParameterValue::fromBuffer(std::vector<uint32_t>(8)), ParameterValue::fromBuffer(std::vector<uint32_t>(8))}, 8);
+	TEST_ASSERT(result.completed);
+	for(uint32_t i = 0; i < 8; ++i)
+	{
+		TEST_ASSERT_EQUALS((a[i] << 3) + (a[i] ^ 85) - (a[i] >> 2), result.buffers.at(2).at(i));
+		TEST_ASSERT_EQUALS(floatBits(4.0f / static_cast<float>(1u << i) + 1.0f), result.buffers.at(3).at(i));
+	}
+}
+
+void TestEmulator::testBranchDelaySlots()
+{
+	//loop with a nested if-else, the delay slots of the branches are filled with instructions from before the branches
+	//NOTE: The IR front-end jumps to the second label if the condition is true, so the labels are swapped
+	const std::string source = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %a, i32 %n, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {
+entry:
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %cmp0 = icmp sgt i32 %n, 0
+  br i1 %cmp0, label %end, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inc, %next ]
+  %sum = phi i32 [ 0, %entry ], [ %sum2, %next ]
+  %idx = add nsw i32 %i, %gid
+  %p = getelementptr inbounds i32, i32 addrspace(1)* %a, i32 %idx
+  %v = load i32, i32 addrspace(1)* %p, align 4
+  %odd = and i32 %v, 1
+  %isodd = icmp ne i32 %odd, 0
+  br i1 %isodd, label %else, label %then
+
+then:
+  %t = shl i32 %v, 2
+  br label %next
+
+else:
+  %e = lshr i32 %v, 1
+  br label %next
+
+next:
+  %val = phi i32 [ %t, %then ], [ %e, %else ]
+  %sum2 = add nsw i32 %sum, %val
+  %inc = add nuw nsw i32 %i, 1
+  %cmp = icmp slt i32 %inc, %n
+  br i1 %cmp, label %end, label %loop
+
+end:
+  %res = phi i32 [ 0, %entry ], [ %sum2, %next ]
+  %q = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid
+  store i32 %res, i32 addrspace(1)* %q, align 4
+  ret void
+}
+
+declare i32 @vc4cl_global_id(i32)
+
+!0 = !{i32 1, i32 0, i32 1}
+)";
+	const uint32_t n = 5;
+	std::vector<uint32_t> a;
+	for(uint32_t i = 0; i < 4 + n; ++i)
+		a.push_back(i * 7 + 3);
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(a), ParameterValue::fromScalar(n), ParameterValue::fromBuffer(std::vector<uint32_t>(4))}, 4);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT(result.qpuStatistics.at(0).branchesTaken > 0);
+	//neither the delay slots nor the branch targets read values too early
+	for(const QPUStatistics& stats : result.qpuStatistics)
+		TEST_ASSERT_EQUALS(0u, stats.getTotalHazards());
+	for(uint32_t gid = 0; gid < 4; ++gid)
+	{
+		uint32_t sum = 0;
+		for(uint32_t i = 0; i < n; ++i)
+			sum += (a[gid + i] & 1) ? a[gid + i] << 2 : a[gid + i] >> 1;
+		TEST_ASSERT_EQUALS(sum, result.buffers.at(2).at(gid));
+	}
+}
+
+void TestEmulator::testRegisterSpilling()
+{
+	//loads more values than fit into the physical registers and combines the first with the last ones, so some of them need to be spilled
+	const uint32_t numValues = 64;
+	const uint32_t numItems = 4;
+	std::stringstream source;
+	source << "define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %a, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {" << std::endl;
+	source << "  %gid = tail call i32 @vc4cl_global_id(i32 0)" << std::endl;
+	source << "  %base = mul i32 %gid, " << numValues << std::endl;
+	for(uint32_t i = 0; i < numValues; ++i)
+	{
+		source << "  %i" << i << " = add i32 %base, " << i << std::endl;
+		source << "  %p" << i << " = getelementptr inbounds i32, i32 addrspace(1)* %a, i32 %i" << i << std::endl;
+		source << "  %v" << i << " = load i32, i32 addrspace(1)* %p" << i << ", align 4" << std::endl;
+	}
+	source << "  %s0 = mul i32 %v0, %v" << (numValues - 1) << std::endl;
+	for(uint32_t i = 1; i < numValues / 2; ++i)
+	{
+		source << "  %m" << i << " = mul i32 %v" << i << ", %v" << (numValues - 1 - i) << std::endl;
+		source << "  %s" << i << " = add i32 %s" << (i - 1) << ", %m" << i << std::endl;
+	}
+	source << "  %q = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid" << std::endl;
+	source << "  store i32 %s" << (numValues / 2 - 1) << ", i32 addrspace(1)* %q, align 4" << std::endl;
+	source << "  ret void" << std::endl;
+	source << "}" << std::endl;
+	source << "declare i32 @vc4cl_global_id(i32)" << std::endl;
+	source << "!0 = !{i32 1, i32 1}" << std::endl;
+
+	std::vector<uint32_t> a;
+	for(uint32_t i = 0; i < numValues * numItems; ++i)
+		a.push_back((i * 7 + 3) % 50);
+	for(const RegisterAllocator allocator : {RegisterAllocator::GRAPH_COLORING, RegisterAllocator::LINEAR_SCAN})
+	{
+		Configuration config;
+		config.registerAllocator = allocator;
+		//the kernel itself only writes into the VPM, so any VPM read reloads a spilled value
+		TEST_ASSERT(compile(source.str(), OutputMode::ASSEMBLER, config).find(", vpm") != std::string::npos);
+		const EmulationResult result = compileAndRun(source.str(), {ParameterValue::fromBuffer(a), ParameterValue::fromBuffer(std::vector<uint32_t>(numItems))}, numItems, config);
+		TEST_ASSERT(result.completed);
+		//the spilled values are not reloaded before the VPM read setup takes effect
+		for(const QPUStatistics& stats : result.qpuStatistics)
+			TEST_ASSERT_EQUALS(0u, stats.hazards[static_cast<std::size_t>(Hazard::VPM_READ)]);
+		for(uint32_t gid = 0; gid < numItems; ++gid)
+		{
+			uint32_t sum = 0;
+			for(uint32_t i = 0; i < numValues / 2; ++i)
+				sum += a[gid * numValues + i] * a[gid * numValues + numValues - 1 - i];
+			TEST_ASSERT_EQUALS(sum, result.buffers.at(1).at(gid));
+		}
+	}
+}
+
+void TestEmulator::testThreadableKernels()
+{
+	//the load via TMU allows to switch the hardware-thread
+	const std::string threadable = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %a, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pa = getelementptr inbounds i32, i32 addrspace(1)* %a, i32 %gid
+  %v = load i32, i32 addrspace(1)* %pa, align 4
+  %r = mul i32 %v, 3
+  %po = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid
+  store i32 %r, i32 addrspace(1)* %po, align 4
+  ret void
+}
+
+declare i32 @vc4cl_global_id(i32)
+
+!0 = !{i32 1, i32 1}
+)";
+	//the buffer %p is cached in a VPM area per QPU, which would be shared by both hardware-threads of a QPU
+	const std::string perQPUArea = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %a, i32 addrspace(1)* noalias nocapture %p) !kernel_arg_addr_space !0 !kernel_arg_type_qual !1 {
+  %v = load i32, i32 addrspace(1)* %a, align 4
+  %1 = load i32, i32 addrspace(1)* %p, align 4
+  %2 = add nsw i32 %1, %v
+  store i32 %2, i32 addrspace(1)* %p, align 4
+  %3 = getelementptr inbounds i32, i32 addrspace(1)* %p, i32 2
+  %4 = load i32, i32 addrspace(1)* %3, align 4
+  %5 = add nsw i32 %4, %2
+  store i32 %5, i32 addrspace(1)* %3, align 4
+  %6 = getelementptr inbounds i32, i32 addrspace(1)* %p, i32 20
+  %7 = load i32, i32 addrspace(1)* %6, align 4
+  %8 = mul nsw i32 %7, %5
+  store i32 %8, i32 addrspace(1)* %6, align 4
+  ret void
+}
+
+!0 = !{i32 1, i32 1}
+!1 = !{!"const", !"restrict"}
+)";
+	Configuration config;
+	config.threadableKernels = true;
+	//the kernel info (containing the threadable flag) is written as comment into the assembler output
+	TEST_ASSERT(compile(threadable, OutputMode::ASSEMBLER, config).find(", threadable,") != std::string::npos);
+	TEST_ASSERT_EQUALS(std::string::npos, compile(perQPUArea, OutputMode::ASSEMBLER, config).find(", threadable,"));
+
+	std::vector<uint32_t> a;
+	for(uint32_t i = 0; i < 8; ++i)
+		a.push_back(i * 11 + 5);
+	EmulationResult result = compileAndRun(threadable, {ParameterValue::fromBuffer(a), ParameterValue::fromBuffer(std::vector<uint32_t>(8))}, 8, config);
+	TEST_ASSERT(result.completed);
+	for(uint32_t i = 0; i < 8; ++i)
+		TEST_ASSERT_EQUALS(a[i] * 3, result.buffers.at(1).at(i));
+
+	std::vector<uint32_t> p(21);
+	for(uint32_t i = 0; i < p.size(); ++i)
+		p[i] = i + 1;
+	result = compileAndRun(perQPUArea, {ParameterValue::fromBuffer(a), ParameterValue::fromBuffer(p)}, 1, config);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT_EQUALS(p[0] + a[0], result.buffers.at(1).at(0));
+	TEST_ASSERT_EQUALS(p[2] + p[0] + a[0], result.buffers.at(1).at(2));
+	TEST_ASSERT_EQUALS(p[20] * (p[2] + p[0] + a[0]), result.buffers.at(1).at(20));
+}
+
+void TestEmulator::testPipelinedTMULoads()
+{
+	//more independent loads than TMU requests can be outstanding, which are distributed among both TMUs and hoisted above the preceding loads
+	const uint32_t numLoads = 9;
+	const uint32_t numItems = 4;
+	std::stringstream source;
+	source << "define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %a, i32 addrspace(1)* nocapture readonly %b, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {" << std::endl;
+	source << "  %gid = tail call i32 @vc4cl_global_id(i32 0)" << std::endl;
+	source << "  %s0 = add i32 %gid, 0" << std::endl;
+	for(uint32_t i = 0; i < numLoads; ++i)
+	{
+		//alternate the loads between both buffers with different offsets
+		source << "  %i" << i << " = add i32 %gid, " << (i * numItems) << std::endl;
+		source << "  %p" << i << " = getelementptr inbounds i32, i32 addrspace(1)* " << (i % 2 == 0 ? "%a" : "%b") << ", i32 %i" << i << std::endl;
+		source << "  %v" << i << " = load i32, i32 addrspace(1)* %p" << i << ", align 4" << std::endl;
+		source << "  %m" << i << " = mul i32 %v" << i << ", " << (i + 1) << std::endl;
+		source << "  %s" << (i + 1) << " = add i32 %s" << i << ", %m" << i << std::endl;
+	}
+	source << "  %q = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid" << std::endl;
+	source << "  store i32 %s" << numLoads << ", i32 addrspace(1)* %q, align 4" << std::endl;
+	source << "  ret void" << std::endl;
+	source << "}" << std::endl;
+	source << "declare i32 @vc4cl_global_id(i32)" << std::endl;
+	source << "!0 = !{i32 1, i32 1, i32 1}" << std::endl;
+
+	std::vector<uint32_t> a;
+	std::vector<uint32_t> b;
+	for(uint32_t i = 0; i < numLoads * numItems; ++i)
+	{
+		a.push_back(i * 13 + 1);
+		b.push_back(i * 1000 + 7);
+	}
+	//the threaded mode allows only half of the outstanding TMU requests per hardware-thread
+	for(const bool threadable : {false, true})
+	{
+		Configuration config;
+		config.threadableKernels = threadable;
+		const EmulationResult result = compileAndRun(source.str(), {ParameterValue::fromBuffer(a), ParameterValue::fromBuffer(b), ParameterValue::fromBuffer(std::vector<uint32_t>(numItems))}, numItems, config);
+		TEST_ASSERT(result.completed);
+		TEST_ASSERT_EQUALS(static_cast<uint64_t>(numLoads * numItems), result.memoryStatistics.tmuRequests);
+		for(uint32_t gid = 0; gid < numItems; ++gid)
+		{
+			uint32_t sum = gid;
+			for(uint32_t i = 0; i < numLoads; ++i)
+				sum += (i % 2 == 0 ? a : b)[gid + i * numItems] * (i + 1);
+			TEST_ASSERT_EQUALS(sum, result.buffers.at(2).at(gid));
+		}
+	}
+}
+
+void TestEmulator::testMemoryCachedInVPM()
+{
+	//the parameter %c is read several times at constant offsets, so the region is loaded once into the VPM instead of accessing it via TMU
+	const std::string readOnly = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %c, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 !kernel_arg_type_qual !1 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %c0 = load i32, i32 addrspace(1)* %c, align 4
+  %p1 = getelementptr inbounds i32, i32 addrspace(1)* %c, i32 1
+  %c1 = load i32, i32 addrspace(1)* %p1, align 4
+  %p2 = getelementptr inbounds i32, i32 addrspace(1)* %c, i32 2
+  %c2 = load i32, i32 addrspace(1)* %p2, align 4
+  %p3 = getelementptr inbounds i32, i32 addrspace(1)* %c, i32 3
+  %c3 = load i32, i32 addrspace(1)* %p3, align 4
+  %m0 = mul nsw i32 %gid, %c0
+  %a0 = add nsw i32 %m0, %c1
+  %m1 = mul nsw i32 %a0, %c2
+  %a1 = add nsw i32 %m1, %c3
+  %q = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid
+  store i32 %a1, i32 addrspace(1)* %q, align 4
+  ret void
+}
+
+declare i32 @vc4cl_global_id(i32)
+
+!0 = !{i32 1, i32 1}
+!1 = !{!"const restrict", !""}
+)";
+	const std::vector<uint32_t> c{3, 5, 7, 11};
+	auto checkReadOnly = [&c](const EmulationResult& result) -> void
+	{
+		TEST_ASSERT(result.completed);
+		for(uint32_t gid = 0; gid < 4; ++gid)
+			TEST_ASSERT_EQUALS((gid * c[0] + c[1]) * c[2] + c[3], result.buffers.at(1).at(gid));
+	};
+	EmulationResult result = compileAndRun(readOnly, {ParameterValue::fromBuffer(c), ParameterValue::fromBuffer(std::vector<uint32_t>(4))}, 4);
+	checkReadOnly(result);
+	TEST_ASSERT_EQUALS(0u, result.memoryStatistics.tmuRequests);
+	TEST_ASSERT(result.memoryStatistics.dmaLoads > 0);
+
+	//volatile memory is never cached
+	std::string volatileSource = readOnly;
+	volatileSource.replace(volatileSource.find("const restrict"), std::string("const restrict").size(), "volatile");
+	result = compileAndRun(volatileSource, {ParameterValue::fromBuffer(c), ParameterValue::fromBuffer(std::vector<uint32_t>(4))}, 4);
+	checkReadOnly(result);
+	TEST_ASSERT_EQUALS(16u, result.memoryStatistics.tmuRequests);
+
+	//the region is read and written, so it is cached per QPU and only the words written are written back at the end of the kernel
+	const std::string written = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture %p) !kernel_arg_addr_space !0 {
+  %1 = load i32, i32 addrspace(1)* %p, align 4
+  %2 = add nsw i32 %1, 1
+  store i32 %2, i32 addrspace(1)* %p, align 4
+  %3 = getelementptr inbounds i32, i32 addrspace(1)* %p, i32 2
+  %4 = load i32, i32 addrspace(1)* %3, align 4
+  %5 = add nsw i32 %4, %2
+  store i32 %5, i32 addrspace(1)* %3, align 4
+  %6 = getelementptr inbounds i32, i32 addrspace(1)* %p, i32 20
+  %7 = load i32, i32 addrspace(1)* %6, align 4
+  %8 = mul nsw i32 %7, %5
+  store i32 %8, i32 addrspace(1)* %6, align 4
+  ret void
+}
+
+!0 = !{i32 1}
+)";
+	std::vector<uint32_t> p(24);
+	for(uint32_t i = 0; i < p.size(); ++i)
+		p[i] = i * 3 + 2;
+	result = compileAndRun(written, {ParameterValue::fromBuffer(p)}, 1);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT_EQUALS(0u, result.memoryStatistics.tmuRequests);
+	TEST_ASSERT_EQUALS(0u, result.qpuStatistics.at(0).hazards[static_cast<std::size_t>(Hazard::VPM_READ)]);
+	for(uint32_t i = 0; i < p.size(); ++i)
+	{
+		uint32_t expected = p[i];
+		if(i == 0)
+			expected = p[0] + 1;
+		else if(i == 2)
+			expected = p[2] + p[0] + 1;
+		else if(i == 20)
+			expected = p[20] * (p[2] + p[0] + 1);
+		TEST_ASSERT_EQUALS(expected, result.buffers.at(0).at(i));
+	}
+}
+
+void TestEmulator::testCopyMultipleRows()
+{
+	//two blocks of 16 rows of 16 words each and a remainder row of 5 words
+	const uint32_t numWords = 2 * 16 * 16 + 5;
+	std::stringstream source;
+	source << "define spir_kernel void @test(i8 addrspace(1)* nocapture readonly %src, i8 addrspace(1)* nocapture %dest) !kernel_arg_addr_space !0 {" << std::endl;
+	source << "  tail call void @llvm.memcpy.p1i8.p1i8.i32(i8 addrspace(1)* %dest, i8 addrspace(1)* %src, i32 " << (numWords * 4) << ", i32 4, i1 false)" << std::endl;
+	source << "  ret void" << std::endl;
+	source << "}" << std::endl;
+	source << "declare void @llvm.memcpy.p1i8.p1i8.i32(i8 addrspace(1)* nocapture, i8 addrspace(1)* nocapture readonly, i32, i32, i1)" << std::endl;
+	source << "!0 = !{i32 1, i32 1}" << std::endl;
+
+	std::vector<uint32_t> src;
+	for(uint32_t i = 0; i < numWords + 3; ++i)
+		src.push_back(i * 17 + 1);
+	//the words behind the copied region must not be overwritten
+	const uint32_t marker = 0xDEADBEEF;
+	const EmulationResult result = compileAndRun(source.str(), {ParameterValue::fromBuffer(src), ParameterValue::fromBuffer(std::vector<uint32_t>(numWords + 3, marker))}, 1);
+	TEST_ASSERT(result.completed);
+	TEST_ASSERT_EQUALS(3u, result.memoryStatistics.dmaLoads);
+	TEST_ASSERT_EQUALS(3u, result.memoryStatistics.dmaStores);
+	TEST_ASSERT_EQUALS(static_cast<uint64_t>(numWords * 4), result.memoryStatistics.dmaBytesWritten);
+	for(uint32_t i = 0; i < numWords; ++i)
+		TEST_ASSERT_EQUALS(src[i], result.buffers.at(1).at(i));
+	for(uint32_t i = numWords; i < numWords + 3; ++i)
+		TEST_ASSERT_EQUALS(marker, result.buffers.at(1).at(i));
+}
+
+void TestEmulator::testInterleavedWrites()
+{
+	//the writes to consecutive words of %a are interleaved with writes to %b
+	std::stringstream source;
+	source << "define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %in, i32 addrspace(1)* nocapture %a, i32 addrspace(1)* nocapture %b) !kernel_arg_addr_space !0 !kernel_arg_type_qual !1 {" << std::endl;
+	source << "  %v = load i32, i32 addrspace(1)* %in, align 4" << std::endl;
+	for(uint32_t i = 0; i < 4; ++i)
+	{
+		source << "  %va" << i << " = add i32 %v, " << (i + 1) << std::endl;
+		source << "  %pa" << i << " = getelementptr inbounds i32, i32 addrspace(1)* %a, i32 " << i << std::endl;
+		source << "  store i32 %va" << i << ", i32 addrspace(1)* %pa" << i << ", align 4" << std::endl;
+		source << "  %vb" << i << " = mul i32 %v, " << (i + 2) << std::endl;
+		source << "  %pb" << i << " = getelementptr inbounds i32, i32 addrspace(1)* %b, i32 " << i << std::endl;
+		source << "  store i32 %vb" << i << ", i32 addrspace(1)* %pb" << i << ", align 4" << std::endl;
+	}
+	source << "  ret void" << std::endl;
+	source << "}" << std::endl;
+	source << "!0 = !{i32 1, i32 1, i32 1}" << std::endl;
+	const std::string restrictSource = source.str() + "!1 = !{!\"const\", !\"restrict\", !\"restrict\"}\n";
+	//without restrict, %a and %b may alias, so the writes need to be executed in their original order
+	const std::string aliasingSource = source.str() + "!1 = !{!\"const\", !\"\", !\"\"}\n";
+
+	const std::vector<uint32_t> in{12345};
+	auto check = [&in](const EmulationResult& result) -> void
+	{
+		TEST_ASSERT(result.completed);
+		for(uint32_t i = 0; i < 4; ++i)
+		{
+			TEST_ASSERT_EQUALS(in[0] + i + 1, result.buffers.at(1).at(i));
+			TEST_ASSERT_EQUALS(in[0] * (i + 2), result.buffers.at(2).at(i));
+		}
+	};
+	const std::vector<ParameterValue> parameters{ParameterValue::fromBuffer(in), ParameterValue::fromBuffer(std::vector<uint32_t>(4)), ParameterValue::fromBuffer(std::vector<uint32_t>(4))};
+	const EmulationResult separate = compileAndRun(aliasingSource, parameters, 1);
+	check(separate);
+	TEST_ASSERT_EQUALS(8u, separate.memoryStatistics.dmaStores);
+	//the writes to %a are combined into a single DMA write, although the writes to %b are interleaved
+	const EmulationResult combined = compileAndRun(restrictSource, parameters, 1);
+	check(combined);
+	TEST_ASSERT(combined.memoryStatistics.dmaStores < separate.memoryStatistics.dmaStores);
+}
+
+void TestEmulator::testCriticalSections()
+{
+	//the critical sections of the last two writes are merged, but not with the first one, since a TMU load lies in between
+	const std::string source = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %in, i32 addrspace(1)* nocapture %a, i32 addrspace(1)* nocapture %b) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pa = getelementptr inbounds i32, i32 addrspace(1)* %a, i32 %gid
+  store i32 %gid, i32 addrspace(1)* %pa, align 4
+  %p = getelementptr inbounds i32, i32 addrspace(1)* %in, i32 %gid
+  %v = load i32, i32 addrspace(1)* %p, align 4
+  %pb = getelementptr inbounds i32, i32 addrspace(1)* %b, i32 %gid
+  store i32 %v, i32 addrspace(1)* %pb, align 4
+  %w = add i32 %v, 1
+  %pc = getelementptr inbounds i32, i32 addrspace(1)* %a, i32 %w
+  store i32 %w, i32 addrspace(1)* %pc, align 4
+  ret void
+}
+
+declare i32 @vc4cl_global_id(i32)
+
+!0 = !{i32 1, i32 1, i32 1}
+)";
+	//the mutex must never be held while a TMU request is pending
+	std::stringstream assembler(compile(source, OutputMode::ASSEMBLER));
+	std::string line;
+	bool holdsMutex = false;
+	unsigned numCriticalSections = 0;
+	while(std::getline(assembler, line))
+	{
+		if(line.find("mutex_acq") != std::string::npos)
+		{
+			holdsMutex = true;
+			++numCriticalSections;
+		}
+		else if(line.find("mutex_rel") != std::string::npos)
+			holdsMutex = false;
+		else if(line.find("tmu") != std::string::npos)
+			TEST_ASSERT(!holdsMutex);
+	}
+	TEST_ASSERT_EQUALS(2u, numCriticalSections);
+
+	const std::vector<uint32_t> in{3, 4, 5, 6};
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(in), ParameterValue::fromBuffer(std::vector<uint32_t>(8)), ParameterValue::fromBuffer(std::vector<uint32_t>(4))}, 4);
+	TEST_ASSERT(result.completed);
+	for(uint32_t gid = 0; gid < 4; ++gid)
+	{
+		TEST_ASSERT_EQUALS(gid, result.buffers.at(1).at(gid));
+		TEST_ASSERT_EQUALS(in[gid] + 1, result.buffers.at(1).at(in[gid] + 1));
+		TEST_ASSERT_EQUALS(in[gid], result.buffers.at(2).at(gid));
+	}
+}
+
+void TestEmulator::testMemset()
+{
+	const std::string source = R"(
+define spir_kernel void @test(i8 addrspace(1)* nocapture %dest) !kernel_arg_addr_space !0 {
+  tail call void @llvm.memset.p1i8.i32(i8 addrspace(1)* %dest, i8 42, i32 6, i32 1, i1 false)
+  ret void
+}
+
+declare void @llvm.memset.p1i8.i32(i8 addrspace(1)* nocapture, i8, i32, i32, i1)
+
+!0 = !{i32 1}
+)";
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(std::vector<uint32_t>(3, 0x01010101))}, 1);
+	TEST_ASSERT(result.completed);
+	//the first 6 bytes are set to 42, the remaining bytes are unchanged
+	TEST_ASSERT_EQUALS(0x2A2A2A2Au, result.buffers.at(0).at(0));
+	TEST_ASSERT_EQUALS(0x01012A2Au, result.buffers.at(0).at(1));
+	TEST_ASSERT_EQUALS(0x01010101u, result.buffers.at(0).at(2));
+}
+
+void TestEmulator::testMul24()
+{
+	//the operands are known to fit into 24 bits (unsigned via the mask, signed via the arithmetic shift), so the multiplications are lowered to mul24
+	const std::string source = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %a, i32 addrspace(1)* nocapture readonly %b, i32 addrspace(1)* nocapture %out, i32 addrspace(1)* nocapture %outSigned) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pa = getelementptr inbounds i32, i32 addrspace(1)* %a, i32 %gid
+  %va = load i32, i32 addrspace(1)* %pa, align 4
+  %pb = getelementptr inbounds i32, i32 addrspace(1)* %b, i32 %gid
+  %vb = load i32, i32 addrspace(1)* %pb, align 4
+  %ua = and i32 %va, 16777215
+  %ub = and i32 %vb, 16777215
+  %mul = mul i32 %ua, %ub
+  %po = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid
+  store i32 %mul, i32 addrspace(1)* %po, align 4
+  %sa = ashr i32 %va, 8
+  %sb = ashr i32 %vb, 8
+  %smul = mul nsw i32 %sa, %sb
+  %ps = getelementptr inbounds i32, i32 addrspace(1)* %outSigned, i32 %gid
+  store i32 %smul, i32 addrspace(1)* %ps, align 4
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+!0 = !{i32 1, i32 1, i32 1, i32 1}
+)";
+	const std::string assembler = compile(source, OutputMode::ASSEMBLER);
+	//the full 32-bit multiplication masks the operands into their 16-bit halves
+	TEST_ASSERT(assembler.find("mul24") != std::string::npos);
+	TEST_ASSERT(assembler.find("65535") == std::string::npos);
+
+	//the products of the 24-bit operands exceed 24 bits and the lower 32 bits of the products need to be calculated
+	const std::vector<uint32_t> a = {0, 1, 0x00FFFFFF, 0xFFFFFFFF, 0x00123456, 0x80000000, 0x7FFFFFFF, 0x00ABCDEF};
+	const std::vector<uint32_t> b = {7, 0x00FFFFFF, 0x00FFFFFF, 0xFFFFFFFF, 0x00654321, 0x7FFFFFFF, 0x80000000, 0xFFFFFF00};
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(a), ParameterValue::fromBuffer(b), ParameterValue::fromBuffer(std::vector<uint32_t>(a.size())), ParameterValue::fromBuffer(std::vector<uint32_t>(a.size()))}, static_cast<uint32_t>(a.size()));
+	TEST_ASSERT(result.completed);
+	for(std::size_t i = 0; i < a.size(); ++i)
+	{
+		const uint32_t expected = (a[i] & 0x00FFFFFF) * (b[i] & 0x00FFFFFF);
+		TEST_ASSERT_EQUALS(expected, result.buffers.at(2).at(i));
+		const int64_t expectedSigned = static_cast<int64_t>(static_cast<int32_t>(a[i]) >> 8) * static_cast<int64_t>(static_cast<int32_t>(b[i]) >> 8);
+		TEST_ASSERT_EQUALS(static_cast<uint32_t>(expectedSigned), result.buffers.at(3).at(i));
+	}
+}
+
+void TestEmulator::testDivisionViaFloat()
+{
+	//the unsigned operands are masked to 23 bits and the absolute values of the signed operands fit into 22 bits, so all divisions are calculated via the floating-point reciprocal
+	const std::string source = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %n, i32 addrspace(1)* nocapture readonly %d, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pn = getelementptr inbounds i32, i32 addrspace(1)* %n, i32 %gid
+  %vn = load i32, i32 addrspace(1)* %pn, align 4
+  %pd = getelementptr inbounds i32, i32 addrspace(1)* %d, i32 %gid
+  %vd = load i32, i32 addrspace(1)* %pd, align 4
+  %un = and i32 %vn, 8388607
+  %ud = and i32 %vd, 8388607
+  %udiv = udiv i32 %un, %ud
+  %urem = urem i32 %un, %ud
+  %sn = ashr i32 %vn, 9
+  %sd = ashr i32 %vd, 9
+  %sdiv = sdiv i32 %sn, %sd
+  %srem = srem i32 %sn, %sd
+  %base = shl i32 %gid, 2
+  %p0 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %base
+  store i32 %udiv, i32 addrspace(1)* %p0, align 4
+  %i1 = or i32 %base, 1
+  %p1 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %i1
+  store i32 %urem, i32 addrspace(1)* %p1, align 4
+  %i2 = or i32 %base, 2
+  %p2 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %i2
+  store i32 %sdiv, i32 addrspace(1)* %p2, align 4
+  %i3 = or i32 %base, 3
+  %p3 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %i3
+  store i32 %srem, i32 addrspace(1)* %p3, align 4
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+!0 = !{i32 1, i32 1, i32 1}
+)";
+	const std::string assembler = compile(source, OutputMode::ASSEMBLER);
+	TEST_ASSERT(assembler.find("sfu_recip") != std::string::npos);
+
+	//N = 0, D = 1, N and D near 2^23, N < D, N = D and (for the signed division after shifting) negative operands
+	const std::vector<uint32_t> n = {0, 0x007FFFFF, 0x007FFFFF, 0x007FFFFE, 0x007FFFFF, 0x00400000, 0x00000200, 0xFFFFFFFF, 0x12345678, 0xFFFFF000, 0x0000FFFF, 0x007FFC00};
+	const std::vector<uint32_t> d = {1, 1, 0x007FFFFF, 0x007FFFFF, 0x007FFFFE, 0x00000003, 0x007FFFFF, 0xFFFFFE00, 0x00000A00, 0x00003000, 0xFFFFF800, 0xFFFFFE00};
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(n), ParameterValue::fromBuffer(d), ParameterValue::fromBuffer(std::vector<uint32_t>(n.size() * 4))}, static_cast<uint32_t>(n.size()));
+	TEST_ASSERT(result.completed);
+	for(std::size_t i = 0; i < n.size(); ++i)
+	{
+		const uint32_t un = n[i] & 0x007FFFFF;
+		const uint32_t ud = d[i] & 0x007FFFFF;
+		const int32_t sn = static_cast<int32_t>(n[i]) >> 9;
+		const int32_t sd = static_cast<int32_t>(d[i]) >> 9;
+		if(ud != 0)
+		{
+			TEST_ASSERT_EQUALS(un / ud, result.buffers.at(2).at(i * 4));
+			TEST_ASSERT_EQUALS(un % ud, result.buffers.at(2).at(i * 4 + 1));
+		}
+		if(sd != 0)
+		{
+			TEST_ASSERT_EQUALS(static_cast<uint32_t>(sn / sd), result.buffers.at(2).at(i * 4 + 2));
+			TEST_ASSERT_EQUALS(static_cast<uint32_t>(sn % sd), result.buffers.at(2).at(i * 4 + 3));
+		}
+	}
+
+	//the vector elements are divided independently
+	const std::string vectorSource = R"(
+define spir_kernel void @test(<4 x i32> addrspace(1)* nocapture readonly %n, <4 x i32> addrspace(1)* nocapture readonly %d, <4 x i32> addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pn = getelementptr inbounds <4 x i32>, <4 x i32> addrspace(1)* %n, i32 %gid
+  %vn = load <4 x i32>, <4 x i32> addrspace(1)* %pn, align 16
+  %pd = getelementptr inbounds <4 x i32>, <4 x i32> addrspace(1)* %d, i32 %gid
+  %vd = load <4 x i32>, <4 x i32> addrspace(1)* %pd, align 16
+  %un = and <4 x i32> %vn, <i32 8388607, i32 8388607, i32 8388607, i32 8388607>
+  %ud = and <4 x i32> %vd, <i32 8388607, i32 8388607, i32 8388607, i32 8388607>
+  %udiv = udiv <4 x i32> %un, %ud
+  %po = getelementptr inbounds <4 x i32>, <4 x i32> addrspace(1)* %out, i32 %gid
+  store <4 x i32> %udiv, <4 x i32> addrspace(1)* %po, align 16
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+!0 = !{i32 1, i32 1, i32 1}
+)";
+	const std::vector<uint32_t> vn = {0, 100, 0x007FFFFF, 12345, 0x007FFFFE, 7, 0x00400001, 999999};
+	const std::vector<uint32_t> vd = {1, 7, 3, 12345, 0x007FFFFF, 1, 2, 1000};
+	const EmulationResult vectorResult = compileAndRun(vectorSource, {ParameterValue::fromBuffer(vn), ParameterValue::fromBuffer(vd), ParameterValue::fromBuffer(std::vector<uint32_t>(vn.size()))}, 2);
+	TEST_ASSERT(vectorResult.completed);
+	for(std::size_t i = 0; i < vn.size(); ++i)
+		TEST_ASSERT_EQUALS(vn[i] / vd[i], vectorResult.buffers.at(2).at(i));
+}
+
+void TestEmulator::testDivisionSkippingIterations()
+{
+	//the divisor is at least 2^8, so the first 8 iterations of the long division are skipped for the unknown numerator
+	//and the numerator masked to 24 bits only requires 24 - 8 iterations
+	const std::string source = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %n, i32 addrspace(1)* nocapture readonly %d, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pn = getelementptr inbounds i32, i32 addrspace(1)* %n, i32 %gid
+  %vn = load i32, i32 addrspace(1)* %pn, align 4
+  %pd = getelementptr inbounds i32, i32 addrspace(1)* %d, i32 %gid
+  %vd = load i32, i32 addrspace(1)* %pd, align 4
+  %md = and i32 %vd, 255
+  %ud = add i32 %md, 256
+  %udiv = udiv i32 %vn, %ud
+  %urem = urem i32 %vn, %ud
+  %mn = and i32 %vn, 16777215
+  %udiv24 = udiv i32 %mn, %ud
+  %urem24 = urem i32 %mn, %ud
+  %base = shl i32 %gid, 2
+  %p0 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %base
+  store i32 %udiv, i32 addrspace(1)* %p0, align 4
+  %i1 = or i32 %base, 1
+  %p1 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %i1
+  store i32 %urem, i32 addrspace(1)* %p1, align 4
+  %i2 = or i32 %base, 2
+  %p2 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %i2
+  store i32 %udiv24, i32 addrspace(1)* %p2, align 4
+  %i3 = or i32 %base, 3
+  %p3 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %i3
+  store i32 %urem24, i32 addrspace(1)* %p3, align 4
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+!0 = !{i32 1, i32 1, i32 1}
+)";
+	const std::string assembler = compile(source, OutputMode::ASSEMBLER);
+	//the numerator does not fit into the floating-point mantissa
+	TEST_ASSERT(assembler.find("sfu_recip") == std::string::npos);
+
+	//N = 0, the smallest and largest divisors, N < D, N = D, N near 2^24 and 2^32
+	const std::vector<uint32_t> n = {0, 0xFFFFFFFF, 0xFFFFFFFF, 255, 256, 511, 0x00FFFFFF, 0x01000000, 0x80000000, 0x12345678, 0xFFFFFF00, 1000};
+	const std::vector<uint32_t> d = {0, 0, 0xFF, 0, 0, 0xFF, 0, 0x7F, 0x01, 0x42, 0xFF, 0xE8};
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(n), ParameterValue::fromBuffer(d), ParameterValue::fromBuffer(std::vector<uint32_t>(n.size() * 4))}, static_cast<uint32_t>(n.size()));
+	TEST_ASSERT(result.completed);
+	for(std::size_t i = 0; i < n.size(); ++i)
+	{
+		const uint32_t ud = (d[i] & 0xFF) + 256;
+		const uint32_t mn = n[i] & 0x00FFFFFF;
+		TEST_ASSERT_EQUALS(n[i] / ud, result.buffers.at(2).at(i * 4));
+		TEST_ASSERT_EQUALS(n[i] % ud, result.buffers.at(2).at(i * 4 + 1));
+		TEST_ASSERT_EQUALS(mn / ud, result.buffers.at(2).at(i * 4 + 2));
+		TEST_ASSERT_EQUALS(mn % ud, result.buffers.at(2).at(i * 4 + 3));
+	}
+}
+
+void TestEmulator::testSignedRemainder()
+{
+	//the operands are not known to fit into the floating-point mantissa, so the 32-bit long division is used
+	const std::string source = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %n, i32 addrspace(1)* nocapture readonly %d, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pn = getelementptr inbounds i32, i32 addrspace(1)* %n, i32 %gid
+  %vn = load i32, i32 addrspace(1)* %pn, align 4
+  %pd = getelementptr inbounds i32, i32 addrspace(1)* %d, i32 %gid
+  %vd = load i32, i32 addrspace(1)* %pd, align 4
+  %sdiv = sdiv i32 %vn, %vd
+  %srem = srem i32 %vn, %vd
+  %base = shl i32 %gid, 1
+  %p0 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %base
+  store i32 %sdiv, i32 addrspace(1)* %p0, align 4
+  %i1 = or i32 %base, 1
+  %p1 = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %i1
+  store i32 %srem, i32 addrspace(1)* %p1, align 4
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+!0 = !{i32 1, i32 1, i32 1}
+)";
+	const std::string assembler = compile(source, OutputMode::ASSEMBLER);
+	TEST_ASSERT(assembler.find("sfu_recip") == std::string::npos);
+
+	//the remainder takes the sign of the numerator only, e.g. 7 % -2 = 1 and -7 % -2 = -1
+	const std::vector<int32_t> n = {7, -7, -7, 7, 0, -1, -100, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max(), -123456789, 987654321, -5};
+	const std::vector<int32_t> d = {-2, 2, -2, 2, -5, std::numeric_limits<int32_t>::max(), -100, 3, -0x40000000, 1000, -77, -7};
+	std::vector<uint32_t> un, ud;
+	for(std::size_t i = 0; i < n.size(); ++i)
+	{
+		un.push_back(static_cast<uint32_t>(n[i]));
+		ud.push_back(static_cast<uint32_t>(d[i]));
+	}
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(un), ParameterValue::fromBuffer(ud), ParameterValue::fromBuffer(std::vector<uint32_t>(n.size() * 2))}, static_cast<uint32_t>(n.size()));
+	TEST_ASSERT(result.completed);
+	for(std::size_t i = 0; i < n.size(); ++i)
+	{
+		TEST_ASSERT_EQUALS(static_cast<uint32_t>(n[i] / d[i]), result.buffers.at(2).at(i * 2));
+		TEST_ASSERT_EQUALS(static_cast<uint32_t>(n[i] % d[i]), result.buffers.at(2).at(i * 2 + 1));
+	}
+}
+
+void TestEmulator::testSaturatedConversions()
+{
+	const std::string toShort = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %in, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pi = getelementptr inbounds i32, i32 addrspace(1)* %in, i32 %gid
+  %v = load i32, i32 addrspace(1)* %pi, align 4
+  %s = trunc i32 %v to i16
+  %e = zext i16 %s to i32
+  %po = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid
+  store i32 %e, i32 addrspace(1)* %po, align 4
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+!0 = !{i32 1, i32 1}
+)";
+	const std::string toChar = R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %in, i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pi = getelementptr inbounds i32, i32 addrspace(1)* %in, i32 %gid
+  %v = load i32, i32 addrspace(1)* %pi, align 4
+  %s = trunc i32 %v to i8
+  %e = sext i8 %s to i32
+  %po = getelementptr inbounds i32, i32 addrspace(1)* %out, i32 %gid
+  store i32 %e, i32 addrspace(1)* %po, align 4
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+!0 = !{i32 1, i32 1}
+)";
+	//the values with the high bit set are large unsigned or negative signed values
+	const std::vector<uint32_t> in = {0, 100, 127, 128, 65535, 65536, 0x7FFFFFFF, 0x80000000, 0xFFFFFF80, 0xFFFFFFFF};
+	const uint32_t numItems = static_cast<uint32_t>(in.size());
+	const auto run = [&in, numItems](const std::string& source, bool isSigned, bool isSourceSigned) -> std::vector<uint32_t>
+	{
+		const EmulationResult result = compileAndRunSaturated(source, {ParameterValue::fromBuffer(in), ParameterValue::fromBuffer(std::vector<uint32_t>(numItems))}, numItems, isSigned, isSourceSigned);
+		TEST_ASSERT(result.completed);
+		return result.buffers.at(1);
+	};
+
+	//convert_ushort_sat(uint)
+	std::vector<uint32_t> out = run(toShort, false, false);
+	for(uint32_t i = 0; i < numItems; ++i)
+		TEST_ASSERT_EQUALS(std::min(in[i], 65535u), out.at(i));
+	//convert_char_sat(uint)
+	out = run(toChar, true, false);
+	for(uint32_t i = 0; i < numItems; ++i)
+		TEST_ASSERT_EQUALS(std::min(in[i], 127u), out.at(i));
+	//convert_ushort_sat(int)
+	out = run(toShort, false, true);
+	for(uint32_t i = 0; i < numItems; ++i)
+		TEST_ASSERT_EQUALS(static_cast<uint32_t>(std::min(std::max(static_cast<int32_t>(in[i]), 0), 65535)), out.at(i));
+	//convert_char_sat(int)
+	out = run(toChar, true, true);
+	for(uint32_t i = 0; i < numItems; ++i)
+		TEST_ASSERT_EQUALS(static_cast<uint32_t>(std::min(std::max(static_cast<int32_t>(in[i]), -128), 127)), out.at(i));
+}
+
+void TestEmulator::testPackedByteSaturation()
+{
+	//the sum and difference of two unsigned chars saturated to unsigned char are calculated by a single v8adds/v8subs
+	const std::string source = R"(
+define spir_kernel void @test(i8 addrspace(1)* nocapture readonly %a, i8 addrspace(1)* nocapture readonly %b, i32 addrspace(1)* nocapture %sum, i32 addrspace(1)* nocapture %diff) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pa = getelementptr inbounds i8, i8 addrspace(1)* %a, i32 %gid
+  %va = load i8, i8 addrspace(1)* %pa, align 1
+  %pb = getelementptr inbounds i8, i8 addrspace(1)* %b, i32 %gid
+  %vb = load i8, i8 addrspace(1)* %pb, align 1
+  %ea = zext i8 %va to i32
+  %eb = zext i8 %vb to i32
+  %add = add nuw nsw i32 %ea, %eb
+  %adds = tail call i32 @vc4cl_saturate_lsb(i32 %add)
+  %ps = getelementptr inbounds i32, i32 addrspace(1)* %sum, i32 %gid
+  store i32 %adds, i32 addrspace(1)* %ps, align 4
+  %sub = sub nsw i32 %ea, %eb
+  %subs = tail call i32 @vc4cl_saturate_lsb(i32 %sub)
+  %pd = getelementptr inbounds i32, i32 addrspace(1)* %diff, i32 %gid
+  store i32 %subs, i32 addrspace(1)* %pd, align 4
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+declare i32 @vc4cl_saturate_lsb(i32)
+!0 = !{i32 1, i32 1, i32 1, i32 1}
+)";
+	const std::string assembler = compile(source, OutputMode::ASSEMBLER);
+	TEST_ASSERT(assembler.find("v8adds") != std::string::npos);
+	TEST_ASSERT(assembler.find("v8subs") != std::string::npos);
+	TEST_ASSERT(assembler.find("satLSBToByte0") == std::string::npos);
+
+	//4 bytes per 32-bit word, with sums above 255 and negative differences
+	const std::vector<uint8_t> a = {0, 1, 100, 200, 255, 255, 128, 17};
+	const std::vector<uint8_t> b = {0, 2, 100, 100, 1, 255, 127, 200};
+	std::vector<uint32_t> packedA(a.size() / 4);
+	std::vector<uint32_t> packedB(b.size() / 4);
+	std::memcpy(packedA.data(), a.data(), a.size());
+	std::memcpy(packedB.data(), b.data(), b.size());
+	const uint32_t numItems = static_cast<uint32_t>(a.size());
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(packedA), ParameterValue::fromBuffer(packedB), ParameterValue::fromBuffer(std::vector<uint32_t>(numItems)), ParameterValue::fromBuffer(std::vector<uint32_t>(numItems))}, numItems);
+	TEST_ASSERT(result.completed);
+	for(uint32_t i = 0; i < numItems; ++i)
+	{
+		TEST_ASSERT_EQUALS(std::min(static_cast<uint32_t>(a[i]) + b[i], 255u), result.buffers.at(2).at(i));
+		TEST_ASSERT_EQUALS(a[i] > b[i] ? static_cast<uint32_t>(a[i] - b[i]) : 0u, result.buffers.at(3).at(i));
+	}
+}
+
+void TestEmulator::testPackedByteVectors()
+{
+	//the uchar16 vectors are read, calculated and written packed as 4 words, 4 bytes per SIMD element
+	const std::string source = R"(
+define spir_kernel void @test(<16 x i8> addrspace(1)* nocapture readonly %a, <16 x i8> addrspace(1)* nocapture readonly %b, <16 x i8> addrspace(1)* nocapture %max, <16 x i8> addrspace(1)* nocapture %sum) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pa = getelementptr inbounds <16 x i8>, <16 x i8> addrspace(1)* %a, i32 %gid
+  %va = load <16 x i8>, <16 x i8> addrspace(1)* %pa, align 16
+  %pb = getelementptr inbounds <16 x i8>, <16 x i8> addrspace(1)* %b, i32 %gid
+  %vb = load <16 x i8>, <16 x i8> addrspace(1)* %pb, align 16
+  %ea = zext <16 x i8> %va to <16 x i32>
+  %eb = zext <16 x i8> %vb to <16 x i32>
+  %add = add <16 x i32> %ea, %eb
+  %adds = tail call <16 x i32> @vc4cl_saturate_lsb(<16 x i32> %add)
+  %ts = trunc <16 x i32> %adds to <16 x i8>
+  %m = tail call <16 x i32> @vc4cl_max(<16 x i32> %ea, <16 x i32> %eb, i32 1)
+  %tm = trunc <16 x i32> %m to <16 x i8>
+  %pm = getelementptr inbounds <16 x i8>, <16 x i8> addrspace(1)* %max, i32 %gid
+  store <16 x i8> %tm, <16 x i8> addrspace(1)* %pm, align 16
+  %ps = getelementptr inbounds <16 x i8>, <16 x i8> addrspace(1)* %sum, i32 %gid
+  store <16 x i8> %ts, <16 x i8> addrspace(1)* %ps, align 16
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+declare <16 x i32> @vc4cl_saturate_lsb(<16 x i32>)
+declare <16 x i32> @vc4cl_max(<16 x i32>, <16 x i32>, i32)
+!0 = !{i32 1, i32 1, i32 1, i32 1}
+)";
+	const std::string assembler = compile(source, OutputMode::ASSEMBLER);
+	TEST_ASSERT(assembler.find("v8adds") != std::string::npos);
+	TEST_ASSERT(assembler.find("v8max") != std::string::npos);
+	TEST_ASSERT(assembler.find("satLSBToByte0") == std::string::npos);
+
+	const uint32_t numItems = 2;
+	std::vector<uint8_t> a(numItems * 16);
+	std::vector<uint8_t> b(numItems * 16);
+	for(std::size_t i = 0; i < a.size(); ++i)
+	{
+		a[i] = static_cast<uint8_t>(i * 37 + 11);
+		b[i] = static_cast<uint8_t>(255 - i * 13);
+	}
+	std::vector<uint32_t> packedA(a.size() / 4);
+	std::vector<uint32_t> packedB(b.size() / 4);
+	std::memcpy(packedA.data(), a.data(), a.size());
+	std::memcpy(packedB.data(), b.data(), b.size());
+	const EmulationResult result = compileAndRun(source, {ParameterValue::fromBuffer(packedA), ParameterValue::fromBuffer(packedB), ParameterValue::fromBuffer(std::vector<uint32_t>(a.size() / 4)), ParameterValue::fromBuffer(std::vector<uint32_t>(a.size() / 4))}, numItems);
+	TEST_ASSERT(result.completed);
+	for(std::size_t i = 0; i < a.size(); ++i)
+	{
+		const uint32_t maxByte = (result.buffers.at(2).at(i / 4) >> (8 * (i % 4))) & 0xFF;
+		const uint32_t sumByte = (result.buffers.at(3).at(i / 4) >> (8 * (i % 4))) & 0xFF;
+		TEST_ASSERT_EQUALS(static_cast<uint32_t>(std::max(a[i], b[i])), maxByte);
+		TEST_ASSERT_EQUALS(std::min(static_cast<uint32_t>(a[i]) + b[i], 255u), sumByte);
+	}
+
+	//the uchar4 vector also used by a 32-bit operation is unpacked for it
+	const std::string unpackSource = R"(
+define spir_kernel void @test(<4 x i8> addrspace(1)* nocapture readonly %a, <4 x i8> addrspace(1)* nocapture %min, <4 x i32> addrspace(1)* nocapture %square) !kernel_arg_addr_space !0 {
+  %gid = tail call i32 @vc4cl_global_id(i32 0)
+  %pa = getelementptr inbounds <4 x i8>, <4 x i8> addrspace(1)* %a, i32 %gid
+  %va = load <4 x i8>, <4 x i8> addrspace(1)* %pa, align 4
+  %ea = zext <4 x i8> %va to <4 x i32>
+  %m = tail call <4 x i32> @vc4cl_min(<4 x i32> %ea, <4 x i32> <i32 100, i32 100, i32 100, i32 100>, i32 1)
+  %tm = trunc <4 x i32> %m to <4 x i8>
+  %pm = getelementptr inbounds <4 x i8>, <4 x i8> addrspace(1)* %min, i32 %gid
+  store <4 x i8> %tm, <4 x i8> addrspace(1)* %pm, align 4
+  %sq = mul <4 x i32> %m, %m
+  %ps = getelementptr inbounds <4 x i32>, <4 x i32> addrspace(1)* %square, i32 %gid
+  store <4 x i32> %sq, <4 x i32> addrspace(1)* %ps, align 16
+  ret void
+}
+declare i32 @vc4cl_global_id(i32)
+declare <4 x i32> @vc4cl_min(<4 x i32>, <4 x i32>, i32)
+!0 = !{i32 1, i32 1, i32 1}
+)";
+	TEST_ASSERT(compile(unpackSource, OutputMode::ASSEMBLER).find("v8min") != std::string::npos);
+	const EmulationResult unpackResult = compileAndRun(unpackSource, {ParameterValue::fromBuffer(packedA), ParameterValue::fromBuffer(std::vector<uint32_t>(a.size() / 4)), ParameterValue::fromBuffer(std::vector<uint32_t>(a.size()))}, static_cast<uint32_t>(a.size() / 4));
+	TEST_ASSERT(unpackResult.completed);
+	for(std::size_t i = 0; i < a.size(); ++i)
+	{
+		const uint32_t minimum = std::min(static_cast<uint32_t>(a[i]), 100u);
+		TEST_ASSERT_EQUALS(minimum, (unpackResult.buffers.at(1).at(i / 4) >> (8 * (i % 4))) & 0xFF);
+		TEST_ASSERT_EQUALS(minimum * minimum, unpackResult.buffers.at(2).at(i));
+	}
+}
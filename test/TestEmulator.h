@@ -0,0 +1,42 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef TEST_EMULATOR_H
+#define TEST_EMULATOR_H
+
+#include "cpptest.h"
+
+class TestEmulator : public Test::Suite
+{
+public:
+	TestEmulator();
+	~TestEmulator() override;
+
+	void testArithmetics();
+	void testSFUHazard();
+	void testReadHazards();
+	void testBranches();
+	void testMultipleQPUs();
+	void testInstructionScheduling();
+	void testBranchDelaySlots();
+	void testRegisterSpilling();
+	void testThreadableKernels();
+	void testPipelinedTMULoads();
+	void testMemoryCachedInVPM();
+	void testCopyMultipleRows();
+	void testInterleavedWrites();
+	void testCriticalSections();
+	void testMemset();
+	void testMul24();
+	void testDivisionViaFloat();
+	void testDivisionSkippingIterations();
+	void testSignedRemainder();
+	void testSaturatedConversions();
+	void testPackedByteSaturation();
+	void testPackedByteVectors();
+};
+
+#endif /* TEST_EMULATOR_H */
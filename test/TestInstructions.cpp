@@ -6,8 +6,15 @@
 
 #include "TestInstructions.h"
 
+#include "analysis/LivenessAnalysis.h"
+#include "analysis/ValueRange.h"
+#include "asm/GraphColoring.h"
 #include "asm/OpCodes.h"
 #include "Bitfield.h"
+#include "intermediate/IntermediateInstruction.h"
+#include "optimization/Optimizer.h"
+#include "periphery/VPM.h"
+#include "Values.h"
 
 using namespace vc4c;
 
@@ -16,6 +23,16 @@ TestInstructions::TestInstructions()
 	TEST_ADD(TestInstructions::testConditionCodes);
 	TEST_ADD(TestInstructions::testConstantSaturations);
 	TEST_ADD(TestInstructions::testBitfields);
+	TEST_ADD(TestInstructions::testValueHashing);
+	TEST_ADD(TestInstructions::testLocalUsers);
+	TEST_ADD(TestInstructions::testLivenessAnalysis);
+	TEST_ADD(TestInstructions::testLiveIntervals);
+	TEST_ADD(TestInstructions::testRegisterBlockedByWrite);
+	TEST_ADD(TestInstructions::testNodeCoalescing);
+	TEST_ADD(TestInstructions::testDMAVPMAddress);
+	TEST_ADD(TestInstructions::testLocalsUsedTogether);
+	TEST_ADD(TestInstructions::testValueRange);
+	TEST_ADD(TestInstructions::testFallThroughBlocks);
 }
 
 TestInstructions::~TestInstructions()
@@ -93,3 +110,471 @@ void TestInstructions::testBitfields()
 	TEST_ASSERT_EQUALS(3, t3.getTupleOffset9());
 	TEST_ASSERT_EQUALS(3 << 9, t3.value);
 }
+
+void TestInstructions::testValueHashing()
+{
+	const vc4c::hash<Value> h;
+
+	//equal values need to have equal hashes
+	TEST_ASSERT_EQUALS(h(INT_ONE), h(Value(Literal(static_cast<int64_t>(1)), TYPE_INT8)));
+	TEST_ASSERT_EQUALS(h(FLOAT_ZERO), h(Value(Literal(-0.0), TYPE_FLOAT)));
+	TEST_ASSERT_EQUALS(h(BOOL_TRUE), h(Value(Literal(true), TYPE_BOOL)));
+	TEST_ASSERT_EQUALS(h(UNIFORM_REGISTER), h(Value(REG_UNIFORM, TYPE_INT32.toVectorType(16))));
+	TEST_ASSERT_EQUALS(h(Value(SmallImmediate(7), TYPE_INT32)), h(Value(SmallImmediate(7), TYPE_INT32)));
+	ContainerValue container;
+	container.elements.push_back(INT_ZERO);
+	container.elements.push_back(INT_ONE);
+	TEST_ASSERT_EQUALS(h(Value(container, TYPE_INT8.toVectorType(2))), h(Value(container, TYPE_INT8.toVectorType(2))));
+
+	//the hash should distinguish the contents and types
+	TEST_ASSERT(h(INT_ZERO) != h(INT_ONE));
+	TEST_ASSERT(h(INT_ONE) != h(Value(Literal(static_cast<int64_t>(1)), TYPE_INT32)));
+	TEST_ASSERT(h(UNIFORM_REGISTER) != h(ELEMENT_NUMBER_REGISTER));
+	TEST_ASSERT(h(Value(SmallImmediate(7), TYPE_INT32)) != h(Value(SmallImmediate(8), TYPE_INT32)));
+	TEST_ASSERT(h(UNDEFINED_VALUE) != h(NOP_REGISTER));
+}
+
+void TestInstructions::testLocalUsers()
+{
+	Parameter a("a", TYPE_INT32);
+	Parameter b("b", TYPE_INT32);
+	const Value valA = a.createReference();
+	const Value valB = b.createReference();
+
+	std::unique_ptr<intermediate::MoveOperation> move(new intermediate::MoveOperation(valB, valA));
+	std::unique_ptr<intermediate::Operation> add(new intermediate::Operation("add", valB, valA, valA));
+	std::unique_ptr<intermediate::MoveOperation> copy(new intermediate::MoveOperation(valA, valB));
+
+	TEST_ASSERT_EQUALS(3u, a.countUsers(LocalUser::Type::BOTH));
+	TEST_ASSERT_EQUALS(2u, a.countUsers(LocalUser::Type::READER));
+	TEST_ASSERT_EQUALS(1u, a.countUsers(LocalUser::Type::WRITER));
+	TEST_ASSERT_EQUALS(2u, a.getUse(*add).numReads);
+	TEST_ASSERT_EQUALS(0u, a.getUse(*add).numWrites);
+	TEST_ASSERT_EQUALS(copy.get(), dynamic_cast<const intermediate::MoveOperation*>(a.getSingleWriter()));
+	TEST_ASSERT(b.getSingleWriter() == nullptr);
+
+	//replacing an argument updates the usage counts
+	add->setArgument(1, INT_ONE);
+	TEST_ASSERT_EQUALS(1u, a.getUse(*add).numReads);
+	TEST_ASSERT_EQUALS(2u, a.countUsers(LocalUser::Type::READER));
+
+	//removing a user (not the last in the list) keeps the positions of the other users intact
+	move.reset();
+	TEST_ASSERT_EQUALS(2u, a.countUsers(LocalUser::Type::BOTH));
+	TEST_ASSERT_EQUALS(1u, a.countUsers(LocalUser::Type::READER));
+	TEST_ASSERT_EQUALS(1u, a.getUse(*add).numReads);
+	TEST_ASSERT_EQUALS(1u, a.getUse(*copy).numWrites);
+	TEST_ASSERT_EQUALS(1u, b.countUsers(LocalUser::Type::WRITER));
+	TEST_ASSERT_EQUALS(add.get(), dynamic_cast<const intermediate::Operation*>(b.getSingleWriter()));
+
+	//the consumer may remove the current user
+	std::size_t numReaders = 0;
+	b.forUsers(LocalUser::Type::READER, [&numReaders](const LocalUser* user) -> void
+	{
+		++numReaders;
+		dynamic_cast<intermediate::MoveOperation*>(const_cast<LocalUser*>(user))->setSource(INT_ZERO);
+	});
+	TEST_ASSERT_EQUALS(1u, numReaders);
+	TEST_ASSERT_EQUALS(0u, b.countUsers(LocalUser::Type::READER));
+
+	add.reset();
+	copy.reset();
+	TEST_ASSERT(a.getUsers().empty());
+	TEST_ASSERT(b.getUsers().empty());
+}
+
+void TestInstructions::testLivenessAnalysis()
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	const Local* loopLabel = method.findOrCreateLocal(TYPE_LABEL, "%loop");
+	const Value i = method.addNewLocal(TYPE_INT32, "%i");
+	const Value sum = method.addNewLocal(TYPE_INT32, "%sum");
+	const Value step = method.addNewLocal(TYPE_INT32, "%step");
+	const Value cond = method.addNewLocal(TYPE_BOOL, "%cond");
+	const Value select = method.addNewLocal(TYPE_INT32, "%select");
+	const Value res = method.addNewLocal(TYPE_INT32, "%res");
+
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%entry")));
+	method.appendToEnd(new intermediate::MoveOperation(i, INT_ZERO));
+	method.appendToEnd(new intermediate::MoveOperation(sum, INT_ZERO));
+	method.appendToEnd(new intermediate::MoveOperation(step, INT_ZERO));
+	method.appendToEnd(new intermediate::MoveOperation(step, INT_ONE));
+	//single block loop, jumping to itself
+	method.appendToEnd(new intermediate::BranchLabel(*loopLabel));
+	method.appendToEnd(new intermediate::Operation("add", sum, sum, i));
+	method.appendToEnd(new intermediate::Operation("add", i, i, step));
+	method.appendToEnd(new intermediate::MoveOperation(cond, i));
+	method.appendToEnd(new intermediate::Branch(loopLabel, COND_ZERO_CLEAR, cond));
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%end")));
+	method.appendToEnd(new intermediate::MoveOperation(select, sum, COND_ZERO_SET));
+	method.appendToEnd(new intermediate::MoveOperation(select, INT_ONE, COND_ZERO_CLEAR));
+	method.appendToEnd(new intermediate::MoveOperation(res, select));
+
+	auto blockIt = method.getBasicBlocks().begin();
+	BasicBlock& entryBlock = *blockIt;
+	BasicBlock& loopBlock = *(++blockIt);
+	BasicBlock& endBlock = *(++blockIt);
+
+	const analysis::LivenessAnalysis liveness(method, true);
+	const analysis::LocalNumbering& numbering = liveness.getLocalNumbering();
+	const auto isLive = [&numbering](const analysis::BitSet& set, const Value& val) -> bool
+	{
+		return set.test(numbering.getNumber(val.local).value());
+	};
+
+	TEST_ASSERT(liveness.getLiveIn(entryBlock).none());
+	TEST_ASSERT_EQUALS(3u, liveness.getLiveOut(entryBlock).count());
+	for(const Value& val : {i, sum, step})
+	{
+		TEST_ASSERT(isLive(liveness.getLiveIn(loopBlock), val));
+		//the values are required in the next iteration of the loop
+		TEST_ASSERT(isLive(liveness.getLiveOut(loopBlock), val));
+	}
+	TEST_ASSERT(!isLive(liveness.getLiveOut(loopBlock), cond));
+	TEST_ASSERT_EQUALS(1u, liveness.getLiveIn(endBlock).count());
+	TEST_ASSERT(isLive(liveness.getLiveIn(endBlock), sum));
+	TEST_ASSERT(liveness.getLiveOut(endBlock).none());
+
+	//the first write of the step is overwritten before being read
+	InstructionWalker it = entryBlock.begin().nextInBlock().nextInBlock().nextInBlock();
+	TEST_ASSERT(!liveness.isLiveAfter(it, step.local));
+	TEST_ASSERT(liveness.isLiveAfter(it.nextInBlock(), step.local));
+
+	std::size_t numInstructions = 0;
+	liveness.forInstructionsInBlock(endBlock, [&numInstructions, &isLive, &select, &res](InstructionWalker it, const analysis::BitSet& liveAfter) -> void
+	{
+		++numInstructions;
+		TEST_ASSERT(!isLive(liveAfter, res));
+	});
+	TEST_ASSERT_EQUALS(4u, numInstructions);
+
+	//if only unconditional writes end the live-range, the selected value is live from the start of the method
+	const analysis::LivenessAnalysis strictLiveness(method, false);
+	TEST_ASSERT_EQUALS(1u, strictLiveness.getLiveIn(entryBlock).count());
+	TEST_ASSERT(strictLiveness.getLiveIn(entryBlock).test(strictLiveness.getLocalNumbering().getNumber(select.local).value()));
+}
+
+void TestInstructions::testLiveIntervals()
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	const Value a = method.addNewLocal(TYPE_INT32, "%a");
+	const Value b = method.addNewLocal(TYPE_INT32, "%b");
+	const Value c = method.addNewLocal(TYPE_INT32, "%c");
+
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%entry")));
+	method.appendToEnd(new intermediate::MoveOperation(a, INT_ONE));
+	method.appendToEnd(new intermediate::MoveOperation(b, a));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::WAIT_REGISTER));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::WAIT_REGISTER));
+	method.appendToEnd(new intermediate::Operation("add", c, b, a));
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%next")));
+	method.appendToEnd(new intermediate::MoveOperation(c, c));
+
+	BasicBlock& entryBlock = method.getBasicBlocks().front();
+	const Optional<LiveInterval> intervalA = method.getLiveInterval(a.local);
+	TEST_ASSERT(!!intervalA);
+	TEST_ASSERT_EQUALS(&entryBlock, intervalA->block);
+	TEST_ASSERT_EQUALS(1u, intervalA->first);
+	TEST_ASSERT_EQUALS(5u, intervalA->last);
+	//c is used in both blocks
+	const Optional<LiveInterval> intervalC = method.getLiveInterval(c.local);
+	TEST_ASSERT(!!intervalC);
+	TEST_ASSERT(intervalC->block == nullptr);
+	TEST_ASSERT_EQUALS(5u, intervalC->first);
+	TEST_ASSERT_EQUALS(7u, intervalC->last);
+
+	InstructionWalker it = entryBlock.begin().nextInBlock();
+	TEST_ASSERT(entryBlock.isLocallyLimited(it, a.local));
+	TEST_ASSERT(!entryBlock.isLocallyLimited(it, a.local, 3));
+	TEST_ASSERT(!entryBlock.isLocallyLimited(it, c.local));
+
+	//modifying the users without modifying the instruction lists updates the cached interval
+	it.nextInBlock()->setArgument(0, INT_ZERO);
+	const Optional<LiveInterval> modifiedA = method.getLiveInterval(a.local);
+	TEST_ASSERT_EQUALS(1u, modifiedA->first);
+	TEST_ASSERT_EQUALS(5u, modifiedA->last);
+	it.nextInBlock().nextInBlock().nextInBlock()->setArgument(1, INT_ZERO);
+	TEST_ASSERT_EQUALS(1u, method.getLiveInterval(a.local)->last);
+	TEST_ASSERT(entryBlock.isLocallyLimited(entryBlock.begin().nextInBlock(), a.local, 0));
+
+	//inserting instructions moves the positions of all following users
+	entryBlock.begin().nextInBlock().emplace(new intermediate::Nop(intermediate::DelayType::WAIT_REGISTER));
+	TEST_ASSERT_EQUALS(2u, method.getLiveInterval(a.local)->first);
+	TEST_ASSERT_EQUALS(6u, method.getLiveInterval(c.local)->first);
+	TEST_ASSERT(!method.getLiveInterval(method.addNewLocal(TYPE_INT32, "%unused").local));
+}
+
+void TestInstructions::testRegisterBlockedByWrite()
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	const Value a = method.addNewLocal(TYPE_INT32, "%a");
+	const Value b = method.addNewLocal(TYPE_INT32, "%b");
+
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%entry")));
+	method.appendToEnd(new intermediate::MoveOperation(a, INT_ONE));
+	//this value of %b is never read, but the write still must not clobber the live value of %a
+	method.appendToEnd(new intermediate::MoveOperation(b, Value(Literal(static_cast<int64_t>(5)), TYPE_INT32)));
+	method.appendToEnd(new intermediate::Operation("add", b, a, INT_ONE));
+	method.appendToEnd(new intermediate::MoveOperation(Value(REG_NOP, TYPE_INT32), b));
+
+	optimizations::AnalysisManager analyses(method);
+	qpu_asm::GraphColoring coloring(method, method.walkAllInstructions(), analyses);
+	TEST_ASSERT(coloring.colorGraph());
+	const FastMap<const Local*, Register> registers = coloring.toRegisterMap();
+	TEST_ASSERT(registers.at(a.local) != registers.at(b.local));
+	//the method is not modified, so coloring the graph again re-uses the cached liveness
+	const analysis::LivenessAnalysis* liveness = &analyses.getLiveness(true);
+	TEST_ASSERT(coloring.colorGraph());
+	TEST_ASSERT(liveness == &analyses.getLiveness(true));
+}
+
+void TestInstructions::testNodeCoalescing()
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	const Value a = method.addNewLocal(TYPE_INT32, "%a");
+	const Value b = method.addNewLocal(TYPE_INT32, "%b");
+	const Value c = method.addNewLocal(TYPE_INT32, "%c");
+	const Value d = method.addNewLocal(TYPE_INT32, "%d");
+
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%entry")));
+	method.appendToEnd(new intermediate::MoveOperation(a, INT_ONE));
+	//%a is not read afterwards, so the copy can use the same register
+	method.appendToEnd(new intermediate::MoveOperation(b, a));
+	method.appendToEnd(new intermediate::Operation("add", c, b, INT_ONE));
+	//%c is still read afterwards, so the copy needs another register
+	method.appendToEnd(new intermediate::MoveOperation(d, c));
+	method.appendToEnd(new intermediate::Operation("add", Value(REG_NOP, TYPE_INT32), c, d));
+
+	optimizations::AnalysisManager analyses(method);
+	qpu_asm::GraphColoring coloring(method, method.walkAllInstructions(), analyses);
+	TEST_ASSERT(coloring.colorGraph());
+	const FastMap<const Local*, Register> registers = coloring.toRegisterMap();
+	TEST_ASSERT_EQUALS(registers.at(a.local), registers.at(b.local));
+	TEST_ASSERT(registers.at(c.local) != registers.at(d.local));
+}
+
+void TestInstructions::testDMAVPMAddress()
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	const Value addr = method.addNewLocal(TYPE_INT32.toPointerType(), "%addr");
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%entry")));
+	//the area is located behind the scratch area, in the second row of the VPM
+	const periphery::VPMArea* area = method.vpm->addArea(addr.local, 64);
+	TEST_ASSERT(area != nullptr);
+	TEST_ASSERT_EQUALS(64u, area->baseOffset);
+
+	InstructionWalker it = method.walkAllInstructions().nextInBlock();
+	it = method.vpm->insertReadRAM(it, addr, TYPE_INT32.toVectorType(16), area, false);
+	it = method.vpm->insertWriteRAM(it, addr, TYPE_INT32.toVectorType(16), area, false);
+
+	unsigned numSetups = 0;
+	it = method.walkAllInstructions();
+	while(!it.isEndOfMethod())
+	{
+		const intermediate::LoadImmediate* load = it.get<const intermediate::LoadImmediate>();
+		if(load != nullptr && load->getOutput()->hasRegister(REG_VPM_IN_SETUP))
+		{
+			const periphery::VPRSetup setup(static_cast<uint32_t>(load->getImmediate().integer));
+			if(setup.isDMASetup())
+			{
+				//the DMA address is given in words: {Y[6:0], X[3:0]}
+				TEST_ASSERT_EQUALS(static_cast<uint16_t>(1 << 4), setup.dmaSetup.getAddress());
+				++numSetups;
+			}
+		}
+		if(load != nullptr && load->getOutput()->hasRegister(REG_VPM_OUT_SETUP))
+		{
+			const periphery::VPWSetup setup(static_cast<uint32_t>(load->getImmediate().integer));
+			if(setup.isDMASetup())
+			{
+				TEST_ASSERT_EQUALS(static_cast<uint16_t>(1 << 4), setup.dmaSetup.getVPMBase());
+				++numSetups;
+			}
+		}
+		it.nextInMethod();
+	}
+	TEST_ASSERT_EQUALS(2u, numSetups);
+}
+
+void TestInstructions::testLocalsUsedTogether()
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	const Value a = method.addNewLocal(TYPE_INT32, "%a");
+	const Value b = method.addNewLocal(TYPE_INT32, "%b");
+	const Value c = method.addNewLocal(TYPE_INT32, "%c");
+	const Value d = method.addNewLocal(TYPE_INT32, "%d");
+	const Value x = method.addNewLocal(TYPE_INT32, "%x");
+	const Value y = method.addNewLocal(TYPE_INT32, "%y");
+
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%entry")));
+	//the ADD and the MUL ALU read their inputs in the same instruction
+	method.appendToEnd(new intermediate::CombinedOperation(new intermediate::Operation(OP_ADD, x, a, b), new intermediate::Operation(OP_MUL24, y, c, d)));
+
+	FastSet<const Local*> usedTogether;
+	qpu_asm::forLocalsUsedTogether(a.local, [&usedTogether](const Local* l) -> void { usedTogether.emplace(l); });
+	TEST_ASSERT(usedTogether.find(b.local) != usedTogether.end());
+	TEST_ASSERT(usedTogether.find(c.local) != usedTogether.end());
+	TEST_ASSERT(usedTogether.find(d.local) != usedTogether.end());
+	TEST_ASSERT(usedTogether.find(a.local) == usedTogether.end());
+}
+
+void TestInstructions::testValueRange()
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	method.parameters.reserve(4);
+	method.parameters.emplace_back(Parameter("%unknown", TYPE_INT32));
+	method.parameters.emplace_back(Parameter("%uchar", TYPE_INT8, ParameterDecorations::ZERO_EXTEND));
+	method.parameters.emplace_back(Parameter("%char", TYPE_INT8, ParameterDecorations::SIGN_EXTEND));
+	method.parameters.emplace_back(Parameter("%short", TYPE_INT16, ParameterDecorations::SIGN_EXTEND));
+	const Value unknown(&method.parameters[0], TYPE_INT32);
+	const Value zeroExtended(&method.parameters[1], TYPE_INT8);
+	const Value signExtended(&method.parameters[2], TYPE_INT8);
+	const Value signExtendedShort(&method.parameters[3], TYPE_INT16);
+
+	const Value masked = method.addNewLocal(TYPE_INT32, "%masked");
+	const Value maskedUnknown = method.addNewLocal(TYPE_INT32, "%masked_unknown");
+	const Value ored = method.addNewLocal(TYPE_INT32, "%or");
+	const Value oredNegative = method.addNewLocal(TYPE_INT32, "%or_negative");
+	const Value shifted = method.addNewLocal(TYPE_INT32, "%shl");
+	const Value shiftedOverflow = method.addNewLocal(TYPE_INT32, "%shl_overflow");
+	const Value shiftedRight = method.addNewLocal(TYPE_INT32, "%shr");
+	const Value sum = method.addNewLocal(TYPE_INT32, "%sum");
+	const Value maxInt = method.addNewLocal(TYPE_INT32, "%max_int");
+	const Value sumOverflow = method.addNewLocal(TYPE_INT32, "%sum_overflow");
+	const Value counter = method.addNewLocal(TYPE_INT32, "%counter");
+	const Value localId = method.addNewLocal(TYPE_INT8, "%local_id");
+	const Value localSize = method.addNewLocal(TYPE_INT8, "%local_size");
+
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%entry")));
+	method.appendToEnd(new intermediate::Operation(OP_AND, masked, unknown, Value(Literal(static_cast<int64_t>(0xFF)), TYPE_INT32)));
+	method.appendToEnd(new intermediate::Operation(OP_AND, maskedUnknown, unknown, signExtended));
+	method.appendToEnd(new intermediate::Operation(OP_OR, ored, masked, Value(Literal(static_cast<int64_t>(0x100)), TYPE_INT32)));
+	method.appendToEnd(new intermediate::Operation(OP_OR, oredNegative, masked, signExtended));
+	method.appendToEnd(new intermediate::Operation(OP_SHL, shifted, masked, Value(Literal(static_cast<int64_t>(8)), TYPE_INT32)));
+	method.appendToEnd(new intermediate::Operation(OP_SHL, shiftedOverflow, masked, Value(Literal(static_cast<int64_t>(24)), TYPE_INT32)));
+	method.appendToEnd(new intermediate::Operation(OP_SHR, shiftedRight, unknown, Value(Literal(static_cast<int64_t>(8)), TYPE_INT32)));
+	method.appendToEnd(new intermediate::Operation(OP_ADD, sum, masked, zeroExtended));
+	method.appendToEnd(new intermediate::Operation(OP_AND, maxInt, unknown, Value(Literal(static_cast<int64_t>(0x7FFFFFFF)), TYPE_INT32)));
+	method.appendToEnd(new intermediate::Operation(OP_ADD, sumOverflow, maxInt, INT_ONE));
+	//loop counter, depending on itself
+	method.appendToEnd(new intermediate::MoveOperation(counter, INT_ZERO));
+	method.appendToEnd(new intermediate::Operation(OP_ADD, counter, counter, INT_ONE));
+	method.appendToEnd(new intermediate::MethodCall(localId, "vc4cl_local_id"));
+	method.appendToEnd(new intermediate::MethodCall(localSize, "vc4cl_local_size"));
+
+	const auto range = [&method](const Value& val) -> analysis::ValueRange
+	{
+		return analysis::ValueRange::getValueRange(val, method);
+	};
+	const auto assertRange = [&range](int64_t minValue, int64_t maxValue, const Value& val) -> void
+	{
+		const analysis::ValueRange r = range(val);
+		TEST_ASSERT_EQUALS(minValue, r.minValue);
+		TEST_ASSERT_EQUALS(maxValue, r.maxValue);
+	};
+
+	assertRange(42, 42, Value(Literal(static_cast<int64_t>(42)), TYPE_INT32));
+	//literals are interpreted as the 32-bit register contents
+	assertRange(-1, -1, Value(Literal(static_cast<int64_t>(0xFFFFFFFF)), TYPE_INT32));
+	TEST_ASSERT(range(unknown).isUnknown());
+
+	assertRange(0, 0xFF, masked);
+	TEST_ASSERT(range(maskedUnknown).isUnknown());
+	assertRange(0, 0x1FF, ored);
+	TEST_ASSERT(range(oredNegative).isUnknown());
+	assertRange(0, 0xFF00, shifted);
+	//the shift could move set bits into the sign bit
+	TEST_ASSERT(range(shiftedOverflow).isUnknown());
+	assertRange(0, 0xFFFFFF, shiftedRight);
+	assertRange(0, 0x1FE, sum);
+	assertRange(0, 0x7FFFFFFF, maxInt);
+	//the addition could wrap around
+	TEST_ASSERT(range(sumOverflow).isUnknown());
+	TEST_ASSERT(range(counter).isUnknown());
+
+	assertRange(0, 0xFF, zeroExtended);
+	assertRange(-128, 127, signExtended);
+	assertRange(-32768, 32767, signExtendedShort);
+	TEST_ASSERT(range(zeroExtended).fitsIntoUnsignedBits(8));
+	TEST_ASSERT(!range(signExtended).fitsIntoUnsignedBits(8));
+	TEST_ASSERT(range(signExtendedShort).absoluteFitsIntoBits(16));
+	TEST_ASSERT(!range(signExtendedShort).absoluteFitsIntoBits(15));
+
+	//without the work-group size, the local ID and size are bounded by the byte they are stored in
+	assertRange(0, 0xFE, localId);
+	assertRange(0, 0xFF, localSize);
+	method.metaData.workGroupSizes = {12, 4, 1};
+	assertRange(0, 11, localId);
+	assertRange(0, 12, localSize);
+}
+
+void TestInstructions::testFallThroughBlocks()
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	const Local* endLabel = method.findOrCreateLocal(TYPE_LABEL, "%end");
+	const Local* elseLabel = method.findOrCreateLocal(TYPE_LABEL, "%else");
+	const Value a = method.addNewLocal(TYPE_INT32, "%a");
+	const Value b = method.addNewLocal(TYPE_INT32, "%b");
+	const Value c = method.addNewLocal(TYPE_INT32, "%c");
+	const Value cond = method.addNewLocal(TYPE_BOOL, "%cond");
+
+	//unconditional branch with all delay slots filled
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%entry")));
+	method.appendToEnd(new intermediate::MoveOperation(cond, INT_ONE));
+	method.appendToEnd(new intermediate::Branch(endLabel, COND_ALWAYS, BOOL_TRUE));
+	method.appendToEnd(new intermediate::MoveOperation(a, INT_ONE));
+	method.appendToEnd(new intermediate::MoveOperation(b, INT_ONE));
+	method.appendToEnd(new intermediate::MoveOperation(c, INT_ONE));
+	//either-or branches, the delay slots of the first one are filled
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%then")));
+	method.appendToEnd(new intermediate::Branch(endLabel, COND_ZERO_CLEAR, cond));
+	method.appendToEnd(new intermediate::MoveOperation(a, b));
+	method.appendToEnd(new intermediate::MoveOperation(b, c));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::BRANCH_DELAY));
+	method.appendToEnd(new intermediate::Branch(elseLabel, COND_ZERO_SET, cond));
+	method.appendToEnd(new intermediate::MoveOperation(c, a));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::BRANCH_DELAY));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::BRANCH_DELAY));
+	//conditional branch with all delay slots filled
+	method.appendToEnd(new intermediate::BranchLabel(*elseLabel));
+	method.appendToEnd(new intermediate::Branch(endLabel, COND_ZERO_CLEAR, cond));
+	method.appendToEnd(new intermediate::MoveOperation(a, c));
+	method.appendToEnd(new intermediate::MoveOperation(b, a));
+	method.appendToEnd(new intermediate::MoveOperation(c, b));
+	//instructions behind the delay slots of a conditional branch
+	method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%next")));
+	method.appendToEnd(new intermediate::Branch(endLabel, COND_ZERO_CLEAR, cond));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::BRANCH_DELAY));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::BRANCH_DELAY));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::BRANCH_DELAY));
+	method.appendToEnd(new intermediate::MoveOperation(a, b));
+	method.appendToEnd(new intermediate::Branch(endLabel, COND_ALWAYS, BOOL_TRUE));
+	method.appendToEnd(new intermediate::MoveOperation(b, INT_ZERO));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::BRANCH_DELAY));
+	method.appendToEnd(new intermediate::Nop(intermediate::DelayType::BRANCH_DELAY));
+	method.appendToEnd(new intermediate::BranchLabel(*endLabel));
+	method.appendToEnd(new intermediate::MoveOperation(c, a));
+
+	auto blockIt = method.getBasicBlocks().begin();
+	TEST_ASSERT(!blockIt->fallsThroughToNextBlock());
+	TEST_ASSERT(!(++blockIt)->fallsThroughToNextBlock());
+	TEST_ASSERT((++blockIt)->fallsThroughToNextBlock());
+	TEST_ASSERT(!(++blockIt)->fallsThroughToNextBlock());
+	TEST_ASSERT((++blockIt)->fallsThroughToNextBlock());
+}
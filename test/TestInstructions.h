@@ -18,6 +18,16 @@ public:
 	void testConditionCodes();
 	void testConstantSaturations();
 	void testBitfields();
+	void testValueHashing();
+	void testLocalUsers();
+	void testLivenessAnalysis();
+	void testLiveIntervals();
+	void testRegisterBlockedByWrite();
+	void testNodeCoalescing();
+	void testDMAVPMAddress();
+	void testLocalsUsedTogether();
+	void testValueRange();
+	void testFallThroughBlocks();
 };
 
 #endif /* TEST_INSTRUCTIONS_H */
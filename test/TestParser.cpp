@@ -8,7 +8,10 @@
 #include "../lib/cpplog/include/log.h"
 #include "../lib/cpplog/include/logger.h"
 
+#include "Module.h"
+
 #include <fstream>
+#include <sstream>
 
 using namespace vc4c;
 
@@ -21,6 +24,8 @@ TestParser::TestParser() : parser1(source1), parser2(source2)
     TEST_ADD(TestParser::testGlobalData);
     TEST_ADD(TestParser::testStructDefinition);
     TEST_ADD(TestParser::testUnionDefinition);
+    TEST_ADD(TestParser::testParameterQualifiers);
+    TEST_ADD(TestParser::testModuleTypes);
 }
 
 bool TestParser::setup()
@@ -61,15 +66,110 @@ void TestParser::testKernelMethod()
 
 void TestParser::testGlobalData()
 {
+	//the address space of the generic pointer parameter is only known after the meta-data is parsed
+	std::stringstream source(R"(
+define spir_kernel void @test(i32 addrspace(4)* nocapture %out) !kernel_arg_addr_space !1 {
+  ret void
+}
+
+!1 = !{i32 1}
+)");
+	Configuration config;
+	Module module(config);
+	llvm2qasm::IRParser parser(source);
+	parser.parse(module);
 
+	TEST_ASSERT_EQUALS(1u, module.methods.size());
+	const Parameter& param = module.methods.front()->parameters.at(0);
+	TEST_ASSERT(param.type.getPointerType());
+	TEST_ASSERT(AddressSpace::GLOBAL == param.type.getPointerType().value()->addressSpace);
+	TEST_ASSERT_EQUALS(TYPE_INT32, param.type.getElementType());
 }
 
 void TestParser::testStructDefinition()
 {
+	//the global is parsed before the end of the struct definitions, but %struct.A references %struct.B declared after it
+	std::stringstream source(R"(
+%struct.A = type { %struct.B, i32 }
+%struct.B = type { i32, i32 }
 
+@g = addrspace(2) constant %struct.A { %struct.B { i32 1, i32 2 }, i32 3 }, align 4
+
+define spir_kernel void @test(i32 addrspace(1)* nocapture %out) !kernel_arg_addr_space !1 {
+  ret void
+}
+
+!1 = !{i32 1}
+)");
+	Configuration config;
+	Module module(config);
+	llvm2qasm::IRParser parser(source);
+	parser.parse(module);
+
+	TEST_ASSERT_EQUALS(1u, module.globalData.size());
+	const DataType globalType = module.globalData.front().type.getElementType();
+	TEST_ASSERT(globalType.getStructType());
+	TEST_ASSERT_EQUALS(2u, globalType.getStructType().value()->elementTypes.size());
+	const DataType nestedType = globalType.getStructType().value()->elementTypes.at(0);
+	TEST_ASSERT(nestedType.getStructType());
+	TEST_ASSERT_EQUALS(2u, nestedType.getStructType().value()->elementTypes.size());
 }
 
 void TestParser::testUnionDefinition()
 {
 
 }
+
+void TestParser::testParameterQualifiers()
+{
+	std::stringstream source(R"(
+define spir_kernel void @test(i32 addrspace(1)* nocapture readonly %a, i32 addrspace(1)* nocapture %b, i32 addrspace(1)* nocapture %c) !kernel_arg_addr_space !1 !kernel_arg_type_qual !2 {
+  ret void
+}
+
+!1 = !{i32 1, i32 1, i32 1}
+!2 = !{!"const restrict", !"volatile", !""}
+)");
+	Configuration config;
+	Module module(config);
+	llvm2qasm::IRParser parser(source);
+	parser.parse(module);
+
+	TEST_ASSERT_EQUALS(1u, module.methods.size());
+	const Parameter& a = module.methods.front()->parameters.at(0);
+	const Parameter& b = module.methods.front()->parameters.at(1);
+	const Parameter& c = module.methods.front()->parameters.at(2);
+	TEST_ASSERT(has_flag(a.decorations, ParameterDecorations::READ_ONLY));
+	TEST_ASSERT(has_flag(a.decorations, ParameterDecorations::RESTRICT));
+	//a constant restricted pointer is not volatile
+	TEST_ASSERT(!has_flag(a.decorations, ParameterDecorations::VOLATILE));
+	TEST_ASSERT(has_flag(b.decorations, ParameterDecorations::VOLATILE));
+	TEST_ASSERT(!has_flag(b.decorations, ParameterDecorations::READ_ONLY));
+	TEST_ASSERT(!has_flag(b.decorations, ParameterDecorations::RESTRICT));
+	TEST_ASSERT(!has_flag(c.decorations, ParameterDecorations::VOLATILE));
+}
+
+void TestParser::testModuleTypes()
+{
+	//types created outside of any module are kept after the module is destroyed
+	const DataType outerType = TYPE_INT16.toPointerType(AddressSpace::LOCAL);
+	{
+		Configuration config;
+		Module module(config);
+		const DataType structType = DataType::createStructType("%struct.S", {outerType, TYPE_INT32.toArrayType(4)});
+		TEST_ASSERT_EQUALS(outerType, structType.getElementType(0));
+		TEST_ASSERT_EQUALS(outerType, TYPE_INT16.toPointerType(AddressSpace::LOCAL));
+	}
+	TEST_ASSERT_EQUALS(std::string("i16*"), outerType.to_string());
+	TEST_ASSERT_EQUALS(TYPE_INT16, outerType.getElementType());
+
+	//the types released with the first module are created anew for the next one
+	Configuration config;
+	Module module(config);
+	const DataType structType = DataType::createStructType("%struct.S", {outerType, TYPE_INT32.toArrayType(4)});
+	TEST_ASSERT(structType.getStructType());
+	TEST_ASSERT_EQUALS(std::string("%struct.S"), structType.to_string());
+	TEST_ASSERT_EQUALS(outerType, structType.getElementType(0));
+	TEST_ASSERT_EQUALS(TYPE_INT32.toArrayType(4), structType.getElementType(1));
+	TEST_ASSERT_EQUALS(TYPE_INT32, structType.getElementType(1).getElementType());
+}
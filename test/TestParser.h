@@ -21,6 +21,8 @@ public:
     void testGlobalData();
     void testStructDefinition();
     void testUnionDefinition();
+    void testParameterQualifiers();
+    void testModuleTypes();
     
 private:
     vc4c::llvm2qasm::IRParser parser1;
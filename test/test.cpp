@@ -9,6 +9,7 @@
 
 #include "cpptest.h"
 #include "cpptest-main.h"
+#include "TestEmulator.h"
 #include "TestInstructions.h"
 #include "TestOperators.h"
 #include "TestParser.h"
@@ -61,6 +62,7 @@ int main(int argc, char** argv)
     Test::registerSuite(Test::newInstance<TestParser>, "test-parser", "Tests the LLVM IR parser");
     Test::registerSuite(Test::newInstance<TestInstructions>, "test-instructions", "Tests some common instruction handling");
     Test::registerSuite(Test::newInstance<TestSPIRVFrontend>, "test-spirv", "Tests the SPIR-V front-end");
+    Test::registerSuite(Test::newInstance<TestEmulator>, "test-emulator", "Tests the emulation of QPU code");
     Test::registerSuite(newLLVMCompilationTest<true>, "regressions-llvm", "Runs the regression-test using the LLVM-IR front-end", false);
     Test::registerSuite(newSPIRVCompiltionTest<true>, "regressions-spirv", "Runs the regression-test using the SPIR-V front-end", false);
     Test::registerSuite(newCompilationTest<true>, "regressions", "Runs the regression-test using the default front-end", false);
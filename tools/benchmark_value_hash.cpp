@@ -0,0 +1,72 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Locals.h"
+#include "Values.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace vc4c;
+
+/*
+ * Micro-benchmark for hashing values, comparing the structural vc4c::hash<Value> with hashing the string-representation of the value
+ *
+ * Inserts 4032 locals, literals and registers 20 times and looks them up 50 times in an unordered set.
+ */
+
+struct StringHash
+{
+	std::size_t operator()(const Value& val) const
+	{
+		return std::hash<std::string>{}(val.to_string());
+	}
+};
+
+template<typename Hash>
+static double runBenchmark(const std::vector<Value>& values)
+{
+	const auto start = std::chrono::steady_clock::now();
+	std::unordered_set<Value, Hash> set;
+	for(unsigned round = 0; round < 20; ++round)
+	{
+		for(const Value& val : values)
+			set.insert(val);
+	}
+	std::size_t found = 0;
+	for(unsigned round = 0; round < 50; ++round)
+	{
+		for(const Value& val : values)
+			found += set.count(val);
+	}
+	const auto end = std::chrono::steady_clock::now();
+	if(found != 50 * values.size())
+		std::cerr << "Not all values found: " << found << std::endl;
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<Parameter> locals;
+	locals.reserve(2000);
+	std::vector<Value> values;
+	for(int i = 0; i < 2000; ++i)
+	{
+		locals.emplace_back("%local_" + std::to_string(i), TYPE_INT32);
+		values.emplace_back(&locals.back(), TYPE_INT32);
+	}
+	for(int i = 0; i < 2000; ++i)
+		values.emplace_back(Literal(static_cast<int64_t>(i)), TYPE_INT32);
+	for(unsigned char i = 0; i < 32; ++i)
+		values.emplace_back(Register(RegisterFile::PHYSICAL_A, i), TYPE_INT32);
+
+	std::cout << "to_string() hash: " << runBenchmark<StringHash>(values) << " ms" << std::endl;
+	std::cout << "structural hash: " << runBenchmark<vc4c::hash<Value>>(values) << " ms" << std::endl;
+	return 0;
+}
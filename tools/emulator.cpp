@@ -0,0 +1,141 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "CompilationError.h"
+#include "log.h"
+#include "tools.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace vc4c;
+using namespace vc4c::tools;
+
+static void printHelp()
+{
+	std::cerr << "Usage: vc4emul [options] <module> [<kernel>] <arguments>" << std::endl;
+	std::cerr << "options:" << std::endl;
+	std::cerr << "\t--local-size x,y,z\tThe number of work-items per work-group (at most 12 in total, default 1,1,1)" << std::endl;
+	std::cerr << "\t--groups x,y,z\t\tThe number of work-groups (default 1,1,1)" << std::endl;
+	std::cerr << "\t--global-offset x,y,z\tThe global offset (default 0,0,0)" << std::endl;
+	std::cerr << "\t--max-cycles <n>\tAborts the emulation after the given number of cycles per work-group" << std::endl;
+	std::cerr << "\t--dump-buffers\t\tPrints the contents of all buffers after the execution" << std::endl;
+	std::cerr << "arguments (one per kernel parameter, in order):" << std::endl;
+	std::cerr << "\t-i <int>\t\tAn integer scalar" << std::endl;
+	std::cerr << "\t-f <float>\t\tA floating-point scalar" << std::endl;
+	std::cerr << "\t-v <a,b,c,...>\t\tAn integer vector" << std::endl;
+	std::cerr << "\t-b <n>\t\t\tA buffer of n zero-initialized words" << std::endl;
+	std::cerr << "\t-B <a,b,c,...>\t\tA buffer with the given integer words" << std::endl;
+}
+
+static std::vector<uint32_t> parseList(const std::string& list)
+{
+	std::vector<uint32_t> values;
+	std::stringstream s(list);
+	std::string part;
+	while(std::getline(s, part, ','))
+		values.push_back(static_cast<uint32_t>(std::strtoll(part.data(), nullptr, 0)));
+	return values;
+}
+
+static std::array<uint32_t, 3> parseDimensions(const std::string& list)
+{
+	const std::vector<uint32_t> values = parseList(list);
+	if(values.empty() || values.size() > 3)
+		throw CompilationError(CompilationStep::GENERAL, "Invalid number of dimensions", list);
+	std::array<uint32_t, 3> dims{{1, 1, 1}};
+	std::copy(values.begin(), values.end(), dims.begin());
+	return dims;
+}
+
+/*
+ * Emulates a single kernel of a compiled module and prints the collected statistics
+ */
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		printHelp();
+		return 1;
+	}
+
+	EmulationData data;
+	bool dumpBuffers = false;
+	std::string moduleFile;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const bool hasNext = i + 1 < argc;
+		if(strcmp("--local-size", argv[i]) == 0 && hasNext)
+			data.localSizes = parseDimensions(argv[++i]);
+		else if(strcmp("--groups", argv[i]) == 0 && hasNext)
+			data.numGroups = parseDimensions(argv[++i]);
+		else if(strcmp("--global-offset", argv[i]) == 0 && hasNext)
+			data.globalOffsets = parseDimensions(argv[++i]);
+		else if(strcmp("--max-cycles", argv[i]) == 0 && hasNext)
+			data.maxCycles = std::strtoull(argv[++i], nullptr, 0);
+		else if(strcmp("--dump-buffers", argv[i]) == 0)
+			dumpBuffers = true;
+		else if(strcmp("-i", argv[i]) == 0 && hasNext)
+			data.parameters.push_back(ParameterValue::fromScalar(static_cast<uint32_t>(std::strtoll(argv[++i], nullptr, 0))));
+		else if(strcmp("-f", argv[i]) == 0 && hasNext)
+		{
+			const float f = std::strtof(argv[++i], nullptr);
+			uint32_t bits;
+			std::memcpy(&bits, &f, sizeof(bits));
+			data.parameters.push_back(ParameterValue::fromScalar(bits));
+		}
+		else if(strcmp("-v", argv[i]) == 0 && hasNext)
+			data.parameters.push_back(ParameterValue::fromVector(parseList(argv[++i])));
+		else if(strcmp("-b", argv[i]) == 0 && hasNext)
+			data.parameters.push_back(ParameterValue::fromBuffer(std::vector<uint32_t>(std::strtoul(argv[++i], nullptr, 0), 0)));
+		else if(strcmp("-B", argv[i]) == 0 && hasNext)
+			data.parameters.push_back(ParameterValue::fromBuffer(parseList(argv[++i])));
+		else if(moduleFile.empty())
+			moduleFile = argv[i];
+		else if(data.kernelName.empty() && argv[i][0] != '-')
+			data.kernelName = argv[i];
+		else
+		{
+			std::cerr << "Invalid argument: " << argv[i] << std::endl;
+			printHelp();
+			return 1;
+		}
+	}
+
+	std::ifstream module(moduleFile, std::ios_base::in | std::ios_base::binary);
+	if(!module)
+	{
+		std::cerr << "Failed to open module: " << moduleFile << std::endl;
+		return 2;
+	}
+
+	try
+	{
+		const EmulationResult result = emulate(module, data);
+		result.dumpStatistics(std::cout);
+		if(dumpBuffers)
+		{
+			for(std::size_t p = 0; p < result.buffers.size(); ++p)
+			{
+				if(!data.parameters[p].isBuffer)
+					continue;
+				std::cout << "Buffer " << p << ":";
+				for(uint32_t word : result.buffers[p])
+					std::cout << " " << word;
+				std::cout << std::endl;
+			}
+		}
+		return result.completed ? 0 : 3;
+	}
+	catch(const CompilationError& e)
+	{
+		logging::error() << "Emulation failed: " << e.what() << logging::endl;
+		return 4;
+	}
+}